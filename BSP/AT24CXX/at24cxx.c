@@ -13,7 +13,35 @@
 #include <stdbool.h>
 #include <string.h>
 
+#define AT24CXX_FILE_SYSTEM_CATALOGUE_ADDR    (AT24CXX_FILE_SYSTEM_INFO_PAGE_NUM * AT24CXX_FILE_SYSTEM_PAGE_SIZE)
+#define AT24CXX_FILE_SYSTEM_INDEX_ADDR        ((AT24CXX_FILE_SYSTEM_INFO_PAGE_NUM + AT24CXX_FILE_SYSTEM_CATALOGUE_PAGE_NUM) * AT24CXX_FILE_SYSTEM_PAGE_SIZE)
+
+/**
+ * \brief Catalogue entry structure, layout of the 32 bytes in the EEPROM
+ */
+typedef struct
+{
+    uint8_t name[28];                           /*!< File name, 0xFF in name[0]: entry free */
+    uint16_t size;                              /*!< File size, 0xFFFF: never written */
+    uint16_t index;                             /*!< First storage page, 0xFFFF: none */
+}at24cxx_file_system_entry_struct;
+
 at24cxx_file_system_struct at24cxx_file_system_info;
+at24cxx_file_system_cache_struct at24cxx_file_system_cache_info;
+static at24cxx_file_system_entry_struct at24cxx_catalogue[AT24CXX_FILE_SYSTEM_CATALOGUE_NUM];  /* catalogue mirror */
+static uint16_t at24cxx_index[AT24CXX_FILE_SYSTEM_STORAGE_PAGE_NUM];                           /* index mirror */
+static uint8_t at24cxx_hash[AT24CXX_FILE_SYSTEM_HASH_NUM];                                     /* first entry of each bucket, 0xFF: none */
+static uint8_t at24cxx_hash_next[AT24CXX_FILE_SYSTEM_CATALOGUE_NUM];                           /* next entry of the bucket */
+
+/* static function declarations */
+static uint8_t at24cxx_file_system_ready(void);
+static uint8_t at24cxx_file_system_hash(const uint8_t *file_name);
+static void at24cxx_file_system_hash_build(void);
+static void at24cxx_file_system_hash_insert(uint8_t entry);
+static void at24cxx_file_system_hash_remove(uint8_t entry);
+static uint8_t at24cxx_file_system_find(const uint8_t *file_name);
+static void at24cxx_file_system_catalogue_sync(uint8_t entry, uint8_t offset, uint8_t len);
+static void at24cxx_file_system_index_sync(uint16_t *page, uint8_t num);
 
 /*!
     \brief      initialize AT24CXX EEPROM
@@ -28,6 +56,7 @@ void at24cxx_init(void)
         iic_init(&iicDevice_1);
     }
     at24cxx_file_system_info_print();
+    at24cxx_file_system_mount();                                    /* mirror catalogue and index in RAM */
 }
 
 /*!
@@ -197,6 +226,8 @@ void at24cxx_read(uint32_t addr, uint8_t *pbuf, uint16_t datalen)
 {
     uint8_t state = 0;
     addr = addr % 131072;
+    at24cxx_file_system_cache_info.read_bytes += datalen;
+    at24cxx_file_system_cache_info.op_read_bytes += datalen;
     #if EE_TYPE == AT24C512
         while (datalen)
         {
@@ -283,6 +314,8 @@ void at24cxx_write(uint32_t addr, uint8_t *pbuf, uint16_t datalen)
 {
     uint8_t state = 0;
     addr = addr % 131072;  
+    at24cxx_file_system_cache_info.write_bytes += datalen;
+    at24cxx_file_system_cache_info.op_write_bytes += datalen;
     #if EE_TYPE == AT24C512
         while (datalen)
         {
@@ -391,6 +424,13 @@ void at24cxx_file_system_format(void)
         write_start_page ++;
     }
     
+    /* Mirror of the empty catalogue and index */
+    memset(at24cxx_catalogue, 0xFF, sizeof(at24cxx_catalogue));
+    memset(at24cxx_index, 0xEE, sizeof(at24cxx_index));
+    at24cxx_file_system_hash_build();
+    at24cxx_file_system_cache_info.mounted = 1;
+    at24cxx_file_system_cache_info.generation++;
+    
     at24cxx_file_system_info.file_system_state = 0xAA;                                        /* Set file system state flag */
     at24cxx_file_system_info.file_system_total_size = AT24CXX_FILE_SYSTEM_TOTAL_SIZE;
     at24cxx_file_system_info.file_system_page_size = AT24CXX_FILE_SYSTEM_PAGE_SIZE;
@@ -407,6 +447,65 @@ void at24cxx_file_system_format(void)
     PRINT_INFO("at24cxx_file_system is formatted successfully.\r\n");
 }
 
+/*!
+    \brief      mirror the catalogue and the index in RAM
+    \param[in]  none
+    \param[out] none
+    \retval     0 if successful, 1 if no file system exists
+    \note       reads the catalogue and index pages once, the file operations
+                then look up names and pages in RAM
+*/
+uint8_t at24cxx_file_system_mount(void)
+{
+    at24cxx_file_system_cache_info.mounted = 0;
+    if(at24cxx_file_system_info.file_system_state != 0xAA)
+    {
+        return 1;
+    }
+    
+    at24cxx_read(AT24CXX_FILE_SYSTEM_CATALOGUE_ADDR, (uint8_t *)at24cxx_catalogue, sizeof(at24cxx_catalogue));
+    at24cxx_read(AT24CXX_FILE_SYSTEM_INDEX_ADDR, (uint8_t *)at24cxx_index, sizeof(at24cxx_index));
+    at24cxx_file_system_hash_build();
+    at24cxx_file_system_cache_info.mounted = 1;
+    at24cxx_file_system_cache_info.generation++;
+    
+    return 0;
+}
+
+/*!
+    \brief      compare the RAM mirror with the EEPROM
+    \param[in]  none
+    \param[out] none
+    \retval     0 if identical, 1 if not mounted, 2 if the EEPROM differs
+    \note       reads the whole catalogue and index, for consistency checks
+                only; on a difference the mirror is reloaded from the EEPROM
+*/
+uint8_t at24cxx_file_system_verify(void)
+{
+    uint8_t data_temp[AT24CXX_FILE_SYSTEM_PAGE_SIZE];
+    uint16_t i;
+    uint32_t generation = at24cxx_file_system_cache_info.generation;
+    
+    if(at24cxx_file_system_cache_info.mounted == 0)
+    {
+        return 1;
+    }
+    
+    for(i = 0; i < AT24CXX_FILE_SYSTEM_CATALOGUE_PAGE_NUM + AT24CXX_FILE_SYSTEM_INDEX_PAGE_NUM; i++)
+    {
+        at24cxx_read(AT24CXX_FILE_SYSTEM_CATALOGUE_ADDR + i*AT24CXX_FILE_SYSTEM_PAGE_SIZE, data_temp, AT24CXX_FILE_SYSTEM_PAGE_SIZE);
+        if(memcmp(data_temp, (i < AT24CXX_FILE_SYSTEM_CATALOGUE_PAGE_NUM) ? (uint8_t *)at24cxx_catalogue + i*AT24CXX_FILE_SYSTEM_PAGE_SIZE : \
+                  (uint8_t *)at24cxx_index + (i - AT24CXX_FILE_SYSTEM_CATALOGUE_PAGE_NUM)*AT24CXX_FILE_SYSTEM_PAGE_SIZE, AT24CXX_FILE_SYSTEM_PAGE_SIZE) != 0)
+        {
+            PRINT_ERROR("at24cxx_file_system mirror differs at page %d (generation %u), reloaded.\r\n", AT24CXX_FILE_SYSTEM_INFO_PAGE_NUM + i, generation);
+            at24cxx_file_system_mount();
+            return 2;
+        }
+    }
+    
+    return 0;
+}
+
 /*!
     \brief      set file system information
     \param[in]  at24cxx_file_system_info: file system information structure to write
@@ -458,21 +557,18 @@ void at24cxx_file_system_info_print(void)
 */
 void at24cxx_file_system_file_get(void)
 {
-    uint8_t data_temp[AT24CXX_FILE_SYSTEM_PAGE_SIZE];
-    uint8_t i = 0, j = 0, state = 0;
-    uint8_t offset = AT24CXX_FILE_SYSTEM_INFO_PAGE_NUM;
+    uint8_t i = 0, state = 0;
     
-    memset(data_temp, 0xFF, AT24CXX_FILE_SYSTEM_PAGE_SIZE);
-    for(i = 0; i < AT24CXX_FILE_SYSTEM_CATALOGUE_PAGE_NUM; i++)
+    if(at24cxx_file_system_ready() != 0)
     {
-        at24cxx_read((offset + i)*AT24CXX_FILE_SYSTEM_PAGE_SIZE, data_temp, AT24CXX_FILE_SYSTEM_PAGE_SIZE);
-        for(j = 0; j < AT24CXX_FILE_SYSTEM_PAGE_SIZE; j += AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE)
+        return;
+    }
+    for(i = 0; i < AT24CXX_FILE_SYSTEM_CATALOGUE_NUM; i++)
+    {
+        if(at24cxx_catalogue[i].name[0] != 0xFF)
         {
-            if(data_temp[j] != 0xFF)
-            {
-                PRINT_INFO("[%d]%s\r\n",state, &data_temp[j]);
-                state++;
-            }
+            PRINT_INFO("[%d]%.28s\r\n",state, at24cxx_catalogue[i].name);
+            state++;
         }
     }
     if(state == 0)
@@ -489,38 +585,33 @@ void at24cxx_file_system_file_get(void)
 */
 uint8_t at24cxx_file_system_file_creat(const uint8_t *file_name)
 {
-    uint8_t data_temp[AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE];
     uint8_t i = 0, addr = 0, state = 0xFF;
-    uint8_t offset = AT24CXX_FILE_SYSTEM_INFO_PAGE_NUM;
     
-    memset(data_temp, 0xFF, AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE);
-    for(i = 0; i < (AT24CXX_FILE_SYSTEM_CATALOGUE_PAGE_NUM * AT24CXX_FILE_SYSTEM_PAGE_SIZE / AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE); i++)
+    if(at24cxx_file_system_ready() != 0)
     {
-        at24cxx_read(offset*AT24CXX_FILE_SYSTEM_PAGE_SIZE + i*AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE, data_temp, AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE);
-        if(data_temp[0] == 0xFF)
+        return 0xFF;
+    }
+    for(i = 0; i < AT24CXX_FILE_SYSTEM_CATALOGUE_NUM; i++)
+    {
+        if(at24cxx_catalogue[i].name[0] == 0xFF)
         {
             addr = i;
             state = 0;
             break;
         }
     }
-    memset(data_temp, 0xFF, AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE);
-    for(i = 0; i < (AT24CXX_FILE_SYSTEM_CATALOGUE_PAGE_NUM * AT24CXX_FILE_SYSTEM_PAGE_SIZE / AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE); i++)  /* Check for duplicate filenames */
+    if(at24cxx_file_system_find(file_name) != 0xFF)                /* Check for duplicate filenames */
     {
-        at24cxx_read(offset*AT24CXX_FILE_SYSTEM_PAGE_SIZE + i*AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE, data_temp, AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE);
-        if(data_temp[0] != 0xFF)
-        {
-            if(strcmp((char *)data_temp, (char *)file_name) == 0)
-            {
-                state = 1;
-            }
-        }
+        state = 1;
     }
     if(state == 0)
     {
         if(strlen((char *)file_name) < 28)                      /* Filename must be < 28 chars (32-byte entry - 2 bytes size - 2 bytes index) */
         {
-            at24cxx_write(offset * AT24CXX_FILE_SYSTEM_PAGE_SIZE + addr*AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE, (uint8_t *)file_name, strlen((char *)file_name)+1);/* Write filename */
+            memset(&at24cxx_catalogue[addr], 0xFF, AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE);
+            strcpy((char *)at24cxx_catalogue[addr].name, (const char *)file_name);
+            at24cxx_file_system_catalogue_sync(addr, 0, strlen((char *)file_name)+1);   /* Write filename */
+            at24cxx_file_system_hash_insert(addr);
             state = 0;
         }
         else
@@ -556,25 +647,13 @@ uint8_t at24cxx_file_system_file_creat(const uint8_t *file_name)
 */
 uint8_t at24cxx_file_system_file_open(const uint8_t *file_name)
 {
-    uint8_t data_temp[AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE];
-    uint8_t i = 0, addr = 0, state = 0xFF;
-    uint8_t offset = AT24CXX_FILE_SYSTEM_INFO_PAGE_NUM;
+    uint8_t addr = 0xFF;
     
-    memset(data_temp, 0xFF, AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE);
-    for(i = 0; i < (AT24CXX_FILE_SYSTEM_CATALOGUE_PAGE_NUM * AT24CXX_FILE_SYSTEM_PAGE_SIZE / AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE); i++)
+    if(at24cxx_file_system_ready() == 0)
     {
-        at24cxx_read(offset*AT24CXX_FILE_SYSTEM_PAGE_SIZE + i*AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE, data_temp, AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE);
-        if(data_temp[0] != 0xFF)
-        {
-            if(strcmp((char *)data_temp, (char *)file_name) == 0)
-            {
-                state = 0;
-                addr = i;
-                break;
-            }
-        }
+        addr = at24cxx_file_system_find(file_name);
     }
-    if(state == 0)
+    if(addr != 0xFF)
     {
         PRINT_INFO("file(%s) opened  successfully in the at24cxx_file_system.\r\n",file_name);
         return addr; 
@@ -596,32 +675,26 @@ uint8_t at24cxx_file_system_file_open(const uint8_t *file_name)
 */
 uint8_t at24cxx_file_system_file_write(const uint8_t *file_name, const uint8_t *write_data, const uint16_t file_size)
 {
-    uint8_t addr = 0, index_num = 0, temp = 0, sum_check_write=0, sum_check_read=0, n=0;
+    uint8_t addr = 0, index_num = 0, temp = 0, sum_check_write=0, sum_check_read=0, n=0, changed_num = 0;
     uint8_t data_temp[AT24CXX_FILE_SYSTEM_PAGE_SIZE];
-    uint16_t offset = AT24CXX_FILE_SYSTEM_INFO_PAGE_NUM;
+    uint16_t offset = AT24CXX_FILE_SYSTEM_INFO_PAGE_NUM+AT24CXX_FILE_SYSTEM_CATALOGUE_PAGE_NUM+AT24CXX_FILE_SYSTEM_INDEX_PAGE_NUM;
     uint16_t i=0;
     uint16_t index[9];
+    uint16_t changed[16];                                                           /* Index entries to write through, old and new chain */
     
     addr = at24cxx_file_system_file_open(file_name);
     if(addr != 0xFF)
     {
-        memset(data_temp, 0xFF, AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE);
-        at24cxx_read(offset*AT24CXX_FILE_SYSTEM_PAGE_SIZE + addr*AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE, data_temp, AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE);
         if(file_size <= 1024 && file_size)                                  /* Write data size must be <= 1KB */  
         {
             index_num = file_size/AT24CXX_FILE_SYSTEM_PAGE_SIZE;
             if(file_size%AT24CXX_FILE_SYSTEM_PAGE_SIZE)index_num += 1;      /* Calculate required pages */
             temp = index_num;
-            if(*(uint16_t *)(data_temp+30) == 0xFFFF)                       /* First time writing to file */                       
+            if(at24cxx_catalogue[addr].index == 0xFFFF)                     /* First time writing to file */                       
             {
-
-                offset = AT24CXX_FILE_SYSTEM_INFO_PAGE_NUM+AT24CXX_FILE_SYSTEM_CATALOGUE_PAGE_NUM;
                 for(i = 0; i < AT24CXX_FILE_SYSTEM_STORAGE_PAGE_NUM; i++)    /* Search for free pages */
                 {
-                    memset(data_temp, 0xFF, AT24CXX_FILE_SYSTEM_INDEX_SIZE);
-                    at24cxx_read(offset*AT24CXX_FILE_SYSTEM_PAGE_SIZE + i*AT24CXX_FILE_SYSTEM_INDEX_SIZE, data_temp, AT24CXX_FILE_SYSTEM_INDEX_SIZE);
-
-                    if(*(uint16_t *)(data_temp) == 0xEEEE)                  /* Check if page is available */
+                    if(at24cxx_index[i] == 0xEEEE)                          /* Check if page is available */
                     {
                         index[index_num - temp] = i;
                         temp--;
@@ -634,11 +707,15 @@ uint8_t at24cxx_file_system_file_write(const uint8_t *file_name, const uint8_t *
             }
             else
             {
-                at24cxx_read(offset*AT24CXX_FILE_SYSTEM_PAGE_SIZE + addr*AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE+30, (uint8_t *)&index[0], AT24CXX_FILE_SYSTEM_INDEX_SIZE);
-                offset = AT24CXX_FILE_SYSTEM_INFO_PAGE_NUM+AT24CXX_FILE_SYSTEM_CATALOGUE_PAGE_NUM;
+                index[0] = at24cxx_catalogue[addr].index;
                 for(i = 0; i < 8; i++)                                                      /* Search for existing file pages */
                 {
-                    at24cxx_read(offset*AT24CXX_FILE_SYSTEM_PAGE_SIZE + index[i]*AT24CXX_FILE_SYSTEM_INDEX_SIZE, (uint8_t *)&index[i+1], AT24CXX_FILE_SYSTEM_INDEX_SIZE);
+                    if(index[i] >= AT24CXX_FILE_SYSTEM_STORAGE_PAGE_NUM)
+                    {
+                        PRINT_ERROR("file(%s) write failure in the at24cxx_file_system.\r\n",file_name);
+                        return 3;
+                    }
+                    index[i+1] = at24cxx_index[index[i]];
                     if(index[i+1] == 0xFFFF)                                                /* End of file page chain */
                     {
                         temp = i+1;
@@ -649,9 +726,7 @@ uint8_t at24cxx_file_system_file_write(const uint8_t *file_name, const uint8_t *
                 {
                     for(i = 0; i < AT24CXX_FILE_SYSTEM_STORAGE_PAGE_NUM; i++)               /* Search for additional free pages */
                     {
-                        memset(data_temp, 0xFF, AT24CXX_FILE_SYSTEM_INDEX_SIZE);
-                        at24cxx_read(offset*AT24CXX_FILE_SYSTEM_PAGE_SIZE + i*AT24CXX_FILE_SYSTEM_INDEX_SIZE, data_temp, AT24CXX_FILE_SYSTEM_INDEX_SIZE);
-                        if(*(uint16_t *)(data_temp) == 0xEEEE)
+                        if(at24cxx_index[i] == 0xEEEE)
                         {
                             index[temp] = i;
                             temp++;
@@ -667,8 +742,8 @@ uint8_t at24cxx_file_system_file_write(const uint8_t *file_name, const uint8_t *
                 {
                     for(i = index_num; i < temp; i++)
                     {
-                        memset(data_temp, 0xEE, AT24CXX_FILE_SYSTEM_INDEX_SIZE);
-                        at24cxx_write(offset*AT24CXX_FILE_SYSTEM_PAGE_SIZE + index[i]*AT24CXX_FILE_SYSTEM_INDEX_SIZE, data_temp, AT24CXX_FILE_SYSTEM_INDEX_SIZE);
+                        at24cxx_index[index[i]] = 0xEEEE;
+                        changed[changed_num++] = index[i];
                     }
                     temp = 0;
                 }
@@ -676,17 +751,15 @@ uint8_t at24cxx_file_system_file_write(const uint8_t *file_name, const uint8_t *
             if(temp == 0)
             {
                 /* Write index data */
-                offset = AT24CXX_FILE_SYSTEM_INFO_PAGE_NUM;
-                at24cxx_write(offset*AT24CXX_FILE_SYSTEM_PAGE_SIZE + addr*AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE+30, (uint8_t *)&index[0], 2);      /* Write directory index */
-                offset = AT24CXX_FILE_SYSTEM_INFO_PAGE_NUM+AT24CXX_FILE_SYSTEM_CATALOGUE_PAGE_NUM;
-                for(i = 0; i < index_num-1; i++)
+                at24cxx_catalogue[addr].index = index[0];
+                at24cxx_file_system_catalogue_sync(addr, 30, AT24CXX_FILE_SYSTEM_INDEX_SIZE);                  /* Write directory index */
+                for(i = 0; i < index_num; i++)
                 {
-                    at24cxx_write(offset*AT24CXX_FILE_SYSTEM_PAGE_SIZE + index[i]*AT24CXX_FILE_SYSTEM_INDEX_SIZE, (uint8_t *)&index[i+1], 2);   /* Write page chain */
+                    at24cxx_index[index[i]] = (i+1 < index_num) ? index[i+1] : 0xFFFF;                    /* Page chain, end of chain */
+                    changed[changed_num++] = index[i];
                 }
-                memset(data_temp, 0xFF, AT24CXX_FILE_SYSTEM_INDEX_SIZE);
-                at24cxx_write(offset*AT24CXX_FILE_SYSTEM_PAGE_SIZE + index[index_num-1]*AT24CXX_FILE_SYSTEM_INDEX_SIZE, data_temp, AT24CXX_FILE_SYSTEM_INDEX_SIZE);/* Mark end of chain */
+                at24cxx_file_system_index_sync(changed, changed_num);
                 /* Write file data */
-                offset = AT24CXX_FILE_SYSTEM_INFO_PAGE_NUM+AT24CXX_FILE_SYSTEM_CATALOGUE_PAGE_NUM+AT24CXX_FILE_SYSTEM_INDEX_PAGE_NUM;
                 for(i = 0; i < index_num-1; i++)
                 {
                     for(n = 0; n < AT24CXX_FILE_SYSTEM_PAGE_SIZE; n++)
@@ -726,9 +799,10 @@ uint8_t at24cxx_file_system_file_write(const uint8_t *file_name, const uint8_t *
                     PRINT_ERROR("file(%s) write failure in the at24cxx_file_system.\r\n",file_name);
                     return 3;
                 }
-                offset = AT24CXX_FILE_SYSTEM_INFO_PAGE_NUM;
-                at24cxx_write(offset*AT24CXX_FILE_SYSTEM_PAGE_SIZE + addr*AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE+28, (uint8_t *)&file_size, 2);/* Write file size to directory */
-                PRINT_INFO("file(%s) write successfully in the at24cxx_file_system.\r\n",file_name);
+                at24cxx_catalogue[addr].size = file_size;
+                at24cxx_file_system_catalogue_sync(addr, 28, 2);                                      /* Write file size to directory */
+                PRINT_INFO("file(%s) write successfully in the at24cxx_file_system, i2c %u/%u byte(s) read/written.\r\n",file_name, \
+                           at24cxx_file_system_cache_info.op_read_bytes, at24cxx_file_system_cache_info.op_write_bytes);
             }
             else
             {
@@ -749,43 +823,50 @@ uint8_t at24cxx_file_system_file_write(const uint8_t *file_name, const uint8_t *
     \param[in]  file_name: pointer to the file name string to read
     \param[out] read_data: pointer to buffer for storing read data
     \retval     0 if successful, error code if read failed
+    \note       consecutive pages of the chain are read in one transfer
 */
 uint8_t at24cxx_file_system_file_read(const uint8_t *file_name, uint8_t *read_data)
 {
     uint8_t addr = 0, index_num = 0;
-    uint16_t i=0, file_size = 0, temp = 0;
+    uint16_t i=0, file_size = 0, run = 0;
     uint16_t index[8];
-    uint16_t offset = AT24CXX_FILE_SYSTEM_INFO_PAGE_NUM;
+    uint16_t offset = AT24CXX_FILE_SYSTEM_INFO_PAGE_NUM+AT24CXX_FILE_SYSTEM_CATALOGUE_PAGE_NUM+AT24CXX_FILE_SYSTEM_INDEX_PAGE_NUM;
     
     addr = at24cxx_file_system_file_open(file_name);
     if(addr != 0xFF)
     {
-        at24cxx_read(offset*AT24CXX_FILE_SYSTEM_PAGE_SIZE + addr*AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE+28, (uint8_t *)&file_size, 2); /* Get file size */
+        file_size = at24cxx_catalogue[addr].size;                   /* Get file size */
         if(file_size <= 1024 && file_size)
         {
             index_num = file_size/AT24CXX_FILE_SYSTEM_PAGE_SIZE;
             if(file_size%AT24CXX_FILE_SYSTEM_PAGE_SIZE)index_num += 1;
-            at24cxx_read(offset*AT24CXX_FILE_SYSTEM_PAGE_SIZE + addr*AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE+30, (uint8_t *)&index[0], AT24CXX_FILE_SYSTEM_INDEX_SIZE);/* Get first page index */
-            offset = AT24CXX_FILE_SYSTEM_INFO_PAGE_NUM+AT24CXX_FILE_SYSTEM_CATALOGUE_PAGE_NUM;
+            index[0] = at24cxx_catalogue[addr].index;               /* Get first page index */
             if(index[0] != 0xFFFF)
             {
-                for(i = 0; i < index_num-1; i++)                /* Search page chain */
+                for(i = 0; i < index_num; i++)                      /* Search page chain */
                 {
-                    at24cxx_read(offset*AT24CXX_FILE_SYSTEM_PAGE_SIZE + index[i]*AT24CXX_FILE_SYSTEM_INDEX_SIZE, (uint8_t *)&index[i+1], AT24CXX_FILE_SYSTEM_INDEX_SIZE);
-                    at24cxx_read((offset+AT24CXX_FILE_SYSTEM_INDEX_PAGE_NUM)*AT24CXX_FILE_SYSTEM_PAGE_SIZE + index[i]*AT24CXX_FILE_SYSTEM_PAGE_SIZE, read_data, AT24CXX_FILE_SYSTEM_PAGE_SIZE);
-                    read_data += AT24CXX_FILE_SYSTEM_PAGE_SIZE;
-                    if(i+1 == index_num-1)                      /* Read last page validation */
+                    if(index[i] >= AT24CXX_FILE_SYSTEM_STORAGE_PAGE_NUM)
                     {
-                        at24cxx_read(offset*AT24CXX_FILE_SYSTEM_PAGE_SIZE + index[i+1]*AT24CXX_FILE_SYSTEM_INDEX_SIZE, (uint8_t *)&temp, AT24CXX_FILE_SYSTEM_INDEX_SIZE);
-                        if(temp != 0xFFFF)                      /* Check if chain ends correctly */
-                        {
-                            PRINT_ERROR("file(%s) read failure in the at24cxx_file_system.\r\n",file_name);
-                            return 3;
-                        }
+                        PRINT_ERROR("file(%s) read failure in the at24cxx_file_system.\r\n",file_name);
+                        return 3;
                     }
-                }           
-                at24cxx_read((offset+AT24CXX_FILE_SYSTEM_INDEX_PAGE_NUM)*AT24CXX_FILE_SYSTEM_PAGE_SIZE + index[index_num-1]*AT24CXX_FILE_SYSTEM_PAGE_SIZE,\
-                              read_data, file_size-AT24CXX_FILE_SYSTEM_PAGE_SIZE*(index_num-1));
+                    if(i+1 < index_num)
+                    {
+                        index[i+1] = at24cxx_index[index[i]];
+                    }
+                    else if(at24cxx_index[index[i]] != 0xFFFF)      /* Check if chain ends correctly */
+                    {
+                        PRINT_ERROR("file(%s) read failure in the at24cxx_file_system.\r\n",file_name);
+                        return 3;
+                    }
+                }
+                for(i = 0; i < index_num; i += run)
+                {
+                    for(run = 1; (i+run < index_num) && (index[i+run] == index[i]+run); run++);
+                    at24cxx_read(offset*AT24CXX_FILE_SYSTEM_PAGE_SIZE + index[i]*AT24CXX_FILE_SYSTEM_PAGE_SIZE, read_data, \
+                                 (i+run < index_num) ? run*AT24CXX_FILE_SYSTEM_PAGE_SIZE : file_size-AT24CXX_FILE_SYSTEM_PAGE_SIZE*i);
+                    read_data += run*AT24CXX_FILE_SYSTEM_PAGE_SIZE;
+                }
             }
         }
         else
@@ -809,47 +890,34 @@ uint8_t at24cxx_file_system_file_read(const uint8_t *file_name, uint8_t *read_da
 */
 uint8_t at24cxx_file_system_file_delete(const uint8_t *file_name)
 {
-    uint8_t data_temp[AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE];
-    uint8_t i = 0, j = 0, state = 0xFF;
-    uint8_t offset = AT24CXX_FILE_SYSTEM_INFO_PAGE_NUM;
+    uint8_t i = 0xFF, j = 0, changed_num = 0, state = 1;
     uint16_t index[9];
+    uint16_t changed[8];
     
-    memset(data_temp, 0xFF, AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE);
-    for(i = 0; i < (AT24CXX_FILE_SYSTEM_CATALOGUE_PAGE_NUM * AT24CXX_FILE_SYSTEM_PAGE_SIZE / AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE); i++)
+    if(at24cxx_file_system_ready() == 0)
+    {
+        i = at24cxx_file_system_find(file_name);
+    }
+    if(i != 0xFF)
     {
-        at24cxx_read(offset*AT24CXX_FILE_SYSTEM_PAGE_SIZE + i*AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE, data_temp, AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE);
-        if(data_temp[0] != 0xFF)
+        index[0] = at24cxx_catalogue[i].index;
+        at24cxx_file_system_hash_remove(i);
+        memset(&at24cxx_catalogue[i], 0xFF, AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE);
+        at24cxx_file_system_catalogue_sync(i, 0, AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE);     /* Clear directory entry */
+        state = 0;
+        if(index[0] != 0xFFFF)
         {
-            if(strcmp((char *)data_temp, (char *)file_name) == 0)
+            for(j = 0; (j < 8) && (index[j] < AT24CXX_FILE_SYSTEM_STORAGE_PAGE_NUM); j++)
             {
-                index[0] = *(uint16_t *)(data_temp+30);
-                memset(data_temp, 0xFF, AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE);
-                at24cxx_write(offset*AT24CXX_FILE_SYSTEM_PAGE_SIZE + i*AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE, data_temp, AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE);/* Clear directory entry */
-                offset = AT24CXX_FILE_SYSTEM_INFO_PAGE_NUM+AT24CXX_FILE_SYSTEM_CATALOGUE_PAGE_NUM;
-                memset(data_temp, 0xEE, AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE);
-                if(index[0] != 0xFFFF)
+                index[j+1] = at24cxx_index[index[j]];
+                at24cxx_index[index[j]] = 0xEEEE;
+                changed[changed_num++] = index[j];
+                if(index[j+1] == 0xFFFF)
                 {
-                    for(j = 0; j < 8; j++)
-                    {
-                        at24cxx_read(offset*AT24CXX_FILE_SYSTEM_PAGE_SIZE + index[j]*AT24CXX_FILE_SYSTEM_INDEX_SIZE, (uint8_t *)&index[j+1], AT24CXX_FILE_SYSTEM_INDEX_SIZE);
-                        at24cxx_write(offset*AT24CXX_FILE_SYSTEM_PAGE_SIZE + index[j]*AT24CXX_FILE_SYSTEM_INDEX_SIZE, data_temp, AT24CXX_FILE_SYSTEM_INDEX_SIZE);
-                        if(index[j+1] == 0xFFFF)
-                        {
-                            state = 0;
-                            break;
-                        }                   
-                    }
+                    break;
                 }
-                break;
-            }
-            else
-            {
-                state = 1;
             }
-        }
-        if(i+1 == AT24CXX_FILE_SYSTEM_CATALOGUE_PAGE_NUM * AT24CXX_FILE_SYSTEM_PAGE_SIZE / AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE)
-        {
-            state = 1;
+            at24cxx_file_system_index_sync(changed, changed_num);
         }
     }
     if(state == 0)
@@ -862,3 +930,175 @@ uint8_t at24cxx_file_system_file_delete(const uint8_t *file_name)
     }
     return state;
 }
+
+/*!
+    \brief      check that the file system is mirrored and start a file operation
+    \param[in]  none
+    \param[out] none
+    \retval     0 if ready, 1 if no file system exists
+    \note       clears the per-operation I2C byte counters
+*/
+static uint8_t at24cxx_file_system_ready(void)
+{
+    at24cxx_file_system_cache_info.op_read_bytes = 0;
+    at24cxx_file_system_cache_info.op_write_bytes = 0;
+    if(at24cxx_file_system_cache_info.mounted == 0)
+    {
+        if(at24cxx_file_system_mount() != 0)
+        {
+            PRINT_ERROR("error: at24cxx_file_system does not exist, please format it.\r\n");
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*!
+    \brief      hash of a file name
+    \param[in]  file_name: file name, at most the 28 bytes of a catalogue name are used
+    \param[out] none
+    \retval     bucket number
+*/
+static uint8_t at24cxx_file_system_hash(const uint8_t *file_name)
+{
+    uint32_t hash = 2166136261U;
+    uint8_t i;
+    
+    for(i = 0; (i < 28) && file_name[i]; i++)
+    {
+        hash ^= file_name[i];
+        hash *= 16777619U;
+    }
+    
+    return (uint8_t)((hash ^ (hash >> 16)) & (AT24CXX_FILE_SYSTEM_HASH_NUM - 1));
+}
+
+/*!
+    \brief      rebuild the name hash from the catalogue mirror
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void at24cxx_file_system_hash_build(void)
+{
+    uint8_t i;
+    
+    memset(at24cxx_hash, 0xFF, sizeof(at24cxx_hash));
+    for(i = 0; i < AT24CXX_FILE_SYSTEM_CATALOGUE_NUM; i++)
+    {
+        if(at24cxx_catalogue[i].name[0] != 0xFF)
+        {
+            at24cxx_file_system_hash_insert(i);
+        }
+    }
+}
+
+/*!
+    \brief      add a catalogue entry to the name hash
+    \param[in]  entry: catalogue entry number
+    \param[out] none
+    \retval     none
+*/
+static void at24cxx_file_system_hash_insert(uint8_t entry)
+{
+    uint8_t bucket = at24cxx_file_system_hash(at24cxx_catalogue[entry].name);
+    
+    at24cxx_hash_next[entry] = at24cxx_hash[bucket];
+    at24cxx_hash[bucket] = entry;
+}
+
+/*!
+    \brief      remove a catalogue entry from the name hash
+    \param[in]  entry: catalogue entry number
+    \param[out] none
+    \retval     none
+*/
+static void at24cxx_file_system_hash_remove(uint8_t entry)
+{
+    uint8_t *link = &at24cxx_hash[at24cxx_file_system_hash(at24cxx_catalogue[entry].name)];
+    
+    while(*link != 0xFF)
+    {
+        if(*link == entry)
+        {
+            *link = at24cxx_hash_next[entry];
+            break;
+        }
+        link = &at24cxx_hash_next[*link];
+    }
+}
+
+/*!
+    \brief      look up a file name
+    \param[in]  file_name: file name
+    \param[out] none
+    \retval     catalogue entry number, 0xFF if not found
+*/
+static uint8_t at24cxx_file_system_find(const uint8_t *file_name)
+{
+    uint8_t entry = at24cxx_hash[at24cxx_file_system_hash(file_name)];
+    
+    if(strlen((char *)file_name) >= 28)
+    {
+        return 0xFF;
+    }
+    while(entry != 0xFF)
+    {
+        if(strncmp((char *)at24cxx_catalogue[entry].name, (char *)file_name, 28) == 0)
+        {
+            break;
+        }
+        entry = at24cxx_hash_next[entry];
+    }
+    
+    return entry;
+}
+
+/*!
+    \brief      write part of a catalogue entry from the mirror to the EEPROM
+    \param[in]  entry: catalogue entry number
+    \param[in]  offset: first byte in the entry
+    \param[in]  len: bytes
+    \param[out] none
+    \retval     none
+*/
+static void at24cxx_file_system_catalogue_sync(uint8_t entry, uint8_t offset, uint8_t len)
+{
+    at24cxx_write(AT24CXX_FILE_SYSTEM_CATALOGUE_ADDR + entry*AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE + offset, (uint8_t *)&at24cxx_catalogue[entry] + offset, len);
+    at24cxx_file_system_cache_info.generation++;
+}
+
+/*!
+    \brief      write index entries from the mirror to the EEPROM
+    \param[in]  page: storage pages whose index entry changed, sorted in place
+    \param[in]  num: number of pages
+    \param[out] none
+    \retval     none
+    \note       runs of consecutive entries are written in one transfer
+*/
+static void at24cxx_file_system_index_sync(uint16_t *page, uint8_t num)
+{
+    uint8_t i, j, run;
+    uint16_t temp;
+    
+    for(i = 1; i < num; i++)                                    /* Insertion sort, at most 16 entries */
+    {
+        temp = page[i];
+        for(j = i; (j > 0) && (page[j-1] > temp); j--)
+        {
+            page[j] = page[j-1];
+        }
+        page[j] = temp;
+    }
+    
+    for(i = 0; i < num; i += run)
+    {
+        for(run = 1; (i+run < num) && (page[i+run] <= page[i+run-1]+1); run++);
+        temp = page[i+run-1] - page[i] + 1;
+        at24cxx_write(AT24CXX_FILE_SYSTEM_INDEX_ADDR + page[i]*AT24CXX_FILE_SYSTEM_INDEX_SIZE, (uint8_t *)&at24cxx_index[page[i]], temp*AT24CXX_FILE_SYSTEM_INDEX_SIZE);
+    }
+    if(num)
+    {
+        at24cxx_file_system_cache_info.generation++;
+    }
+}
@@ -4,6 +4,18 @@
     \version    1.0
     \date       2025-07-24
     \author     Ze-Hou
+    \note       the file system keeps the catalogue (AT24CXX_FILE_SYSTEM_CATALOGUE_NUM
+                entries of 32 bytes: name, size, first page) and the page index
+                (one 2-byte entry per storage page: next page, 0xFFFF last
+                page, 0xEEEE free) mirrored in RAM after mounting. Lookups go
+                through a name hash and never read the EEPROM; every change is
+                made in RAM and written through to the EEPROM at once, so the
+                EEPROM only sees the catalogue and index bytes that change,
+                the file data and the read-back check of written data.
+                generation counts the changes, at24cxx_file_system_verify
+                compares the mirror with the EEPROM. read_bytes/write_bytes
+                count the I2C payload bytes, op_read_bytes/op_write_bytes those
+                of the last file operation.
 */
 
 #ifndef __AT24CXX_H
@@ -39,6 +51,8 @@
 #define AT24CXX_FILE_SYSTEM_STORAGE_PAGE_NUM      960                     /*!< File system data storage pages */
 #define AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE        32                      /*!< File system catalogue entry size (32 bytes) */ 
 #define AT24CXX_FILE_SYSTEM_INDEX_SIZE            2                       /*!< File system index entry size (2 bytes) */ 
+#define AT24CXX_FILE_SYSTEM_CATALOGUE_NUM         (AT24CXX_FILE_SYSTEM_CATALOGUE_PAGE_NUM * AT24CXX_FILE_SYSTEM_PAGE_SIZE / AT24CXX_FILE_SYSTEM_CATALOGUE_SIZE)   /*!< Catalogue entries (files) */
+#define AT24CXX_FILE_SYSTEM_HASH_NUM              64                      /*!< Name hash buckets, power of 2 */
 
 /**
  * \brief File system information structure
@@ -60,6 +74,21 @@ typedef struct
 
 extern at24cxx_file_system_struct at24cxx_file_system_info;
 
+/**
+ * \brief File system RAM mirror statistics structure
+ */
+typedef struct
+{
+    uint8_t mounted;                            /*!< 1: catalogue and index mirrored in RAM */
+    uint32_t generation;                        /*!< Catalogue and index changes since mounting */
+    uint32_t read_bytes;                        /*!< I2C payload bytes read */
+    uint32_t write_bytes;                       /*!< I2C payload bytes written */
+    uint32_t op_read_bytes;                     /*!< Bytes read by the last file operation */
+    uint32_t op_write_bytes;                    /*!< Bytes written by the last file operation */
+}at24cxx_file_system_cache_struct;
+
+extern at24cxx_file_system_cache_struct at24cxx_file_system_cache_info;
+
 /* function declarations */
 void at24cxx_init(void);                                                                /*!< initialize AT24CXX EEPROM driver */
 uint8_t at24cxx_read_one_byte(uint8_t device, uint16_t addr);                           /*!< read one byte from EEPROM */
@@ -67,6 +96,8 @@ void at24cxx_write_one_byte(uint8_t device, uint16_t addr, uint8_t data);
 void at24cxx_read(uint32_t addr, uint8_t *pbuf, uint16_t datalen);                      /*!< read multiple bytes from EEPROM */
 void at24cxx_write(uint32_t addr, uint8_t *pbuf, uint16_t datalen);                     /*!< write multiple bytes to EEPROM */
 void at24cxx_file_system_format(void);                                                  /*!< format EEPROM file system */
+uint8_t at24cxx_file_system_mount(void);                                                /*!< mirror catalogue and index in RAM */
+uint8_t at24cxx_file_system_verify(void);                                               /*!< compare the RAM mirror with the EEPROM */
 void at24cxx_file_system_info_set(at24cxx_file_system_struct at24cxx_file_system_info); /*!< set file system information */
 void at24cxx_file_system_info_print(void);                                              /*!< print file system information */
 void at24cxx_file_system_file_get(void);                                                /*!< get and display all files */
@@ -63,6 +63,51 @@ uint8_t mpu_set_protection(uint32_t baseaddr, uint32_t size, uint32_t rnum, uint
     return 0;
 }
 
+/*!
+    \brief      reprogram one region while the MPU stays enabled
+    \param[in]  baseaddr: base address of protection region
+    \param[in]  size: protection region size (MPU_REGION_SIZE_32B to MPU_REGION_SIZE_4GB)
+    \param[in]  rnum: protection region number (MPU_REGION_NUMBER0 to MPU_REGION_NUMBER15)
+    \param[in]  de: instruction access permission (MPU_INSTRUCTION_EXEC_PERMIT/NOT_PERMIT)
+    \param[in]  tex: type extension field (MPU_TEX_TYPE0/TYPE1)
+    \param[in]  ap: access permission (refer to gd32h7xx_misc.h)
+    \param[in]  sen: shareable attribute (MPU_ACCESS_SHAREABLE/NON_SHAREABLE)
+    \param[in]  cen: cacheable attribute (MPU_ACCESS_CACHEABLE/NON_CACHEABLE)
+    \param[in]  ben: bufferable attribute (MPU_ACCESS_BUFFERABLE/NON_BUFFERABLE)
+    \param[out] none
+    \retval     success status (0 for success)
+    \note       for use at runtime: mpu_set_protection turns the MPU off, so
+                every other region (SDRAM, AXI SRAM attributes) falls back to
+                the default map for a moment. Here RNR/RBAR/RASR are written
+                with interrupts masked, an interrupt cannot run between the
+                register writes, and DSB/ISB make the new attributes apply to
+                the next access
+*/
+uint8_t mpu_update_protection(uint32_t baseaddr, uint32_t size, uint32_t rnum, uint8_t de, \
+                              uint8_t tex, uint8_t ap, uint8_t sen, uint8_t cen, uint8_t ben)
+{
+    uint32_t primask = __get_PRIMASK();
+    uint32_t rasr;
+    
+    rasr = ((uint32_t)de  << MPU_RASR_XN_Pos)  |
+           ((uint32_t)ap  << MPU_RASR_AP_Pos)  |
+           ((uint32_t)tex << MPU_RASR_TEX_Pos) |
+           ((uint32_t)sen << MPU_RASR_S_Pos)   |
+           ((uint32_t)cen << MPU_RASR_C_Pos)   |
+           ((uint32_t)ben << MPU_RASR_B_Pos)   |
+           ((uint32_t)size << MPU_RASR_SIZE_Pos) |
+           MPU_RASR_ENABLE_Msk;
+    
+    __disable_irq();
+    __DMB();                                                                /* finish accesses under the old attributes */
+    ARM_MPU_SetRegionEx(rnum, baseaddr, rasr);
+    __DSB();
+    __ISB();
+    __set_PRIMASK(primask);
+    
+    return 0;
+}
+
 /*!
     \brief      configure memory protection for all system memory regions
     \param[in]  none
@@ -145,4 +190,15 @@ void mpu_memory_protection(void)
                         MPU_ACCESS_NON_SHAREABLE,                        /* non-shareable */
                         MPU_ACCESS_CACHEABLE,                            /* cacheable */
                         MPU_ACCESS_NON_BUFFERABLE);                      /* non-bufferable */
+    
+    /* OSPI0 memory-mapped window, 32MB, no access until w25q256_init maps the flash */
+    mpu_set_protection( 0x90000000,                                 /* base address */
+                        MPU_REGION_SIZE_32MB,                           /* size */
+                        MPU_REGION_NUMBER7,                             /* region 7 */
+                        MPU_INSTRUCTION_EXEC_NOT_PERMIT,                  /* disable instruction access */
+                        MPU_TEX_TYPE0,                                   /* MPU TEX type 0 */
+                        MPU_AP_NO_ACCESS,                                 /* no access */
+                        MPU_ACCESS_NON_SHAREABLE,                        /* non-shareable */
+                        MPU_ACCESS_NON_CACHEABLE,                        /* non-cacheable */
+                        MPU_ACCESS_NON_BUFFERABLE);                      /* non-bufferable */
 }
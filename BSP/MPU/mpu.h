@@ -13,6 +13,8 @@
 /* function declarations */
 uint8_t mpu_set_protection(uint32_t baseaddr, uint32_t size, uint32_t rnum, uint8_t de, \
                            uint8_t tex, uint8_t ap, uint8_t sen, uint8_t cen, uint8_t ben);     /*!< configure memory protection region with specified attributes */
+uint8_t mpu_update_protection(uint32_t baseaddr, uint32_t size, uint32_t rnum, uint8_t de, \
+                              uint8_t tex, uint8_t ap, uint8_t sen, uint8_t cen, uint8_t ben);  /*!< reprogram a region at runtime, the MPU stays enabled */
 void mpu_memory_protection(void);                                                               /*!< configure memory protection for all system memory regions */
 
 #endif /* __MPU_H */
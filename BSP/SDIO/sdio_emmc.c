@@ -10,6 +10,17 @@
 #include "./SDIO/sdio_emmc.h"
 #include "./USART/usart.h"
 #include "./DELAY/delay.h"
+#include "./SYSTEM/system.h"
+#include <string.h>
+
+#if (SYSTEM_SUPPORT_OS && EMMC_DMA_MODE && EMMC_IT_MODE)
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#define EMMC_USE_IT         1
+#else
+#define EMMC_USE_IT         0
+#endif
 
 /* emmc memory card bus commands index */
 /* class 0 (basic) */
@@ -67,6 +78,10 @@
 #define EMMC_RCA                              ((uint16_t)0x0001U)        /* rac bits */
 #define EMMC_RCA_SHIFT                        ((uint8_t)0x10U)           /* rac shift bits */
 
+/* CMD38 arguments */
+#define EMMC_ERASE_ARG_ERASE                  ((uint32_t)0x00000000U)    /* erase whole erase groups */
+#define EMMC_ERASE_ARG_TRIM                   ((uint32_t)0x00000001U)    /* trim write blocks */
+
 /* emmc data */
 #define EMMC_DATATIMEOUT                      ((uint32_t)0xFFFFFFFFU)    /* DSM data timeout */
 
@@ -75,6 +90,18 @@
 #define EMMC_FIFOHALF_WORDS                   ((uint32_t)0x00000008U)    /* words of FIFO half full/empty */
 #define EMMC_FIFOHALF_BYTES                   ((uint32_t)0x00000020U)    /* bytes of FIFO half full/empty */
 
+/* buffers the transfer engine cannot use directly */
+#define EMMC_BOUNCE_BLOCKS                    (EMMC_BOUNCE_SIZE / 512)   /* blocks per bounce buffer half */
+#define EMMC_STREAM_BLOCKS                    (EMMC_BOUNCE_BLOCKS * EMMC_STREAM_HALVES)   /* blocks per streamed command */
+#define EMMC_DCACHE_LINE                      32U                       /* Cortex-M7 D-cache line size */
+#if(EMMC_DMA_MODE)
+    /* IDMA needs 8-byte aligned addresses and has no path to ITCM/DTCM */
+    #define EMMC_BUFFER_UNSAFE(addr)          ((((uint32_t)(addr)) & 0x7U) || (((uint32_t)(addr)) < 0x00100000U) || \
+                                               ((((uint32_t)(addr)) >= 0x20000000U) && (((uint32_t)(addr)) < 0x20100000U)))
+#else
+    #define EMMC_BUFFER_UNSAFE(addr)          (((uint32_t)(addr)) & 0x3U)
+#endif
+
 /* card status of R1 definitions (JESD84-A441) */
 #define EMMC_R1_OUT_OF_RANGE                  BIT(31)                   /* command's argument was out of the allowed range */
 #define EMMC_R1_ADDRESS_ERROR                 BIT(30)                   /* misaligned address which did not match the block length */
@@ -128,16 +155,79 @@ static emmc_error_enum emmc_power_off(void);
 static emmc_error_enum emmc_card_init(void);                                                  /* initialize eMMC card */
 static emmc_error_enum emmc_card_extcsd_get(void);                                           /* get extended CSD register */
 static emmc_error_enum emmc_enter_high_speed_mode(void);                                     /* enter high speed mode */
+static emmc_error_enum emmc_erase_group_config(void);                                        /* select the erase group size and the discard command */
+static emmc_error_enum emmc_cache_config(void);                                              /* enable or disable the device write cache */
 static emmc_error_enum emmc_transfer_stop(void);                                             /* stop data transfer */
 static emmc_error_enum cmdsent_error_check(void);                                            /* check if command sent error occurs */
 static emmc_error_enum r1_error_check(uint8_t cmdindex);                                     /* check if error occurs for R1 response */
 static emmc_error_enum r1_error_type_check(uint32_t resp);                                   /* check error type for R1 response */
 static emmc_error_enum r2_error_check(void);                                                 /* check if error occurs for R2 response */
 static emmc_error_enum r3_error_check(void);                                                 /* check if error occurs for R3 response */
+static emmc_error_enum emmc_data_wait(void);                                                 /* wait for the end of a data transfer */
+static emmc_error_enum emmc_busy_wait(void);                                                 /* wait while the card is programming */
+static emmc_error_enum emmc_blocks_read(uint32_t *pbuffer, uint32_t blockaddr, uint32_t blocksnumber);       /* read blocks into a DMA-safe buffer */
+static emmc_error_enum emmc_blocks_write(uint32_t *pbuffer, uint32_t blockaddr, uint32_t blocksnumber);      /* write blocks from a DMA-safe buffer */
+static emmc_error_enum emmc_bounce_read(uint8_t *pbuffer, uint32_t blockaddr, uint32_t blocksnumber);        /* read blocks through the bounce buffer */
+static emmc_error_enum emmc_bounce_write(const uint8_t *pbuffer, uint32_t blockaddr, uint32_t blocksnumber); /* write blocks through the bounce buffer */
+static void emmc_dcache_clean(const void *addr, uint32_t length);                            /* clean the D-cache lines of a buffer */
+static void emmc_dcache_invalidate(void *addr, uint32_t length);                             /* invalidate the D-cache lines of a buffer */
+#if(EMMC_DMA_MODE)
+static void emmc_idma_config(uint32_t *pbuffer);                                             /* set up the IDMA for a multi-block transfer */
+static emmc_error_enum emmc_stream_wait(void);                                               /* serve the bounce halves until the transfer ends */
+#endif
+#if EMMC_BUSMODE_AUTO
+static emmc_error_enum emmc_bus_negotiate(void);                                             /* select the fastest stable bus mode */
+#endif
 
 /* define emmc information struct */
 emmc_info_struct emmc_info={0}; /* emmc information struct */
 
+#if EMMC_BUSMODE_AUTO
+/*!
+    \brief      bus mode candidate structure
+*/
+typedef struct
+{
+    uint32_t busmode;                                   /*!< SDIO_BUSMODE_xBIT */
+    uint32_t datarate;                                  /*!< SDIO_DATA_RATE_SDR/DDR */
+    uint8_t width;                                      /*!< data bus width */
+    uint8_t ddr;                                        /*!< 1: needs DEVICE_TYPE DDR support */
+}emmc_bus_candidate_struct;
+
+/* candidates from fastest to slowest, 1-bit SDR is the fallback */
+static const emmc_bus_candidate_struct emmc_bus_candidate[] =
+{
+    {SDIO_BUSMODE_8BIT, SDIO_DATA_RATE_DDR, 8, 1},
+    {SDIO_BUSMODE_8BIT, SDIO_DATA_RATE_SDR, 8, 0},
+    {SDIO_BUSMODE_4BIT, SDIO_DATA_RATE_DDR, 4, 1},
+    {SDIO_BUSMODE_4BIT, SDIO_DATA_RATE_SDR, 4, 0},
+};
+
+static __ALIGNED(32) uint32_t emmc_test_buffer[2][256];     /* reference and test block for negotiation */
+#endif
+
+#if EMMC_USE_IT
+static SemaphoreHandle_t emmc_data_semaphore = NULL; /* given by SDIO1_IRQHandler at the end of a data transfer */
+#endif
+
+static __ALIGNED(32) uint8_t emmc_bounce_buffer[2][EMMC_BOUNCE_SIZE];  /* bounce buffer, IDMA double buffer halves */
+
+#if(EMMC_DMA_MODE)
+/*!
+    \brief      bounced double-buffer transfer structure
+*/
+typedef struct
+{
+    uint8_t *pbuffer;                                   /*!< Caller buffer */
+    uint32_t length;                                    /*!< Transfer length, 0 when not streaming */
+    uint32_t done;                                      /*!< Bytes copied between the halves and the caller buffer */
+    uint32_t switched;                                  /*!< Halves finished by the IDMA */
+    uint8_t write;                                      /*!< 1: halves are refilled, 0: halves are drained */
+}emmc_stream_struct;
+
+static emmc_stream_struct emmc_stream = {0};
+#endif
+
 /*!
     \brief      configure SDIO pins and clock for eMMC interface
     \param[in]  none
@@ -180,6 +270,20 @@ static uint8_t sdio_emmc_config(void)
     gpio_output_options_set(GPIOG, GPIO_OTYPE_PP, GPIO_OSPEED_100_220MHZ, GPIO_PIN_9 | GPIO_PIN_10 | GPIO_PIN_11 | \
                                                                           GPIO_PIN_12 | GPIO_PIN_13 | GPIO_PIN_14);
     
+    #if EMMC_USE_IT
+        if(emmc_data_semaphore == NULL)
+        {
+            emmc_data_semaphore = xSemaphoreCreateBinary();
+            
+            if(emmc_data_semaphore == NULL)
+            {
+                return 1;
+            }
+        }
+        
+        nvic_irq_enable(SDIO1_IRQn, EMMC_IT_PRIORITY, 0);
+    #endif
+    
     return 0;
 }
 
@@ -243,6 +347,15 @@ emmc_error_enum emmc_init(void)
         }
         
         sdio_clock_config(SDIO_EMMC, SDIO_SDIOCLKEDGE_FALLING, SDIO_CLOCKPWRSAVE_DISABLE, EMMC_CLK_DIV_TRANS_HSPEED);
+        
+        status = emmc_card_extcsd_get(); /* HS_TIMING[185] now reports the switch, emmc_bus_negotiate needs it for DDR */
+        
+        if(status != EMMC_OK)
+        {
+            PRINT_ERROR("emmc_card_extcsd_get(%d)\r\n", status);
+            
+            return status;
+        }
     }
     else
     {
@@ -251,7 +364,9 @@ emmc_error_enum emmc_init(void)
     
     delay_xms(10);
     
-    #if(SDR_BUSMODE_1BIT)
+    #if(EMMC_BUSMODE_AUTO)
+        status = emmc_bus_negotiate();
+    #elif(SDR_BUSMODE_1BIT)
         status = emmc_bus_mode_config(SDIO_BUSMODE_1BIT, SDIO_DATA_RATE_SDR);
     #elif(SDR_BUSMODE_4BIT)
         status = emmc_bus_mode_config(SDIO_BUSMODE_4BIT, SDIO_DATA_RATE_SDR);
@@ -269,6 +384,24 @@ emmc_error_enum emmc_init(void)
         
         return status;
     }
+    
+    status = emmc_erase_group_config(); /* erase group size for discard and format alignment */
+    
+    if(status != EMMC_OK)
+    {
+        PRINT_ERROR("emmc_erase_group_config(%d)\r\n", status);
+        
+        return status;
+    }
+    
+    status = emmc_cache_config(); /* volatile write cache, see EMMC_CACHE_ENABLE */
+    
+    if(status != EMMC_OK)
+    {
+        PRINT_ERROR("emmc_cache_config(%d)\r\n", status);
+        
+        return status;
+    }
 
     status = emmc_card_extcsd_get(); /* update ext_csd of a emmc card */
     
@@ -393,6 +526,8 @@ void emmc_info_print(void)
     
     PRINT_INFO("emmc sector number: %u\r\n", (*(uint32_t *)((uint8_t *)&emmc_info.ext_csd + 212)));
     PRINT_INFO("emmc capacity: %.2f GB\r\n", (double)(*(uint32_t *)((uint8_t *)&emmc_info.ext_csd + 212)) *512 /1024 /1024 /1024);
+    PRINT_INFO("emmc erase group: %u KB, discard by %s\r\n", emmc_info.erase_group / 2, emmc_info.trim ? "trim" : "erase");
+    PRINT_INFO("emmc write cache: %u KB, %s\r\n", (*(uint32_t *)((uint8_t *)&emmc_info.ext_csd + 249)), emmc_info.cache ? "enabled" : "disabled");
     
     if(*(uint8_t *)((uint8_t *)&emmc_info.ext_csd + 196))
     {
@@ -409,6 +544,8 @@ void emmc_info_print(void)
     {
         PRINT_INFO("emmc card in high speed mode\r\n");
     }
+    
+    PRINT_INFO("emmc bus mode: %u-bit %s\r\n", emmc_info.bus_width, emmc_info.bus_ddr ? "DDR" : "SDR");
   
     PRINT_INFO("/*********************************************************************/\r\n");
 }
@@ -577,6 +714,9 @@ emmc_error_enum emmc_bus_mode_config(uint32_t busmode, uint32_t datarate)
 
     sdio_flag_clear(SDIO_EMMC, SDIO_MASK_INTC_FLAGS);
     
+    emmc_info.bus_width = (busmode == SDIO_BUSMODE_8BIT) ? 8 : ((busmode == SDIO_BUSMODE_4BIT) ? 4 : 1);
+    emmc_info.bus_ddr = (datarate == SDIO_DATA_RATE_DDR) ? 1 : 0;
+    
     status = emmc_card_state_get();
     
     while((status == EMMC_OK) && (emmc_info.card_state == EMMC_CARDSTATE_PROGRAMMING))
@@ -589,64 +729,327 @@ emmc_error_enum emmc_bus_mode_config(uint32_t busmode, uint32_t datarate)
 
 /*!
     \brief      read data from eMMC disk
-    \param[in]  pbuffer: pointer to buffer for data reading
+    \param[in]  pbuffer: pointer to buffer for data reading, any alignment
     \param[in]  blockaddr: start block address
     \param[in]  blocksnumber: number of blocks to read
     \param[out] none
     \retval     emmc_error_enum: error status
+    \note       unaligned and TCM buffers go through the bounce buffer; the
+                D-cache lines of a direct buffer are invalidated after the DMA,
+                so the caller must not write other data sharing its first or
+                last cache line while the read is in progress
 */
 emmc_error_enum emmc_read_disk(uint32_t *pbuffer, uint32_t blockaddr, uint32_t blocksnumber)
+{
+    if((pbuffer == NULL) || (blocksnumber == 0)) /* buffer address invalid */
+    {
+        return EMMC_PARAMETER_INVALID;
+    }
+    
+    if(EMMC_BUFFER_UNSAFE(pbuffer))
+    {
+        return emmc_bounce_read((uint8_t *)pbuffer, blockaddr, blocksnumber);
+    }
+    
+    return emmc_blocks_read(pbuffer, blockaddr, blocksnumber);
+}
+
+/*!
+    \brief      write data to eMMC disk
+    \param[in]  pbuffer: pointer to buffer containing data to write, any alignment
+    \param[in]  blockaddr: start block address
+    \param[in]  blocksnumber: number of blocks to write
+    \param[out] none
+    \retval     emmc_error_enum: error status
+*/
+emmc_error_enum emmc_write_disk(uint32_t *pbuffer, uint32_t blockaddr, uint32_t blocksnumber)
+{
+    if((pbuffer == NULL) || (blocksnumber == 0)) /* buffer address invalid */
+    {
+        return EMMC_PARAMETER_INVALID;
+    }
+    
+    if(EMMC_BUFFER_UNSAFE(pbuffer))
+    {
+        return emmc_bounce_write((const uint8_t *)pbuffer, blockaddr, blocksnumber);
+    }
+    
+    return emmc_blocks_write(pbuffer, blockaddr, blocksnumber);
+}
+
+/*!
+    \brief      measure sequential read and write speed of eMMC card
+    \param[in]  pbuffer: 4-byte aligned buffer of blocksnumber * 512 bytes
+    \param[in]  blocksnumber: number of blocks per transfer
+    \param[in]  write: 0 read only, the card is not written, 1 read and write
+    \param[out] none
+    \retval     emmc_error_enum: error status
+    \note       the last blocks of the card are read and, with write, written
+                back unchanged, results are stored in emmc_info.read_speed/
+                write_speed (KB/s) and the time of one single block write in
+                write_latency (us)
+*/
+emmc_error_enum emmc_speed_test(uint32_t *pbuffer, uint32_t blocksnumber, uint8_t write)
 {
     emmc_error_enum status = EMMC_OK;
+    uint32_t blockaddr, cycles;
     
-    if((pbuffer == NULL) || ((uint32_t)pbuffer % 4)) /* buffer address invalid or not 4-byte aligned */
+    if((emmc_info.emmc_init_state != 0xAA) || (blocksnumber == 0))
+    {
+        return EMMC_OPERATION_IMPROPER;
+    }
+    
+    blockaddr = (*(uint32_t *)((uint8_t *)&emmc_info.ext_csd + 212)) - blocksnumber;
+    
+    cycles = DWT_CYCCNT;
+    status = emmc_read_disk(pbuffer, blockaddr, blocksnumber);
+    cycles = DWT_CYCCNT - cycles;
+    
+    if(status != EMMC_OK)
     {
-        status = EMMC_PARAMETER_INVALID;
-        
         return status;
     }
     
-    if(blocksnumber == 1)
+    emmc_info.read_speed = (uint32_t)((uint64_t)blocksnumber * 512 * (SystemCoreClock / 1000) / 1024 / (cycles / 1000 + 1));
+    
+    if(!write)
     {
-        status = emmc_block_read(pbuffer, blockaddr);
+        PRINT_INFO("emmc sequential read %u KB/s\r\n", emmc_info.read_speed);
+        return status;
     }
-    else
+    
+    cycles = DWT_CYCCNT;
+    status = emmc_write_disk(pbuffer, blockaddr, blocksnumber);
+    cycles = DWT_CYCCNT - cycles;
+    
+    if(status != EMMC_OK)
+    {
+        return status;
+    }
+    
+    emmc_info.write_speed = (uint32_t)((uint64_t)blocksnumber * 512 * (SystemCoreClock / 1000) / 1024 / (cycles / 1000 + 1));
+    
+    cycles = DWT_CYCCNT;
+    status = emmc_write_disk(pbuffer, blockaddr, 1); /* small write: config save, log or record */
+    cycles = DWT_CYCCNT - cycles;
+    
+    if(status != EMMC_OK)
     {
-         status = emmc_multiblocks_read(pbuffer, blockaddr, blocksnumber);
+        return status;
     }
     
+    emmc_info.write_latency = cycles / (SystemCoreClock / 1000000);
+    
+    PRINT_INFO("emmc sequential read %u KB/s, write %u KB/s\r\n", emmc_info.read_speed, emmc_info.write_speed);
+    PRINT_INFO("emmc single block write %u us (write cache %s)\r\n", emmc_info.write_latency, emmc_info.cache ? "enabled" : "disabled");
+    
     return status;
 }
 
 /*!
-    \brief      write data to eMMC disk
-    \param[in]  pbuffer: pointer to buffer containing data to write
+    \brief      discard blocks that no longer hold data
     \param[in]  blockaddr: start block address
-    \param[in]  blocksnumber: number of blocks to write
+    \param[in]  blocksnumber: number of blocks to discard
     \param[out] none
     \retval     emmc_error_enum: error status
+    \note       with TRIM the exact range is discarded; without it only the
+                erase groups lying completely inside the range are erased and
+                the partial groups at both ends are left untouched, a range
+                without a whole group returns EMMC_OK at once. The call blocks
+                until the card leaves the programming state.
 */
-emmc_error_enum emmc_write_disk(uint32_t *pbuffer, uint32_t blockaddr, uint32_t blocksnumber)
+emmc_error_enum emmc_trim(uint32_t blockaddr, uint32_t blocksnumber)
 {
     emmc_error_enum status = EMMC_OK;
+    uint32_t start, end, argument;
     
-    if((pbuffer == NULL) || ((uint32_t)pbuffer % 4)) /* buffer address invalid or not 4-byte aligned */
+    if(emmc_info.emmc_init_state != 0xAA)
     {
-        status = EMMC_PARAMETER_INVALID;
+        return EMMC_OPERATION_IMPROPER;
+    }
+    
+    if((blocksnumber == 0) || (blockaddr + blocksnumber < blockaddr) || \
+       (blockaddr + blocksnumber > (*(uint32_t *)((uint8_t *)&emmc_info.ext_csd + 212))))
+    {
+        return EMMC_PARAMETER_INVALID;
+    }
+    
+    if(emmc_info.trim)
+    {
+        start = blockaddr;
+        end = blockaddr + blocksnumber - 1;
+        argument = EMMC_ERASE_ARG_TRIM;
+    }
+    else
+    {
+        if(emmc_info.erase_group == 0)
+        {
+            return EMMC_FUNCTION_UNSUPPORTED;
+        }
+        
+        start = (blockaddr + emmc_info.erase_group - 1) / emmc_info.erase_group * emmc_info.erase_group;
+        end = (blockaddr + blocksnumber) / emmc_info.erase_group * emmc_info.erase_group;
         
+        if(end <= start) /* no whole erase group inside the range */
+        {
+            return EMMC_OK;
+        }
+        
+        end -= 1;
+        argument = EMMC_ERASE_ARG_ERASE;
+    }
+    
+    status = emmc_card_state_get(); /* check whether the card is locked */
+    
+    if(EMMC_OK != status)
+    {
         return status;
     }
     
-    if(blocksnumber == 1)
+    if(emmc_info.card_locked_state)
     {
-        status = emmc_block_write(pbuffer, blockaddr);
+        return EMMC_LOCKED_STSTE;
     }
-    else
+    
+    /* send CMD35(ERASE_GROUP_START) to set the first block */
+    sdio_command_response_config(SDIO_EMMC, EMMC_CMD_ERASE_GROUP_START, start, SDIO_RESPONSETYPE_SHORT);
+    sdio_wait_type_set(SDIO_EMMC, SDIO_WAITTYPE_NO);
+    sdio_csm_enable(SDIO_EMMC); /* enable the CSM */
+    
+    status = r1_error_check(EMMC_CMD_ERASE_GROUP_START); /* check if some error occurs */
+    
+    if(EMMC_OK != status)
     {
-         status = emmc_multiblocks_write(pbuffer, blockaddr, blocksnumber);
+        return status;
     }
-    return status;
+    
+    /* send CMD36(ERASE_GROUP_END) to set the last block */
+    sdio_command_response_config(SDIO_EMMC, EMMC_CMD_ERASE_GROUP_END, end, SDIO_RESPONSETYPE_SHORT);
+    sdio_wait_type_set(SDIO_EMMC, SDIO_WAITTYPE_NO);
+    sdio_csm_enable(SDIO_EMMC); /* enable the CSM */
+    
+    status = r1_error_check(EMMC_CMD_ERASE_GROUP_END); /* check if some error occurs */
+    
+    if(EMMC_OK != status)
+    {
+        return status;
+    }
+    
+    /* send CMD38(ERASE) to start trimming or erasing */
+    sdio_command_response_config(SDIO_EMMC, EMMC_CMD_ERASE, argument, SDIO_RESPONSETYPE_SHORT);
+    sdio_wait_type_set(SDIO_EMMC, SDIO_WAITTYPE_NO);
+    sdio_csm_enable(SDIO_EMMC); /* enable the CSM */
+    
+    status = r1_error_check(EMMC_CMD_ERASE); /* check if some error occurs */
+    
+    if(EMMC_OK != status)
+    {
+        return status;
+    }
+    
+    return emmc_busy_wait(); /* R1b, the card stays in programming state until done */
+}
+
+/*!
+    \brief      write the device cache to the flash
+    \param[in]  none
+    \param[out] none
+    \retval     emmc_error_enum: error status
+    \note       returns at once when the cache is disabled, otherwise blocks
+                until the card leaves the programming state
+*/
+emmc_error_enum emmc_cache_flush(void)
+{
+    emmc_error_enum status = EMMC_OK;
+    
+    if((emmc_info.emmc_init_state != 0xAA) || (emmc_info.cache == 0))
+    {
+        return EMMC_OK;
+    }
+    
+    /* send CMD6(EMMC_CMD_SWITCH) to write FLUSH_CACHE = 1 */
+    sdio_command_response_config(SDIO_EMMC, EMMC_CMD_SWITCH_FUNC, (uint32_t)0x03200100, SDIO_RESPONSETYPE_SHORT);
+    sdio_wait_type_set(SDIO_EMMC, SDIO_WAITTYPE_NO);
+    sdio_csm_enable(SDIO_EMMC); /* enable the CSM */
+    
+    status = r1_error_check(EMMC_CMD_SWITCH_FUNC); /* check if some error occurs */
+    
+    if(EMMC_OK != status)
+    {
+        return status;
+    }
+    
+    return emmc_busy_wait(); /* R1b, busy until the cache is written */
+}
+
+#if EMMC_BUSMODE_AUTO
+/*!
+    \brief      select the fastest bus mode that passes the test reads
+    \param[in]  none
+    \param[out] none
+    \retval     emmc_error_enum: error status
+    \note       candidates not allowed by EXT_CSD DEVICE_TYPE[196] are skipped;
+                each candidate must read the reference blocks EMMC_NEGOTIATE_NUM
+                times without data CRC error and with identical content
+*/
+static emmc_error_enum emmc_bus_negotiate(void)
+{
+    emmc_error_enum status = EMMC_OK;
+    uint8_t device_type = *(uint8_t *)((uint8_t *)&emmc_info.ext_csd + 196);
+    uint8_t high_speed = *(uint8_t *)((uint8_t *)&emmc_info.ext_csd + 185);
+    uint8_t i, j;
+    
+    /* reference read in the 1-bit mode every card supports */
+    status = emmc_bus_mode_config(SDIO_BUSMODE_1BIT, SDIO_DATA_RATE_SDR);
+    
+    if(status != EMMC_OK)
+    {
+        return status;
+    }
+    
+    status = emmc_read_disk(emmc_test_buffer[0], 0, 2);
+    
+    if(status != EMMC_OK)
+    {
+        return status;
+    }
+    
+    for(i = 0; i < sizeof(emmc_bus_candidate) / sizeof(emmc_bus_candidate[0]); i++)
+    {
+        if(emmc_bus_candidate[i].ddr && (!high_speed || !(device_type & 0x0C))) /* HS_DDR 52MHz at 1.8V/3V or 1.2V */
+        {
+            continue;
+        }
+        
+        status = emmc_bus_mode_config(emmc_bus_candidate[i].busmode, emmc_bus_candidate[i].datarate);
+        
+        for(j = 0; (status == EMMC_OK) && (j < EMMC_NEGOTIATE_NUM); j++)
+        {
+            memset(emmc_test_buffer[1], 0x00, sizeof(emmc_test_buffer[1]));
+            
+            status = emmc_read_disk(emmc_test_buffer[1], 0, 2);
+            
+            if((status == EMMC_OK) && memcmp(emmc_test_buffer[0], emmc_test_buffer[1], sizeof(emmc_test_buffer[0])))
+            {
+                status = EMMC_DATA_CRC_ERROR;
+            }
+        }
+        
+        if(status == EMMC_OK)
+        {
+            PRINT_INFO("emmc bus negotiated: %u-bit %s\r\n", emmc_bus_candidate[i].width, emmc_bus_candidate[i].ddr ? "DDR" : "SDR");
+            
+            return status;
+        }
+        
+        emmc_transfer_stop(); /* leave a half finished transfer before switching again */
+        sdio_flag_clear(SDIO_EMMC, SDIO_MASK_DATA_FLAGS);
+        PRINT_WARN("emmc %u-bit %s unstable(%d)\r\n", emmc_bus_candidate[i].width, emmc_bus_candidate[i].ddr ? "DDR" : "SDR", status);
+    }
+    
+    return emmc_bus_mode_config(SDIO_BUSMODE_1BIT, SDIO_DATA_RATE_SDR);
 }
+#endif
 
 /*!
     \brief      read single block from eMMC card
@@ -701,11 +1104,16 @@ static emmc_error_enum emmc_block_read(uint32_t *pbuffer, uint32_t blockaddr)
             return status;
         }
         
-        while(!sdio_flag_get(SDIO_EMMC, SDIO_FLAG_DTCRCERR | SDIO_FLAG_DTTMOUT | SDIO_FLAG_RXORE | SDIO_FLAG_DTEND));
+        status = emmc_data_wait(); /* interrupt driven once the scheduler runs, polling before */
         
         sdio_idma_disable(SDIO_EMMC);
         sdio_trans_start_disable(SDIO_EMMC);
         
+        if(EMMC_OK != status)
+        {
+            return status;
+        }
+        
         if(RESET != sdio_flag_get(SDIO_EMMC, SDIO_FLAG_DTCRCERR))/* whether some error occurs and return it */
         {
             status = EMMC_DATA_CRC_ERROR;
@@ -836,9 +1244,7 @@ static emmc_error_enum emmc_multiblocks_read(uint32_t *pbuffer, uint32_t blockad
     sdio_trans_start_enable(SDIO_EMMC);
     
     #if(EMMC_DMA_MODE)
-        sdio_idma_set(SDIO_EMMC, SDIO_IDMA_SINGLE_BUFFER, (uint32_t)(512 >> 5));
-        sdio_idma_buffer0_address_set(SDIO_EMMC, (uint32_t)pbuffer);
-        sdio_idma_enable(SDIO_EMMC);
+        emmc_idma_config(pbuffer);
 
         /* send CMD18(READ_MULTIPLE_BLOCK) to read multiple blocks */
         sdio_command_response_config(SDIO_EMMC, EMMC_CMD_READ_MULTIPLE_BLOCK, (uint32_t)blockaddr, SDIO_RESPONSETYPE_SHORT);
@@ -852,10 +1258,15 @@ static emmc_error_enum emmc_multiblocks_read(uint32_t *pbuffer, uint32_t blockad
             return status;
         }
         
-        while(!sdio_flag_get(SDIO_EMMC, SDIO_FLAG_DTCRCERR | SDIO_FLAG_DTTMOUT | SDIO_FLAG_RXORE | SDIO_FLAG_DTEND));
+        status = emmc_stream.length ? emmc_stream_wait() : emmc_data_wait(); /* interrupt driven once the scheduler runs, polling before */
         
         sdio_idma_disable(SDIO_EMMC);
         sdio_trans_start_disable(SDIO_EMMC);
+        
+        if(EMMC_OK != status)
+        {
+            return status;
+        }
                 
         if(RESET != sdio_flag_get(SDIO_EMMC, SDIO_FLAG_DTCRCERR))/* whether some error occurs and return it */
         {
@@ -1025,11 +1436,16 @@ static emmc_error_enum emmc_block_write(uint32_t *pbuffer, uint32_t blockaddr)
             return status;
         }
         
-        while(!sdio_flag_get(SDIO_EMMC, SDIO_FLAG_DTCRCERR | SDIO_FLAG_DTTMOUT | SDIO_FLAG_RXORE | SDIO_FLAG_DTEND));
+        status = emmc_data_wait(); /* interrupt driven once the scheduler runs, polling before */
         
         sdio_idma_disable(SDIO_EMMC);
         sdio_trans_start_disable(SDIO_EMMC);
         
+        if(EMMC_OK != status)
+        {
+            return status;
+        }
+        
         if(RESET != sdio_flag_get(SDIO_EMMC, SDIO_FLAG_DTCRCERR))/* whether some error occurs and return it */
         {
             status = EMMC_DATA_CRC_ERROR;
@@ -1114,12 +1530,7 @@ static emmc_error_enum emmc_block_write(uint32_t *pbuffer, uint32_t blockaddr)
 
     sdio_flag_clear(SDIO_EMMC, SDIO_MASK_DATA_FLAGS); /* clear the DATA_FLAGS flags */
     
-    status = emmc_card_state_get();
-    
-    while((status == EMMC_OK) && ((emmc_info.card_state == EMMC_CARDSTATE_PROGRAMMING) || (emmc_info.card_state == EMMC_CARDSTATE_RECEIVING)))
-    {
-        status = emmc_card_state_get();
-    }
+    status = emmc_busy_wait();
         
     return status;
 }
@@ -1190,9 +1601,7 @@ static emmc_error_enum emmc_multiblocks_write(uint32_t *pbuffer, uint32_t blocka
     sdio_trans_start_enable(SDIO_EMMC);
     
     #if(EMMC_DMA_MODE)
-        sdio_idma_set(SDIO_EMMC, SDIO_IDMA_SINGLE_BUFFER, (uint32_t)(512 >> 5));
-        sdio_idma_buffer0_address_set(SDIO_EMMC, (uint32_t)pbuffer);
-        sdio_idma_enable(SDIO_EMMC);
+        emmc_idma_config(pbuffer);
 
         /* send CMD25(WRITE_MULTIPLE_BLOCK) to continuously write blocks of data */
         sdio_command_response_config(SDIO_EMMC, EMMC_CMD_WRITE_MULTIPLE_BLOCK, (uint32_t)blockaddr, SDIO_RESPONSETYPE_SHORT);
@@ -1206,15 +1615,20 @@ static emmc_error_enum emmc_multiblocks_write(uint32_t *pbuffer, uint32_t blocka
             return status;
         }
         
-        while(!sdio_flag_get(SDIO_EMMC, SDIO_FLAG_DTCRCERR | SDIO_FLAG_DTTMOUT | SDIO_FLAG_RXORE | SDIO_FLAG_DTEND));
+        status = emmc_stream.length ? emmc_stream_wait() : emmc_data_wait(); /* interrupt driven once the scheduler runs, polling before */
         
         sdio_idma_disable(SDIO_EMMC);
         sdio_trans_start_disable(SDIO_EMMC);
         
-        if(RESET != sdio_flag_get(SDIO_EMMC, SDIO_FLAG_DTCRCERR))/* whether some error occurs and return it */
+        if(EMMC_OK != status)
         {
-            status = EMMC_DATA_CRC_ERROR;
-            sdio_flag_clear(SDIO_EMMC, SDIO_FLAG_DTCRCERR);
+            return status;
+        }
+        
+        if(RESET != sdio_flag_get(SDIO_EMMC, SDIO_FLAG_DTCRCERR))/* whether some error occurs and return it */
+        {
+            status = EMMC_DATA_CRC_ERROR;
+            sdio_flag_clear(SDIO_EMMC, SDIO_FLAG_DTCRCERR);
             
             return status;
         }
@@ -1295,12 +1709,7 @@ static emmc_error_enum emmc_multiblocks_write(uint32_t *pbuffer, uint32_t blocka
 
     sdio_flag_clear(SDIO_EMMC, SDIO_MASK_DATA_FLAGS); /* clear the DATA_FLAGS flags */
     
-    status = emmc_card_state_get();
-    
-    while((status == EMMC_OK) && ((emmc_info.card_state == EMMC_CARDSTATE_PROGRAMMING) || (emmc_info.card_state == EMMC_CARDSTATE_RECEIVING)))
-    {
-        status = emmc_card_state_get();
-    }
+    status = emmc_busy_wait();
         
     return status;
 }
@@ -1557,6 +1966,115 @@ static emmc_error_enum emmc_enter_high_speed_mode(void)
         return status;
     }
 
+    return emmc_busy_wait(); /* R1b, busy until the timing is switched */
+}
+
+/*!
+    \brief      select the erase group size and the discard command
+    \param[in]  none
+    \param[out] none
+    \retval     emmc_error_enum: error status
+    \note       cards with HC_ERASE_GRP_SIZE[224] are switched to high capacity
+                erase groups (ERASE_GROUP_DEF[175] = 1), which is also what
+                HC_WP_GRP_SIZE and the partition sizes are expressed in; older
+                cards keep the CSD ERASE_GRP_SIZE/ERASE_GRP_MULT group. TRIM is
+                used when SEC_FEATURE_SUPPORT[231] SEC_GB_CL_EN is set.
+*/
+static emmc_error_enum emmc_erase_group_config(void)
+{
+    emmc_error_enum status = EMMC_OK;
+    uint8_t hc_erase_grp_size = *(uint8_t *)((uint8_t *)&emmc_info.ext_csd + 224);
+    
+    if(hc_erase_grp_size)
+    {
+        /* send CMD6(EMMC_CMD_SWITCH) to write ERASE_GROUP_DEF = 1 */
+        sdio_command_response_config(SDIO_EMMC, EMMC_CMD_SWITCH_FUNC, (uint32_t)0x03AF0100, SDIO_RESPONSETYPE_SHORT);
+        sdio_wait_type_set(SDIO_EMMC, SDIO_WAITTYPE_NO);
+        sdio_csm_enable(SDIO_EMMC); /* enable the CSM */
+        
+        status = r1_error_check(EMMC_CMD_SWITCH_FUNC); /* check if some error occurs */
+        
+        if(EMMC_OK != status)
+        {
+            return status;
+        }
+        
+        status = emmc_busy_wait();
+        
+        if(EMMC_OK != status)
+        {
+            return status;
+        }
+        
+        emmc_info.erase_group = (uint32_t)hc_erase_grp_size * 1024; /* 512KB units */
+    }
+    else
+    {
+        emmc_info.erase_group = (((uint8_t)(emmc_info.csd[1] >> 10) & 0x1F) + 1) * (((uint8_t)(emmc_info.csd[1] >> 5) & 0x1F) + 1);
+    }
+    
+    #if(EMMC_TRIM_ENABLE)
+        emmc_info.trim = ((*(uint8_t *)((uint8_t *)&emmc_info.ext_csd + 231)) & 0x10) ? 1 : 0;
+    #else
+        emmc_info.trim = 0;
+    #endif
+    
+    return status;
+}
+
+/*!
+    \brief      enable or disable the device write cache
+    \param[in]  none
+    \param[out] none
+    \retval     emmc_error_enum: error status
+    \note       the cache needs EXT_CSD_REV[192] >= 6 (v4.5) and CACHE_SIZE[252:249]
+                non-zero; CACHE_CTRL[33] is written in both directions since it
+                keeps its value over a soft reset of the MCU
+*/
+static emmc_error_enum emmc_cache_config(void)
+{
+    emmc_error_enum status = EMMC_OK;
+    uint32_t argument;
+    
+    emmc_info.cache = 0;
+    
+    if(((*(uint8_t *)((uint8_t *)&emmc_info.ext_csd + 192)) < 6) || ((*(uint32_t *)((uint8_t *)&emmc_info.ext_csd + 249)) == 0))
+    {
+        return EMMC_OK; /* no cache, writes are always programmed */
+    }
+    
+    #if(EMMC_CACHE_ENABLE)
+        argument = 0x03210100; /* CACHE_CTRL = 1 */
+    #else
+        if(((*(uint8_t *)((uint8_t *)&emmc_info.ext_csd + 33)) & 0x1) == 0)
+        {
+            return EMMC_OK;
+        }
+        
+        argument = 0x03210000; /* CACHE_CTRL = 0, the card flushes before turning it off */
+    #endif
+    
+    /* send CMD6(EMMC_CMD_SWITCH) to write CACHE_CTRL */
+    sdio_command_response_config(SDIO_EMMC, EMMC_CMD_SWITCH_FUNC, argument, SDIO_RESPONSETYPE_SHORT);
+    sdio_wait_type_set(SDIO_EMMC, SDIO_WAITTYPE_NO);
+    sdio_csm_enable(SDIO_EMMC); /* enable the CSM */
+    
+    status = r1_error_check(EMMC_CMD_SWITCH_FUNC); /* check if some error occurs */
+    
+    if(EMMC_OK != status)
+    {
+        return status;
+    }
+    
+    status = emmc_busy_wait();
+    
+    if(EMMC_OK != status)
+    {
+        return status;
+    }
+    
+    emmc_info.cache = (argument & 0x0100) ? 1 : 0;
+    
     return status;
 }
 
@@ -1854,3 +2372,455 @@ static emmc_error_enum r3_error_check(void)
 
 
 
+
+/*!
+    \brief      wait for the end of the current data transfer
+    \param[in]  none
+    \param[out] none
+    \retval     emmc_error_enum: error status
+    \note       error flags are left set for the caller to decode; the task
+                sleeps on the SDIO interrupt once the scheduler runs and the
+                caller is not an ISR (MSC callbacks), otherwise the flags are polled
+*/
+static emmc_error_enum emmc_data_wait(void)
+{
+    #if EMMC_USE_IT
+        if((__get_IPSR() == 0U) && (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING))
+        {
+            xSemaphoreTake(emmc_data_semaphore, 0); /* drop a stale completion */
+            sdio_interrupt_enable(SDIO_EMMC, SDIO_INT_DTCRCERR | SDIO_INT_DTTMOUT | SDIO_INT_RXORE | SDIO_INT_DTEND);
+            
+            if(pdTRUE != xSemaphoreTake(emmc_data_semaphore, pdMS_TO_TICKS(EMMC_IT_TIMEOUT_MS)))
+            {
+                sdio_interrupt_disable(SDIO_EMMC, SDIO_INT_DTCRCERR | SDIO_INT_DTTMOUT | SDIO_INT_RXORE | SDIO_INT_DTEND);
+                PRINT_ERROR("emmc data transfer timeout\r\n");
+                
+                return EMMC_DATA_TIMEOUT;
+            }
+            
+            return EMMC_OK;
+        }
+    #endif
+    
+    /* polling mode */
+    while(!sdio_flag_get(SDIO_EMMC, SDIO_FLAG_DTCRCERR | SDIO_FLAG_DTTMOUT | SDIO_FLAG_RXORE | SDIO_FLAG_DTEND));
+    
+    return EMMC_OK;
+}
+
+/*!
+    \brief      wait while the card is receiving or programming data
+    \param[in]  none
+    \param[out] none
+    \retval     emmc_error_enum: error status
+    \note       after EMMC_BUSY_SPIN_NUM polls the calling task sleeps one tick
+                between CMD13 polls so long programming times do not block others
+*/
+static emmc_error_enum emmc_busy_wait(void)
+{
+    emmc_error_enum status = EMMC_OK;
+    uint32_t count = 0U;
+    
+    status = emmc_card_state_get();
+    
+    while((status == EMMC_OK) && ((emmc_info.card_state == EMMC_CARDSTATE_PROGRAMMING) || (emmc_info.card_state == EMMC_CARDSTATE_RECEIVING)))
+    {
+        #if EMMC_USE_IT
+            if((++count > EMMC_BUSY_SPIN_NUM) && (__get_IPSR() == 0U) && (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING))
+            {
+                vTaskDelay(1);
+            }
+        #else
+            (void)count;
+        #endif
+        
+        status = emmc_card_state_get();
+    }
+    
+    return status;
+}
+
+/*!
+    \brief      read blocks into a buffer the transfer engine can reach
+    \param[in]  pbuffer: 8-byte aligned (DMA) or 4-byte aligned (polling) buffer outside TCM
+    \param[in]  blockaddr: start block address
+    \param[in]  blocksnumber: number of blocks to read
+    \param[out] none
+    \retval     emmc_error_enum: error status
+*/
+static emmc_error_enum emmc_blocks_read(uint32_t *pbuffer, uint32_t blockaddr, uint32_t blocksnumber)
+{
+    emmc_error_enum status = EMMC_OK;
+    
+    #if(EMMC_DMA_MODE)
+        emmc_dcache_clean(pbuffer, blocksnumber * 512); /* no dirty line may be evicted over the DMA data */
+    #endif
+    
+    if(blocksnumber == 1)
+    {
+        status = emmc_block_read(pbuffer, blockaddr);
+    }
+    else
+    {
+        status = emmc_multiblocks_read(pbuffer, blockaddr, blocksnumber);
+    }
+    
+    #if(EMMC_DMA_MODE)
+        emmc_dcache_invalidate(pbuffer, blocksnumber * 512);
+    #endif
+    
+    return status;
+}
+
+/*!
+    \brief      write blocks from a buffer the transfer engine can reach
+    \param[in]  pbuffer: 8-byte aligned (DMA) or 4-byte aligned (polling) buffer outside TCM
+    \param[in]  blockaddr: start block address
+    \param[in]  blocksnumber: number of blocks to write
+    \param[out] none
+    \retval     emmc_error_enum: error status
+*/
+static emmc_error_enum emmc_blocks_write(uint32_t *pbuffer, uint32_t blockaddr, uint32_t blocksnumber)
+{
+    #if(EMMC_DMA_MODE)
+        emmc_dcache_clean(pbuffer, blocksnumber * 512);
+    #endif
+    
+    if(blocksnumber == 1)
+    {
+        return emmc_block_write(pbuffer, blockaddr);
+    }
+    
+    return emmc_multiblocks_write(pbuffer, blockaddr, blocksnumber);
+}
+
+/*!
+    \brief      read blocks into an unaligned or TCM buffer
+    \param[in]  pbuffer: caller buffer
+    \param[in]  blockaddr: start block address
+    \param[in]  blocksnumber: number of blocks to read
+    \param[out] none
+    \retval     emmc_error_enum: error status
+    \note       with DMA, transfers longer than one half run as CMD18s of at
+                most EMMC_STREAM_BLOCKS with the two halves in IDMA double-buffer
+                mode, each half is copied out while the other one fills. The
+                scheduler runs again between the commands
+*/
+static emmc_error_enum emmc_bounce_read(uint8_t *pbuffer, uint32_t blockaddr, uint32_t blocksnumber)
+{
+    emmc_error_enum status = EMMC_OK;
+    uint32_t count, segment;
+    
+    while(blocksnumber && (status == EMMC_OK))
+    {
+        segment = (blocksnumber > EMMC_STREAM_BLOCKS) ? EMMC_STREAM_BLOCKS : blocksnumber;
+        
+        #if(EMMC_DMA_MODE)
+            if(segment > EMMC_BOUNCE_BLOCKS)
+            {
+                emmc_stream.pbuffer = pbuffer;
+                emmc_stream.length = segment * 512;
+                emmc_stream.done = 0;
+                emmc_stream.switched = 0;
+                emmc_stream.write = 0;
+                emmc_dcache_clean(emmc_bounce_buffer, sizeof(emmc_bounce_buffer));
+                
+                status = emmc_multiblocks_read((uint32_t *)emmc_bounce_buffer[0], blockaddr, segment);
+                emmc_stream.length = 0;
+                
+                if(status != EMMC_DMA_ERROR)
+                {
+                    pbuffer += segment * 512;
+                    blockaddr += segment;
+                    blocksnumber -= segment;
+                    continue;
+                }
+                
+                /* a half was not drained in time, read this segment again half by half */
+                PRINT_WARN("emmc bounce stream overrun, chunked read\r\n");
+                emmc_info.stream_fallback++;
+                status = emmc_busy_wait();
+            }
+        #endif
+        
+        while(segment && (status == EMMC_OK))
+        {
+            count = (segment > EMMC_BOUNCE_BLOCKS) ? EMMC_BOUNCE_BLOCKS : segment;
+            status = emmc_blocks_read((uint32_t *)emmc_bounce_buffer[0], blockaddr, count);
+            
+            if(status == EMMC_OK)
+            {
+                memcpy(pbuffer, emmc_bounce_buffer[0], count * 512);
+            }
+            
+            pbuffer += count * 512;
+            blockaddr += count;
+            blocksnumber -= count;
+            segment -= count;
+        }
+    }
+    
+    return status;
+}
+
+/*!
+    \brief      write blocks from an unaligned or TCM buffer
+    \param[in]  pbuffer: caller buffer
+    \param[in]  blockaddr: start block address
+    \param[in]  blocksnumber: number of blocks to write
+    \param[out] none
+    \retval     emmc_error_enum: error status
+    \note       with DMA, transfers longer than one half run as CMD25s of at
+                most EMMC_STREAM_BLOCKS, each half is refilled as soon as the
+                IDMA moves to the other one. The scheduler runs again between
+                the commands
+*/
+static emmc_error_enum emmc_bounce_write(const uint8_t *pbuffer, uint32_t blockaddr, uint32_t blocksnumber)
+{
+    emmc_error_enum status = EMMC_OK;
+    uint32_t count, segment;
+    
+    while(blocksnumber && (status == EMMC_OK))
+    {
+        segment = (blocksnumber > EMMC_STREAM_BLOCKS) ? EMMC_STREAM_BLOCKS : blocksnumber;
+        
+        #if(EMMC_DMA_MODE)
+            if(segment > EMMC_BOUNCE_BLOCKS)
+            {
+                emmc_stream.pbuffer = (uint8_t *)pbuffer;
+                emmc_stream.length = segment * 512;
+                emmc_stream.done = (emmc_stream.length > sizeof(emmc_bounce_buffer)) ? sizeof(emmc_bounce_buffer) : emmc_stream.length;
+                emmc_stream.switched = 0;
+                emmc_stream.write = 1;
+                memcpy(emmc_bounce_buffer, pbuffer, emmc_stream.done);
+                emmc_dcache_clean(emmc_bounce_buffer, emmc_stream.done);
+                
+                status = emmc_multiblocks_write((uint32_t *)emmc_bounce_buffer[0], blockaddr, segment);
+                emmc_stream.length = 0;
+                
+                if(status != EMMC_DMA_ERROR)
+                {
+                    pbuffer += segment * 512;
+                    blockaddr += segment;
+                    blocksnumber -= segment;
+                    continue;
+                }
+                
+                /* a half was not refilled in time, write this segment again half by half */
+                PRINT_WARN("emmc bounce stream underrun, chunked write\r\n");
+                emmc_info.stream_fallback++;
+                status = emmc_busy_wait();
+            }
+        #endif
+        
+        while(segment && (status == EMMC_OK))
+        {
+            count = (segment > EMMC_BOUNCE_BLOCKS) ? EMMC_BOUNCE_BLOCKS : segment;
+            memcpy(emmc_bounce_buffer[0], pbuffer, count * 512);
+            status = emmc_blocks_write((uint32_t *)emmc_bounce_buffer[0], blockaddr, count);
+            
+            pbuffer += count * 512;
+            blockaddr += count;
+            blocksnumber -= count;
+            segment -= count;
+        }
+    }
+    
+    return status;
+}
+
+/*!
+    \brief      clean the D-cache lines covering a buffer
+    \param[in]  addr: buffer start
+    \param[in]  length: buffer length in bytes
+    \param[out] none
+    \retval     none
+    \note       only the lines touched by the buffer are maintained, never the whole cache
+*/
+static void emmc_dcache_clean(const void *addr, uint32_t length)
+{
+    uint32_t start = (uint32_t)addr & ~(EMMC_DCACHE_LINE - 1U);
+    uint32_t end = ((uint32_t)addr + length + EMMC_DCACHE_LINE - 1U) & ~(EMMC_DCACHE_LINE - 1U);
+    
+    SCB_CleanDCache_by_Addr((void *)start, (int32_t)(end - start));
+}
+
+/*!
+    \brief      invalidate the D-cache lines covering a buffer
+    \param[in]  addr: buffer start
+    \param[in]  length: buffer length in bytes
+    \param[out] none
+    \retval     none
+    \note       partial first and last lines were cleaned before the transfer,
+                so only data the CPU wrote to them during the DMA would be lost
+*/
+static void emmc_dcache_invalidate(void *addr, uint32_t length)
+{
+    uint32_t start = (uint32_t)addr & ~(EMMC_DCACHE_LINE - 1U);
+    uint32_t end = ((uint32_t)addr + length + EMMC_DCACHE_LINE - 1U) & ~(EMMC_DCACHE_LINE - 1U);
+    
+    SCB_InvalidateDCache_by_Addr((void *)start, (int32_t)(end - start));
+}
+
+#if(EMMC_DMA_MODE)
+/*!
+    \brief      set up the IDMA for a multi-block transfer
+    \param[in]  pbuffer: DMA buffer, ignored while a bounced transfer streams
+    \param[out] none
+    \retval     none
+*/
+static void emmc_idma_config(uint32_t *pbuffer)
+{
+    if(emmc_stream.length)
+    {
+        sdio_idma_set(SDIO_EMMC, SDIO_IDMA_DOUBLE_BUFFER, (uint32_t)(EMMC_BOUNCE_SIZE >> 5));
+        sdio_idma_buffer0_address_set(SDIO_EMMC, (uint32_t)emmc_bounce_buffer[0]);
+        sdio_idma_buffer1_address_set(SDIO_EMMC, (uint32_t)emmc_bounce_buffer[1]);
+        sdio_idma_buffer_select(SDIO_EMMC, SDIO_IDMA_BUFFER0);
+        sdio_flag_clear(SDIO_EMMC, SDIO_FLAG_IDMAEND);
+    }
+    else
+    {
+        sdio_idma_set(SDIO_EMMC, SDIO_IDMA_SINGLE_BUFFER, (uint32_t)(512 >> 5));
+        sdio_idma_buffer0_address_set(SDIO_EMMC, (uint32_t)pbuffer);
+    }
+    
+    sdio_idma_enable(SDIO_EMMC);
+}
+
+/*!
+    \brief      serve the bounce halves until a double-buffer transfer ends
+    \param[in]  none
+    \param[out] none
+    \retval     emmc_error_enum: error status, EMMC_DMA_ERROR when a half
+                was not served in time, EMMC_DATA_TIMEOUT without progress
+    \note       the IDMA does not wait for software, so the scheduler is
+                suspended (interrupts stay enabled) while the halves are
+                served; the callers stream at most EMMC_STREAM_BLOCKS per
+                command to bound that time. Software owns a half from its IDMAEND until the next
+                one: when the IDMA is not on the other half (a switch was
+                missed) or finishes it while the half is still being served,
+                the transfer is stopped. The tick count does not advance
+                while the scheduler is suspended, EMMC_IT_TIMEOUT_MS without
+                a switch is measured with the DWT counter. Error flags are
+                left set for the caller to decode
+*/
+static emmc_error_enum emmc_stream_wait(void)
+{
+    emmc_error_enum status = EMMC_OK;
+    uint32_t timeout = EMMC_IT_TIMEOUT_MS * (SystemCoreClock / 1000U);
+    uint32_t start = DWT_CYCCNT;
+    uint32_t active;
+    uint8_t *half;
+    uint32_t size;
+    
+    #if EMMC_USE_IT
+        uint8_t suspended = (__get_IPSR() == 0U) && (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING);
+        
+        if(suspended)vTaskSuspendAll();
+    #endif
+    
+    while(status == EMMC_OK)
+    {
+        if(RESET != sdio_flag_get(SDIO_EMMC, SDIO_FLAG_IDMAEND))
+        {
+            sdio_flag_clear(SDIO_EMMC, SDIO_FLAG_IDMAEND);
+            half = emmc_bounce_buffer[emmc_stream.switched & 1U];
+            emmc_stream.switched++;
+            start = DWT_CYCCNT;
+            
+            /* while the transfer goes on the IDMA must be on the other half */
+            active = (emmc_stream.switched & 1U) ? SDIO_IDMA_BUFFER1 : SDIO_IDMA_BUFFER0;
+            if((emmc_stream.switched * EMMC_BOUNCE_SIZE < emmc_stream.length) && (sdio_buffer_selection_get(SDIO_EMMC) != active))
+            {
+                status = EMMC_DMA_ERROR;
+                break;
+            }
+            
+            size = emmc_stream.length - emmc_stream.done;
+            size = (size > EMMC_BOUNCE_SIZE) ? EMMC_BOUNCE_SIZE : size;
+            
+            if(emmc_stream.write)
+            {
+                memcpy(half, emmc_stream.pbuffer + emmc_stream.done, size);       /* refill the half the IDMA just left */
+                emmc_dcache_clean(half, size);
+            }
+            else
+            {
+                emmc_dcache_invalidate(half, size);
+                memcpy(emmc_stream.pbuffer + emmc_stream.done, half, size);       /* drain the half the IDMA just filled */
+            }
+            emmc_stream.done += size;
+            
+            /* the other half ended while this one was served: the IDMA may have entered it */
+            if(((emmc_stream.switched + 1U) * EMMC_BOUNCE_SIZE < emmc_stream.length) && (RESET != sdio_flag_get(SDIO_EMMC, SDIO_FLAG_IDMAEND)))
+            {
+                status = EMMC_DMA_ERROR;
+            }
+        }
+        else if(RESET != sdio_flag_get(SDIO_EMMC, SDIO_FLAG_DTCRCERR | SDIO_FLAG_DTTMOUT | SDIO_FLAG_RXORE | SDIO_FLAG_DTEND))
+        {
+            break;
+        }
+        else if(DWT_CYCCNT - start > timeout)
+        {
+            status = EMMC_DATA_TIMEOUT;
+        }
+    }
+    
+    /* a last partial half does not raise IDMAEND */
+    if((status == EMMC_OK) && !emmc_stream.write && (emmc_stream.done < emmc_stream.length) && (RESET != sdio_flag_get(SDIO_EMMC, SDIO_FLAG_DTEND)))
+    {
+        half = emmc_bounce_buffer[emmc_stream.switched & 1U];
+        size = emmc_stream.length - emmc_stream.done;
+        emmc_dcache_invalidate(half, size);
+        memcpy(emmc_stream.pbuffer + emmc_stream.done, half, size);
+        emmc_stream.done += size;
+    }
+    sdio_flag_clear(SDIO_EMMC, SDIO_FLAG_IDMAEND);
+    
+    if(status != EMMC_OK)
+    {
+        /* the card still sends or expects data: stop it and flush the FIFO */
+        sdio_idma_disable(SDIO_EMMC);
+        sdio_trans_start_disable(SDIO_EMMC);
+        emmc_transfer_stop();
+        sdio_fifo_reset_enable(SDIO_EMMC);
+        sdio_fifo_reset_disable(SDIO_EMMC);
+        sdio_flag_clear(SDIO_EMMC, SDIO_MASK_DATA_FLAGS);
+    }
+    
+    #if EMMC_USE_IT
+        if(suspended)xTaskResumeAll();
+    #endif
+    
+    if(status == EMMC_DATA_TIMEOUT)
+    {
+        PRINT_ERROR("emmc data transfer timeout\r\n");
+    }
+    
+    return status;
+}
+#endif
+
+#if EMMC_USE_IT
+/*!
+    \brief      SDIO1 interrupt handler, signals the end of a data transfer
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void SDIO1_IRQHandler(void)
+{
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    
+    if(RESET != sdio_flag_get(SDIO_EMMC, SDIO_FLAG_DTCRCERR | SDIO_FLAG_DTTMOUT | SDIO_FLAG_RXORE | SDIO_FLAG_DTEND))
+    {
+        /* flags stay set for emmc_data_wait(), mask them to stop re-entering */
+        sdio_interrupt_disable(SDIO_EMMC, SDIO_INT_DTCRCERR | SDIO_INT_DTTMOUT | SDIO_INT_RXORE | SDIO_INT_DTEND);
+        xSemaphoreGiveFromISR(emmc_data_semaphore, &xHigherPriorityTaskWoken);
+    }
+    
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+#endif
@@ -14,7 +14,13 @@
 /* configure emmc sdio */
 #define SDIO_EMMC           SDIO1
 
-/* config SDIO bus mode */
+/* config SDIO bus mode, 1: negotiate the fastest stable mode at init, 0: use the fixed mode below */
+#define EMMC_BUSMODE_AUTO   1
+#define EMMC_NEGOTIATE_NUM  4       /* CRC-checked test reads per candidate mode */
+#define EMMC_SPEED_TEST_NUM 512     /* blocks per sequential speed test (256KB) */
+#define EMMC_SPEED_TEST_BOOT 0     /* 0: boot speed test reads only, 1: it also rewrites the last EMMC_SPEED_TEST_NUM blocks */
+
+/* config fixed SDIO bus mode */
 #define SDR_BUSMODE_1BIT    0
 #define SDR_BUSMODE_4BIT    0
 #define SDR_BUSMODE_8BIT    0
@@ -24,6 +30,23 @@
 /* config data transfer mode */
 #define EMMC_DMA_MODE       1
 
+/* config DMA transfer completion: 1 wait on the SDIO interrupt once the scheduler runs, 0 always poll */
+#define EMMC_IT_MODE        1
+#define EMMC_IT_PRIORITY    6       /* SDIO1 interrupt priority, not above configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY */
+#define EMMC_IT_TIMEOUT_MS  1000    /* completion timeout, the hardware data timeout fires first */
+#define EMMC_BUSY_SPIN_NUM  8       /* CMD13 polls before sleeping while the card is programming */
+
+/* config bounce buffer for unaligned or TCM buffers, two halves used as IDMA double buffer for long transfers */
+#define EMMC_BOUNCE_SIZE    4096    /* bytes per half, multiple of 512 and at most 8160 (IDMASIZE) */
+#define EMMC_STREAM_HALVES  16      /* bounce halves per streamed CMD18/CMD25, the scheduler is suspended for one */
+
+/* config discard, 1: use CMD38 TRIM when the card supports it, 0: only erase whole erase groups */
+#define EMMC_TRIM_ENABLE    1
+
+/* config device write cache, 1: enable the volatile cache (writes ending in the cache are lost on power failure
+   until the next flush), 0: every write is programmed before it completes (power-fail safe) */
+#define EMMC_CACHE_ENABLE   0
+
 /* emmc error flags */
 typedef enum
 {
@@ -75,6 +98,14 @@ typedef enum
         cid: see JESD84-A441 for detials
         csd: see JESD84-A441 for detials
         ext_csd: see JESD84-A441 for detials  
+        bus_width: negotiated data bus width (1, 4 or 8)
+        bus_ddr: 0 SDR, 1 DDR
+        read_speed/write_speed: measured sequential speed in KB/s, 0 not measured
+        erase_group: erase group size in blocks, high capacity size when ERASE_GROUP_DEF is set
+        trim: 0 discard by erasing whole erase groups, 1 discard by TRIM (write block granularity)
+        cache: 1 volatile write cache enabled, data reaches the flash on emmc_cache_flush
+        write_latency: measured single block write time in us, 0 not measured
+        stream_fallback: double-buffer bounce transfers redone in single-buffer chunks
 */
 typedef struct
 {
@@ -86,6 +117,15 @@ typedef struct
     uint32_t cid[4];
     uint32_t csd[4];
     uint32_t ext_csd[128];
+    uint8_t bus_width;
+    uint8_t bus_ddr;
+    uint32_t read_speed;
+    uint32_t write_speed;
+    uint32_t erase_group;
+    uint8_t trim;
+    uint8_t cache;
+    uint32_t write_latency;
+    uint32_t stream_fallback;
 }emmc_info_struct;
 
 extern emmc_info_struct emmc_info; /* emmc information struct */
@@ -98,4 +138,7 @@ emmc_error_enum emmc_card_state_get(void);
 emmc_error_enum emmc_bus_mode_config(uint32_t busmode, uint32_t datarate);                 /* configure eMMC bus mode and data rate */
 emmc_error_enum emmc_read_disk(uint32_t *pbuffer, uint32_t blockaddr, uint32_t blocksnumber); /* read data from eMMC disk */
 emmc_error_enum emmc_write_disk(uint32_t *pbuffer, uint32_t blockaddr, uint32_t blocksnumber); /* write data to eMMC disk */
+emmc_error_enum emmc_speed_test(uint32_t *pbuffer, uint32_t blocksnumber, uint8_t write);   /* measure sequential read/write speed */
+emmc_error_enum emmc_trim(uint32_t blockaddr, uint32_t blocksnumber);                        /* discard blocks that no longer hold data */
+emmc_error_enum emmc_cache_flush(void);                                                      /* write the device cache to the flash */
 #endif
@@ -11,10 +11,58 @@
 #include "./DELAY/delay.h"
 #include "./USART/usart.h"
 #include "./MALLOC/malloc.h"
+#include "./MPU/mpu.h"
+#include "./SYSTEM/system.h"
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "queue.h"
+
+#if (SYSTEM_SUPPORT_OS && W25Q256_IT_MODE)
+#define W25Q256_USE_IT      1
+#else
+#define W25Q256_USE_IT      0
+#endif
 
 /* define ospi init struct */
 static ospi_parameter_struct ospi_struct = {0}; /*!< OSPI initialization structure */
 
+w25q256_info_struct w25q256_info = {0};
+w25q256_sfdp_struct w25q256_sfdp = {0};
+
+/*!
+    \brief      Read command structure
+*/
+typedef struct
+{
+    uint32_t instruction;                       /*!< Opcode */
+    uint32_t addr_mode;                         /*!< OSPI_ADDRESS_x_LINE(S) */
+    uint32_t data_mode;                         /*!< OSPI_DATA_x_LINE(S) */
+    uint32_t dummy_cycles;                      /*!< OSPI_DUMYC_CYCLES_x */
+    const char *name;                           /*!< Mode name for the log */
+}w25q256_read_cmd_struct;
+
+/*!< read command of the indirect and memory-mapped reads, 1-4-4 until SFDP says otherwise */
+static w25q256_read_cmd_struct w25q256_read_cmd = {W25Q_FastReadQuad, OSPI_ADDRESS_4_LINES, OSPI_DATA_4_LINES, OSPI_DUMYC_CYCLES_6, "1-4-4"};
+static uint8_t w25q256_block_erase = 1;         /*!< 0: the SFDP tables list no 64KB erase, blocks are erased by sectors */
+
+static SemaphoreHandle_t w25q256_mutex = NULL;  /*!< recursive, serialises commands against mapped reads */
+static uint32_t w25q256_dirty_start = 0xFFFFFFFF; /*!< range rewritten while the window was closed */
+static uint32_t w25q256_dirty_end = 0;
+
+#if W25Q256_USE_IT
+static SemaphoreHandle_t w25q256_event_semaphore = NULL; /*!< given by OSPI0_IRQHandler and MDMA_IRQHandler */
+#endif
+
+static QueueHandle_t w25q256_async_queue = NULL;        /*!< asynchronous requests for the flash task */
+static TaskHandle_t w25q256_async_task_handle = NULL;
+
+/* static function declarations */
+static void w25q256_async_task(void *pvParameters);
+static int w25q256_async_enqueue(w25q256_request_struct *request, SemaphoreHandle_t done);
+static void w25q256_async_execute(w25q256_request_struct *request);
+
 /*!
     \brief      configure OSPI interface for W25Q256 in indirect mode
     \param[in]  none
@@ -131,6 +179,31 @@ static void ospi_send_command(uint32_t operation_type, uint32_t ins_mode, uint32
     ospi_command_config(OSPI0, &ospi_struct, &cmd_struct);
 }
 
+/*!
+    \brief      wait until a status flag of the OSPI or the MDMA is set
+    \param[in]  stat: status register
+    \param[in]  flags: flags to wait for, any of them ends the wait
+    \retval     none
+    \note       with W25Q256_USE_IT the task sleeps until the interrupt enabled
+                by the caller fires, before the scheduler starts it polls
+*/
+static void w25q256_event_wait(volatile uint32_t *stat, uint32_t flags)
+{
+#if W25Q256_USE_IT
+    if((w25q256_event_semaphore != NULL) && (__get_IPSR() == 0U) && (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING))
+    {
+        while((*stat & flags) == 0)
+        {
+            xSemaphoreTake(w25q256_event_semaphore, pdMS_TO_TICKS(W25Q256_IT_TIMEOUT_MS));
+        }
+        
+        return;
+    }
+#endif
+    
+    while((*stat & flags) == 0);
+}
+
 /*!
     \brief      auto-polling to wait for memory ready (busy bit clear)
     \param[in]  none
@@ -138,18 +211,29 @@ static void ospi_send_command(uint32_t operation_type, uint32_t ins_mode, uint32
 */
 static void ospi_autopolling_memready(void)
 {
-    ospi_autopolling_struct autopl_cfg_struct = {0};
-    
     ospi_send_command(OSPI_OPTYPE_COMMON_CFG, OSPI_INSTRUCTION_1_LINE, W25Q_ReadStatusReg1, \
                           OSPI_ADDRESS_NONE, NULL, NULL, \
                           OSPI_DATA_1_LINE, 1, OSPI_DUMYC_CYCLES_0); /* send command */
     
-    autopl_cfg_struct.match = 0x00;
-    autopl_cfg_struct.mask  = 0x01;
-    autopl_cfg_struct.match_mode = OSPI_MATCH_MODE_AND;
-    autopl_cfg_struct.interval = 0x10;
-    autopl_cfg_struct.automatic_stop = OSPI_AUTOMATIC_STOP_MATCH;
-    ospi_autopolling_mode(OSPI0, &ospi_struct, &autopl_cfg_struct);
+    /* same sequence as ospi_autopolling_mode, which spins on the match flag */
+    while(OSPI_STAT(OSPI0) & OSPI_FLAG_BUSY);
+    OSPI_STATMATCH(OSPI0) = 0x00;
+    OSPI_STATMK(OSPI0) = 0x01;                  /* BUSY bit of status register-1 */
+    OSPI_INTERVAL(OSPI0) = 0x10;
+    OSPI_CTL(OSPI0) = (OSPI_CTL(OSPI0) & ~(OSPI_CTL_SPMOD | OSPI_CTL_SPS | OSPI_CTL_FMOD)) | \
+                      (OSPI_MATCH_MODE_AND | OSPI_AUTOMATIC_STOP_MATCH | OSPI_STATUS_POLLING);
+#if W25Q256_USE_IT
+    if(w25q256_event_semaphore != NULL)
+    {
+        xSemaphoreTake(w25q256_event_semaphore, 0); /* drop a stale event */
+        OSPI_CTL(OSPI0) |= OSPI_CTL_SMIE;
+    }
+#endif
+    OSPI_INS(OSPI0) = OSPI_INS(OSPI0);          /* start polling */
+    
+    w25q256_event_wait(&OSPI_STAT(OSPI0), OSPI_FLAG_SM);
+    OSPI_CTL(OSPI0) &= ~OSPI_CTL_SMIE;
+    OSPI_STATC(OSPI0) = OSPI_STATC_SMC;
 }
 
 /*!
@@ -200,9 +284,140 @@ static void ospi_mdma_config(uint32_t ospi_periph, uint8_t *pbuffer, uint16_t da
     mdma_init_struct.bufferable_write_mode  = MDMA_BUFFERABLE_WRITE_DISABLE;
     
     mdma_init(MDMA_CH0, &mdma_init_struct);
+#if W25Q256_USE_IT
+    if(w25q256_event_semaphore != NULL)
+    {
+        xSemaphoreTake(w25q256_event_semaphore, 0); /* drop a stale event */
+        mdma_interrupt_enable(MDMA_CH0, MDMA_INT_CHTC | MDMA_INT_ERR);
+    }
+#endif
     mdma_channel_enable(MDMA_CH0);
 }
 
+#if W25Q256_XIP_ENABLE
+/*!
+    \brief      switch OSPI0 to memory-mapped mode and open the window
+    \param[in]  none
+    \retval     none
+    \note       the window is normal memory, write-through and read-only, so
+                the D-cache and the core prefetcher serve repeated and
+                sequential reads
+*/
+static void w25q256_mapped_enter(void)
+{
+    uint32_t start, end;
+    
+    ospi_send_command(OSPI_OPTYPE_READ_CFG, OSPI_INSTRUCTION_1_LINE, w25q256_read_cmd.instruction, \
+                      w25q256_read_cmd.addr_mode, 0, OSPI_ADDRESS_32_BITS, \
+                      w25q256_read_cmd.data_mode, 0, w25q256_read_cmd.dummy_cycles); /*!< same sequence as the indirect read */
+    OSPI_CTL(OSPI0) = (OSPI_CTL(OSPI0) & ~OSPI_CTL_FMOD) | OSPI_MEMORY_MAPPED; /*!< memory-mapped mode */
+    
+    mpu_update_protection(W25Q256_XIP_BASE,                         /* base address */
+                        MPU_REGION_SIZE_32MB,                           /* size */
+                        MPU_REGION_NUMBER7,                             /* region 7 */
+                        MPU_INSTRUCTION_EXEC_NOT_PERMIT,                  /* disable instruction access */
+                        MPU_TEX_TYPE0,                                   /* MPU TEX type 0 */
+                        MPU_AP_PRIV_UNPRIV_RO,                            /* read-only */
+                        MPU_ACCESS_NON_SHAREABLE,                        /* non-shareable */
+                        MPU_ACCESS_CACHEABLE,                            /* cacheable */
+                        MPU_ACCESS_NON_BUFFERABLE);                      /* non-bufferable */
+    
+    /* lines of a rewritten range may still hold the old data */
+    if(w25q256_dirty_end > w25q256_dirty_start)
+    {
+        if((w25q256_dirty_end - w25q256_dirty_start) > W25Q256_DCACHE_RANGE_MAX)
+        {
+            SCB_CleanInvalidateDCache();
+        }
+        else
+        {
+            start = (W25Q256_XIP_BASE + w25q256_dirty_start) & ~31U;
+            end = (W25Q256_XIP_BASE + w25q256_dirty_end + 31U) & ~31U;
+            SCB_InvalidateDCache_by_Addr((void *)start, (int32_t)(end - start));
+        }
+        w25q256_dirty_start = 0xFFFFFFFF;
+        w25q256_dirty_end = 0;
+    }
+    
+    w25q256_info.mapped = 1;
+}
+
+/*!
+    \brief      close the window and return OSPI0 to indirect mode
+    \param[in]  none
+    \retval     none
+*/
+static void w25q256_mapped_leave(void)
+{
+    w25q256_info.mapped = 0;
+    
+    /* strongly ordered and no access, no speculative read may start a transfer */
+    mpu_update_protection(W25Q256_XIP_BASE,                         /* base address */
+                        MPU_REGION_SIZE_32MB,                           /* size */
+                        MPU_REGION_NUMBER7,                             /* region 7 */
+                        MPU_INSTRUCTION_EXEC_NOT_PERMIT,                  /* disable instruction access */
+                        MPU_TEX_TYPE0,                                   /* MPU TEX type 0 */
+                        MPU_AP_NO_ACCESS,                                 /* no access */
+                        MPU_ACCESS_NON_SHAREABLE,                        /* non-shareable */
+                        MPU_ACCESS_NON_CACHEABLE,                        /* non-cacheable */
+                        MPU_ACCESS_NON_BUFFERABLE);                      /* non-bufferable */
+    
+    ospi_disable(OSPI0); /*!< ends the memory-mapped read in progress */
+    while(OSPI_STAT(OSPI0) & OSPI_FLAG_BUSY);
+    OSPI_CTL(OSPI0) &= ~OSPI_CTL_FMOD;
+    ospi_enable(OSPI0);
+}
+#endif
+
+/*!
+    \brief      take the OSPI for a command sequence and leave memory-mapped mode
+    \param[in]  none
+    \retval     previous mapped state, pass it to w25q256_command_end
+*/
+static uint8_t w25q256_command_begin(void)
+{
+    uint8_t mapped;
+    
+    w25q256_lock();
+    mapped = w25q256_info.mapped;
+#if W25Q256_XIP_ENABLE
+    if(mapped)
+    {
+        w25q256_mapped_leave();
+    }
+#endif
+    
+    return mapped;
+}
+
+/*!
+    \brief      restore the mode saved by w25q256_command_begin and release the OSPI
+    \param[in]  mapped: return value of w25q256_command_begin
+    \retval     none
+*/
+static void w25q256_command_end(uint8_t mapped)
+{
+#if W25Q256_XIP_ENABLE
+    if(mapped)
+    {
+        w25q256_mapped_enter();
+    }
+#endif
+    w25q256_unlock();
+}
+
+/*!
+    \brief      record a range changed by erase or program
+    \param[in]  address: start address
+    \param[in]  size: bytes
+    \retval     none
+*/
+static void w25q256_dirty_mark(uint32_t address, uint32_t size)
+{
+    if(address < w25q256_dirty_start)w25q256_dirty_start = address;
+    if(address + size > w25q256_dirty_end)w25q256_dirty_end = address + size;
+}
+
 /*!
     \brief      enable write operation for W25Q256
     \param[in]  none
@@ -521,6 +736,174 @@ static void w25q256_set_drv(uint8_t drv)
     }
 }
 
+#if W25Q256_SFDP_ENABLE
+/*!
+    \brief      read and decode the SFDP tables into w25q256_sfdp
+    \param[in]  none
+    \retval     none
+    \note       before 4-byte address mode, the erase types decide w25q256_block_erase
+*/
+static void w25q256_sfdp_read(void)
+{
+    uint8_t *buffer;
+    uint8_t i;
+    
+    buffer = mymalloc(SRAMIN, W25Q256_SFDP_SIZE);
+    if(buffer == NULL)return;
+    
+    ospi_send_command(OSPI_OPTYPE_COMMON_CFG, OSPI_INSTRUCTION_1_LINE, W25Q_ReadSFDP, \
+                      OSPI_ADDRESS_1_LINE, 0, OSPI_ADDRESS_24_BITS, \
+                      OSPI_DATA_1_LINE, W25Q256_SFDP_SIZE, OSPI_DUMYC_CYCLES_8); /*!< send command */
+    ospi_receive(OSPI0, buffer);
+    
+    if(w25q256_sfdp_parse(buffer, W25Q256_SFDP_SIZE, &w25q256_sfdp) == 0)
+    {
+        PRINT_INFO("w25q256 sfdp %u.%u: %u KB, page %u, %s address, dtr %s\r\n", w25q256_sfdp.major, w25q256_sfdp.minor,
+                   w25q256_sfdp.density / 1024, w25q256_sfdp.page_size,
+                   (w25q256_sfdp.addr_bytes == 3) ? "3-byte" : ((w25q256_sfdp.addr_bytes == 4) ? "4-byte" : "3/4-byte"),
+                   w25q256_sfdp.dtr ? "yes" : "no");
+        PRINT_INFO("w25q256 sfdp read 1-1-4 0x%02X/%u, 1-4-4 0x%02X/%u, 4-4-4 0x%02X/%u, 4-byte table 0x%08X\r\n",
+                   w25q256_sfdp.read_114.opcode, w25q256_sfdp.read_114.dummy, w25q256_sfdp.read_144.opcode, w25q256_sfdp.read_144.dummy,
+                   w25q256_sfdp.read_444.opcode, w25q256_sfdp.read_444.dummy, w25q256_sfdp.opcode_4b);
+        
+        w25q256_block_erase = 0;
+        for(i = 0; i < 4; i++)
+        {
+            if(w25q256_sfdp.erase_size[i] == W25Q256_BLOCK_SIZE)w25q256_block_erase = 1;
+        }
+    }
+    else
+    {
+        PRINT_WARN("w25q256 no sfdp, using 1-4-4 read 0x%02X\r\n", W25Q_FastReadQuad);
+    }
+    
+    myfree(SRAMIN, buffer);
+}
+
+/*!
+    \brief      check whether all bytes of a buffer are equal
+    \param[in]  pbuffer: data
+    \param[in]  size: bytes
+    \retval     1: uniform (erased, or stuck or floating lines could match it), 0: not
+*/
+static uint8_t w25q256_data_uniform(const uint8_t *pbuffer, uint32_t size)
+{
+    uint32_t i;
+    
+    for(i = 1; i < size; i++)
+    {
+        if(pbuffer[i] != pbuffer[0])return 0;
+    }
+    
+    return 1;
+}
+
+/*!
+    \brief      read the reference data for w25q256_read_mode_select with the 1-1-1 command
+    \param[out] pbuffer: 256 bytes of reference data
+    \retval     address of the reference, W25Q256_FLASH_SIZE: no usable reference
+    \note       address 0 when it holds data, else the sector at
+                W25Q256_CHECK_ADDR, which is erased and programmed with a
+                pattern of all 256 byte values when it is uniform (blank chip)
+*/
+static uint32_t w25q256_read_reference(uint8_t *pbuffer)
+{
+    uint32_t i;
+    
+    if((w25q256_read_data(0, pbuffer, 256) == 0) && !w25q256_data_uniform(pbuffer, 256))return 0;
+    
+    if((w25q256_read_data(W25Q256_CHECK_ADDR, pbuffer, 256) == 0) && !w25q256_data_uniform(pbuffer, 256))return W25Q256_CHECK_ADDR;
+    
+    for(i = 0; i < 256; i++)
+    {
+        pbuffer[i] = (uint8_t)(i ^ 0x5A);               /*!< every nibble value on every data line */
+    }
+    w25q256_erase_sector(W25Q256_CHECK_ADDR / 4096);
+    w25q256_program_data(W25Q256_CHECK_ADDR, pbuffer, 256);
+    PRINT_INFO("w25q256 blank, read mode check pattern programmed at 0x%08X\r\n", W25Q256_CHECK_ADDR);
+    
+    memset(pbuffer, 0xFF, 256);
+    if((w25q256_read_data(W25Q256_CHECK_ADDR, pbuffer, 256) == 0) && !w25q256_data_uniform(pbuffer, 256))return W25Q256_CHECK_ADDR;
+    
+    return W25Q256_FLASH_SIZE;
+}
+
+/*!
+    \brief      select the fastest read command that reads back correctly
+    \param[in]  none
+    \retval     none
+    \note       in 4-byte address mode with quad enabled; candidates come from
+                the SFDP tables, 4-byte opcodes (0xEC, 0x6C) when the 4-byte
+                address instruction table lists them. Each is checked against
+                a 1-1-1 fast read of 256 bytes of non-uniform data (see
+                w25q256_read_reference), the quad modes are refused when there
+                is none: erased data reads the same as floating data lines
+*/
+static void w25q256_read_mode_select(void)
+{
+    w25q256_read_cmd_struct candidate[3];
+    w25q256_read_cmd_struct reference;
+    uint32_t address;
+    uint8_t *buffer;
+    uint8_t i, num = 0;
+    
+    if(!w25q256_sfdp.valid)return;
+    
+    buffer = mymalloc(SRAMIN, 512);
+    if(buffer == NULL)return;
+    
+    if(w25q256_sfdp.read_144.opcode && (w25q256_sfdp.read_144.dummy <= 31))
+    {
+        candidate[num].instruction = (w25q256_sfdp.opcode_4b & (1U << 5)) ? 0xEC : w25q256_sfdp.read_144.opcode;
+        candidate[num].addr_mode = OSPI_ADDRESS_4_LINES;
+        candidate[num].data_mode = OSPI_DATA_4_LINES;
+        candidate[num].dummy_cycles = OSPI_DUMYC(w25q256_sfdp.read_144.dummy);
+        candidate[num++].name = "1-4-4";
+    }
+    if(w25q256_sfdp.read_114.opcode && (w25q256_sfdp.read_114.dummy <= 31))
+    {
+        candidate[num].instruction = (w25q256_sfdp.opcode_4b & (1U << 4)) ? 0x6C : w25q256_sfdp.read_114.opcode;
+        candidate[num].addr_mode = OSPI_ADDRESS_1_LINE;
+        candidate[num].data_mode = OSPI_DATA_4_LINES;
+        candidate[num].dummy_cycles = OSPI_DUMYC(w25q256_sfdp.read_114.dummy);
+        candidate[num++].name = "1-1-4";
+    }
+    
+    /* 1-1-1 fast read, the 3-byte opcode takes 4 address bytes in 4-byte address mode */
+    reference.instruction = (w25q256_sfdp.opcode_4b & (1U << 1)) ? W25Q_FastRead : 0x0B;
+    reference.addr_mode = OSPI_ADDRESS_1_LINE;
+    reference.data_mode = OSPI_DATA_1_LINE;
+    reference.dummy_cycles = OSPI_DUMYC_CYCLES_8;
+    reference.name = "1-1-1";
+    
+    w25q256_read_cmd = reference;
+    address = w25q256_read_reference(buffer);
+    if(address == W25Q256_FLASH_SIZE)
+    {
+        PRINT_WARN("w25q256 no reference data for the read mode check, quad reads refused\r\n");
+        num = 0;
+    }
+    
+    for(i = 0; i < num; i++)
+    {
+        w25q256_read_cmd = candidate[i];
+        memset(buffer + 256, 0x00, 256);
+        w25q256_read_data(address, buffer + 256, 256);
+        
+        if(memcmp(buffer, buffer + 256, 256) == 0)break;
+        
+        PRINT_WARN("w25q256 %s read 0x%02X reads back wrong data, skipped\r\n", candidate[i].name, candidate[i].instruction);
+    }
+    if(i == num)w25q256_read_cmd = reference;
+    
+    PRINT_INFO("w25q256 read mode %s, opcode 0x%02X, %u dummy cycles%s%s\r\n", w25q256_read_cmd.name, w25q256_read_cmd.instruction,
+               (uint32_t)(w25q256_read_cmd.dummy_cycles & OSPI_TIMCFG_DUMYC),
+               w25q256_sfdp.read_444.opcode ? ", 4-4-4 supported" : "", w25q256_sfdp.dtr ? ", dtr supported" : "");
+    
+    myfree(SRAMIN, buffer);
+}
+#endif
+
 /*!
     \brief      initialize W25Q256 device
     \param[in]  none
@@ -531,6 +914,20 @@ static void w25q256_set_drv(uint8_t drv)
 uint8_t w25q256_init(void)
 {
     uint32_t temp = 0;
+    
+    if(w25q256_mutex == NULL)
+    {
+        w25q256_mutex = xSemaphoreCreateRecursiveMutex();
+    }
+    
+#if W25Q256_USE_IT
+    if(w25q256_event_semaphore == NULL)
+    {
+        w25q256_event_semaphore = xSemaphoreCreateBinary();
+    }
+    nvic_irq_enable(OSPI0_IRQn, W25Q256_IT_PRIORITY, 0);
+    nvic_irq_enable(MDMA_IRQn, W25Q256_IT_PRIORITY, 0);
+#endif
   
     w25q256_ospi_config();
     temp = w25q256_read_device_id();
@@ -543,11 +940,132 @@ uint8_t w25q256_init(void)
     }
     
     w25q256_reset();                    /*!< reset W25Q256 */
+#if W25Q256_SFDP_ENABLE
+    w25q256_sfdp_read();                /*!< SFDP reads take a 3-byte address */
+#endif
     w25q256_enter_4byte_address_mode(); /*!< enter 4-byte address mode */
     w25q256_quad_enable();              /*!< enable W25Q256 quad mode */               
     w25q256_set_drv(3);                 /*!< set driver strength */
+#if W25Q256_SFDP_ENABLE
+    w25q256_read_mode_select();         /*!< fastest read command that reads back correctly */
+#endif
+    w25q256_info.read_mode = w25q256_read_cmd.name;
     w25q256_info_print();
     
+#if W25Q256_XIP_ENABLE
+    w25q256_mapped_enter();             /*!< reads become CPU loads from W25Q256_XIP_BASE */
+    PRINT_INFO("w25q256 memory-mapped at 0x%08X\r\n", W25Q256_XIP_BASE);
+#endif
+    
+    return 0;
+}
+
+/*!
+    \brief      take the flash for the calling task
+    \param[in]  none
+    \retval     none
+    \note       recursive; while it is held no other task can erase or program,
+                so pointers from w25q256_mapped_address stay readable
+*/
+void w25q256_lock(void)
+{
+    if((w25q256_mutex != NULL) && (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED))
+    {
+        xSemaphoreTakeRecursive(w25q256_mutex, portMAX_DELAY);
+    }
+}
+
+/*!
+    \brief      release the flash
+    \param[in]  none
+    \retval     none
+*/
+void w25q256_unlock(void)
+{
+    if((w25q256_mutex != NULL) && (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED))
+    {
+        xSemaphoreGiveRecursive(w25q256_mutex);
+    }
+}
+
+/*!
+    \brief      get the CPU address of flash data
+    \param[in]  address: flash address
+    \retval     pointer into the memory-mapped window, NULL when the flash is not mapped
+    \note       hold w25q256_lock while reading through the pointer if another
+                task may erase or program the flash at the same time
+*/
+const uint8_t *w25q256_mapped_address(uint32_t address)
+{
+#if W25Q256_XIP_ENABLE
+    if(w25q256_info.mapped && (address < W25Q256_FLASH_SIZE))
+    {
+        return (const uint8_t *)(W25Q256_XIP_BASE + address);
+    }
+#endif
+    
+    return NULL;
+}
+
+/*!
+    \brief      measure read latency and speed of indirect and memory-mapped mode
+    \param[in]  pbuffer: buffer of size bytes
+    \param[in]  size: bytes per sequential read, multiple of 32
+    \retval     0: success, 1: invalid parameter
+    \note       the start of the flash is read, results are stored in w25q256_info
+*/
+uint8_t w25q256_speed_test(uint8_t *pbuffer, uint32_t size)
+{
+    uint32_t cycles, word;
+    uint8_t mapped;
+    
+    if((size == 0) || (size >= W25Q256_FLASH_SIZE))
+    {
+        return 1;
+    }
+    
+    mapped = w25q256_command_begin();
+    
+    cycles = DWT_CYCCNT;
+    w25q256_read_data(0, pbuffer, size);
+    cycles = DWT_CYCCNT - cycles;
+    w25q256_info.indirect_speed = (uint32_t)((uint64_t)size * (SystemCoreClock / 1000) / 1024 / (cycles / 1000 + 1));
+    
+    cycles = DWT_CYCCNT;
+    w25q256_read_data(size, (uint8_t *)&word, 4);
+    cycles = DWT_CYCCNT - cycles;
+    w25q256_info.indirect_latency = cycles * 1000 / (SystemCoreClock / 1000000);
+    
+    w25q256_command_end(mapped);
+    
+#if W25Q256_XIP_ENABLE
+    w25q256_lock();
+    if(w25q256_info.mapped)
+    {
+        SCB_InvalidateDCache_by_Addr((void *)W25Q256_XIP_BASE, (int32_t)((size + 32 + 31) & ~31U));
+        
+        cycles = DWT_CYCCNT;
+        memcpy(pbuffer, (const void *)W25Q256_XIP_BASE, size);
+        cycles = DWT_CYCCNT - cycles;
+        w25q256_info.mapped_speed = (uint32_t)((uint64_t)size * (SystemCoreClock / 1000) / 1024 / (cycles / 1000 + 1));
+        
+        cycles = DWT_CYCCNT;
+        memcpy(pbuffer, (const void *)W25Q256_XIP_BASE, size);
+        cycles = DWT_CYCCNT - cycles;
+        w25q256_info.cached_speed = (uint32_t)((uint64_t)size * (SystemCoreClock / 1000) / 1024 / (cycles / 1000 + 1));
+        
+        cycles = DWT_CYCCNT;
+        word = *(volatile const uint32_t *)(W25Q256_XIP_BASE + ((size + 31) & ~31U));
+        cycles = DWT_CYCCNT - cycles;
+        w25q256_info.mapped_latency = cycles * 1000 / (SystemCoreClock / 1000000);
+    }
+    w25q256_unlock();
+#endif
+    
+    PRINT_INFO("w25q256 indirect read %u KB/s, 4-byte read %u ns\r\n", w25q256_info.indirect_speed, w25q256_info.indirect_latency);
+    PRINT_INFO("w25q256 mapped read %u KB/s (cached %u KB/s), 4-byte read %u ns\r\n",
+               w25q256_info.mapped_speed, w25q256_info.cached_speed, w25q256_info.mapped_latency);
+    
     return 0;
 }
 
@@ -559,7 +1077,9 @@ uint8_t w25q256_init(void)
 void w25q256_info_print(void)
 {
     uint8_t temp[8];
+    uint8_t mapped;
     
+    mapped = w25q256_command_begin();
     PRINT_INFO("print w25q256 information>>\r\n");
     PRINT_INFO("/*********************************************************************/\r\n");
     *(uint32_t *)temp = w25q256_read_device_id();
@@ -572,6 +1092,7 @@ void w25q256_info_print(void)
     PRINT_INFO("w25q256 status register-2: 0x%02X\r\n",w25q256_read_sr(2));
     PRINT_INFO("w25q256 status register-3: 0x%02X\r\n",w25q256_read_sr(3));
     PRINT_INFO("/*********************************************************************/\r\n");
+    w25q256_command_end(mapped);
 }
 
 /*!
@@ -582,11 +1103,14 @@ void w25q256_info_print(void)
 uint32_t w25q256_read_device_id(void)
 {
     uint8_t device_id[3];
+    uint8_t mapped;
     
+    mapped = w25q256_command_begin();
     ospi_send_command(OSPI_OPTYPE_COMMON_CFG, OSPI_INSTRUCTION_1_LINE, W25Q_DeviceID, 
                       OSPI_ADDRESS_NONE, NULL, NULL, \
                       OSPI_DATA_1_LINE, 3, OSPI_DUMYC_CYCLES_0);            /*!< send command */
     ospi_receive(OSPI0, device_id);                                         /*!< receive data */
+    w25q256_command_end(mapped);
     
     return (device_id[0]<<16) | (device_id[1]<<8) | device_id[2];
 }
@@ -599,11 +1123,14 @@ uint32_t w25q256_read_device_id(void)
 uint64_t w25q256_read_unique_id(void)
 {
     uint64_t unique_id = 0;
+    uint8_t mapped;
 
+    mapped = w25q256_command_begin();
     ospi_send_command(OSPI_OPTYPE_COMMON_CFG, OSPI_INSTRUCTION_1_LINE, W25Q_UniqueID, \
                       OSPI_ADDRESS_1_LINE, 0, OSPI_ADDRESS_24_BITS, \
                       OSPI_DATA_1_LINE, 8, OSPI_DUMYC_CYCLES_16); /*!< send command */
     ospi_receive(OSPI0, (uint8_t *)&unique_id);  /*!< receive data */
+    w25q256_command_end(mapped);
 
     return unique_id;
 }
@@ -616,26 +1143,151 @@ uint64_t w25q256_read_unique_id(void)
     \retval     W25Q256 read status
       \arg        0: read successful
       \arg        1: read failed
+    \note       memory-mapped: a copy from the window, otherwise indirect
+                reads of up to W25Q256_MDMA_SIZE_MAX bytes
 */
-uint8_t w25q256_read_data(uint32_t address, uint8_t *pbuffer, uint16_t read_size)
+uint8_t w25q256_read_data(uint32_t address, uint8_t *pbuffer, uint32_t read_size)
 {
-    if(read_size == 0)return 1;
+    uint32_t size;
+    uint8_t status = 0;
     
-    ospi_send_command(OSPI_OPTYPE_COMMON_CFG, OSPI_INSTRUCTION_1_LINE, W25Q_FastReadQuad, \
-                      OSPI_ADDRESS_4_LINES, address, OSPI_ADDRESS_32_BITS, \
-                      OSPI_DATA_4_LINES, read_size, OSPI_DUMYC_CYCLES_6); /*!< send command */
-  
-    OSPI_CTL(OSPI0) = (OSPI_CTL(OSPI0) & ~OSPI_CTL_FMOD) | OSPI_INDIRECT_READ; /*!< indirect read mode */
-    ospi_mdma_config(OSPI0, pbuffer, read_size);
-    ospi_dma_enable(OSPI0); /*!< enable OSPI DMA transfer */
-    OSPI_ADDR(OSPI0) = address; /*!< start OSPI transfer */
-    while((MDMA_CHXSTAT0(MDMA_CH0) & MDMA_FLAG_CHTCF) == RESET); /*!< wait for MDMA transfer complete */
-    MDMA_CHXSTATC(MDMA_CH0)   = 0x1F;
-    while((OSPI_STAT(OSPI0) & OSPI_FLAG_TC) == RESET);
-    OSPI_STATC(OSPI0) = OSPI_STATC_TCC; /*!< clear transfer complete flag */
-    ospi_dma_disable(OSPI0); /*!< disable OSPI DMA transfer */
+    if((read_size == 0) || (address >= W25Q256_FLASH_SIZE) || (read_size > W25Q256_FLASH_SIZE - address))return 1;
     
-    return 0;
+    w25q256_lock();
+    
+#if W25Q256_XIP_ENABLE
+    if(w25q256_info.mapped)
+    {
+        memcpy(pbuffer, (const uint8_t *)(W25Q256_XIP_BASE + address), read_size);
+        w25q256_unlock();
+        
+        return 0;
+    }
+#endif
+    
+    while(read_size > 0)
+    {
+        size = (read_size > W25Q256_MDMA_SIZE_MAX) ? W25Q256_MDMA_SIZE_MAX : read_size;
+        
+        ospi_send_command(OSPI_OPTYPE_COMMON_CFG, OSPI_INSTRUCTION_1_LINE, w25q256_read_cmd.instruction, \
+                          w25q256_read_cmd.addr_mode, address, OSPI_ADDRESS_32_BITS, \
+                          w25q256_read_cmd.data_mode, size, w25q256_read_cmd.dummy_cycles); /*!< send command */
+      
+        OSPI_CTL(OSPI0) = (OSPI_CTL(OSPI0) & ~OSPI_CTL_FMOD) | OSPI_INDIRECT_READ; /*!< indirect read mode */
+        ospi_mdma_config(OSPI0, pbuffer, (uint16_t)size);
+        ospi_dma_enable(OSPI0); /*!< enable OSPI DMA transfer */
+        OSPI_ADDR(OSPI0) = address; /*!< start OSPI transfer */
+        w25q256_event_wait(&MDMA_CHXSTAT0(MDMA_CH0), MDMA_FLAG_CHTCF | MDMA_FLAG_ERR); /*!< wait for MDMA transfer complete */
+        status = (MDMA_CHXSTAT0(MDMA_CH0) & MDMA_FLAG_ERR) ? 1 : 0;
+        mdma_interrupt_disable(MDMA_CH0, MDMA_INT_CHTC | MDMA_INT_ERR);
+        MDMA_CHXSTATC(MDMA_CH0)   = 0x1F;
+        while((OSPI_STAT(OSPI0) & OSPI_FLAG_TC) == RESET);
+        OSPI_STATC(OSPI0) = OSPI_STATC_TCC; /*!< clear transfer complete flag */
+        ospi_dma_disable(OSPI0); /*!< disable OSPI DMA transfer */
+        
+        if(status)break;
+        
+        address += size;
+        pbuffer += size;
+        read_size -= size;
+    }
+    
+    w25q256_unlock();
+    
+    return status;
+}
+
+/*!
+    \brief      read data from W25Q256 with MDMA, the CPU is given to other tasks meanwhile
+    \param[in]  address: start address
+    \param[in]  pbuffer: destination buffer pointer
+    \param[in]  read_size: size of data to read, at most W25Q256_MDMA_SIZE_MAX
+    \retval     W25Q256 read status
+      \arg        0: read successful
+      \arg        1: read failed
+    \note       memory-mapped: MDMA_CH1 copies from the window (memory to memory)
+                and the calling task yields until it completes, otherwise the
+                same as w25q256_read_data. The task sleeps on the MDMA interrupt
+                (W25Q256_IT_MODE). Keep read_size small, the flash is
+                locked for the whole transfer. The D-cache lines of pbuffer
+                are cleaned and invalidated before the transfer (SDRAM is
+                write-back) and invalidated after it, pbuffer must not share
+                lines with data written meanwhile.
+*/
+uint8_t w25q256_read_background(uint32_t address, uint8_t *pbuffer, uint32_t read_size)
+{
+    uint8_t status = 0;
+#if W25Q256_XIP_ENABLE
+    mdma_parameter_struct mdma_init_struct;
+    uint32_t start, end, width;
+#endif
+    
+    if((read_size == 0) || (read_size > W25Q256_MDMA_SIZE_MAX) || \
+       (address >= W25Q256_FLASH_SIZE) || (read_size > W25Q256_FLASH_SIZE - address))return 1;
+    
+    w25q256_lock();
+    
+#if W25Q256_XIP_ENABLE
+    if(w25q256_info.mapped)
+    {
+        width = (((address | (uint32_t)pbuffer | read_size) & 0x03) == 0); /*!< word transfers when aligned */
+        start = (uint32_t)pbuffer & ~31U;
+        end = ((uint32_t)pbuffer + read_size + 31U) & ~31U;
+        SCB_CleanInvalidateDCache_by_Addr((void *)start, (int32_t)(end - start)); /*!< no dirty line may be evicted over the MDMA data */
+        
+        mdma_para_struct_init(&mdma_init_struct);
+        mdma_init_struct.request                = MDMA_REQUEST_SW;
+        mdma_init_struct.trans_trig_mode        = MDMA_BLOCK_TRANSFER;
+        mdma_init_struct.priority               = MDMA_PRIORITY_LOW;
+        mdma_init_struct.endianness             = MDMA_LITTLE_ENDIANNESS;
+        mdma_init_struct.source_addr            = W25Q256_XIP_BASE + address;
+        mdma_init_struct.destination_addr       = (uint32_t)pbuffer;
+        mdma_init_struct.source_inc             = width ? MDMA_SOURCE_INCREASE_32BIT : MDMA_SOURCE_INCREASE_8BIT;
+        mdma_init_struct.dest_inc               = width ? MDMA_DESTINATION_INCREASE_32BIT : MDMA_DESTINATION_INCREASE_8BIT;
+        mdma_init_struct.source_data_size       = width ? MDMA_SOURCE_DATASIZE_32BIT : MDMA_SOURCE_DATASIZE_8BIT;
+        mdma_init_struct.dest_data_dize         = width ? MDMA_DESTINATION_DATASIZE_32BIT : MDMA_DESTINATION_DATASIZE_8BIT;
+        mdma_init_struct.source_burst           = MDMA_SOURCE_BURST_16BEATS;
+        mdma_init_struct.dest_burst             = MDMA_DESTINATION_BURST_16BEATS;
+        mdma_init_struct.source_bus             = MDMA_SOURCE_AXI;
+        mdma_init_struct.destination_bus        = ((((uint32_t)pbuffer & 0xFF000000U) == 0x20000000U) || \
+                                                   (((uint32_t)pbuffer & 0xFF000000U) == 0x00000000U)) ? MDMA_DESTINATION_AHB_TCM : MDMA_DESTINATION_AXI;
+        mdma_init_struct.data_alignment         = MDMA_DATAALIGN_PKEN;
+        mdma_init_struct.buff_trans_len         = 127;
+        mdma_init_struct.tbytes_num_in_block    = read_size;
+        mdma_init_struct.mask_addr              = 0;
+        mdma_init_struct.mask_data              = 0;
+        mdma_init_struct.bufferable_write_mode  = MDMA_BUFFERABLE_WRITE_DISABLE;
+        
+        MDMA_CHXSTATC(MDMA_CH1) = 0x1F;
+        mdma_init(MDMA_CH1, &mdma_init_struct);
+#if W25Q256_USE_IT
+        if(w25q256_event_semaphore != NULL)
+        {
+            xSemaphoreTake(w25q256_event_semaphore, 0); /* drop a stale event */
+            mdma_interrupt_enable(MDMA_CH1, MDMA_INT_CHTC | MDMA_INT_ERR);
+        }
+#endif
+        mdma_channel_enable(MDMA_CH1);
+        mdma_channel_software_request_enable(MDMA_CH1);
+        
+        w25q256_event_wait(&MDMA_CHXSTAT0(MDMA_CH1), MDMA_FLAG_CHTCF | MDMA_FLAG_ERR);
+        status = (MDMA_CHXSTAT0(MDMA_CH1) & MDMA_FLAG_ERR) ? 1 : 0;
+        mdma_interrupt_disable(MDMA_CH1, MDMA_INT_CHTC | MDMA_INT_ERR);
+        MDMA_CHXSTATC(MDMA_CH1) = 0x1F;
+        mdma_channel_disable(MDMA_CH1);
+        
+        SCB_InvalidateDCache_by_Addr((void *)start, (int32_t)(end - start)); /*!< drop lines the core prefetched meanwhile */
+        
+        w25q256_unlock();
+        
+        return status;
+    }
+#endif
+    
+    status = w25q256_read_data(address, pbuffer, read_size);
+    w25q256_unlock();
+    
+    return status;
 }
 
 /*!
@@ -645,13 +1297,52 @@ uint8_t w25q256_read_data(uint32_t address, uint8_t *pbuffer, uint16_t read_size
 */
 void w25q256_erase_sector(uint16_t sector)
 {
+    uint8_t mapped;
+    
     if(sector < 8192)
     {
+        mapped = w25q256_command_begin();
         w25q256_write_enable();
         ospi_send_command(OSPI_OPTYPE_COMMON_CFG, OSPI_INSTRUCTION_1_LINE, W25Q_SectorErase, \
                           OSPI_ADDRESS_1_LINE, sector*4096 , OSPI_ADDRESS_32_BITS, \
                           OSPI_DATA_NONE, NULL, OSPI_DUMYC_CYCLES_0); /*!< send command */   
         ospi_autopolling_memready();
+        w25q256_dirty_mark(sector * 4096, 4096);
+        w25q256_command_end(mapped);
+    }
+}
+
+/*!
+    \brief      erase W25Q256 64KB block
+    \param[in]  block: block number (0-511)
+    \retval     none
+    \note       one block erase replaces 16 sector erases, typically 150ms
+                against 16 x 45ms
+*/
+void w25q256_erase_block(uint16_t block)
+{
+    uint8_t mapped;
+    uint16_t i;
+    
+    if(block < W25Q256_FLASH_SIZE / W25Q256_BLOCK_SIZE)
+    {
+        if(!w25q256_block_erase)
+        {
+            for(i = 0; i < W25Q256_BLOCK_SIZE / 4096; i++)
+            {
+                w25q256_erase_sector(block * (W25Q256_BLOCK_SIZE / 4096) + i);
+            }
+            return;
+        }
+        
+        mapped = w25q256_command_begin();
+        w25q256_write_enable();
+        ospi_send_command(OSPI_OPTYPE_COMMON_CFG, OSPI_INSTRUCTION_1_LINE, W25Q_BlockErase64K, \
+                          OSPI_ADDRESS_1_LINE, block * W25Q256_BLOCK_SIZE, OSPI_ADDRESS_32_BITS, \
+                          OSPI_DATA_NONE, NULL, OSPI_DUMYC_CYCLES_0); /*!< send command */   
+        ospi_autopolling_memready();
+        w25q256_dirty_mark(block * W25Q256_BLOCK_SIZE, W25Q256_BLOCK_SIZE);
+        w25q256_command_end(mapped);
     }
 }
 
@@ -662,11 +1353,16 @@ void w25q256_erase_sector(uint16_t sector)
 */
 void w25q256_erase_chip(uint16_t sector)
 {
+    uint8_t mapped;
+    
+    mapped = w25q256_command_begin();
     w25q256_write_enable();
     ospi_send_command(OSPI_OPTYPE_COMMON_CFG, OSPI_INSTRUCTION_1_LINE, W25Q_ChipErase, \
                       OSPI_ADDRESS_NONE, NULL , NULL, \
                       OSPI_DATA_NONE, NULL, OSPI_DUMYC_CYCLES_0); /*!< send command */   
     ospi_autopolling_memready();
+    w25q256_dirty_mark(0, W25Q256_FLASH_SIZE);
+    w25q256_command_end(mapped);
 }
 
 /*!
@@ -684,6 +1380,7 @@ static void w25q256_write_page(uint32_t address, uint8_t *pbuffer, uint16_t writ
                       OSPI_DATA_4_LINES, write_size, OSPI_DUMYC_CYCLES_0); /*!< send command */
     ospi_transmit(OSPI0, (uint8_t *)pbuffer);
     ospi_autopolling_memready();
+    w25q256_dirty_mark(address, write_size);
 }
 
 /*!
@@ -748,6 +1445,7 @@ uint8_t w25q256_write_data(uint32_t address, uint8_t *pbuffer, uint16_t write_si
     uint16_t secoff;            /*!< offset within sector */
     uint16_t secremain;         /*!< remaining space in sector */
     uint16_t i;
+    uint8_t mapped;
 
     secpos = address / 4096;
     secoff = address % 4096;
@@ -761,6 +1459,8 @@ uint8_t w25q256_write_data(uint32_t address, uint8_t *pbuffer, uint16_t write_si
         return 1;
     }
     
+    mapped = w25q256_command_begin();
+    
     if (write_size <= secremain)
     {
         secremain = write_size;    /*!< not exceeding 4096 bytes */
@@ -817,11 +1517,47 @@ uint8_t w25q256_write_data(uint32_t address, uint8_t *pbuffer, uint16_t write_si
         }
     }
     
+    w25q256_command_end(mapped);
     myfree(SRAMIN, flash_buf);
     
     return 0;
 }
 
+/*!
+    \brief      program data into erased W25Q256 area
+    \param[in]  address: start address
+    \param[in]  pbuffer: source data buffer pointer
+    \param[in]  write_size: size of data to write
+    \retval     W25Q256 write status
+      \arg        0: write successful
+      \arg        1: write failed
+    \note       the area must have been erased (w25q256_erase_block or
+                w25q256_erase_sector), unlike w25q256_write_data the sectors
+                are neither read back nor erased, only pages are programmed
+*/
+uint8_t w25q256_program_data(uint32_t address, uint8_t *pbuffer, uint32_t write_size)
+{
+    uint16_t size;
+    uint8_t mapped;
+    
+    if((write_size == 0) || (address + write_size > W25Q256_FLASH_SIZE))return 1;
+    
+    mapped = w25q256_command_begin();
+    
+    while(write_size > 0)
+    {
+        size = (write_size > 4096) ? 4096 : write_size;
+        w25q256_write_page_nocheck(address, pbuffer, size);
+        pbuffer += size;
+        address += size;
+        write_size -= size;
+    }
+    
+    w25q256_command_end(mapped);
+    
+    return 0;
+}
+
 /*!
     \brief      read W25Q256 security register
     \param[in]  reg: security register number (1-3)
@@ -836,6 +1572,7 @@ uint8_t w25q256_write_data(uint32_t address, uint8_t *pbuffer, uint16_t write_si
 uint8_t w25q256_read_security_register(uint8_t reg, uint8_t address, uint8_t *pbuffer, uint16_t read_size)
 {
     uint32_t read_address = address;
+    uint8_t mapped;
     
     switch(reg)
     {
@@ -861,10 +1598,12 @@ uint8_t w25q256_read_security_register(uint8_t reg, uint8_t address, uint8_t *pb
         read_size = 256 - address;
     }
 
+    mapped = w25q256_command_begin();
     ospi_send_command(OSPI_OPTYPE_COMMON_CFG, OSPI_INSTRUCTION_1_LINE, W25Q_ReadSecurityReg, \
                       OSPI_ADDRESS_1_LINE, read_address, OSPI_ADDRESS_32_BITS, \
                       OSPI_DATA_1_LINE, read_size, OSPI_DUMYC_CYCLES_8);
     ospi_receive(OSPI0, pbuffer);
+    w25q256_command_end(mapped);
     
     return 0;
 }
@@ -879,6 +1618,7 @@ uint8_t w25q256_read_security_register(uint8_t reg, uint8_t address, uint8_t *pb
 uint8_t w25q256_erase_security_register(uint8_t reg)
 {
     uint32_t erase_address = 0;
+    uint8_t mapped;
     
     switch(reg)
     {
@@ -899,11 +1639,13 @@ uint8_t w25q256_erase_security_register(uint8_t reg)
         return 1;
     }
     
+    mapped = w25q256_command_begin();
     w25q256_write_enable();
     ospi_send_command(OSPI_OPTYPE_COMMON_CFG, OSPI_INSTRUCTION_1_LINE, W25Q_SecurityRegErase, \
                       OSPI_ADDRESS_1_LINE, erase_address, OSPI_ADDRESS_32_BITS, \
                       OSPI_DATA_NONE, NULL, OSPI_DUMYC_CYCLES_0); /*!< send command */   
     ospi_autopolling_memready();
+    w25q256_command_end(mapped);
     
     return 0;
 }
@@ -926,6 +1668,7 @@ uint8_t w25q256_write_security_register(uint8_t reg, uint8_t address, uint8_t *p
     uint16_t i;
     uint16_t regremain = 0; /*!< remaining bytes in security register */
     uint32_t write_address = address;
+    uint8_t mapped;
     
     regremain = 256 - address;
     
@@ -963,6 +1706,7 @@ uint8_t w25q256_write_security_register(uint8_t reg, uint8_t address, uint8_t *p
         return 2;
     }
     
+    mapped = w25q256_command_begin();
     w25q256_read_security_register(reg, write_address-address, temp_buf, 256);
     
     for(i = 0; i < regremain; i++)
@@ -999,7 +1743,244 @@ uint8_t w25q256_write_security_register(uint8_t reg, uint8_t address, uint8_t *p
         ospi_autopolling_memready();
     }
     
+    w25q256_command_end(mapped);
     myfree(SRAMIN, temp_buf);
     
     return 0;
 }
+
+/*!
+    \brief      create the flash task for asynchronous requests
+    \param[in]  none
+    \retval     0: success, -1: out of memory, requests are then executed by the caller
+    \note       call before the scheduler starts, after w25q256_init
+*/
+int w25q256_async_init(void)
+{
+    w25q256_async_queue = xQueueCreate(W25Q256_QUEUE_LEN, sizeof(w25q256_request_struct *));
+    
+    if((w25q256_async_queue == NULL) ||
+       (xTaskCreate((TaskFunction_t)w25q256_async_task, "w25q256_task", W25Q256_STK_SIZE, NULL,
+                    W25Q256_TASK_PRIO, &w25q256_async_task_handle) != pdPASS))
+    {
+        PRINT_ERROR("w25q256 asynchronous requests disabled, out of memory\r\n");
+        w25q256_async_task_handle = NULL;
+        return -1;
+    }
+    
+    return 0;
+}
+
+/*!
+    \brief      queue a request, returns at once
+    \param[in]  request: filled in request, state is set to W25Q256_REQ_QUEUED
+    \retval     0: queued or already executed, -1: queue full
+    \note       before the scheduler starts, from the flash task itself (a
+                callback) or without the flash task the request runs right away
+*/
+int w25q256_async_submit(w25q256_request_struct *request)
+{
+    return w25q256_async_enqueue(request, NULL);
+}
+
+/*!
+    \brief      queue a request with its waiter semaphore
+    \param[in]  request: filled in request
+    \param[in]  done: semaphore given on completion, NULL: none
+    \retval     0: queued or already executed, -1: queue full
+    \note       done is always written, a stale handle left in a reused or
+                stack request is never given
+*/
+static int w25q256_async_enqueue(w25q256_request_struct *request, SemaphoreHandle_t done)
+{
+    request->done = done;
+    request->state = W25Q256_REQ_QUEUED;
+    request->status = 1;
+    
+    if((w25q256_async_task_handle == NULL) || (xTaskGetSchedulerState() != taskSCHEDULER_RUNNING) ||
+       (xTaskGetCurrentTaskHandle() == w25q256_async_task_handle))
+    {
+        w25q256_async_execute(request);
+        return 0;
+    }
+    
+    if(xQueueSend(w25q256_async_queue, &request, 0) != pdPASS)
+    {
+        request->state = W25Q256_REQ_IDLE;
+        return -1;
+    }
+    
+    return 0;
+}
+
+/*!
+    \brief      queue a request and wait for it
+    \param[in]  request: filled in request
+    \retval     status of the request, 0: success, 1: failed
+    \note       without a semaphore (out of memory) the wait polls the state
+*/
+uint8_t w25q256_async_run(w25q256_request_struct *request)
+{
+    SemaphoreHandle_t done;
+    
+    if((w25q256_async_task_handle == NULL) || (xTaskGetSchedulerState() != taskSCHEDULER_RUNNING) ||
+       (xTaskGetCurrentTaskHandle() == w25q256_async_task_handle))
+    {
+        w25q256_async_enqueue(request, NULL);
+        return request->status;
+    }
+    
+    done = xSemaphoreCreateBinary();
+    while(w25q256_async_enqueue(request, done) != 0)
+    {
+        vTaskDelay(1);                                  /* queue full, let the flash task catch up */
+    }
+    if(done != NULL)
+    {
+        xSemaphoreTake(done, portMAX_DELAY);
+    }
+    while(request->state != W25Q256_REQ_DONE)
+    {
+        vTaskDelay(1);
+    }
+    if(done != NULL)
+    {
+        vSemaphoreDelete(done);
+    }
+    
+    return request->status;
+}
+
+/*!
+    \brief      execute a request and signal its completion
+    \param[in]  request: queued request
+    \retval     none
+*/
+static void w25q256_async_execute(w25q256_request_struct *request)
+{
+    uint32_t address, end;
+    SemaphoreHandle_t done = request->done;
+    
+    switch(request->op)
+    {
+        case W25Q256_OP_READ:
+            request->status = w25q256_read_data(request->address, request->pbuffer, request->size);
+            break;
+        
+        case W25Q256_OP_READ_BACKGROUND:
+            request->status = w25q256_read_background(request->address, request->pbuffer, request->size);
+            break;
+        
+        case W25Q256_OP_PROGRAM:
+            request->status = w25q256_program_data(request->address, request->pbuffer, request->size);
+            break;
+        
+        case W25Q256_OP_WRITE:
+            request->status = (request->size > 0xFFFF) ? 1 : w25q256_write_data(request->address, request->pbuffer, (uint16_t)request->size);
+            break;
+        
+        case W25Q256_OP_ERASE_SECTOR:
+        case W25Q256_OP_ERASE_BLOCK:
+            end = request->address + request->size;
+            request->status = ((request->size == 0) || (end > W25Q256_FLASH_SIZE) || (end < request->address)) ? 1 : 0;
+            if(request->status)break;
+            
+            if(request->op == W25Q256_OP_ERASE_SECTOR)
+            {
+                for(address = request->address & ~4095U; address < end; address += 4096)
+                {
+                    w25q256_erase_sector(address / 4096);
+                }
+            }
+            else
+            {
+                for(address = request->address & ~(W25Q256_BLOCK_SIZE - 1); address < end; address += W25Q256_BLOCK_SIZE)
+                {
+                    w25q256_erase_block(address / W25Q256_BLOCK_SIZE);
+                }
+            }
+            break;
+        
+        default:
+            request->status = 1;
+            break;
+    }
+    
+    if(request->callback != NULL)
+    {
+        request->callback(request);
+    }
+    if(request->notify != NULL)
+    {
+        xTaskNotify(request->notify, request->notify_bits, eSetBits);
+    }
+    request->state = W25Q256_REQ_DONE;                  /* the request may be reused or freed from here on */
+    if(done != NULL)
+    {
+        xSemaphoreGive(done);
+    }
+}
+
+/*!
+    \brief      flash task, serves the asynchronous requests in order
+    \param[in]  pvParameters: not used
+    \retval     none
+    \note       the task sleeps in the driver while the flash is busy, so a
+                long erase costs the other tasks no CPU time
+*/
+static void w25q256_async_task(void *pvParameters)
+{
+    w25q256_request_struct *request;
+    
+    (void)pvParameters;
+    
+    while(1)
+    {
+        xQueueReceive(w25q256_async_queue, &request, portMAX_DELAY);
+        w25q256_async_execute(request);
+    }
+}
+
+#if W25Q256_USE_IT
+/*!
+    \brief      OSPI0 interrupt handler, signals the status match after program and erase
+    \param[in]  none
+    \retval     none
+*/
+void OSPI0_IRQHandler(void)
+{
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    
+    if((OSPI_CTL(OSPI0) & OSPI_CTL_SMIE) && (OSPI_STAT(OSPI0) & OSPI_FLAG_SM))
+    {
+        /* the flag stays set for w25q256_event_wait, mask it to stop re-entering */
+        OSPI_CTL(OSPI0) &= ~OSPI_CTL_SMIE;
+        xSemaphoreGiveFromISR(w25q256_event_semaphore, &xHigherPriorityTaskWoken);
+    }
+    
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+/*!
+    \brief      MDMA interrupt handler, signals the end of the flash reads on MDMA_CH0 and MDMA_CH1
+    \param[in]  none
+    \retval     none
+*/
+void MDMA_IRQHandler(void)
+{
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    
+    if((MDMA_CHXCTL0(MDMA_CH0) & (MDMA_INT_CHTC | MDMA_INT_ERR)) && (MDMA_CHXSTAT0(MDMA_CH0) & (MDMA_FLAG_CHTCF | MDMA_FLAG_ERR)))
+    {
+        mdma_interrupt_disable(MDMA_CH0, MDMA_INT_CHTC | MDMA_INT_ERR);
+        xSemaphoreGiveFromISR(w25q256_event_semaphore, &xHigherPriorityTaskWoken);
+    }
+    if((MDMA_CHXCTL0(MDMA_CH1) & (MDMA_INT_CHTC | MDMA_INT_ERR)) && (MDMA_CHXSTAT0(MDMA_CH1) & (MDMA_FLAG_CHTCF | MDMA_FLAG_ERR)))
+    {
+        mdma_interrupt_disable(MDMA_CH1, MDMA_INT_CHTC | MDMA_INT_ERR);
+        xSemaphoreGiveFromISR(w25q256_event_semaphore, &xHigherPriorityTaskWoken);
+    }
+    
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+#endif
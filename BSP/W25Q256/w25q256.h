@@ -4,11 +4,70 @@
     \version    1.0
     \date       2025-07-25
     \author     Ze-Hou
+    \note       with W25Q256_XIP_ENABLE the flash stays in OSPI memory-mapped
+                mode after w25q256_init: reads are CPU loads from
+                W25Q256_XIP_BASE through a cacheable, read-only MPU region and
+                w25q256_read_data is a memcpy. Erase, program, ID and status
+                register commands switch to indirect mode, close the window
+                and map it again when they are done, invalidating the D-cache
+                lines of the rewritten range.
+                Cost of a read (ospi_sck = ck_ahb / 3, quad I/O 0xEC): every
+                access sends 8 instruction + 8 address + 6 dummy clocks.
+                - indirect: command, MDMA setup and completion polling per
+                  call, the bytes then arrive at 2 per clock
+                - mapped: a D-cache miss fetches one 32-byte line, 22 + 64
+                  clocks, sequential lines run at close to 2 bytes per clock
+                  and repeated reads are served by the D-cache at core speed
+                w25q256_speed_test logs both modes (4-byte latency and
+                sequential KB/s), values are kept in w25q256_info; main runs
+                it at boot when W25Q256_SPEED_TEST_BOOT is 1.
+                With W25Q256_IT_MODE the calling task sleeps while MDMA reads
+                run and while the flash is busy after a program or erase
+                (OSPI status-match polling in hardware), woken by the MDMA and
+                OSPI0 interrupts; before the scheduler starts it polls.
+                w25q256_async_submit hands read, program and erase requests
+                to the flash task and returns at once, the caller (the LVGL
+                task) goes on rendering and learns the result by callback,
+                task notification bits or the request state.
+                With W25Q256_SFDP_ENABLE w25q256_init reads the SFDP tables
+                (basic flash parameter table, 4-byte address instruction
+                table) and picks the read command: 1-4-4, then 1-1-4, then
+                1-1-1, with the opcode and dummy cycles of the table. A mode
+                is used only when 256 bytes read with it match a 1-1-1
+                reference read of non-uniform data: address 0, or on a blank
+                chip a pattern programmed once into the reserved sector at
+                W25Q256_CHECK_ADDR; without such data only 1-1-1 is used. 4-4-4 (QPI) and DTR are reported but not
+                selected: every other command is sent with a 1-line SDR
+                instruction, and QPI saves only the 8 instruction clocks of
+                the ~86 clocks of a 32-byte line.
 */
 
 #ifndef __W25Q256_H
 #define __W25Q256_H
 #include <stdint.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "./W25Q256/w25q256_sfdp.h"
+
+/* W25Q256 configuration */
+#define W25Q256_XIP_ENABLE              1               /*!< 1: keep the flash memory-mapped between commands */
+#define W25Q256_XIP_BASE                0x90000000U     /*!< OSPI0 memory-mapped window */
+#define W25Q256_FLASH_SIZE              (32 * 1024 * 1024)  /*!< flash size in bytes */
+#define W25Q256_BLOCK_SIZE              (64 * 1024)     /*!< erase block of w25q256_erase_block */
+#define W25Q256_MDMA_SIZE_MAX           (32 * 1024)     /*!< largest indirect read per MDMA transfer */
+#define W25Q256_DCACHE_RANGE_MAX        (64 * 1024)     /*!< rewritten ranges above this clean and invalidate the whole D-cache */
+#define W25Q256_SPEED_TEST_SIZE         4096            /*!< bytes read by w25q256_speed_test */
+#define W25Q256_SPEED_TEST_BOOT         0               /*!< 1: run w25q256_speed_test at boot */
+#define W25Q256_IT_MODE                 1               /*!< 1: sleep on the MDMA and status-match interrupts once the scheduler runs, 0: always poll */
+#define W25Q256_IT_PRIORITY             6               /*!< OSPI0 and MDMA interrupt priority, not above configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY */
+#define W25Q256_IT_TIMEOUT_MS           100             /*!< flags are checked again after this, a lost interrupt only costs time */
+#define W25Q256_SFDP_ENABLE             1               /*!< 1: select the read command from the SFDP tables at init */
+#define W25Q256_SFDP_SIZE               256             /*!< bytes of the SFDP area read at init */
+#define W25Q256_CHECK_ADDR              (W25Q256_FLASH_SIZE - 4096) /*!< last sector, reserved for the read mode check pattern */
+#define W25Q256_TASK_PRIO               2               /*!< flash task priority, below LVGL */
+#define W25Q256_STK_SIZE                256             /*!< flash task stack size */
+#define W25Q256_QUEUE_LEN               8               /*!< queued asynchronous requests */
 
 #define W25Q256                         0xEF4019      /*!< W25Q256 device ID */
 #define GD25Q256                        0xC84019      /*!< GD25Q256 device ID */
@@ -29,24 +88,103 @@
 #define W25Q_Exit4ByteAddressMode       0xE9        /*!< exit 4-byte address mode instruction */
 #define W25Q_DeviceID                   0x9F        /*!< read device ID instruction */
 #define W25Q_UniqueID                   0x4B        /*!< read unique ID instruction */
+#define W25Q_FastRead                   0x0C        /*!< fast read with 4-byte address instruction */
 #define W25Q_FastReadQuad               0xEC        /*!< fast read quad I/O with 4-byte address instruction */
+#define W25Q_ReadSFDP                   0x5A        /*!< read SFDP register instruction, 3-byte address, 8 dummy clocks */
 #define W25Q_SectorErase                0x21        /*!< erase sector instruction */
+#define W25Q_BlockErase64K              0xDC        /*!< erase 64KB block with 4-byte address instruction */
 #define W25Q_ChipErase                  0xC7        /*!< erase chip instruction */
 #define W25Q_WritePageQuad              0x34        /*!< quad input page program with 4-byte address instruction */
 #define W25Q_ReadSecurityReg            0x48        /*!< read security register instruction */
 #define W25Q_SecurityRegErase           0x44        /*!< erase security register instruction */
 #define W25Q_WriteSecurityReg           0x42        /*!< write security register instruction */
 
+/*!
+    \brief      W25Q256 state and read timing structure
+*/
+typedef struct
+{
+    volatile uint8_t mapped;                    /*!< 1: memory-mapped mode, W25Q256_XIP_BASE is readable */
+    uint32_t indirect_speed;                    /*!< Indirect sequential read (KB/s) */
+    uint32_t indirect_latency;                  /*!< Indirect 4-byte read (ns) */
+    uint32_t mapped_speed;                      /*!< Memory-mapped sequential read, D-cache cold (KB/s) */
+    uint32_t mapped_latency;                    /*!< Memory-mapped 4-byte read, D-cache miss (ns) */
+    uint32_t cached_speed;                      /*!< Memory-mapped sequential read, D-cache warm (KB/s) */
+    const char *read_mode;                      /*!< Read command in use: "1-4-4", "1-1-4" or "1-1-1" */
+}w25q256_info_struct;
+
+extern w25q256_info_struct w25q256_info;
+
+extern w25q256_sfdp_struct w25q256_sfdp;
+
+/*!
+    \brief      Asynchronous request operation enumeration
+*/
+typedef enum
+{
+    W25Q256_OP_READ = 0,                        /*!< (0) Read size bytes at address into pbuffer */
+    W25Q256_OP_PROGRAM,                         /*!< (1) Program size bytes into erased flash, see w25q256_program_data */
+    W25Q256_OP_WRITE,                           /*!< (2) Write with read-modify-erase, size at most 65535, see w25q256_write_data */
+    W25Q256_OP_ERASE_SECTOR,                    /*!< (3) Erase the 4KB sectors of address..address + size */
+    W25Q256_OP_ERASE_BLOCK,                     /*!< (4) Erase the 64KB blocks of address..address + size */
+    W25Q256_OP_READ_BACKGROUND,                 /*!< (5) Read with MDMA, size at most W25Q256_MDMA_SIZE_MAX, see w25q256_read_background */
+}w25q256_op_enum;
+
+/*!
+    \brief      Asynchronous request state enumeration
+*/
+typedef enum
+{
+    W25Q256_REQ_IDLE = 0,                       /*!< (0) Not submitted */
+    W25Q256_REQ_QUEUED,                         /*!< (1) Waiting for or being served by the flash task */
+    W25Q256_REQ_DONE,                           /*!< (2) Finished, status is valid */
+}w25q256_state_enum;
+
+typedef struct w25q256_request w25q256_request_struct;
+
+/*!
+    \brief      Request completion callback, called in the flash task
+*/
+typedef void (*w25q256_async_cb)(w25q256_request_struct *request);
+
+/*!
+    \brief      Asynchronous request structure, valid until the state is W25Q256_REQ_DONE
+*/
+struct w25q256_request
+{
+    w25q256_op_enum op;                         /*!< Operation */
+    uint32_t address;                           /*!< Flash address */
+    uint8_t *pbuffer;                           /*!< Data, not used by erase */
+    uint32_t size;                              /*!< Bytes */
+    uint8_t status;                             /*!< 0: success, 1: failed */
+    volatile w25q256_state_enum state;          /*!< w25q256_state_enum */
+    w25q256_async_cb callback;                  /*!< Completion callback, may be NULL */
+    void *user;                                 /*!< Caller context for the callback */
+    TaskHandle_t notify;                        /*!< Task notified with notify_bits (eSetBits) when done, may be NULL */
+    uint32_t notify_bits;                       /*!< Notification bits */
+    SemaphoreHandle_t done;                     /*!< Internal, set by submit and run, given when a waited request finishes */
+};
+
 /* function declarations */
 uint8_t w25q256_init(void);                                                                                         /* initialize W25Q256 device and configure OSPI interface */
 void w25q256_info_print(void);                                                                                      /* print W25Q256 device information */
 uint32_t w25q256_read_device_id(void);                                                                              /* read device ID */
 uint64_t w25q256_read_unique_id(void);                                                                              /* read unique ID */
-uint8_t w25q256_read_data(uint32_t address, uint8_t *pbuffer, uint16_t read_size);                                  /* read data from W25Q256 */
+uint8_t w25q256_read_data(uint32_t address, uint8_t *pbuffer, uint32_t read_size);                                  /* read data from W25Q256 */
+uint8_t w25q256_read_background(uint32_t address, uint8_t *pbuffer, uint32_t read_size);                            /* read with MDMA, yielding the CPU */
+const uint8_t *w25q256_mapped_address(uint32_t address);                                                            /* CPU address of flash data, NULL when not mapped */
+void w25q256_lock(void);                                                                                            /* keep the flash mapped and the OSPI to the caller */
+void w25q256_unlock(void);                                                                                          /* release w25q256_lock */
+uint8_t w25q256_speed_test(uint8_t *pbuffer, uint32_t size);                                                        /* measure indirect and memory-mapped reads */
 void w25q256_erase_sector(uint16_t sector);                                                                         /* erase sector */
+void w25q256_erase_block(uint16_t block);                                                                           /* erase 64KB block */
 void w25q256_erase_chip(uint16_t sector);                                                                           /* erase entire chip */
 uint8_t w25q256_write_data(uint32_t address, uint8_t *pbuffer, uint16_t write_size);                                /* write data to W25Q256 */
+uint8_t w25q256_program_data(uint32_t address, uint8_t *pbuffer, uint32_t write_size);                              /* program erased flash, no read back */
 uint8_t w25q256_read_security_register(uint8_t reg, uint8_t address, uint8_t *pbuffer, uint16_t read_size);         /* read security register */
 uint8_t w25q256_erase_security_register(uint8_t reg);                                                               /* erase security register */
 uint8_t w25q256_write_security_register(uint8_t reg, uint8_t address, uint8_t *pbuffer, uint16_t write_size);       /* write security register */
+int w25q256_async_init(void);                                                                                       /* create the flash task */
+int w25q256_async_submit(w25q256_request_struct *request);                                                          /* queue a request, returns at once */
+uint8_t w25q256_async_run(w25q256_request_struct *request);                                                         /* queue a request and wait for it */
 #endif
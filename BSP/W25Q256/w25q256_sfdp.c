@@ -0,0 +1,130 @@
+/*!
+    \file       w25q256_sfdp.c
+    \brief      SFDP (JESD216) table decoder implementation
+    \version    1.0
+    \date       2025-09-01
+    \author     Ze-Hou
+*/
+
+#include "./W25Q256/w25q256_sfdp.h"
+#include <string.h>
+
+/*!
+    \brief      decode the SFDP (JESD216) tables
+    \param[in]  sfdp: SFDP area read from address 0 with W25Q_ReadSFDP
+    \param[in]  size: bytes in sfdp
+    \param[out] info: features, zeroed when no valid table is found
+    \retval     0: basic flash parameter table decoded, 1: no SFDP or table outside the dump
+    \note       no hardware access, can be fed with dumps of other chips
+*/
+uint8_t w25q256_sfdp_parse(const uint8_t *sfdp, uint32_t size, w25q256_sfdp_struct *info)
+{
+    uint32_t i, nph, id, ptr, len;
+    uint32_t bfpt = 0, bfpt_len = 0, fbait = 0;
+    uint32_t dw[16];
+    
+    memset(info, 0x00, sizeof(w25q256_sfdp_struct));
+    
+    if((size < 16) || (sfdp[0] != 'S') || (sfdp[1] != 'F') || (sfdp[2] != 'D') || (sfdp[3] != 'P'))
+    {
+        return 1;
+    }
+    
+    /* parameter headers, a later basic table has a higher revision */
+    nph = sfdp[6] + 1U;
+    for(i = 0; (i < nph) && (16 + i * 8 <= size); i++)
+    {
+        id = sfdp[8 + i * 8] | ((uint32_t)sfdp[8 + i * 8 + 7] << 8);
+        len = sfdp[8 + i * 8 + 3];
+        ptr = sfdp[8 + i * 8 + 4] | ((uint32_t)sfdp[8 + i * 8 + 5] << 8) | ((uint32_t)sfdp[8 + i * 8 + 6] << 16);
+        
+        if(ptr + len * 4 > size)continue;       /* outside the dump */
+        
+        if((id == 0xFF00) && (len >= 9))
+        {
+            bfpt = ptr;
+            bfpt_len = (len > 16) ? 16 : len;
+            info->major = sfdp[8 + i * 8 + 2];
+            info->minor = sfdp[8 + i * 8 + 1];
+        }
+        else if((id == 0xFF84) && (len >= 2))
+        {
+            fbait = ptr;
+        }
+    }
+    
+    if(bfpt_len == 0)
+    {
+        info->major = 0;
+        info->minor = 0;
+        return 1;
+    }
+    
+    for(i = 0; i < 16; i++)
+    {
+        dw[i] = (i < bfpt_len) ? (sfdp[bfpt + i * 4] | ((uint32_t)sfdp[bfpt + i * 4 + 1] << 8) |
+                                  ((uint32_t)sfdp[bfpt + i * 4 + 2] << 16) | ((uint32_t)sfdp[bfpt + i * 4 + 3] << 24)) : 0;
+    }
+    
+    /* DWORD 1: address bytes, DTR, fast read modes */
+    switch((dw[0] >> 17) & 0x03)
+    {
+        case 0: info->addr_bytes = 3; break;
+        case 1: info->addr_bytes = 34; break;
+        case 2: info->addr_bytes = 4; break;
+        default: break;
+    }
+    info->dtr = (dw[0] >> 19) & 0x01;
+    
+    /* DWORD 2: density */
+    if(dw[1] & 0x80000000U)
+    {
+        info->density = ((dw[1] & 0x7FFFFFFFU) >= 3) && ((dw[1] & 0x7FFFFFFFU) <= 34) ? (1U << ((dw[1] & 0x7FFFFFFFU) - 3)) : 0;
+    }
+    else
+    {
+        info->density = (dw[1] >> 3) + 1;
+    }
+    
+    /* DWORD 3: 1-4-4 and 1-1-4 read, DWORD 5 and 7: 4-4-4 read */
+    if(dw[0] & (1U << 21))
+    {
+        info->read_144.opcode = (dw[2] >> 8) & 0xFF;
+        info->read_144.dummy = (dw[2] & 0x1F) + ((dw[2] >> 5) & 0x07);
+    }
+    if(dw[0] & (1U << 22))
+    {
+        info->read_114.opcode = (dw[2] >> 24) & 0xFF;
+        info->read_114.dummy = ((dw[2] >> 16) & 0x1F) + ((dw[2] >> 21) & 0x07);
+    }
+    if(dw[4] & (1U << 4))
+    {
+        info->read_444.opcode = (dw[6] >> 24) & 0xFF;
+        info->read_444.dummy = ((dw[6] >> 16) & 0x1F) + ((dw[6] >> 21) & 0x07);
+    }
+    
+    /* DWORD 8 and 9: erase types */
+    for(i = 0; i < 4; i++)
+    {
+        len = (dw[7 + i / 2] >> ((i % 2) * 16)) & 0xFF;
+        if((len > 0) && (len < 32))
+        {
+            info->erase_size[i] = 1U << len;
+            info->erase_opcode[i] = (dw[7 + i / 2] >> ((i % 2) * 16 + 8)) & 0xFF;
+        }
+    }
+    
+    /* DWORD 11 (JESD216A and later): page size */
+    info->page_size = (bfpt_len >= 11) ? (1U << ((dw[10] >> 4) & 0x0F)) : 256;
+    
+    /* 4-byte address instruction table, DWORD 1 */
+    if(fbait != 0)
+    {
+        info->opcode_4b = sfdp[fbait] | ((uint32_t)sfdp[fbait + 1] << 8) |
+                          ((uint32_t)sfdp[fbait + 2] << 16) | ((uint32_t)sfdp[fbait + 3] << 24);
+    }
+    
+    info->valid = 1;
+    
+    return 0;
+}
@@ -0,0 +1,46 @@
+/*!
+    \file       w25q256_sfdp.h
+    \brief      SFDP (JESD216) table decoder header file
+    \version    1.0
+    \date       2025-09-01
+    \author     Ze-Hou
+    \note       no hardware access, tools/sfdp_test builds the decoder on the
+                host and checks it against the SFDP tables of several chips
+*/
+
+#ifndef __W25Q256_SFDP_H
+#define __W25Q256_SFDP_H
+#include <stdint.h>
+
+/*!
+    \brief      Read command found in the SFDP tables
+*/
+typedef struct
+{
+    uint8_t opcode;                             /*!< Instruction, 0: not supported */
+    uint8_t dummy;                              /*!< Mode clocks plus wait states */
+}w25q256_sfdp_read_struct;
+
+/*!
+    \brief      SFDP (JESD216) features structure
+*/
+typedef struct
+{
+    uint8_t valid;                              /*!< 1: signature and basic flash parameter table found */
+    uint8_t major;                              /*!< Basic flash parameter table revision */
+    uint8_t minor;
+    uint8_t addr_bytes;                         /*!< 3: 3-byte only, 34: 3- or 4-byte, 4: 4-byte only */
+    uint8_t dtr;                                /*!< 1: DTR clocking supported */
+    w25q256_sfdp_read_struct read_114;          /*!< 1-1-4 fast read */
+    w25q256_sfdp_read_struct read_144;          /*!< 1-4-4 fast read */
+    w25q256_sfdp_read_struct read_444;          /*!< 4-4-4 (QPI) fast read */
+    uint32_t erase_size[4];                     /*!< Erase type sizes (bytes), 0: unused */
+    uint8_t erase_opcode[4];                    /*!< Erase type instructions */
+    uint32_t page_size;                         /*!< Program page size */
+    uint32_t density;                           /*!< Flash size (bytes) */
+    uint32_t opcode_4b;                         /*!< 4-byte address instruction table DWORD 1, 0: no table */
+}w25q256_sfdp_struct;
+
+/* function declarations */
+uint8_t w25q256_sfdp_parse(const uint8_t *sfdp, uint32_t size, w25q256_sfdp_struct *info);                         /* decode an SFDP dump */
+#endif
@@ -28,6 +28,9 @@ enum Stage {
     MSC_WAIT_CSW = 4, /* Command Status Wrapper */
 };
 
+/* thread/polling event: flush the backend cache, then send the CSW */
+#define MSC_SYNC_CACHE 5
+
 /* Device data structure */
 USB_NOCACHE_RAM_SECTION struct usbd_msc_priv {
     /* state of the bulk-only state machine */
@@ -348,6 +351,40 @@ static bool SCSI_inquiry(uint8_t busid, uint8_t **data, uint32_t *len)
     return true;
 }
 
+__WEAK int usbd_msc_sync_cache(uint8_t busid, uint8_t lun)
+{
+    (void)busid;
+    (void)lun;
+
+    return 0;
+}
+
+static bool SCSI_processSync(uint8_t busid)
+{
+    if (usbd_msc_sync_cache(busid, g_usbd_msc[busid].cbw.bLUN) != 0) {
+        SCSI_SetSenseData(busid, SCSI_KCQHE_WRITEFAULT);
+        return false;
+    }
+
+    return true;
+}
+
+/* the CSW is sent once the backend cache is flushed */
+static bool SCSI_deferSync(uint8_t busid)
+{
+#if defined(CONFIG_USBDEV_MSC_THREAD)
+    g_usbd_msc[busid].stage = MSC_SEND_CSW;
+    usb_osal_mq_send(g_usbd_msc[busid].usbd_msc_mq, MSC_SYNC_CACHE);
+    return true;
+#elif defined(CONFIG_USBDEV_MSC_POLLING)
+    g_usbd_msc[busid].stage = MSC_SEND_CSW;
+    chry_ringbuffer_write_byte(&g_usbd_msc[busid].msc_rb, MSC_SYNC_CACHE);
+    return true;
+#else
+    return SCSI_processSync(busid);
+#endif
+}
+
 static bool SCSI_startStopUnit(uint8_t busid, uint8_t **data, uint32_t *len)
 {
     if (g_usbd_msc[busid].cbw.dDataLength != 0U) {
@@ -362,6 +399,9 @@ static bool SCSI_startStopUnit(uint8_t busid, uint8_t **data, uint32_t *len)
     {
         //SCSI_MEDIUM_EJECTED;
         g_usbd_msc[busid].popup = true;
+        *data = NULL;
+        *len = 0;
+        return SCSI_deferSync(busid);
     } else if ((g_usbd_msc[busid].cbw.CB[4] & 0x3U) == 0x3U) /* START=1 and LOEJ Load Eject=1 */
     {
         //SCSI_MEDIUM_UNLOCKED;
@@ -373,6 +413,18 @@ static bool SCSI_startStopUnit(uint8_t busid, uint8_t **data, uint32_t *len)
     return true;
 }
 
+static bool SCSI_synchronizeCache10(uint8_t busid, uint8_t **data, uint32_t *len)
+{
+    if (g_usbd_msc[busid].cbw.dDataLength != 0U) {
+        SCSI_SetSenseData(busid, SCSI_KCQIR_INVALIDCOMMAND);
+        return false;
+    }
+
+    *data = NULL;
+    *len = 0;
+    return SCSI_deferSync(busid);
+}
+
 static bool SCSI_preventAllowMediaRemoval(uint8_t busid, uint8_t **data, uint32_t *len)
 {
     if (g_usbd_msc[busid].cbw.dDataLength != 0U) {
@@ -806,6 +858,9 @@ static bool SCSI_CBWDecode(uint8_t busid, uint32_t nbytes)
             case SCSI_CMD_WRITE12:
                 ret = SCSI_write12(busid, NULL, 0);
                 break;
+            case SCSI_CMD_SYNCHCACHE10:
+                ret = SCSI_synchronizeCache10(busid, &buf2send, &len2send);
+                break;
             case SCSI_CMD_VERIFY10:
                 //ret = SCSI_verify10(NULL, 0);
                 ret = false;
@@ -931,6 +986,8 @@ static void usbdev_msc_thread(void *argument)
             if (SCSI_processRead(busid) == false) {
                 usbd_msc_send_csw(busid, CSW_STATUS_CMD_FAILED); /* send fail status to host,and the host will retry*/
             }
+        } else if (event == MSC_SYNC_CACHE) {
+            usbd_msc_send_csw(busid, SCSI_processSync(busid) ? CSW_STATUS_CMD_PASSED : CSW_STATUS_CMD_FAILED);
         } else {
         }
     }
@@ -950,6 +1007,8 @@ void usbd_msc_polling(uint8_t busid)
             if (SCSI_processRead(busid) == false) {
                 usbd_msc_send_csw(busid, CSW_STATUS_CMD_FAILED); /* send fail status to host,and the host will retry*/
             }
+        } else if (event == MSC_SYNC_CACHE) {
+            usbd_msc_send_csw(busid, SCSI_processSync(busid) ? CSW_STATUS_CMD_PASSED : CSW_STATUS_CMD_FAILED);
         } else {
         }
     }
@@ -21,6 +21,7 @@ struct usbd_interface *usbd_msc_init_intf(uint8_t busid, struct usbd_interface *
 void usbd_msc_get_cap(uint8_t busid, uint8_t lun, uint32_t *block_num, uint32_t *block_size);
 int usbd_msc_sector_read(uint8_t busid, uint8_t lun, uint32_t sector, uint8_t *buffer, uint32_t length);
 int usbd_msc_sector_write(uint8_t busid, uint8_t lun, uint32_t sector, uint8_t *buffer, uint32_t length);
+int usbd_msc_sync_cache(uint8_t busid, uint8_t lun);
 
 void usbd_msc_set_readonly(uint8_t busid, bool readonly);
 bool usbd_msc_get_popup(uint8_t busid);
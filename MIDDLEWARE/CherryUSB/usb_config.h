@@ -102,10 +102,10 @@
 // #define CONFIG_USBDEV_MSC_POLLING
 
 /* move msc read & write from isr to thread */
-// #define CONFIG_USBDEV_MSC_THREAD
+#define CONFIG_USBDEV_MSC_THREAD
 
 #ifndef CONFIG_USBDEV_MSC_PRIO
-#define CONFIG_USBDEV_MSC_PRIO 4
+#define CONFIG_USBDEV_MSC_PRIO 3
 #endif
 
 #ifndef CONFIG_USBDEV_MSC_STACKSIZE
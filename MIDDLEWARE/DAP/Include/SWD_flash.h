@@ -7,6 +7,8 @@
 
 error_t target_flash_init(uint32_t flash_start);
 error_t target_flash_uninit(void);
+error_t target_flash_algo_load(uint32_t flash_start);
+error_t target_flash_algo_unload(void);
 error_t target_flash_program_page(uint32_t addr, const uint8_t *buf, uint32_t size);
 error_t target_flash_erase_sector(uint32_t addr);
 error_t target_flash_erase_chip(void);
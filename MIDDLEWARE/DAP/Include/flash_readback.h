@@ -0,0 +1,65 @@
+/*!
+    \file       flash_readback.h
+    \brief      Target flash readback to file header file
+    \version    1.0
+    \date       2025-08-24
+    \author     Ze-Hou
+*/
+
+#ifndef __FLASH_READBACK_H
+#define __FLASH_READBACK_H
+#include <stdint.h>
+#include "error.h"
+#include "./FATFS/fatfs_config.h"
+
+/* readback configuration */
+#define FLASH_READBACK_PATH             "C:/READBACK"           /*!< output folder */
+#define FLASH_READBACK_BUF_SIZE         (16 * 1024)             /*!< size of each pipeline buffer, multiple of 32 */
+#define FLASH_READBACK_HEX_BUF_SIZE     (2 * 1024)              /*!< Intel HEX line staging buffer */
+#define FLASH_READBACK_WRITER_PRIO      2                       /*!< writer task priority, above the SWD reader */
+#define FLASH_READBACK_WRITER_STK_SIZE  512                     /*!< writer task stack size */
+#define FLASH_READBACK_SWEEP_NUM        6                       /*!< number of SWJ clocks in the speed sweep */
+
+/*!
+    \brief      Readback output format enumeration
+*/
+typedef enum
+{
+    FLASH_READBACK_BIN = 0,                             /*!< (0) Raw binary */
+    FLASH_READBACK_HEX,                                 /*!< (1) Intel HEX */
+}flash_readback_format_enum;
+
+/*!
+    \brief      Readback job structure
+*/
+typedef struct
+{
+    uint32_t addr;                                      /*!< Target start address */
+    uint32_t size;                                      /*!< Number of bytes to read */
+    flash_readback_format_enum format;                  /*!< Output format */
+    uint32_t swj_clock;                                 /*!< SWJ clock in Hz, 0 keeps the current clock */
+    char path[FF_LFN_BUF + 1];                          /*!< Output file path */
+    uint32_t done;                                      /*!< Bytes read so far */
+    uint32_t time_ms;                                   /*!< Job time (ms) */
+}flash_readback_struct;
+
+/*!
+    \brief      Readback speed sweep result structure
+*/
+typedef struct
+{
+    uint32_t swj_clock;                                 /*!< Effective SWJ clock (Hz) */
+    uint32_t kbps;                                      /*!< Measured throughput (KB/s) */
+}flash_readback_speed_struct;
+
+/*!
+    \brief      Readback progress callback, called after each pipeline buffer
+*/
+typedef void (*flash_readback_progress_cb)(uint32_t done, uint32_t total);
+
+/* function declarations */
+error_t flash_readback_run(flash_readback_struct *job, flash_readback_progress_cb progress);    /* stream target memory into a file */
+error_t flash_readback_sweep(flash_readback_struct *job, flash_readback_speed_struct *result, flash_readback_progress_cb progress);  /* readback at each SWJ clock */
+uint32_t flash_readback_swj_clock_get(void);                                                    /* get current SWJ clock in Hz */
+uint32_t flash_readback_kbps(const flash_readback_struct *job);                                 /* throughput of a finished job */
+#endif /* __FLASH_READBACK_H */
@@ -0,0 +1,89 @@
+/*!
+    \file       flash_recipe.h
+    \brief      Multi-region programming recipe header file
+    \version    1.0
+    \date       2025-08-20
+    \author     Ze-Hou
+*/
+
+#ifndef __FLASH_RECIPE_H
+#define __FLASH_RECIPE_H
+#include <stdint.h>
+#include "flash_blob.h"
+#include "FlashOS.h"
+#include "error.h"
+#include "./FATFS/fatfs_config.h"
+
+/* recipe configuration */
+#define FLASH_RECIPE_STEP_MAX           8                       /*!< maximum number of steps in one recipe */
+#define FLASH_RECIPE_ALGO_CACHE_NUM     4                       /*!< number of parsed FLM algorithms kept in SDRAM */
+#define FLASH_RECIPE_PATH_LEN           (FF_LFN_BUF + 1)        /*!< maximum path length */
+#define FLASH_RECIPE_LINE_LEN           (2 * FLASH_RECIPE_PATH_LEN + 32) /*!< maximum recipe line length */
+
+/*
+ * Recipe file (*.RCP, text) format, one step per line, '#' starts a comment:
+ *     <flm path>, <image path>, <base address>, <verify mode>
+ * e.g.
+ *     C:/FLM/STM32F4xx_1024.FLM, C:/BIN/app.bin, 0x08000000, read
+ *     C:/FLM/W25Q64_EXT.FLM, C:/BIN/assets.bin, 0x90000000, none
+ * Verify mode: "none" or "read" (read back and compare with the image).
+ */
+
+/*!
+    \brief      Recipe step verify mode enumeration
+*/
+typedef enum
+{
+    FLASH_RECIPE_VERIFY_NONE = 0,                       /*!< (0) No verification */
+    FLASH_RECIPE_VERIFY_READ,                           /*!< (1) Read back and compare */
+}flash_recipe_verify_enum;
+
+/*!
+    \brief      Recipe step phase enumeration, reported through the progress callback
+*/
+typedef enum
+{
+    FLASH_RECIPE_PHASE_ALGO = 0,                        /*!< (0) Loading algorithm */
+    FLASH_RECIPE_PHASE_ERASE,                           /*!< (1) Erasing sectors */
+    FLASH_RECIPE_PHASE_PROGRAM,                         /*!< (2) Programming pages */
+    FLASH_RECIPE_PHASE_VERIFY,                          /*!< (3) Verifying */
+    FLASH_RECIPE_PHASE_DONE,                            /*!< (4) Step finished */
+}flash_recipe_phase_enum;
+
+/*!
+    \brief      Recipe step structure
+*/
+typedef struct
+{
+    char flm_path[FLASH_RECIPE_PATH_LEN];               /*!< FLM algorithm file path */
+    char image_path[FLASH_RECIPE_PATH_LEN];             /*!< Image (BIN) file path */
+    uint32_t base_addr;                                 /*!< Target address of the image */
+    flash_recipe_verify_enum verify;                    /*!< Verify mode */
+    uint32_t image_size;                                /*!< Image size, filled in when executed */
+    uint32_t time_ms;                                   /*!< Step execution time (ms) */
+    error_t error;                                      /*!< Step result */
+}flash_recipe_step_struct;
+
+/*!
+    \brief      Recipe structure
+*/
+typedef struct
+{
+    uint8_t step_num;                                   /*!< Number of valid steps */
+    uint8_t step_done;                                  /*!< Number of executed steps */
+    uint32_t total_time_ms;                             /*!< Total execution time (ms) */
+    flash_recipe_step_struct step[FLASH_RECIPE_STEP_MAX];   /*!< Recipe steps */
+}flash_recipe_struct;
+extern flash_recipe_struct *flash_recipe;
+
+/*!
+    \brief      Recipe progress callback, step is the index of the running step
+*/
+typedef void (*flash_recipe_progress_cb)(uint8_t step, flash_recipe_phase_enum phase);
+
+/* function declarations */
+int flash_recipe_load(const char *fpath);                                           /* load and parse recipe file */
+error_t flash_recipe_run(uint8_t attached, flash_recipe_progress_cb progress);      /* execute loaded recipe */
+void flash_recipe_free(void);                                                       /* free loaded recipe */
+void flash_recipe_algo_cache_clear(void);                                           /* free cached algorithms */
+#endif /* __FLASH_RECIPE_H */
@@ -0,0 +1,60 @@
+/*!
+    \file       flm_library.h
+    \brief      FLM device library index header file
+    \version    1.0
+    \date       2025-08-22
+    \author     Ze-Hou
+*/
+
+#ifndef __FLM_LIBRARY_H
+#define __FLM_LIBRARY_H
+#include <stdint.h>
+#include "./FATFS/fatfs_config.h"
+
+/* library configuration */
+#define FLM_LIBRARY_PATH            "C:/SYSTEM/FLM"                 /*!< device library folder */
+#define FLM_LIBRARY_INDEX_PATH      "C:/SYSTEM/FLM/FLMLIB.IDX"      /*!< binary index file */
+#define FLM_LIBRARY_ENTRY_MAX       512                             /*!< maximum number of indexed devices */
+#define FLM_LIBRARY_NAME_LEN        64                              /*!< maximum FLM file name length */
+#define FLM_LIBRARY_MAGIC           0x42494C46                      /*!< "FLIB" */
+#define FLM_LIBRARY_VERSION         1                               /*!< index format version */
+
+/*
+ * Each <name>.FLM in FLM_LIBRARY_PATH is described by a <name>.ID text file:
+ *     id = <dp idcode>, <cpuid>, <dbgmcu address>, <dbgmcu mask>, <dbgmcu idcode>
+ *     ram = <ram base>, <ram size>
+ * Several id lines may share one FLM. A dbgmcu mask of 0 matches any device
+ * with the same DP IDCODE and CPUID.
+ */
+
+/*!
+    \brief      Index file header structure
+*/
+typedef struct
+{
+    uint32_t magic;                                     /*!< FLM_LIBRARY_MAGIC */
+    uint16_t version;                                   /*!< FLM_LIBRARY_VERSION */
+    uint16_t count;                                     /*!< Number of entries */
+}flm_library_header_struct;
+
+/*!
+    \brief      Index entry structure, entries are sorted by (dp_idcode, cpuid)
+*/
+typedef struct
+{
+    uint32_t dp_idcode;                                 /*!< SW-DP IDCODE */
+    uint32_t cpuid;                                     /*!< SCB CPUID */
+    uint32_t dbgmcu_addr;                               /*!< DBGMCU_IDCODE register address */
+    uint32_t dbgmcu_mask;                               /*!< DBGMCU_IDCODE compare mask */
+    uint32_t dbgmcu_idcode;                             /*!< DBGMCU_IDCODE value after mask */
+    uint32_t flash_base;                                /*!< Flash base address (from FLM) */
+    uint32_t flash_size;                                /*!< Flash size (from FLM) */
+    uint32_t ram_base;                                  /*!< Target RAM base address */
+    uint32_t ram_size;                                  /*!< Target RAM size */
+    char flm_name[FLM_LIBRARY_NAME_LEN];                /*!< FLM file name inside FLM_LIBRARY_PATH */
+}flm_library_entry_struct;
+
+/* function declarations */
+int flm_library_index_build(void);                                              /* scan library folder and write sorted index */
+int flm_library_lookup(flm_library_entry_struct *entry, char *fpath, uint16_t len); /* identify attached target and find its FLM */
+#endif /* __FLM_LIBRARY_H */
@@ -15,6 +15,13 @@ error_t target_flash_init(uint32_t flash_start)
         return ERROR_RESET;
     }
     
+    return target_flash_algo_load(flash_start);
+}
+
+// Download flash_algo into an already halted target and initialise it, used to
+// switch algorithms inside one debug session without another reset.
+error_t target_flash_algo_load(uint32_t flash_start)
+{
     // Download flash programming algorithm to target and initialise.
     if (0 == swd_write_memory(flash_algo.algo_start, (uint8_t *)flash_algo.algo_blob, flash_algo.algo_size)) {
         return ERROR_ALGO_DL;
@@ -27,6 +34,16 @@ error_t target_flash_init(uint32_t flash_start)
     return ERROR_SUCCESS;
 }
 
+// Uninitialise the loaded algorithm but keep the target halted and attached.
+error_t target_flash_algo_unload(void)
+{
+    if (0 == swd_flash_syscall_exec(&flash_algo.sys_call_s, flash_algo.uninit, 3, 0, 0, 0)) {
+        return ERROR_INIT;
+    }
+
+    return ERROR_SUCCESS;
+}
+
 error_t target_flash_uninit(void)
 {
 	swd_flash_syscall_exec(&flash_algo.sys_call_s, flash_algo.uninit, 3, 0, 0, 0);
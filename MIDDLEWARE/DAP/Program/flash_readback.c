@@ -0,0 +1,380 @@
+/*!
+    \file       flash_readback.c
+    \brief      Target flash readback to file implementation file
+    \version    1.0
+    \date       2025-08-24
+    \author     Ze-Hou
+    \note       SWD reads and eMMC writes are pipelined through two 32-byte aligned
+                buffers: the caller's task reads the target while a short-lived
+                writer task feeds f_write, so the two buses work at the same time
+*/
+
+#include "flash_readback.h"
+#include "SWD_host.h"
+#include "DAP_config.h"
+#include "DAP.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+#include "./FATFS/storage_service.h"
+#include "./MALLOC/malloc.h"
+#include "./USART/usart.h"
+#include <stdio.h>
+#include <string.h>
+
+/*!
+    \brief      Pipeline buffer descriptor passed between reader and writer
+*/
+typedef struct
+{
+    uint8_t index;                                      /*!< Buffer index */
+    uint32_t addr;                                      /*!< Target address of the data */
+    uint32_t len;                                       /*!< Valid bytes, 0 ends the job */
+}flash_readback_block_struct;
+
+/*!
+    \brief      Pipeline state shared with the writer task
+*/
+typedef struct
+{
+    uint8_t *buffer[2];                                 /*!< Pipeline buffers */
+    char *hex;                                          /*!< Intel HEX staging buffer */
+    uint32_t hex_len;                                   /*!< Bytes staged in hex */
+    uint32_t hex_upper;                                 /*!< Current extended linear address */
+    FIL *file;                                          /*!< Output file */
+    flash_readback_format_enum format;                  /*!< Output format */
+    QueueHandle_t free_queue;                           /*!< Buffers ready to be filled */
+    QueueHandle_t full_queue;                           /*!< Buffers ready to be written */
+    SemaphoreHandle_t done;                             /*!< Given by the writer when finished */
+    volatile FRESULT fresult;                           /*!< First write error */
+}flash_readback_pipe_struct;
+
+/* static function declarations */
+static FRESULT flash_readback_hex_flush(flash_readback_pipe_struct *pipe);
+static FRESULT flash_readback_hex_record(flash_readback_pipe_struct *pipe, uint8_t type, uint16_t offset, const uint8_t *data, uint8_t len);
+static FRESULT flash_readback_hex_write(flash_readback_pipe_struct *pipe, uint32_t addr, const uint8_t *data, uint32_t len);
+static void flash_readback_writer_task(void *pvParameters);
+
+static const uint32_t flash_readback_sweep_clock[FLASH_READBACK_SWEEP_NUM] = {
+    1000000, 2000000, 5000000, 10000000, 20000000, 50000000
+};
+
+/*!
+    \brief      throughput of a finished job
+    \param[in]  job: readback job
+    \param[out] none
+    \retval     KB/s
+*/
+uint32_t flash_readback_kbps(const flash_readback_struct *job)
+{
+    if(job->time_ms == 0)return 0;
+    return (uint32_t)((uint64_t)job->done * 1000 / job->time_ms / 1024);
+}
+
+/*!
+    \brief      get the SWJ clock currently configured in DAP_Data
+    \param[in]  none
+    \param[out] none
+    \retval     SWJ clock in Hz
+*/
+uint32_t flash_readback_swj_clock_get(void)
+{
+    if(DAP_Data.fast_clock)
+    {
+        return (CPU_CLOCK / 2U) / (IO_PORT_WRITE_CYCLES + DELAY_FAST_CYCLES);
+    }
+    return (CPU_CLOCK / 2U) / (IO_PORT_WRITE_CYCLES + DAP_Data.clock_delay * DELAY_SLOW_CYCLES);
+}
+
+/*!
+    \brief      write staged Intel HEX text to the file
+    \param[in]  pipe: pipeline state
+    \param[out] none
+    \retval     FatFs result
+*/
+static FRESULT flash_readback_hex_flush(flash_readback_pipe_struct *pipe)
+{
+    UINT bw;
+    FRESULT fresult = FR_OK;
+
+    if(pipe->hex_len)
+    {
+        fresult = f_write(pipe->file, pipe->hex, pipe->hex_len, &bw);
+        pipe->hex_len = 0;
+    }
+    return fresult;
+}
+
+/*!
+    \brief      stage one Intel HEX record
+    \param[in]  pipe: pipeline state
+    \param[in]  type: record type
+    \param[in]  offset: 16-bit load offset
+    \param[in]  data: record data
+    \param[in]  len: record data length (max 16)
+    \param[out] none
+    \retval     FatFs result
+*/
+static FRESULT flash_readback_hex_record(flash_readback_pipe_struct *pipe, uint8_t type, uint16_t offset, const uint8_t *data, uint8_t len)
+{
+    uint8_t i, sum;
+    FRESULT fresult = FR_OK;
+
+    if(pipe->hex_len + 48 > FLASH_READBACK_HEX_BUF_SIZE)
+    {
+        fresult = flash_readback_hex_flush(pipe);
+    }
+
+    sum = len + (offset >> 8) + (offset & 0xFF) + type;
+    pipe->hex_len += sprintf(pipe->hex + pipe->hex_len, ":%02X%04X%02X", len, offset, type);
+    for(i = 0; i < len; i++)
+    {
+        sum += data[i];
+        pipe->hex_len += sprintf(pipe->hex + pipe->hex_len, "%02X", data[i]);
+    }
+    pipe->hex_len += sprintf(pipe->hex + pipe->hex_len, "%02X\r\n", (uint8_t)(0x100 - sum));
+
+    return fresult;
+}
+
+/*!
+    \brief      convert a block to Intel HEX records
+    \param[in]  pipe: pipeline state
+    \param[in]  addr: target address of the block
+    \param[in]  data: block data
+    \param[in]  len: block length
+    \param[out] none
+    \retval     FatFs result
+*/
+static FRESULT flash_readback_hex_write(flash_readback_pipe_struct *pipe, uint32_t addr, const uint8_t *data, uint32_t len)
+{
+    uint8_t n, upper[2];
+    FRESULT fresult = FR_OK;
+
+    while(len && (fresult == FR_OK))
+    {
+        if((addr >> 16) != pipe->hex_upper)
+        {
+            pipe->hex_upper = addr >> 16;
+            upper[0] = pipe->hex_upper >> 8;
+            upper[1] = pipe->hex_upper & 0xFF;
+            fresult = flash_readback_hex_record(pipe, 0x04, 0, upper, 2);
+        }
+        n = (len > 16) ? 16 : len;
+        if(((addr & 0xFFFF) + n) > 0x10000)
+        {
+            n = 0x10000 - (addr & 0xFFFF);
+        }
+        if(fresult == FR_OK)
+        {
+            fresult = flash_readback_hex_record(pipe, 0x00, addr & 0xFFFF, data, n);
+        }
+        addr += n;
+        data += n;
+        len -= n;
+    }
+    return fresult;
+}
+
+/*!
+    \brief      writer task, drains full buffers into the output file
+    \param[in]  pvParameters: pipeline state
+    \param[out] none
+    \retval     none
+*/
+static void flash_readback_writer_task(void *pvParameters)
+{
+    UINT bw;
+    FRESULT fresult;
+    flash_readback_block_struct block;
+    flash_readback_pipe_struct *pipe = (flash_readback_pipe_struct *)pvParameters;
+
+    while(1)
+    {
+        xQueueReceive(pipe->full_queue, &block, portMAX_DELAY);
+        if(block.len == 0)break;
+
+        if(pipe->fresult == FR_OK)
+        {
+            if(pipe->format == FLASH_READBACK_HEX)
+            {
+                fresult = flash_readback_hex_write(pipe, block.addr, pipe->buffer[block.index], block.len);
+            }
+            else
+            {
+                fresult = f_write(pipe->file, pipe->buffer[block.index], block.len, &bw);
+                if((fresult == FR_OK) && (bw != block.len))fresult = FR_DENIED;
+            }
+            if(fresult != FR_OK)pipe->fresult = fresult;
+        }
+        xQueueSend(pipe->free_queue, &block.index, portMAX_DELAY);
+    }
+
+    if((pipe->format == FLASH_READBACK_HEX) && (pipe->fresult == FR_OK))
+    {
+        fresult = flash_readback_hex_record(pipe, 0x01, 0, NULL, 0);
+        if(fresult == FR_OK)fresult = flash_readback_hex_flush(pipe);
+        if(fresult != FR_OK)pipe->fresult = fresult;
+    }
+
+    xSemaphoreGive(pipe->done);
+    vTaskDelete(NULL);
+}
+
+/*!
+    \brief      stream target memory into a BIN or HEX file
+    \param[in]  job: readback job, done and time_ms are updated
+    \param[in]  progress: progress callback, may be NULL
+    \param[out] none
+    \retval     error code
+    \note       the target must already be attached and halted (offline debugger connected)
+*/
+error_t flash_readback_run(flash_readback_struct *job, flash_readback_progress_cb progress)
+{
+    uint8_t index = 0;
+    uint8_t fast_clock = DAP_Data.fast_clock;
+    uint32_t clock_delay = DAP_Data.clock_delay;
+    error_t error = ERROR_SUCCESS;
+    TickType_t tick_start;
+    flash_readback_block_struct block;
+    flash_readback_pipe_struct pipe;
+    storage_request_struct request = {0};
+
+    memset(&pipe, 0x00, sizeof(pipe));
+    job->done = 0;
+    job->time_ms = 0;
+
+    pipe.format = job->format;
+    pipe.hex_upper = 0xFFFFFFFF;
+    pipe.buffer[0] = (uint8_t *)mymalloc(SRAMIN, FLASH_READBACK_BUF_SIZE);
+    pipe.buffer[1] = (uint8_t *)mymalloc(SRAMIN, FLASH_READBACK_BUF_SIZE);
+    pipe.file = (FIL *)mymalloc(SRAMIN, sizeof(FIL));
+    if(job->format == FLASH_READBACK_HEX)
+    {
+        pipe.hex = (char *)mymalloc(SRAMIN, FLASH_READBACK_HEX_BUF_SIZE);
+    }
+    pipe.free_queue = xQueueCreate(2, sizeof(uint8_t));
+    pipe.full_queue = xQueueCreate(2, sizeof(flash_readback_block_struct));
+    pipe.done = xSemaphoreCreateBinary();
+    if((pipe.buffer[0] == NULL) || (pipe.buffer[1] == NULL) || (pipe.file == NULL) ||
+       ((job->format == FLASH_READBACK_HEX) && (pipe.hex == NULL)) ||
+       (pipe.free_queue == NULL) || (pipe.full_queue == NULL) || (pipe.done == NULL))
+    {
+        error = ERROR_INTERNAL;
+        goto __exit;
+    }
+
+    f_mkdir(FLASH_READBACK_PATH);
+    if(f_open(pipe.file, job->path, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK)
+    {
+        error = ERROR_FAILURE;
+        goto __exit;
+    }
+
+    if(job->swj_clock)
+    {
+        Set_Clock_Delay(job->swj_clock);
+    }
+
+    if(xTaskCreate((TaskFunction_t)flash_readback_writer_task, (const char*)"readback_writer_task",
+                   (uint16_t)FLASH_READBACK_WRITER_STK_SIZE, (void*)&pipe,
+                   (UBaseType_t)FLASH_READBACK_WRITER_PRIO, NULL) != pdPASS)
+    {
+        f_close(pipe.file);
+        error = ERROR_INTERNAL;
+        goto __clock;
+    }
+
+    index = 0;
+    xQueueSend(pipe.free_queue, &index, 0);
+    index = 1;
+    xQueueSend(pipe.free_queue, &index, 0);
+
+    tick_start = xTaskGetTickCount();
+    block.addr = job->addr;
+    while((job->done < job->size) && (pipe.fresult == FR_OK))
+    {
+        xQueueReceive(pipe.free_queue, &block.index, portMAX_DELAY);
+        block.len = job->size - job->done;
+        if(block.len > FLASH_READBACK_BUF_SIZE)block.len = FLASH_READBACK_BUF_SIZE;
+
+        if(swd_read_memory(block.addr, pipe.buffer[block.index], block.len) == 0)
+        {
+            error = ERROR_FAILURE;
+            break;
+        }
+        xQueueSend(pipe.full_queue, &block, portMAX_DELAY);
+
+        block.addr += block.len;
+        job->done += block.len;
+        if(progress)progress(job->done, job->size);
+    }
+
+    /* end marker, then wait for the writer to drain */
+    block.len = 0;
+    xQueueSend(pipe.full_queue, &block, portMAX_DELAY);
+    xSemaphoreTake(pipe.done, portMAX_DELAY);
+    job->time_ms = (xTaskGetTickCount() - tick_start) * portTICK_PERIOD_MS;
+
+    if(f_close(pipe.file) != FR_OK)pipe.fresult = FR_DISK_ERR;
+    request.op = STORAGE_OP_INDEX;                       /* the storage task owns the index rebuild */
+    request.prio = STORAGE_PRIO_NORMAL;
+    request.path = job->path;
+    storage_service_run(&request);
+    if((error == ERROR_SUCCESS) && (pipe.fresult != FR_OK))
+    {
+        error = ERROR_FAILURE;
+    }
+
+    PRINT_INFO("readback %s: %u bytes, %ums, %u KB/s @ %u kHz\r\n", (error == ERROR_SUCCESS) ? "ok" : "failed", job->done, job->time_ms,
+               flash_readback_kbps(job), flash_readback_swj_clock_get() / 1000);
+
+__clock:
+    DAP_Data.fast_clock = fast_clock;
+    DAP_Data.clock_delay = clock_delay;
+__exit:
+    if(pipe.done)vSemaphoreDelete(pipe.done);
+    if(pipe.full_queue)vQueueDelete(pipe.full_queue);
+    if(pipe.free_queue)vQueueDelete(pipe.free_queue);
+    myfree(SRAMIN, pipe.hex);
+    myfree(SRAMIN, pipe.file);
+    myfree(SRAMIN, pipe.buffer[1]);
+    myfree(SRAMIN, pipe.buffer[0]);
+    return error;
+}
+
+/*!
+    \brief      repeat a BIN readback at each SWJ clock of the sweep table
+    \param[in]  job: readback job, the last run is left in done/time_ms
+    \param[in]  progress: progress callback, may be NULL
+    \param[out] result: measured clock and throughput per setting
+    \retval     error code of the first failing run
+*/
+error_t flash_readback_sweep(flash_readback_struct *job, flash_readback_speed_struct *result, flash_readback_progress_cb progress)
+{
+    uint8_t i;
+    uint8_t fast_clock;
+    uint32_t clock_delay;
+    error_t error = ERROR_SUCCESS;
+
+    job->format = FLASH_READBACK_BIN;
+    for(i = 0; (i < FLASH_READBACK_SWEEP_NUM) && (error == ERROR_SUCCESS); i++)
+    {
+        job->swj_clock = flash_readback_sweep_clock[i];
+
+        /* the clock the DAP really runs at after rounding of the delay loop */
+        fast_clock = DAP_Data.fast_clock;
+        clock_delay = DAP_Data.clock_delay;
+        Set_Clock_Delay(job->swj_clock);
+        result[i].swj_clock = flash_readback_swj_clock_get();
+        DAP_Data.fast_clock = fast_clock;
+        DAP_Data.clock_delay = clock_delay;
+
+        error = flash_readback_run(job, progress);
+        result[i].kbps = (error == ERROR_SUCCESS) ? flash_readback_kbps(job) : 0;
+    }
+    job->swj_clock = 0;
+
+    return error;
+}
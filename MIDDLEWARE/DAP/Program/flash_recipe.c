@@ -0,0 +1,488 @@
+/*!
+    \file       flash_recipe.c
+    \brief      Multi-region programming recipe implementation file
+    \version    1.0
+    \date       2025-08-20
+    \author     Ze-Hou
+*/
+
+#include "flash_recipe.h"
+#include "SWD_host.h"
+#include "SWD_flash.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "./MALLOC/malloc.h"
+#include "./USART/usart.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+extern FlashDeviceStruct flash_device;         /* target flash information */
+extern program_target_t flash_algo;            /* target flash algorithm information */
+extern int flm_prase(const char* fpath);       /* FLM file parser function */
+
+/*!
+    \brief      Cached FLM algorithm structure
+*/
+typedef struct
+{
+    char path[FLASH_RECIPE_PATH_LEN];                   /*!< FLM file path, cache key */
+    program_target_t algo;                              /*!< Parsed algorithm, blob lives in SDRAM */
+    FlashDeviceStruct device;                           /*!< Parsed device, sectors live in SDRAM */
+    uint32_t last_used;                                 /*!< LRU stamp */
+}flash_recipe_algo_struct;
+
+flash_recipe_struct *flash_recipe = NULL;
+
+static flash_recipe_algo_struct *algo_cache[FLASH_RECIPE_ALGO_CACHE_NUM];
+static uint32_t algo_cache_stamp = 0;
+
+/* static function declarations */
+static char *flash_recipe_trim(char *str);
+static flash_recipe_algo_struct *flash_recipe_algo_get(const char *fpath);
+static void flash_recipe_algo_release(flash_recipe_algo_struct *algo);
+static void flash_recipe_sector_get(uint32_t offset, uint32_t *start, uint32_t *size);
+static error_t flash_recipe_step_exec(flash_recipe_step_struct *step, uint8_t index, flash_recipe_progress_cb progress);
+
+/*!
+    \brief      strip leading and trailing white space in place
+    \param[in]  str: string to trim
+    \param[out] none
+    \retval     pointer to the first non-space character
+*/
+static char *flash_recipe_trim(char *str)
+{
+    char *end;
+
+    while(isspace((unsigned char)*str))str++;
+    end = str + strlen(str);
+    while((end > str) && isspace((unsigned char)*(end - 1)))end--;
+    *end = '\0';
+
+    return str;
+}
+
+/*!
+    \brief      load and parse a recipe file into flash_recipe
+    \param[in]  fpath: recipe file path
+    \param[out] none
+    \retval     number of steps, negative on error
+*/
+int flash_recipe_load(const char *fpath)
+{
+    int res = 0;
+    uint8_t n = 0;
+    uint16_t line_num = 0;
+    char *line, *field[4], *p;
+    FIL *file;
+    flash_recipe_step_struct *step;
+
+    flash_recipe_free();
+    flash_recipe = (flash_recipe_struct *)mymalloc(SRAMEX, sizeof(flash_recipe_struct));
+    file = (FIL *)mymalloc(SRAMIN, sizeof(FIL));
+    line = (char *)mymalloc(SRAMIN, FLASH_RECIPE_LINE_LEN);
+    if((flash_recipe == NULL) || (file == NULL) || (line == NULL))
+    {
+        res = -2;
+        goto __exit;
+    }
+    memset(flash_recipe, 0x00, sizeof(flash_recipe_struct));
+
+    if(f_open(file, fpath, FA_READ) != FR_OK)
+    {
+        res = -1;
+        goto __exit;
+    }
+
+    while(f_gets(line, FLASH_RECIPE_LINE_LEN, file) != NULL)
+    {
+        line_num++;
+        p = strchr(line, '#');
+        if(p)*p = '\0';
+        p = flash_recipe_trim(line);
+        if(*p == '\0')continue;
+
+        for(n = 0; n < 4; n++)
+        {
+            field[n] = p;
+            p = strchr(p, ',');
+            if(p == NULL)break;
+            *p++ = '\0';
+        }
+        if((n != 3) || (flash_recipe->step_num >= FLASH_RECIPE_STEP_MAX))
+        {
+            PRINT_ERROR("recipe line %u invalid\r\n", line_num);
+            res = -3;
+            break;
+        }
+
+        step = &flash_recipe->step[flash_recipe->step_num];
+        strncpy(step->flm_path, flash_recipe_trim(field[0]), FLASH_RECIPE_PATH_LEN - 1);
+        strncpy(step->image_path, flash_recipe_trim(field[1]), FLASH_RECIPE_PATH_LEN - 1);
+        step->base_addr = strtoul(flash_recipe_trim(field[2]), NULL, 0);
+        p = flash_recipe_trim(field[3]);
+        step->verify = ((p[0] == 'r') || (p[0] == 'R')) ? FLASH_RECIPE_VERIFY_READ : FLASH_RECIPE_VERIFY_NONE;
+        step->error = ERROR_SUCCESS;
+        flash_recipe->step_num++;
+    }
+    f_close(file);
+
+    if((res == 0) && (flash_recipe->step_num == 0))
+    {
+        res = -3;
+    }
+
+__exit:
+    myfree(SRAMIN, line);
+    myfree(SRAMIN, file);
+    if(res < 0)
+    {
+        flash_recipe_free();
+        return res;
+    }
+    return flash_recipe->step_num;
+}
+
+/*!
+    \brief      free the loaded recipe
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void flash_recipe_free(void)
+{
+    myfree(SRAMEX, flash_recipe);
+    flash_recipe = NULL;
+}
+
+/*!
+    \brief      release one cached algorithm
+    \param[in]  algo: cached algorithm
+    \param[out] none
+    \retval     none
+*/
+static void flash_recipe_algo_release(flash_recipe_algo_struct *algo)
+{
+    if(algo == NULL)return;
+
+    myfree(SRAMEX, algo->algo.algo_blob);
+    myfree(SRAMEX, algo->device.sectors);
+    myfree(SRAMEX, algo);
+}
+
+/*!
+    \brief      free all cached algorithms
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void flash_recipe_algo_cache_clear(void)
+{
+    uint8_t i;
+
+    for(i = 0; i < FLASH_RECIPE_ALGO_CACHE_NUM; i++)
+    {
+        flash_recipe_algo_release(algo_cache[i]);
+        algo_cache[i] = NULL;
+    }
+}
+
+/*!
+    \brief      get a parsed algorithm from the cache, parse the FLM file on a miss
+    \param[in]  fpath: FLM file path
+    \param[out] none
+    \retval     cached algorithm, NULL on error
+    \note       flm_prase works on the flash_algo/flash_device globals, they are saved
+                and restored around the call so the caller's selection is untouched
+*/
+static flash_recipe_algo_struct *flash_recipe_algo_get(const char *fpath)
+{
+    uint8_t i, slot = 0;
+    int res;
+    program_target_t algo_saved;
+    FlashDeviceStruct device_saved;
+    flash_recipe_algo_struct *algo;
+
+    for(i = 0; i < FLASH_RECIPE_ALGO_CACHE_NUM; i++)
+    {
+        if(algo_cache[i] && (strcmp(algo_cache[i]->path, fpath) == 0))
+        {
+            algo_cache[i]->last_used = ++algo_cache_stamp;
+            return algo_cache[i];
+        }
+    }
+
+    /* miss: use a free slot or evict the least recently used one */
+    for(i = 0; i < FLASH_RECIPE_ALGO_CACHE_NUM; i++)
+    {
+        if(algo_cache[i] == NULL)
+        {
+            slot = i;
+            break;
+        }
+        if(algo_cache[i]->last_used < algo_cache[slot]->last_used)
+        {
+            slot = i;
+        }
+    }
+    flash_recipe_algo_release(algo_cache[slot]);
+    algo_cache[slot] = NULL;
+
+    algo = (flash_recipe_algo_struct *)mymalloc(SRAMEX, sizeof(flash_recipe_algo_struct));
+    if(algo == NULL)return NULL;
+    memset(algo, 0x00, sizeof(flash_recipe_algo_struct));
+
+    algo_saved = flash_algo;
+    device_saved = flash_device;
+    flash_algo.algo_blob = NULL;
+    flash_device.sectors = NULL;
+    res = flm_prase(fpath);
+    if(res == 0)
+    {
+        /* move blob and sector table out of the internal SRAM */
+        algo->algo = flash_algo;
+        algo->device = flash_device;
+        algo->algo.algo_blob = (uint32_t *)mymalloc(SRAMEX, flash_algo.algo_size);
+        algo->device.sectors = (FlashSectorStruct *)mymalloc(SRAMEX, SECTOR_NUM * sizeof(FlashSectorStruct));
+        if(algo->algo.algo_blob && algo->device.sectors)
+        {
+            memcpy(algo->algo.algo_blob, flash_algo.algo_blob, flash_algo.algo_size);
+            memcpy(algo->device.sectors, flash_device.sectors, SECTOR_NUM * sizeof(FlashSectorStruct));
+        }
+        else
+        {
+            res = -2;
+        }
+        myfree(SRAMIN, flash_algo.algo_blob);
+        myfree(SRAMIN, flash_device.sectors);
+    }
+    flash_algo = algo_saved;
+    flash_device = device_saved;
+
+    if(res != 0)
+    {
+        flash_recipe_algo_release(algo);
+        return NULL;
+    }
+
+    strncpy(algo->path, fpath, FLASH_RECIPE_PATH_LEN - 1);
+    algo->last_used = ++algo_cache_stamp;
+    algo_cache[slot] = algo;
+
+    return algo;
+}
+
+/*!
+    \brief      get the sector containing an offset from the active device
+    \param[in]  offset: offset from flash_device.devAdr
+    \param[out] start: sector start offset
+    \param[out] size: sector size
+    \retval     none
+*/
+static void flash_recipe_sector_get(uint32_t offset, uint32_t *start, uint32_t *size)
+{
+    uint16_t i;
+    uint32_t region = 0, sz = flash_device.sectors[0].szSector;
+
+    for(i = 0; i < SECTOR_NUM; i++)
+    {
+        if((flash_device.sectors[i].szSector == 0xFFFFFFFF) || (offset < flash_device.sectors[i].adrSector))
+        {
+            break;
+        }
+        region = flash_device.sectors[i].adrSector;
+        sz = flash_device.sectors[i].szSector;
+    }
+
+    *start = region + ((offset - region) / sz) * sz;
+    *size = sz;
+}
+
+/*!
+    \brief      erase, program and optionally verify one step with the active algorithm
+    \param[in]  step: recipe step
+    \param[in]  index: step index
+    \param[in]  progress: progress callback, may be NULL
+    \param[out] none
+    \retval     error code
+*/
+static error_t flash_recipe_step_exec(flash_recipe_step_struct *step, uint8_t index, flash_recipe_progress_cb progress)
+{
+    error_t error = ERROR_SUCCESS;
+    uint32_t offset, end, start, size, read_bytes, addr;
+    uint8_t *buffer = NULL, *buffer_verify = NULL;
+    FIL *file;
+
+    file = (FIL *)mymalloc(SRAMIN, sizeof(FIL));
+    buffer = (uint8_t *)mymalloc(SRAMIN, flash_device.szPage);
+    if((file == NULL) || (buffer == NULL))
+    {
+        error = ERROR_INTERNAL;
+        goto __exit;
+    }
+
+    if(f_open(file, step->image_path, FA_READ) != FR_OK)
+    {
+        error = ERROR_FAILURE;
+        goto __exit;
+    }
+    step->image_size = f_size(file);
+
+    /* the image must fit inside the device described by the algorithm */
+    if((step->image_size == 0) || (step->base_addr < flash_device.devAdr) ||
+       ((step->base_addr - flash_device.devAdr + step->image_size) > flash_device.szDev))
+    {
+        error = ERROR_FAILURE;
+        goto __close;
+    }
+    offset = step->base_addr - flash_device.devAdr;
+    end = offset + step->image_size;
+
+    if(progress)progress(index, FLASH_RECIPE_PHASE_ERASE);
+    while(offset < end)
+    {
+        flash_recipe_sector_get(offset, &start, &size);
+        error = target_flash_erase_sector(flash_device.devAdr + start);
+        if(error != ERROR_SUCCESS)goto __close;
+        offset = start + size;
+    }
+
+    if(progress)progress(index, FLASH_RECIPE_PHASE_PROGRAM);
+    for(addr = step->base_addr; addr < step->base_addr + step->image_size; addr += read_bytes)
+    {
+        memset(buffer, flash_device.valEmpty, flash_device.szPage);
+        if((f_read(file, buffer, flash_device.szPage, &read_bytes) != FR_OK) || (read_bytes == 0))
+        {
+            error = ERROR_FAILURE;
+            goto __close;
+        }
+        error = target_flash_program_page(addr, buffer, (read_bytes + 3) & ~3);
+        if(error != ERROR_SUCCESS)goto __close;
+    }
+
+    if(step->verify == FLASH_RECIPE_VERIFY_READ)
+    {
+        if(progress)progress(index, FLASH_RECIPE_PHASE_VERIFY);
+        buffer_verify = (uint8_t *)mymalloc(SRAMIN, flash_device.szPage);
+        if((buffer_verify == NULL) || (f_lseek(file, 0) != FR_OK))
+        {
+            error = ERROR_INTERNAL;
+            goto __close;
+        }
+        for(addr = step->base_addr; addr < step->base_addr + step->image_size; addr += read_bytes)
+        {
+            if((f_read(file, buffer, flash_device.szPage, &read_bytes) != FR_OK) || (read_bytes == 0) ||
+               (swd_read_memory(addr, buffer_verify, read_bytes) == 0) ||
+               (memcmp(buffer, buffer_verify, read_bytes) != 0))
+            {
+                error = ERROR_WRITE;
+                goto __close;
+            }
+        }
+    }
+
+__close:
+    f_close(file);
+__exit:
+    myfree(SRAMIN, buffer_verify);
+    myfree(SRAMIN, buffer);
+    myfree(SRAMIN, file);
+    return error;
+}
+
+/*!
+    \brief      execute the loaded recipe in one debug session
+    \param[in]  attached: 1 if the target is already connected with flash_algo loaded
+                          (the session is reused and flash_algo is reloaded afterwards),
+                          0 to connect for the recipe and disconnect at the end
+    \param[in]  progress: progress callback, may be NULL
+    \param[out] none
+    \retval     error code of the first failing step
+    \note       runs in the debugger download task, per-step and total time are
+                stored in flash_recipe
+*/
+error_t flash_recipe_run(uint8_t attached, flash_recipe_progress_cb progress)
+{
+    uint8_t i;
+    uint8_t session = attached;
+    error_t error = ERROR_SUCCESS;
+    TickType_t tick_start, tick_step;
+    program_target_t algo_saved = flash_algo;
+    FlashDeviceStruct device_saved = flash_device;
+    flash_recipe_algo_struct *algo, *algo_active = NULL;
+    flash_recipe_step_struct *step;
+
+    if(flash_recipe == NULL)return ERROR_FAILURE;
+
+    flash_recipe->step_done = 0;
+    flash_recipe->total_time_ms = 0;
+    for(i = 0; i < flash_recipe->step_num; i++)
+    {
+        flash_recipe->step[i].time_ms = 0;
+        flash_recipe->step[i].error = ERROR_SUCCESS;
+    }
+    tick_start = xTaskGetTickCount();
+
+    for(i = 0; i < flash_recipe->step_num; i++)
+    {
+        step = &flash_recipe->step[i];
+        tick_step = xTaskGetTickCount();
+        if(progress)progress(i, FLASH_RECIPE_PHASE_ALGO);
+
+        algo = flash_recipe_algo_get(step->flm_path);
+        if(algo == NULL)
+        {
+            error = ERROR_ALGO_DL;
+        }
+        else if(algo != algo_active)
+        {
+            /* switch algorithm inside the session, only the first step resets the target */
+            if(session)
+            {
+                target_flash_algo_unload();
+            }
+            flash_algo = algo->algo;
+            flash_device = algo->device;
+            error = session ? target_flash_algo_load(flash_device.devAdr) : target_flash_init(flash_device.devAdr);
+            session = 1;
+            algo_active = algo;
+        }
+
+        if(error == ERROR_SUCCESS)
+        {
+            error = flash_recipe_step_exec(step, i, progress);
+        }
+
+        step->error = error;
+        step->time_ms = (xTaskGetTickCount() - tick_step) * portTICK_PERIOD_MS;
+        PRINT_INFO("recipe step %u: %s @0x%08X, %u bytes, %ums, %s\r\n", i + 1, step->image_path, step->base_addr,
+                   step->image_size, step->time_ms, error_get_string(error));
+        if(error != ERROR_SUCCESS)break;
+
+        flash_recipe->step_done++;
+        if(progress)progress(i, FLASH_RECIPE_PHASE_DONE);
+    }
+
+    /* give the session back in the state it was found */
+    if(attached)
+    {
+        if(algo_active)
+        {
+            target_flash_algo_unload();
+            flash_algo = algo_saved;
+            flash_device = device_saved;
+            target_flash_algo_load(flash_device.devAdr);
+        }
+    }
+    else if(session)
+    {
+        target_flash_uninit();
+    }
+    flash_algo = algo_saved;
+    flash_device = device_saved;
+
+    flash_recipe->total_time_ms = (xTaskGetTickCount() - tick_start) * portTICK_PERIOD_MS;
+    PRINT_INFO("recipe done: %u/%u steps, %ums\r\n", flash_recipe->step_done, flash_recipe->step_num, flash_recipe->total_time_ms);
+
+    return error;
+}
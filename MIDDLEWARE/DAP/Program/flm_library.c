@@ -0,0 +1,313 @@
+/*!
+    \file       flm_library.c
+    \brief      FLM device library index implementation file
+    \version    1.0
+    \date       2025-08-22
+    \author     Ze-Hou
+*/
+
+#include "flm_library.h"
+#include "FlashOS.h"
+#include "SWD_host.h"
+#include "./MALLOC/malloc.h"
+#include "./USART/usart.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define FLM_LIBRARY_LINE_LEN        128                     /*!< maximum descriptor line length */
+#define FLM_LIBRARY_CPUID_ADDR      0xE000ED00              /*!< SCB->CPUID */
+
+extern int flm_device_info_get(const char *fpath, FlashDeviceStruct *device);
+
+/* static function declarations */
+static int flm_library_entry_compare(const void *a, const void *b);
+static int flm_library_desc_parse(const char *name, flm_library_entry_struct *entry, uint16_t max);
+
+/*!
+    \brief      sort order of index entries: (dp_idcode, cpuid), entries with a
+                DBGMCU mask before the catch-all ones
+    \param[in]  a: entry a
+    \param[in]  b: entry b
+    \param[out] none
+    \retval     compare result
+*/
+static int flm_library_entry_compare(const void *a, const void *b)
+{
+    const flm_library_entry_struct *ea = (const flm_library_entry_struct *)a;
+    const flm_library_entry_struct *eb = (const flm_library_entry_struct *)b;
+
+    if(ea->dp_idcode != eb->dp_idcode)return (ea->dp_idcode < eb->dp_idcode) ? -1 : 1;
+    if(ea->cpuid != eb->cpuid)return (ea->cpuid < eb->cpuid) ? -1 : 1;
+    if(ea->dbgmcu_mask != eb->dbgmcu_mask)return (ea->dbgmcu_mask > eb->dbgmcu_mask) ? -1 : 1;
+    return 0;
+}
+
+/*!
+    \brief      parse one <name>.ID descriptor into index entries
+    \param[in]  name: descriptor file name inside FLM_LIBRARY_PATH
+    \param[out] entry: entry array to fill
+    \param[in]  max: free entries in the array
+    \retval     number of entries, negative on error
+*/
+static int flm_library_desc_parse(const char *name, flm_library_entry_struct *entry, uint16_t max)
+{
+    int count = 0;
+    uint16_t i;
+    uint32_t ram_base = 0x20000000, ram_size = 0;
+    char *path, *line, *p;
+    FIL *file;
+    FlashDeviceStruct *device;
+
+    path = (char *)mymalloc(SRAMIN, FF_LFN_BUF + 1);
+    line = (char *)mymalloc(SRAMIN, FLM_LIBRARY_LINE_LEN);
+    file = (FIL *)mymalloc(SRAMIN, sizeof(FIL));
+    device = (FlashDeviceStruct *)mymalloc(SRAMIN, sizeof(FlashDeviceStruct));
+    if((path == NULL) || (line == NULL) || (file == NULL) || (device == NULL))
+    {
+        count = -2;
+        goto __exit;
+    }
+
+    snprintf(path, FF_LFN_BUF + 1, "%s/%s", FLM_LIBRARY_PATH, name);
+    if(f_open(file, path, FA_READ) != FR_OK)
+    {
+        count = -1;
+        goto __exit;
+    }
+    while((f_gets(line, FLM_LIBRARY_LINE_LEN, file) != NULL) && (count < max))
+    {
+        for(p = line; isspace((unsigned char)*p); p++);
+        if(strncmp(p, "id", 2) == 0)
+        {
+            p = strchr(p, '=');
+            if(p == NULL)continue;
+            p++;
+            memset(&entry[count], 0x00, sizeof(flm_library_entry_struct));
+            entry[count].dp_idcode = strtoul(p, &p, 0);
+            if(*p == ',')entry[count].cpuid = strtoul(p + 1, &p, 0);
+            if(*p == ',')entry[count].dbgmcu_addr = strtoul(p + 1, &p, 0);
+            if(*p == ',')entry[count].dbgmcu_mask = strtoul(p + 1, &p, 0);
+            if(*p == ',')entry[count].dbgmcu_idcode = strtoul(p + 1, &p, 0) & entry[count].dbgmcu_mask;
+            count++;
+        }
+        else if(strncmp(p, "ram", 3) == 0)
+        {
+            p = strchr(p, '=');
+            if(p == NULL)continue;
+            ram_base = strtoul(p + 1, &p, 0);
+            if(*p == ',')ram_size = strtoul(p + 1, &p, 0);
+        }
+    }
+    f_close(file);
+
+    /* <name>.ID -> <name>.FLM */
+    p = strrchr(path, '.');
+    if((count <= 0) || (p == NULL) || (strlen(strrchr(path, '/') + 1) >= FLM_LIBRARY_NAME_LEN - 1))
+    {
+        count = -3;
+        goto __exit;
+    }
+    strcpy(p, ".FLM");
+    if(flm_device_info_get(path, device) != 0)
+    {
+        PRINT_WARN("FLM library: %s not usable\r\n", path);
+        count = -3;
+        goto __exit;
+    }
+
+    for(i = 0; i < count; i++)
+    {
+        entry[i].flash_base = device->devAdr;
+        entry[i].flash_size = device->szDev;
+        entry[i].ram_base = ram_base;
+        entry[i].ram_size = ram_size;
+        strcpy(entry[i].flm_name, strrchr(path, '/') + 1);
+    }
+
+__exit:
+    myfree(SRAMIN, device);
+    myfree(SRAMIN, file);
+    myfree(SRAMIN, line);
+    myfree(SRAMIN, path);
+    return count;
+}
+
+/*!
+    \brief      scan FLM_LIBRARY_PATH once and write the sorted binary index
+    \param[in]  none
+    \param[out] none
+    \retval     number of indexed devices, negative on error
+*/
+int flm_library_index_build(void)
+{
+    int res = 0, n;
+    uint32_t bw;
+    char *ext;
+    DIR *dir;
+    FILINFO *fileinfo;
+    FIL *file;
+    flm_library_header_struct header;
+    flm_library_entry_struct *entry;
+
+    dir = (DIR *)mymalloc(SRAMIN, sizeof(DIR));
+    fileinfo = (FILINFO *)mymalloc(SRAMIN, sizeof(FILINFO));
+    file = (FIL *)mymalloc(SRAMIN, sizeof(FIL));
+    entry = (flm_library_entry_struct *)mymalloc(SRAMEX, FLM_LIBRARY_ENTRY_MAX * sizeof(flm_library_entry_struct));
+    if((dir == NULL) || (fileinfo == NULL) || (file == NULL) || (entry == NULL))
+    {
+        res = -2;
+        goto __exit;
+    }
+
+    header.magic = FLM_LIBRARY_MAGIC;
+    header.version = FLM_LIBRARY_VERSION;
+    header.count = 0;
+
+    if(f_opendir(dir, FLM_LIBRARY_PATH) != FR_OK)
+    {
+        res = -1;
+        goto __exit;
+    }
+    while((f_readdir(dir, fileinfo) == FR_OK) && (fileinfo->fname[0] != '\0'))
+    {
+        if(fileinfo->fattrib & AM_DIR)continue;
+        ext = strrchr(fileinfo->fname, '.');
+        if((ext == NULL) || (toupper(ext[1]) != 'I') || (toupper(ext[2]) != 'D') || (ext[3] != '\0'))continue;
+
+        n = flm_library_desc_parse(fileinfo->fname, &entry[header.count], FLM_LIBRARY_ENTRY_MAX - header.count);
+        if(n > 0)header.count += n;
+        if(header.count >= FLM_LIBRARY_ENTRY_MAX)break;
+    }
+    f_closedir(dir);
+
+    qsort(entry, header.count, sizeof(flm_library_entry_struct), flm_library_entry_compare);
+
+    if(f_open(file, FLM_LIBRARY_INDEX_PATH, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK)
+    {
+        res = -1;
+        goto __exit;
+    }
+    if((f_write(file, &header, sizeof(header), &bw) != FR_OK) ||
+       (f_write(file, entry, header.count * sizeof(flm_library_entry_struct), &bw) != FR_OK))
+    {
+        res = -1;
+    }
+    f_close(file);
+    if(res == 0)
+    {
+        res = header.count;
+        PRINT_INFO("FLM library: %u devices indexed\r\n", header.count);
+    }
+
+__exit:
+    myfree(SRAMEX, entry);
+    myfree(SRAMIN, file);
+    myfree(SRAMIN, fileinfo);
+    myfree(SRAMIN, dir);
+    return res;
+}
+
+/*!
+    \brief      identify the attached target and look its FLM up in the index
+    \param[in]  none
+    \param[out] entry: matching index entry
+    \param[out] fpath: full path of the matching FLM file
+    \param[in]  len: size of fpath
+    \retval     0: found, 1: not in library, negative on error
+    \note       the index is built on first use; the search is a binary search
+                on the index file, so only O(log n) entries are read
+*/
+int flm_library_lookup(flm_library_entry_struct *entry, char *fpath, uint16_t len)
+{
+    int res = 1;
+    uint32_t br, dp_idcode = 0, cpuid = 0, dbgmcu = 0;
+    uint32_t low, high, mid;
+    FIL *file;
+    flm_library_header_struct header;
+
+    file = (FIL *)mymalloc(SRAMIN, sizeof(FIL));
+    if(file == NULL)return -2;
+
+    if(f_open(file, FLM_LIBRARY_INDEX_PATH, FA_READ) != FR_OK)
+    {
+        if((flm_library_index_build() < 0) || (f_open(file, FLM_LIBRARY_INDEX_PATH, FA_READ) != FR_OK))
+        {
+            myfree(SRAMIN, file);
+            return -1;
+        }
+    }
+    if((f_read(file, &header, sizeof(header), &br) != FR_OK) || (br != sizeof(header)) ||
+       (header.magic != FLM_LIBRARY_MAGIC) || (header.version != FLM_LIBRARY_VERSION))
+    {
+        res = -3;
+        goto __exit;
+    }
+
+    /* identify the target */
+    if((swd_init_debug() == 0) || (swd_read_idcode(&dp_idcode) == 0) ||
+       (swd_read_memory(FLM_LIBRARY_CPUID_ADDR, (uint8_t *)&cpuid, 4) == 0))
+    {
+        res = -4;
+        goto __exit;
+    }
+
+    /* lower bound of (dp_idcode, cpuid) */
+    low = 0;
+    high = header.count;
+    while(low < high)
+    {
+        mid = (low + high) / 2;
+        if((f_lseek(file, sizeof(header) + mid * sizeof(flm_library_entry_struct)) != FR_OK) ||
+           (f_read(file, entry, sizeof(flm_library_entry_struct), &br) != FR_OK))
+        {
+            res = -3;
+            goto __exit;
+        }
+        if((entry->dp_idcode < dp_idcode) || ((entry->dp_idcode == dp_idcode) && (entry->cpuid < cpuid)))
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    /* candidates are contiguous, the most specific DBGMCU match comes first */
+    f_lseek(file, sizeof(header) + low * sizeof(flm_library_entry_struct));
+    for(; low < header.count; low++)
+    {
+        if((f_read(file, entry, sizeof(flm_library_entry_struct), &br) != FR_OK) ||
+           (entry->dp_idcode != dp_idcode) || (entry->cpuid != cpuid))
+        {
+            break;
+        }
+        if(entry->dbgmcu_mask == 0)
+        {
+            res = 0;
+            break;
+        }
+        if(swd_read_memory(entry->dbgmcu_addr, (uint8_t *)&dbgmcu, 4) && ((dbgmcu & entry->dbgmcu_mask) == entry->dbgmcu_idcode))
+        {
+            res = 0;
+            break;
+        }
+    }
+
+    if(res == 0)
+    {
+        snprintf(fpath, len, "%s/%s", FLM_LIBRARY_PATH, entry->flm_name);
+    }
+    else
+    {
+        PRINT_INFO("FLM library: no match for DP 0x%08X CPUID 0x%08X\r\n", dp_idcode, cpuid);
+    }
+
+__exit:
+    swd_off();
+    f_close(file);
+    myfree(SRAMIN, file);
+    return res;
+}
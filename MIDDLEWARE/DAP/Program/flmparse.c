@@ -27,6 +27,8 @@ static uint8_t *buffer;
 
 #define LOAD_FUN_NUM 5
 
+int flm_prase_ram(const char* fpath, uint32_t ram_base, uint32_t ram_size);
+
 const char* StrFunNameTable[LOAD_FUN_NUM] = {
 	"Init",
 	"UnInit",
@@ -275,12 +277,25 @@ int FLM_Prase(const void *fpath)
 
 /**************************************************************
 函数名称 ： flm_prase
-功    能 ： flm下载算法文件解析
+功    能 ： flm下载算法文件解析，算法加载到默认内存基地址
 参    数 ： fpath: 文件路径  
-返 回 值 ： 无
+返 回 值 ： 0: 成功, -1: 失败
 作    者 ： ZeHou
 **************************************************************/
 int flm_prase(const char* fpath)
+{
+    return flm_prase_ram(fpath, MCU_RAM_BASE_ADDR, 0);
+}
+
+/**************************************************************
+函数名称 ： flm_prase_ram
+功    能 ： flm下载算法文件解析，算法、编程缓冲区和栈按目标内存布局放置
+参    数 ： fpath: 文件路径, ram_base: 目标内存基地址,
+            ram_size: 目标内存大小，0表示不检查
+返 回 值 ： 0: 成功, -1: 解析失败或目标内存放不下
+作    者 ： ZeHou
+**************************************************************/
+int flm_prase_ram(const char* fpath, uint32_t ram_base, uint32_t ram_size)
 {
     int i = 0;
 
@@ -303,20 +318,30 @@ int flm_prase(const char* fpath)
 	flash_algo.algo_blob[6] = 0x2A001E52;
 	flash_algo.algo_blob[7] = 0x4770D1F2;
     
-    flash_algo.init += (MCU_RAM_BASE_ADDR + 32);
-	flash_algo.uninit += (MCU_RAM_BASE_ADDR + 32);
-	flash_algo.erase_chip += (MCU_RAM_BASE_ADDR + 32);
-	flash_algo.erase_sector += (MCU_RAM_BASE_ADDR + 32);
-	flash_algo.program_page += (MCU_RAM_BASE_ADDR + 32);
+    flash_algo.init += (ram_base + 32);
+	flash_algo.uninit += (ram_base + 32);
+	flash_algo.erase_chip += (ram_base + 32);
+	flash_algo.erase_sector += (ram_base + 32);
+	flash_algo.program_page += (ram_base + 32);
     
-    flash_algo.program_buffer = MCU_RAM_BASE_ADDR + ((flash_algo.algo_size % 0x400) ? ((flash_algo.algo_size / 0x400 + 1) * 0x400) : flash_algo.algo_size);
-    flash_algo.algo_start = MCU_RAM_BASE_ADDR;
+    flash_algo.program_buffer = ram_base + ((flash_algo.algo_size % 0x400) ? ((flash_algo.algo_size / 0x400 + 1) * 0x400) : flash_algo.algo_size);
+    flash_algo.algo_start = ram_base;
     flash_algo.program_buffer_size = flash_device.szPage;
     
-    flash_algo.sys_call_s.breakpoint = MCU_RAM_BASE_ADDR + 1;
+    flash_algo.sys_call_s.breakpoint = ram_base + 1;
     flash_algo.sys_call_s.static_base = flash_algo.program_buffer + flash_algo.program_buffer_size;
     flash_algo.sys_call_s.stack_pointer = flash_algo.sys_call_s.static_base + 0x400;
     
+    if(ram_size && (flash_algo.sys_call_s.stack_pointer - ram_base > ram_size))
+    {
+        myfree(SRAMIN, flash_algo.algo_blob);
+        myfree(SRAMIN, flash_device.sectors);
+        flash_algo.algo_blob = NULL;
+        flash_device.sectors = NULL;
+        PRINT_INFO("错误：目标内存0x%08X(%u字节)放不下FLM算法！\r\n", ram_base, ram_size);
+        return -1;
+    }
+    
     #if FLM_PRASE_INFO_PRINT
     PRINT_INFO("print flash algorithm information>>\r\n");
     PRINT_INFO("/*********************************************************************/\r\n");
@@ -342,3 +367,43 @@ int flm_prase(const char* fpath)
 
 	return 0;
 }
+
+/**************************************************************
+函数名称 ： flm_device_info_get
+功    能 ： 只读取FLM文件中的FlashDevice描述(不含扇区表)，
+            不修改flash_algo/flash_device，用于建立算法库索引
+参    数 ： fpath: 文件路径, device: 输出的设备描述
+返 回 值 ： 0: 成功, 其他: 失败
+作    者 ： ZeHou
+**************************************************************/
+int flm_device_info_get(const char *fpath, FlashDeviceStruct *device)
+{
+	Elf32_Ehdr ehdr = {0};
+	Elf32_Phdr phdr = {0};
+
+	if(ReadDataFromFile(fpath, 0, &ehdr, sizeof(Elf32_Ehdr)) != 0)
+	{
+		return -1;
+	}
+	if((strstr((const char *)ehdr.e_ident, "ELF") == NULL) || (ehdr.e_phnum < 2))
+	{
+		return -1;
+	}
+
+	/* 与FLM_Prase一致，第二个程序段为FlashDevice */
+	if(ReadDataFromFile(fpath, ehdr.e_phoff + sizeof(Elf32_Phdr), &phdr, sizeof(Elf32_Phdr)) != 0)
+	{
+		return -3;
+	}
+	if(phdr.p_type != PT_LOAD)
+	{
+		return -3;
+	}
+	if(ReadDataFromFile(fpath, phdr.p_offset, device, offsetof(FlashDeviceStruct, sectors)) != 0)
+	{
+		return -3;
+	}
+	device->sectors = NULL;
+
+	return 0;
+}
@@ -4,6 +4,7 @@
 #include "usbd_msc.h"
 #include "usb_dwc2_reg.h"
 #include "./SDIO/sdio_emmc.h"
+#include "./DAP/msc_storage.h"
 #include "./SYSTEM/system.h"
 #include "DAP_config.h"
 #include "DAP.h"
@@ -502,6 +503,7 @@ void cmsisdap_init(uint8_t busid, uintptr_t reg_base)
     usbd_add_endpoint(busid, &cdc_out_ep);
     usbd_add_endpoint(busid, &cdc_in_ep);
     
+    msc_storage_init();
     usbd_add_interface(busid, usbd_msc_init_intf(busid, &intf3, MSC_OUT_EP, MSC_IN_EP));
 
     usbd_initialize(busid, reg_base, usbd_event_handler);
@@ -515,16 +517,17 @@ void usbd_msc_get_cap(uint8_t busid, uint8_t lun, uint32_t *block_num, uint32_t
 
 int usbd_msc_sector_read(uint8_t busid, uint8_t lun, uint32_t sector, uint8_t *buffer, uint32_t length)
 {
-    emmc_read_disk((uint32_t *)buffer, sector, length / BLOCK_SIZE);
-    
-    return 0;
+    return msc_storage_read(sector, buffer, length);
 }
 
 int usbd_msc_sector_write(uint8_t busid, uint8_t lun, uint32_t sector, uint8_t *buffer, uint32_t length)
 {
-    emmc_write_disk((uint32_t *)buffer, sector, length / BLOCK_SIZE);
-    
-    return 0;
+    return msc_storage_write(sector, buffer, length);
+}
+
+int usbd_msc_sync_cache(uint8_t busid, uint8_t lun)
+{
+    return msc_storage_sync();
 }
 
 void chry_dap_handle(void)
@@ -0,0 +1,470 @@
+/*!
+    \file       msc_storage.c
+    \brief      USB mass storage backend with read-ahead and write-back implementation file
+    \version    1.0
+    \date       2025-08-26
+    \author     Ze-Hou
+*/
+
+#include "./DAP/msc_storage.h"
+#include "./SDIO/sdio_emmc.h"
+#include "./FATFS/block_cache.h"
+#include "./MALLOC/malloc.h"
+#include "./USART/usart.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+#include <string.h>
+
+#define MSC_STORAGE_WB_SECTORS      (MSC_STORAGE_WB_SIZE / MSC_STORAGE_BLOCK_SIZE)
+#define MSC_STORAGE_RA_SECTORS      (MSC_STORAGE_RA_SIZE / MSC_STORAGE_BLOCK_SIZE)
+#define MSC_STORAGE_SECTOR_COUNT    (*(uint32_t *)((uint8_t *)&emmc_info.ext_csd + 212))
+#define MSC_STORAGE_QUEUE_LEN       4
+
+/*!
+    \brief      Write-back buffer state enumeration
+*/
+typedef enum
+{
+    MSC_WB_FREE = 0,                                    /*!< (0) Empty */
+    MSC_WB_FILL,                                        /*!< (1) Collecting host writes */
+    MSC_WB_FLUSH,                                       /*!< (2) Owned by the storage task */
+}msc_storage_wb_state_enum;
+
+/*!
+    \brief      Read-ahead buffer state enumeration
+*/
+typedef enum
+{
+    MSC_RA_EMPTY = 0,                                   /*!< (0) No data */
+    MSC_RA_LOADING,                                     /*!< (1) Owned by the storage task */
+    MSC_RA_VALID,                                       /*!< (2) Holds ra_count sectors from ra_sector */
+}msc_storage_ra_state_enum;
+
+/*!
+    \brief      Storage task command structure
+*/
+typedef struct
+{
+    uint8_t cmd;                                        /*!< 0: flush write-back buffer, 1: read ahead */
+    uint8_t index;                                      /*!< Write-back buffer index */
+}msc_storage_cmd_struct;
+
+/*!
+    \brief      Write-back buffer structure, holds one contiguous run of sectors
+*/
+typedef struct
+{
+    uint8_t *buffer;                                    /*!< MSC_STORAGE_WB_SIZE bytes in SDRAM */
+    uint32_t sector;                                    /*!< First sector */
+    uint32_t count;                                     /*!< Number of sectors */
+    volatile uint8_t state;                             /*!< msc_storage_wb_state_enum */
+}msc_storage_wb_struct;
+
+/*!
+    \brief      Backend state structure
+*/
+typedef struct
+{
+    msc_storage_wb_struct wb[2];                        /*!< Write-back double buffer */
+    uint8_t active;                                     /*!< Buffer collecting host writes */
+    uint8_t *ra_buffer;                                 /*!< Read-ahead buffer in SDRAM */
+    uint32_t ra_sector;                                 /*!< First read-ahead sector */
+    uint32_t ra_count;                                  /*!< Number of read-ahead sectors */
+    volatile uint8_t ra_state;                          /*!< msc_storage_ra_state_enum */
+    uint32_t seq_end;                                   /*!< Sector after the last host read */
+    uint8_t seq_count;                                  /*!< Number of back-to-back sequential reads */
+    volatile uint8_t error;                             /*!< Deferred write-back error, reported on next write/sync */
+    QueueHandle_t queue;                                /*!< Storage task commands */
+    SemaphoreHandle_t done;                             /*!< Given after each finished command */
+    SemaphoreHandle_t state_lock;                       /*!< Guards the write-back buffer bookkeeping */
+    TickType_t busy_start;                              /*!< Start of the current busy period */
+    TickType_t last_io;                                 /*!< Last host request */
+    uint32_t read_bytes;                                /*!< Bytes read in the busy period */
+    uint32_t write_bytes;                               /*!< Bytes written in the busy period */
+}msc_storage_struct;
+
+msc_storage_info_struct msc_storage_info;
+static msc_storage_struct msc_storage;
+
+/* static function declarations */
+static void msc_storage_task(void *pvParameters);
+static void msc_storage_submit(uint8_t index);
+static void msc_storage_wait(volatile uint8_t *state, uint8_t busy);
+static void msc_storage_account(uint32_t *bytes, uint32_t length);
+
+/*!
+    \brief      allocate buffers and start the storage task
+    \param[in]  none
+    \param[out] none
+    \retval     0: success, -1: out of memory, requests then go straight to the eMMC
+*/
+int msc_storage_init(void)
+{
+    memset(&msc_storage, 0x00, sizeof(msc_storage));
+    memset(&msc_storage_info, 0x00, sizeof(msc_storage_info));
+
+    msc_storage.wb[0].buffer = (uint8_t *)mymalloc(SRAMEX, MSC_STORAGE_WB_SIZE);
+    msc_storage.wb[1].buffer = (uint8_t *)mymalloc(SRAMEX, MSC_STORAGE_WB_SIZE);
+    msc_storage.ra_buffer = (uint8_t *)mymalloc(SRAMEX, MSC_STORAGE_RA_SIZE);
+    msc_storage.queue = xQueueCreate(MSC_STORAGE_QUEUE_LEN, sizeof(msc_storage_cmd_struct));
+    msc_storage.done = xSemaphoreCreateBinary();
+    msc_storage.state_lock = xSemaphoreCreateMutex();
+
+    if((msc_storage.wb[0].buffer == NULL) || (msc_storage.wb[1].buffer == NULL) || (msc_storage.ra_buffer == NULL) ||
+       (msc_storage.queue == NULL) || (msc_storage.done == NULL) || (msc_storage.state_lock == NULL) ||
+       (xTaskCreate((TaskFunction_t)msc_storage_task, "msc_storage_task", MSC_STORAGE_STK_SIZE, NULL, MSC_STORAGE_TASK_PRIO, NULL) != pdPASS))
+    {
+        PRINT_ERROR("msc storage backend disabled, out of memory\r\n");
+        myfree(SRAMEX, msc_storage.wb[0].buffer);
+        myfree(SRAMEX, msc_storage.wb[1].buffer);
+        myfree(SRAMEX, msc_storage.ra_buffer);
+        msc_storage.queue = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+/*!
+    \brief      read sectors for the host
+    \param[in]  sector: first sector
+    \param[out] buffer: destination (USB transfer buffer)
+    \param[in]  length: number of bytes, multiple of MSC_STORAGE_BLOCK_SIZE
+    \retval     0: success, -1: error
+    \note       pending writes to the same sectors are flushed first and the
+                read-ahead data is dropped; after MSC_STORAGE_RA_TRIGGER
+                sequential reads the next chunk is read by the storage task
+                while the USB sends the current one, up to the first sector
+                still waiting in a write-back buffer
+*/
+int msc_storage_read(uint32_t sector, uint8_t *buffer, uint32_t length)
+{
+    uint8_t i, overlap = 0;
+    uint32_t count = length / MSC_STORAGE_BLOCK_SIZE;
+    emmc_error_enum status;
+    msc_storage_cmd_struct cmd;
+
+    if(msc_storage.queue == NULL)
+    {
+        return (block_cache_read(BLOCK_CACHE_OWNER_MSC, buffer, sector, count) == EMMC_OK) ? 0 : -1;
+    }
+
+    xSemaphoreTake(msc_storage.state_lock, portMAX_DELAY);
+    for(i = 0; i < 2; i++)
+    {
+        if(msc_storage.wb[i].count && (sector < msc_storage.wb[i].sector + msc_storage.wb[i].count) &&
+           (sector + count > msc_storage.wb[i].sector))
+        {
+            overlap = 1;
+        }
+    }
+    xSemaphoreGive(msc_storage.state_lock);
+
+    msc_storage_wait(&msc_storage.ra_state, MSC_RA_LOADING);
+    if(overlap)
+    {
+        msc_storage.ra_state = MSC_RA_EMPTY;            /* may hold the sectors as they were before the pending writes */
+        if(msc_storage_sync() != 0)
+        {
+            return -1;
+        }
+    }
+
+    if((msc_storage.ra_state == MSC_RA_VALID) && (sector >= msc_storage.ra_sector) &&
+       (sector + count <= msc_storage.ra_sector + msc_storage.ra_count))
+    {
+        memcpy(buffer, msc_storage.ra_buffer + (sector - msc_storage.ra_sector) * MSC_STORAGE_BLOCK_SIZE, length);
+        msc_storage_info.ra_hit++;
+    }
+    else
+    {
+        status = block_cache_read(BLOCK_CACHE_OWNER_MSC, buffer, sector, count);
+        msc_storage_info.ra_miss++;
+
+        if(status != EMMC_OK)
+        {
+            PRINT_ERROR("msc read sector %u failed(%d)\r\n", sector, status);
+            return -1;
+        }
+    }
+    msc_storage_account(&msc_storage.read_bytes, length);
+
+    /* sequential read detector */
+    if(sector == msc_storage.seq_end)
+    {
+        if(msc_storage.seq_count < 0xFF)msc_storage.seq_count++;
+    }
+    else
+    {
+        msc_storage.seq_count = 0;
+    }
+    msc_storage.seq_end = sector + count;
+
+    if((msc_storage.seq_count >= MSC_STORAGE_RA_TRIGGER) && (msc_storage.seq_end < MSC_STORAGE_SECTOR_COUNT) &&
+       ((msc_storage.ra_state != MSC_RA_VALID) || (msc_storage.seq_end + count > msc_storage.ra_sector + msc_storage.ra_count)))
+    {
+        msc_storage.ra_sector = msc_storage.seq_end;
+        msc_storage.ra_count = MSC_STORAGE_SECTOR_COUNT - msc_storage.seq_end;
+        if(msc_storage.ra_count > MSC_STORAGE_RA_SECTORS)msc_storage.ra_count = MSC_STORAGE_RA_SECTORS;
+
+        /* stop in front of sectors still in a write-back buffer, the eMMC has their old data */
+        xSemaphoreTake(msc_storage.state_lock, portMAX_DELAY);
+        for(i = 0; i < 2; i++)
+        {
+            if(msc_storage.wb[i].count && (msc_storage.ra_sector < msc_storage.wb[i].sector + msc_storage.wb[i].count) &&
+               (msc_storage.ra_sector + msc_storage.ra_count > msc_storage.wb[i].sector))
+            {
+                msc_storage.ra_count = (msc_storage.wb[i].sector > msc_storage.ra_sector) ? (msc_storage.wb[i].sector - msc_storage.ra_sector) : 0;
+            }
+        }
+        if(msc_storage.ra_count)
+        {
+            msc_storage.ra_state = MSC_RA_LOADING;
+            cmd.cmd = 1;
+            cmd.index = 0;
+            xQueueSend(msc_storage.queue, &cmd, portMAX_DELAY);
+        }
+        else
+        {
+            msc_storage.ra_state = MSC_RA_EMPTY;
+        }
+        xSemaphoreGive(msc_storage.state_lock);
+    }
+
+    return 0;
+}
+
+/*!
+    \brief      queue sectors written by the host
+    \param[in]  sector: first sector
+    \param[in]  buffer: source (USB transfer buffer)
+    \param[in]  length: number of bytes, multiple of MSC_STORAGE_BLOCK_SIZE
+    \retval     0: success, -1: error (including a failed earlier flush)
+    \note       data is copied into the active write-back buffer and written by
+                the storage task when the buffer is full, the run is broken, the
+                host syncs or ejects, or after MSC_STORAGE_IDLE_MS without requests
+*/
+int msc_storage_write(uint32_t sector, const uint8_t *buffer, uint32_t length)
+{
+    uint32_t count = length / MSC_STORAGE_BLOCK_SIZE;
+    msc_storage_wb_struct *wb;
+
+    if(msc_storage.queue == NULL)
+    {
+        return (block_cache_write(BLOCK_CACHE_OWNER_MSC, buffer, sector, count) == EMMC_OK) ? 0 : -1;
+    }
+
+    if(msc_storage.error)
+    {
+        msc_storage.error = 0;
+        return -1;
+    }
+
+    /* drop read-ahead data that this write makes stale */
+    msc_storage_wait(&msc_storage.ra_state, MSC_RA_LOADING);
+    if((msc_storage.ra_state == MSC_RA_VALID) && (sector < msc_storage.ra_sector + msc_storage.ra_count) &&
+       (sector + count > msc_storage.ra_sector))
+    {
+        msc_storage.ra_state = MSC_RA_EMPTY;
+    }
+
+    for(;;)
+    {
+        xSemaphoreTake(msc_storage.state_lock, portMAX_DELAY);
+        wb = &msc_storage.wb[msc_storage.active];
+        if(wb->state == MSC_WB_FLUSH)
+        {
+            xSemaphoreGive(msc_storage.state_lock);
+            msc_storage_wait(&wb->state, MSC_WB_FLUSH);
+            continue;
+        }
+        if(wb->count && ((sector != wb->sector + wb->count) || (wb->count + count > MSC_STORAGE_WB_SECTORS)))
+        {
+            msc_storage_submit(msc_storage.active);
+            xSemaphoreGive(msc_storage.state_lock);
+            continue;
+        }
+        break;
+    }
+
+    if(wb->count == 0)
+    {
+        wb->sector = sector;
+        wb->state = MSC_WB_FILL;
+    }
+    memcpy(wb->buffer + wb->count * MSC_STORAGE_BLOCK_SIZE, buffer, length); /* write-through SDRAM, no clean needed for the DMA */
+    wb->count += count;
+
+    if(wb->count == MSC_STORAGE_WB_SECTORS)
+    {
+        msc_storage_submit(msc_storage.active);
+    }
+    xSemaphoreGive(msc_storage.state_lock);
+
+    msc_storage_account(&msc_storage.write_bytes, length);
+
+    return 0;
+}
+
+/*!
+    \brief      flush the write-back buffers and wait until the data is on the eMMC flash
+    \param[in]  none
+    \param[out] none
+    \retval     0: success, -1: a flush failed
+*/
+int msc_storage_sync(void)
+{
+    if(msc_storage.queue == NULL)
+    {
+        return (block_cache_flush() == EMMC_OK) ? 0 : -1;
+    }
+
+    xSemaphoreTake(msc_storage.state_lock, portMAX_DELAY);
+    if((msc_storage.wb[msc_storage.active].state == MSC_WB_FILL) && msc_storage.wb[msc_storage.active].count)
+    {
+        msc_storage_submit(msc_storage.active);
+    }
+    xSemaphoreGive(msc_storage.state_lock);
+
+    msc_storage_wait(&msc_storage.wb[0].state, MSC_WB_FLUSH);
+    msc_storage_wait(&msc_storage.wb[1].state, MSC_WB_FLUSH);
+
+    if(msc_storage.error)
+    {
+        msc_storage.error = 0;
+        return -1;
+    }
+
+    if(block_cache_flush() != EMMC_OK) /* SYNCHRONIZE CACHE and eject also empty the eMMC write cache */
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+/*!
+    \brief      hand a write-back buffer to the storage task and switch buffers
+    \param[in]  index: write-back buffer index
+    \param[out] none
+    \retval     none
+    \note       called with state_lock held
+*/
+static void msc_storage_submit(uint8_t index)
+{
+    msc_storage_cmd_struct cmd;
+
+    msc_storage.wb[index].state = MSC_WB_FLUSH;
+    msc_storage.active = index ^ 1;
+    cmd.cmd = 0;
+    cmd.index = index;
+    xQueueSend(msc_storage.queue, &cmd, portMAX_DELAY);
+}
+
+/*!
+    \brief      wait until a buffer leaves the busy state
+    \param[in]  state: buffer state
+    \param[in]  busy: state owned by the storage task
+    \param[out] none
+    \retval     none
+*/
+static void msc_storage_wait(volatile uint8_t *state, uint8_t busy)
+{
+    while(*state == busy)
+    {
+        xSemaphoreTake(msc_storage.done, pdMS_TO_TICKS(10));
+    }
+}
+
+/*!
+    \brief      account a host request for the throughput statistics
+    \param[in]  bytes: read or write byte counter
+    \param[in]  length: request length
+    \param[out] none
+    \retval     none
+*/
+static void msc_storage_account(uint32_t *bytes, uint32_t length)
+{
+    msc_storage.last_io = xTaskGetTickCount();
+    if((msc_storage.read_bytes == 0) && (msc_storage.write_bytes == 0))
+    {
+        msc_storage.busy_start = msc_storage.last_io;
+    }
+    *bytes += length;
+}
+
+/*!
+    \brief      storage task, executes flush and read-ahead commands and
+                flushes the write-back buffer when the host goes idle
+    \param[in]  pvParameters: unused
+    \param[out] none
+    \retval     none
+*/
+static void msc_storage_task(void *pvParameters)
+{
+    uint8_t index;
+    uint32_t time_ms;
+    emmc_error_enum status;
+    msc_storage_cmd_struct cmd;
+    msc_storage_wb_struct *wb;
+
+    (void)pvParameters;
+
+    while(1)
+    {
+        if(xQueueReceive(msc_storage.queue, &cmd, pdMS_TO_TICKS(MSC_STORAGE_IDLE_MS)) != pdTRUE)
+        {
+            if((msc_storage.read_bytes == 0) && (msc_storage.write_bytes == 0))
+            {
+                continue;
+            }
+            if((xTaskGetTickCount() - msc_storage.last_io) < pdMS_TO_TICKS(MSC_STORAGE_IDLE_MS))
+            {
+                continue;
+            }
+
+            /* host idle: flush the partly filled buffer */
+            xSemaphoreTake(msc_storage.state_lock, portMAX_DELAY);
+            index = msc_storage.active;
+            if((msc_storage.wb[index].state == MSC_WB_FILL) && msc_storage.wb[index].count)
+            {
+                msc_storage_submit(index);
+            }
+            xSemaphoreGive(msc_storage.state_lock);
+
+            time_ms = (msc_storage.last_io - msc_storage.busy_start) * portTICK_PERIOD_MS + 1;
+            if(msc_storage.read_bytes)msc_storage_info.read_speed = (uint32_t)((uint64_t)msc_storage.read_bytes * 1000 / 1024 / time_ms);
+            if(msc_storage.write_bytes)msc_storage_info.write_speed = (uint32_t)((uint64_t)msc_storage.write_bytes * 1000 / 1024 / time_ms);
+            PRINT_INFO("msc %u KB read, %u KB written in %u ms (R %u KB/s, W %u KB/s, read-ahead %u/%u)\r\n",
+                       msc_storage.read_bytes / 1024, msc_storage.write_bytes / 1024, time_ms,
+                       msc_storage_info.read_speed, msc_storage_info.write_speed,
+                       msc_storage_info.ra_hit, msc_storage_info.ra_hit + msc_storage_info.ra_miss);
+            msc_storage.read_bytes = 0;
+            msc_storage.write_bytes = 0;
+            continue;
+        }
+
+        if(cmd.cmd == 0)
+        {
+            wb = &msc_storage.wb[cmd.index];
+            status = block_cache_write(BLOCK_CACHE_OWNER_MSC, wb->buffer, wb->sector, wb->count);
+            if(status != EMMC_OK)
+            {
+                PRINT_ERROR("msc write-back sector %u failed(%d)\r\n", wb->sector, status);
+                msc_storage.error = 1;
+            }
+            msc_storage_info.wb_flush++;
+            wb->count = 0;
+            wb->state = MSC_WB_FREE;
+        }
+        else
+        {
+            status = block_cache_read(BLOCK_CACHE_OWNER_MSC, msc_storage.ra_buffer, msc_storage.ra_sector, msc_storage.ra_count);
+            msc_storage.ra_state = (status == EMMC_OK) ? MSC_RA_VALID : MSC_RA_EMPTY;
+        }
+
+        xSemaphoreGive(msc_storage.done);
+    }
+}
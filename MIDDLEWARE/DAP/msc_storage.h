@@ -0,0 +1,41 @@
+/*!
+    \file       msc_storage.h
+    \brief      USB mass storage backend with read-ahead and write-back header file
+    \version    1.0
+    \date       2025-08-26
+    \author     Ze-Hou
+*/
+
+#ifndef __MSC_STORAGE_H
+#define __MSC_STORAGE_H
+#include <stdint.h>
+
+/* backend configuration */
+#define MSC_STORAGE_BLOCK_SIZE      512U                    /*!< sector size */
+#define MSC_STORAGE_WB_SIZE         (512 * 1024)            /*!< size of each of the two write-back buffers (SDRAM) */
+#define MSC_STORAGE_RA_SIZE         (64 * 1024)             /*!< read-ahead chunk (SDRAM) */
+#define MSC_STORAGE_RA_TRIGGER      2                       /*!< sequential reads before read-ahead starts */
+#define MSC_STORAGE_IDLE_MS         200                     /*!< write-back flush after this idle time */
+#define MSC_STORAGE_TASK_PRIO       3                       /*!< storage task priority, same as the MSC thread */
+#define MSC_STORAGE_STK_SIZE        512                     /*!< storage task stack size */
+
+/*!
+    \brief      Backend statistics structure, speeds cover the last busy period
+*/
+typedef struct
+{
+    uint32_t read_speed;                                /*!< Host-visible read speed (KB/s) */
+    uint32_t write_speed;                               /*!< Host-visible write speed (KB/s) */
+    uint32_t ra_hit;                                    /*!< Reads served from the read-ahead buffer */
+    uint32_t ra_miss;                                   /*!< Reads sent to the eMMC */
+    uint32_t wb_flush;                                  /*!< Write-back buffers flushed */
+}msc_storage_info_struct;
+
+extern msc_storage_info_struct msc_storage_info;
+
+/* function declarations */
+int msc_storage_init(void);                                                     /* allocate buffers and start the storage task */
+int msc_storage_read(uint32_t sector, uint8_t *buffer, uint32_t length);        /* read sectors for the host */
+int msc_storage_write(uint32_t sector, const uint8_t *buffer, uint32_t length); /* queue sectors written by the host */
+int msc_storage_sync(void);                                                     /* flush the write-back buffers */
+#endif /* __MSC_STORAGE_H */
@@ -0,0 +1,584 @@
+/*!
+    \file       block_cache.c
+    \brief      Shared eMMC sector cache in SDRAM implementation file
+    \version    1.0
+    \date       2025-08-27
+    \author     Ze-Hou
+    \note       segmented LRU: new sectors enter the cold list, a second hit
+                (or a pinned sector) moves them to the hot list, so FAT and
+                directory sectors survive a large file being streamed through
+                the cold list
+*/
+
+#include "./FATFS/block_cache.h"
+#include "./MALLOC/malloc.h"
+#include "./USART/usart.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include <string.h>
+
+#define BLOCK_CACHE_NIL             0xFFFF
+#define BLOCK_CACHE_HASH(sector)    ((sector) & (BLOCK_CACHE_HASH_SIZE - 1))
+
+/*!
+    \brief      Cache list enumeration
+*/
+typedef enum
+{
+    BLOCK_CACHE_FREE = 0,                               /*!< (0) Unused lines */
+    BLOCK_CACHE_COLD,                                   /*!< (1) Probation list */
+    BLOCK_CACHE_HOT,                                    /*!< (2) Protected list */
+}block_cache_list_enum;
+
+/*!
+    \brief      Cache line structure
+*/
+typedef struct
+{
+    uint32_t sector;                                    /*!< Cached sector */
+    uint16_t prev;                                      /*!< Toward the list head (most recent) */
+    uint16_t next;                                      /*!< Toward the list tail (least recent) */
+    uint16_t hash_next;                                 /*!< Next line in the same hash bucket */
+    uint8_t list;                                       /*!< block_cache_list_enum */
+    uint8_t hits;                                       /*!< Hits while on the cold list */
+}block_cache_line_struct;
+
+/*!
+    \brief      Cache list structure
+*/
+typedef struct
+{
+    uint16_t head;                                      /*!< Most recently used line */
+    uint16_t tail;                                      /*!< Least recently used line */
+    uint16_t count;                                     /*!< Number of lines */
+}block_cache_head_struct;
+
+/*!
+    \brief      Cache control structure
+*/
+typedef struct
+{
+    block_cache_line_struct *line;                      /*!< Line bookkeeping */
+    uint8_t *data;                                      /*!< Line data in SDRAM */
+    uint16_t hash[BLOCK_CACHE_HASH_SIZE];               /*!< First line of each bucket */
+    block_cache_head_struct list[3];                    /*!< Indexed by block_cache_list_enum */
+    uint32_t pin_sector[BLOCK_CACHE_PIN_NUM];           /*!< First sector of each pinned range */
+    uint32_t pin_count[BLOCK_CACHE_PIN_NUM];            /*!< Sectors in each pinned range */
+    SemaphoreHandle_t lock;                             /*!< Serializes the cache and the eMMC */
+}block_cache_struct;
+
+block_cache_info_struct block_cache_info;
+static block_cache_struct block_cache;
+
+/* static function declarations */
+static void block_cache_lock(void);
+static void block_cache_unlock(void);
+static void block_cache_unlink(uint16_t index);
+static void block_cache_link(uint16_t index, uint8_t list);
+static uint16_t block_cache_find(uint32_t sector);
+static void block_cache_hash_remove(uint16_t index);
+static uint8_t block_cache_pinned(uint32_t sector);
+static void block_cache_touch(uint16_t index);
+static uint16_t block_cache_alloc(uint32_t sector);
+static void block_cache_reset(void);
+
+/*!
+    \brief      allocate the cache in SDRAM
+    \param[in]  none
+    \param[out] none
+    \retval     0: success, -1: out of memory, reads and writes then go straight to the eMMC
+    \note       call after my_mem_init and before the first disk access
+*/
+int block_cache_init(void)
+{
+    memset(&block_cache_info, 0x00, sizeof(block_cache_info));
+
+    block_cache.line = (block_cache_line_struct *)mymalloc(SRAMEX, BLOCK_CACHE_LINES * sizeof(block_cache_line_struct));
+    block_cache.data = (uint8_t *)mymalloc(SRAMEX, BLOCK_CACHE_LINES * BLOCK_CACHE_SECTOR_SIZE);
+    if(block_cache.lock == NULL)
+    {
+        block_cache.lock = xSemaphoreCreateMutex();
+    }
+
+    if((block_cache.line == NULL) || (block_cache.data == NULL) || (block_cache.lock == NULL))
+    {
+        PRINT_ERROR("block cache disabled, out of memory\r\n");
+        myfree(SRAMEX, block_cache.line);
+        myfree(SRAMEX, block_cache.data);
+        block_cache.line = NULL;
+        block_cache.data = NULL;
+        return -1;
+    }
+
+    memset(block_cache.pin_count, 0x00, sizeof(block_cache.pin_count));
+    block_cache_reset();
+    PRINT_INFO("block cache %u KB in SDRAM\r\n", BLOCK_CACHE_LINES * BLOCK_CACHE_SECTOR_SIZE / 1024);
+
+    return 0;
+}
+
+/*!
+    \brief      read sectors
+    \param[in]  owner: block_cache_owner_enum
+    \param[out] buffer: destination, any alignment
+    \param[in]  sector: first sector
+    \param[in]  count: number of sectors
+    \retval     emmc_error_enum
+    \note       a request up to BLOCK_CACHE_MAX_SECTORS is served from SDRAM
+                when every sector is cached, otherwise it is read in one
+                piece and the sectors are added to the cache
+*/
+emmc_error_enum block_cache_read(block_cache_owner_enum owner, uint8_t *buffer, uint32_t sector, uint32_t count)
+{
+    uint32_t i;
+    uint16_t index;
+    emmc_error_enum status = EMMC_OK;
+
+    (void)owner;
+
+    if(block_cache.data == NULL)
+    {
+        return emmc_read_disk((uint32_t *)buffer, sector, count);
+    }
+
+    block_cache_lock();
+    if(count > BLOCK_CACHE_MAX_SECTORS)
+    {
+        status = emmc_read_disk((uint32_t *)buffer, sector, count);
+        block_cache_info.bypass += count;
+        block_cache_unlock();
+        return status;
+    }
+
+    for(i = 0; i < count; i++)
+    {
+        if(block_cache_find(sector + i) == BLOCK_CACHE_NIL)break;
+    }
+
+    if(i == count)
+    {
+        for(i = 0; i < count; i++)
+        {
+            index = block_cache_find(sector + i);
+            memcpy(buffer + i * BLOCK_CACHE_SECTOR_SIZE, block_cache.data + index * BLOCK_CACHE_SECTOR_SIZE, BLOCK_CACHE_SECTOR_SIZE);
+            block_cache_touch(index);
+        }
+        block_cache_info.hit += count;
+    }
+    else if(count == 1)
+    {
+        /* read straight into a line, the caller's buffer may sit anywhere */
+        index = block_cache_alloc(sector);
+        status = emmc_read_disk((uint32_t *)(block_cache.data + index * BLOCK_CACHE_SECTOR_SIZE), sector, 1);
+        if(status == EMMC_OK)
+        {
+            memcpy(buffer, block_cache.data + index * BLOCK_CACHE_SECTOR_SIZE, BLOCK_CACHE_SECTOR_SIZE);
+            block_cache_info.miss++;
+        }
+        else
+        {
+            block_cache_hash_remove(index);
+            block_cache_unlink(index);
+            block_cache_link(index, BLOCK_CACHE_FREE);
+        }
+    }
+    else
+    {
+        status = emmc_read_disk((uint32_t *)buffer, sector, count);
+        if(status == EMMC_OK)
+        {
+            for(i = 0; i < count; i++)
+            {
+                index = block_cache_find(sector + i);
+                if(index != BLOCK_CACHE_NIL)
+                {
+                    block_cache_touch(index);
+                    continue;
+                }
+                index = block_cache_alloc(sector + i);
+                memcpy(block_cache.data + index * BLOCK_CACHE_SECTOR_SIZE, buffer + i * BLOCK_CACHE_SECTOR_SIZE, BLOCK_CACHE_SECTOR_SIZE);
+            }
+            block_cache_info.miss += count;
+        }
+    }
+    block_cache_unlock();
+
+    return status;
+}
+
+/*!
+    \brief      write sectors
+    \param[in]  owner: block_cache_owner_enum
+    \param[in]  buffer: source, any alignment
+    \param[in]  sector: first sector
+    \param[in]  count: number of sectors
+    \retval     emmc_error_enum
+    \note       write-through: cached copies are updated only after the eMMC
+                accepted the data and dropped when it did not; small FatFs
+                writes (FAT, directory entries) are also added to the cache
+*/
+emmc_error_enum block_cache_write(block_cache_owner_enum owner, const uint8_t *buffer, uint32_t sector, uint32_t count)
+{
+    uint32_t i;
+    uint16_t index;
+    emmc_error_enum status;
+
+    if(owner == BLOCK_CACHE_OWNER_MSC)
+    {
+        block_cache_info.generation++;
+    }
+
+    if(block_cache.data == NULL)
+    {
+        return emmc_write_disk((uint32_t *)buffer, sector, count);
+    }
+
+    block_cache_lock();
+    status = emmc_write_disk((uint32_t *)buffer, sector, count);
+    for(i = 0; i < count; i++)
+    {
+        index = block_cache_find(sector + i);
+        if(status != EMMC_OK)
+        {
+            if(index != BLOCK_CACHE_NIL)
+            {
+                block_cache_hash_remove(index);
+                block_cache_unlink(index);
+                block_cache_link(index, BLOCK_CACHE_FREE);
+            }
+            continue;
+        }
+
+        if(index == BLOCK_CACHE_NIL)
+        {
+            if((owner != BLOCK_CACHE_OWNER_FATFS) || (count > BLOCK_CACHE_MAX_SECTORS))continue;
+            index = block_cache_alloc(sector + i);
+        }
+        memcpy(block_cache.data + index * BLOCK_CACHE_SECTOR_SIZE, buffer + i * BLOCK_CACHE_SECTOR_SIZE, BLOCK_CACHE_SECTOR_SIZE);
+    }
+    block_cache_unlock();
+
+    return status;
+}
+
+/*!
+    \brief      discard sectors
+    \param[in]  sector: first sector
+    \param[in]  count: number of sectors
+    \retval     emmc_error_enum
+    \note       the cached copies are dropped whether or not the card accepted
+                the discard, the range holds no data anyone will read back
+*/
+emmc_error_enum block_cache_trim(uint32_t sector, uint32_t count)
+{
+    uint16_t i;
+    emmc_error_enum status;
+
+    if(block_cache.data == NULL)
+    {
+        return emmc_trim(sector, count);
+    }
+
+    block_cache_lock();
+    status = emmc_trim(sector, count);
+    for(i = 0; i < BLOCK_CACHE_LINES; i++)
+    {
+        if((block_cache.line[i].list != BLOCK_CACHE_FREE) && (block_cache.line[i].sector - sector < count))
+        {
+            block_cache_hash_remove(i);
+            block_cache_unlink(i);
+            block_cache_link(i, BLOCK_CACHE_FREE);
+        }
+    }
+    if(status == EMMC_OK)
+    {
+        block_cache_info.trim += count;
+    }
+    block_cache_unlock();
+
+    return status;
+}
+
+/*!
+    \brief      write the eMMC device cache to the flash
+    \param[in]  none
+    \retval     emmc_error_enum
+    \note       nothing to do when the device cache is disabled
+*/
+emmc_error_enum block_cache_flush(void)
+{
+    emmc_error_enum status;
+
+    if(emmc_info.cache == 0)
+    {
+        return EMMC_OK;
+    }
+
+    block_cache_lock();
+    status = emmc_cache_flush();
+    block_cache_unlock();
+
+    return status;
+}
+
+/*!
+    \brief      keep a sector range on the hot list
+    \param[in]  index: range slot, 0 ~ BLOCK_CACHE_PIN_NUM - 1
+    \param[in]  sector: first sector
+    \param[in]  count: number of sectors, 0 releases the slot
+    \param[out] none
+    \retval     none
+    \note       pinned sectors skip the cold list when they are cached, they
+                are still evicted from the hot list when it is full
+*/
+void block_cache_pin(uint8_t index, uint32_t sector, uint32_t count)
+{
+    if(index >= BLOCK_CACHE_PIN_NUM)return;
+
+    block_cache_lock();
+    block_cache.pin_sector[index] = sector;
+    block_cache.pin_count[index] = count;
+    block_cache_unlock();
+}
+
+/*!
+    \brief      drop all cached sectors
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void block_cache_invalidate(void)
+{
+    if(block_cache.data == NULL)return;
+
+    block_cache_lock();
+    block_cache_reset();
+    block_cache_unlock();
+}
+
+/*!
+    \brief      take the cache lock once the scheduler runs
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void block_cache_lock(void)
+{
+    if((block_cache.lock != NULL) && (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED))
+    {
+        xSemaphoreTake(block_cache.lock, portMAX_DELAY);
+    }
+}
+
+/*!
+    \brief      release the cache lock
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void block_cache_unlock(void)
+{
+    if((block_cache.lock != NULL) && (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED))
+    {
+        xSemaphoreGive(block_cache.lock);
+    }
+}
+
+/*!
+    \brief      remove a line from its list
+    \param[in]  index: line index
+    \param[out] none
+    \retval     none
+*/
+static void block_cache_unlink(uint16_t index)
+{
+    block_cache_line_struct *line = &block_cache.line[index];
+    block_cache_head_struct *list = &block_cache.list[line->list];
+
+    if(line->prev != BLOCK_CACHE_NIL)block_cache.line[line->prev].next = line->next;
+    else list->head = line->next;
+    if(line->next != BLOCK_CACHE_NIL)block_cache.line[line->next].prev = line->prev;
+    else list->tail = line->prev;
+    list->count--;
+}
+
+/*!
+    \brief      insert a line at the head of a list
+    \param[in]  index: line index
+    \param[in]  list: block_cache_list_enum
+    \param[out] none
+    \retval     none
+*/
+static void block_cache_link(uint16_t index, uint8_t list)
+{
+    block_cache_line_struct *line = &block_cache.line[index];
+    block_cache_head_struct *head = &block_cache.list[list];
+
+    line->list = list;
+    line->prev = BLOCK_CACHE_NIL;
+    line->next = head->head;
+    if(head->head != BLOCK_CACHE_NIL)block_cache.line[head->head].prev = index;
+    else head->tail = index;
+    head->head = index;
+    head->count++;
+
+    block_cache_info.hot = block_cache.list[BLOCK_CACHE_HOT].count;
+    block_cache_info.cold = block_cache.list[BLOCK_CACHE_COLD].count;
+}
+
+/*!
+    \brief      look up a sector
+    \param[in]  sector: sector address
+    \param[out] none
+    \retval     line index, BLOCK_CACHE_NIL when not cached
+*/
+static uint16_t block_cache_find(uint32_t sector)
+{
+    uint16_t index = block_cache.hash[BLOCK_CACHE_HASH(sector)];
+
+    while(index != BLOCK_CACHE_NIL)
+    {
+        if(block_cache.line[index].sector == sector)break;
+        index = block_cache.line[index].hash_next;
+    }
+
+    return index;
+}
+
+/*!
+    \brief      remove a line from its hash bucket
+    \param[in]  index: line index
+    \param[out] none
+    \retval     none
+*/
+static void block_cache_hash_remove(uint16_t index)
+{
+    uint16_t *link = &block_cache.hash[BLOCK_CACHE_HASH(block_cache.line[index].sector)];
+
+    while(*link != BLOCK_CACHE_NIL)
+    {
+        if(*link == index)
+        {
+            *link = block_cache.line[index].hash_next;
+            break;
+        }
+        link = &block_cache.line[*link].hash_next;
+    }
+}
+
+/*!
+    \brief      check whether a sector is in a pinned range
+    \param[in]  sector: sector address
+    \param[out] none
+    \retval     1: pinned, 0: not pinned
+*/
+static uint8_t block_cache_pinned(uint32_t sector)
+{
+    uint8_t i;
+
+    for(i = 0; i < BLOCK_CACHE_PIN_NUM; i++)
+    {
+        if((sector >= block_cache.pin_sector[i]) && (sector - block_cache.pin_sector[i] < block_cache.pin_count[i]))
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/*!
+    \brief      record a hit, promote to the hot list on the second hit
+    \param[in]  index: line index
+    \param[out] none
+    \retval     none
+*/
+static void block_cache_touch(uint16_t index)
+{
+    block_cache_line_struct *line = &block_cache.line[index];
+    uint16_t demote;
+
+    block_cache_unlink(index);
+    if((line->list == BLOCK_CACHE_COLD) && (++line->hits >= 2))
+    {
+        if(block_cache.list[BLOCK_CACHE_HOT].count >= BLOCK_CACHE_HOT_LINES)
+        {
+            demote = block_cache.list[BLOCK_CACHE_HOT].tail;
+            block_cache_unlink(demote);
+            block_cache.line[demote].hits = 0;
+            block_cache_link(demote, BLOCK_CACHE_COLD);
+        }
+        block_cache_link(index, BLOCK_CACHE_HOT);
+    }
+    else
+    {
+        block_cache_link(index, line->list);
+    }
+}
+
+/*!
+    \brief      take a line for a sector, reusing the least recently used one
+    \param[in]  sector: sector address
+    \param[out] none
+    \retval     line index, linked and hashed
+*/
+static uint16_t block_cache_alloc(uint32_t sector)
+{
+    uint16_t index, demote;
+    uint8_t list;
+
+    if(block_cache.list[BLOCK_CACHE_FREE].count)index = block_cache.list[BLOCK_CACHE_FREE].tail;
+    else if(block_cache.list[BLOCK_CACHE_COLD].count)index = block_cache.list[BLOCK_CACHE_COLD].tail;
+    else index = block_cache.list[BLOCK_CACHE_HOT].tail;
+
+    if(block_cache.line[index].list != BLOCK_CACHE_FREE)
+    {
+        block_cache_hash_remove(index);
+        block_cache_info.evict++;
+    }
+    block_cache_unlink(index);
+
+    list = BLOCK_CACHE_COLD;
+    if(block_cache_pinned(sector))
+    {
+        list = BLOCK_CACHE_HOT;
+        if(block_cache.list[BLOCK_CACHE_HOT].count >= BLOCK_CACHE_HOT_LINES)
+        {
+            demote = block_cache.list[BLOCK_CACHE_HOT].tail;
+            block_cache_unlink(demote);
+            block_cache.line[demote].hits = 0;
+            block_cache_link(demote, BLOCK_CACHE_COLD);
+        }
+    }
+
+    block_cache.line[index].sector = sector;
+    block_cache.line[index].hits = 0;
+    block_cache.line[index].hash_next = block_cache.hash[BLOCK_CACHE_HASH(sector)];
+    block_cache.hash[BLOCK_CACHE_HASH(sector)] = index;
+    block_cache_link(index, list);
+
+    return index;
+}
+
+/*!
+    \brief      put every line on the free list
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void block_cache_reset(void)
+{
+    uint16_t i;
+
+    memset(block_cache.hash, 0xFF, sizeof(block_cache.hash));
+    memset(block_cache.list, 0xFF, sizeof(block_cache.list));
+    for(i = 0; i < 3; i++)block_cache.list[i].count = 0;
+
+    for(i = 0; i < BLOCK_CACHE_LINES; i++)
+    {
+        block_cache.line[i].hits = 0;
+        block_cache.line[i].hash_next = BLOCK_CACHE_NIL;
+        block_cache_link(i, BLOCK_CACHE_FREE);
+    }
+}
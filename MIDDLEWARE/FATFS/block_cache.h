@@ -0,0 +1,71 @@
+/*!
+    \file       block_cache.h
+    \brief      Shared eMMC sector cache in SDRAM header file
+    \version    1.0
+    \date       2025-08-27
+    \author     Ze-Hou
+    \note       the cache sits under both FatFs (diskio.c) and the USB mass
+                storage backend, rules for keeping it coherent:
+                - it is write-through, a successful write always reaches the
+                  eMMC before the cached copy is updated, so there is never
+                  anything to flush here; block_cache_flush only empties the
+                  eMMC's own write cache (EMMC_CACHE_ENABLE)
+                - every eMMC data access while the cache is enabled must go
+                  through block_cache_read/block_cache_write, they also
+                  serialize the eMMC between tasks
+                - code that touches the eMMC behind the cache (re-init, format
+                  from another path, erase) must call block_cache_invalidate,
+                  discards go through block_cache_trim
+                - writes owned by BLOCK_CACHE_OWNER_MSC bump the generation
+                  counter, FatFs users compare it to notice that the host
+                  changed the volume under them
+*/
+
+#ifndef __BLOCK_CACHE_H
+#define __BLOCK_CACHE_H
+#include <stdint.h>
+#include "./SDIO/sdio_emmc.h"
+
+/* cache configuration */
+#define BLOCK_CACHE_SECTOR_SIZE     512U                    /*!< cache line size, one eMMC block */
+#define BLOCK_CACHE_LINES           1024                    /*!< number of cached sectors (512KB of SDRAM) */
+#define BLOCK_CACHE_HASH_SIZE       256                     /*!< hash buckets, power of 2 */
+#define BLOCK_CACHE_HOT_LINES       (BLOCK_CACHE_LINES / 2) /*!< upper limit of the protected (hot) list */
+#define BLOCK_CACHE_MAX_SECTORS     8                       /*!< larger requests bypass the cache */
+#define BLOCK_CACHE_PIN_NUM         3                       /*!< number of pinned sector ranges (FATs, root, system folder) */
+
+/*!
+    \brief      Cache user enumeration
+*/
+typedef enum
+{
+    BLOCK_CACHE_OWNER_FATFS = 0,                        /*!< (0) FatFs on the device */
+    BLOCK_CACHE_OWNER_MSC,                              /*!< (1) USB host through mass storage */
+}block_cache_owner_enum;
+
+/*!
+    \brief      Cache statistics structure
+*/
+typedef struct
+{
+    uint32_t hit;                                       /*!< Sectors served from SDRAM */
+    uint32_t miss;                                      /*!< Sectors read from the eMMC and cached */
+    uint32_t bypass;                                    /*!< Sectors of large requests not cached */
+    uint32_t evict;                                     /*!< Lines reused for another sector */
+    uint32_t generation;                                /*!< Incremented by every host (MSC) write */
+    uint32_t trim;                                      /*!< Sectors discarded on the eMMC */
+    uint16_t hot;                                       /*!< Lines on the protected list */
+    uint16_t cold;                                      /*!< Lines on the probation list */
+}block_cache_info_struct;
+
+extern block_cache_info_struct block_cache_info;
+
+/* function declarations */
+int block_cache_init(void);                                                     /* allocate the cache in SDRAM */
+emmc_error_enum block_cache_read(block_cache_owner_enum owner, uint8_t *buffer, uint32_t sector, uint32_t count);         /* read sectors */
+emmc_error_enum block_cache_write(block_cache_owner_enum owner, const uint8_t *buffer, uint32_t sector, uint32_t count);  /* write sectors */
+emmc_error_enum block_cache_trim(uint32_t sector, uint32_t count);             /* discard sectors and drop their cached copies */
+emmc_error_enum block_cache_flush(void);                                        /* write the eMMC device cache to the flash */
+void block_cache_pin(uint8_t index, uint32_t sector, uint32_t count);           /* keep a sector range (FAT, directories) on the hot list */
+void block_cache_invalidate(void);                                              /* drop all cached sectors */
+#endif /* __BLOCK_CACHE_H */
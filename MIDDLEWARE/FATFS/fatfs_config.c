@@ -7,6 +7,7 @@
 */
 
 #include "./FATFS/fatfs_config.h"
+#include "./FATFS/block_cache.h"
 #include "./MALLOC/malloc.h"
    
 /******************************************************************************************/
@@ -43,4 +44,93 @@ uint8_t fatfs_config(void)
     {
         return 1;   /* at least one allocation failed */
     }
-}
\ No newline at end of file
+}
+
+/*!
+    \brief      create a volume aligned to the eMMC erase groups
+    \param[in]  path: logical drive, e.g. "C:"
+    \param[out] none
+    \retval     FRESULT
+    \note       f_mkfs takes the erase group from GET_BLOCK_SIZE, discards the
+                whole volume (CTRL_TRIM) and starts the data area on a group
+                boundary; cluster sizes are powers of 2, so every cluster then
+                lies inside one group (or covers whole groups)
+*/
+FRESULT fatfs_format(const TCHAR *path)
+{
+    MKFS_PARM opt = {FM_ANY, 0, 0, 0, 0};   /* align 0: use GET_BLOCK_SIZE, au_size 0: default cluster size */
+    uint8_t *work;
+    FRESULT res;
+
+    work = (uint8_t *)mymalloc(SRAMEX, FATFS_MKFS_WORK_SIZE);
+
+    if (!work)
+    {
+        return FR_NOT_ENOUGH_CORE;
+    }
+
+    res = f_mkfs(path, &opt, work, FATFS_MKFS_WORK_SIZE);
+    myfree(SRAMEX, work);
+
+    return res;
+}
+
+/*!
+    \brief      unmount a volume and empty the eMMC write cache
+    \param[in]  path: logical drive, e.g. "C:"
+    \param[out] none
+    \retval     FRESULT
+    \note       f_unmount does not touch the disk, files must be closed (synced)
+                before; the flush makes their data power-fail safe when the
+                eMMC write cache is enabled
+*/
+FRESULT fatfs_unmount(const TCHAR *path)
+{
+    FRESULT res;
+
+    res = f_unmount(path);
+
+    if (block_cache_flush() != EMMC_OK)
+    {
+        return FR_DISK_ERR;
+    }
+
+    return res;
+}
+
+/*!
+    \brief      keep the allocation tables and the hot directories in the sector cache
+    \param[in]  fs: mounted volume
+    \param[in]  path: folder whose first cluster is pinned as well, e.g. "C:/SYSTEM"
+    \param[out] none
+    \retval     none
+    \note       a pin is one contiguous sector range, so of a directory kept in
+                a cluster chain (the FAT32 root, sub folders) only the first
+                cluster is pinned; with the default cluster size it holds
+                hundreds of entries, further clusters and the other folders
+                still reach the hot list on their second hit
+*/
+void fatfs_cache_pin(FATFS *fs, const TCHAR *path)
+{
+    DIR dir;
+
+    block_cache_pin(0, fs->fatbase, fs->fsize * fs->n_fats);                              /* the FATs */
+
+    if (fs->fs_type == FS_FAT32)
+    {
+        block_cache_pin(1, fs->database + (fs->dirbase - 2) * fs->csize, fs->csize);      /* first cluster of the root */
+    }
+    else
+    {
+        block_cache_pin(1, fs->dirbase, fs->database - fs->dirbase);                      /* fixed root directory */
+    }
+
+    if (f_opendir(&dir, path) == FR_OK)
+    {
+        if (dir.obj.sclust >= 2)
+        {
+            block_cache_pin(2, fs->database + (dir.obj.sclust - 2) * fs->csize, fs->csize);   /* first cluster of the folder */
+        }
+        f_closedir(&dir);
+    }
+}
@@ -11,9 +11,15 @@
 #include <stdint.h>
 #include "ff.h"
 
+/* f_mkfs work buffer (SDRAM), larger buffers write the FAT in fewer requests */
+#define FATFS_MKFS_WORK_SIZE    (32 * 1024)
+
 /* logical drive working area array */
 extern FATFS *fatfs[FF_VOLUMES];
 
 /* function declarations */
 uint8_t fatfs_config(void);             /*!< configure FATFS memory allocation */
+FRESULT fatfs_format(const TCHAR *path);/*!< create a volume aligned to the eMMC erase groups */
+FRESULT fatfs_unmount(const TCHAR *path);/*!< unmount a volume and empty the eMMC write cache */
+void fatfs_cache_pin(FATFS *fs, const TCHAR *path);/*!< keep the FATs, the root and one folder in the sector cache */
 #endif
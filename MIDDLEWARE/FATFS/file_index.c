@@ -0,0 +1,880 @@
+/*!
+    \file       file_index.c
+    \brief      Persistent index of the files on the eMMC volume implementation file
+    \version    1.0
+    \date       2025-08-29
+    \author     Ze-Hou
+    \note       two index copies live in SDRAM: queries read the live copy while
+                a rebuild fills the other one, the copies are swapped when the
+                scan is complete. Cached CRCs are carried over by the rebuild
+                for files whose size and time did not change.
+*/
+
+#include "./FATFS/file_index.h"
+#include "./FATFS/block_cache.h"
+#include "./MALLOC/malloc.h"
+#include "./USART/usart.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define FILE_INDEX_NIL              0xFFFF
+#define FILE_INDEX_CRC_CHUNK        (32 * 1024)             /* file read size of a CRC calculation (SDRAM) */
+
+/*!
+    \brief      Index copy structure
+*/
+typedef struct
+{
+    file_index_entry_struct *entry;                     /*!< Entries, unordered */
+    char *names;                                        /*!< Path storage */
+    uint32_t names_used;                                /*!< Used bytes of the path storage */
+    uint16_t count;                                     /*!< Number of entries */
+}file_index_set_struct;
+
+/*!
+    \brief      Index control structure
+*/
+typedef struct
+{
+    file_index_set_struct set[2];                       /*!< Live copy and rebuild target */
+    uint8_t live;                                       /*!< Index of the live copy */
+    uint8_t building;                                   /*!< 1: a rebuild fills set[live ^ 1] */
+    uint8_t rebuild;                                    /*!< 1: rebuild at the next service call */
+    uint8_t dirty;                                      /*!< Live copy differs from FILE_INDEX_FILE */
+    uint8_t depth;                                      /*!< Open folders of the rebuild */
+    uint32_t generation;                                /*!< Block cache generation the live copy matches */
+    uint32_t build_generation;                          /*!< Generation when the running rebuild started */
+    uint32_t seen_generation;                           /*!< Last generation seen by file_index_service */
+    TickType_t seen_tick;                               /*!< When seen_generation was first seen */
+    DIR *dir[FILE_INDEX_DEPTH_MAX];                     /*!< Open folders of the rebuild */
+    uint16_t path_len[FILE_INDEX_DEPTH_MAX];            /*!< Path length of each open folder */
+    char path[FF_LFN_BUF + 1];                          /*!< Path being scanned */
+    FILINFO *fileinfo;                                  /*!< Rebuild directory entry */
+    SemaphoreHandle_t lock;                             /*!< Protects both copies */
+}file_index_struct;
+
+/*!
+    \brief      Extension to type table
+*/
+static const struct
+{
+    const char *ext;
+    uint8_t type;
+}file_index_ext[] = {
+    {"FLM", FILE_INDEX_TYPE_FLM},
+    {"BIN", FILE_INDEX_TYPE_BIN},
+    {"HEX", FILE_INDEX_TYPE_HEX},
+    {"RCP", FILE_INDEX_TYPE_RCP},
+    {"BMP", FILE_INDEX_TYPE_IMAGE},
+    {"JPG", FILE_INDEX_TYPE_IMAGE},
+    {"JPEG", FILE_INDEX_TYPE_IMAGE},
+    {"PNG", FILE_INDEX_TYPE_IMAGE},
+    {"GIF", FILE_INDEX_TYPE_IMAGE},
+    {"TXT", FILE_INDEX_TYPE_LOG},
+    {"LOG", FILE_INDEX_TYPE_LOG},
+    {"CSV", FILE_INDEX_TYPE_LOG},
+};
+
+file_index_info_struct file_index_info;
+static file_index_struct file_index;
+static const file_index_set_struct *file_index_sort_set;   /* qsort has no context argument, set under the lock */
+
+/* static function declarations */
+static void file_index_lock(void);
+static void file_index_unlock(void);
+static int file_index_strcmp(const char *a, const char *b);
+static uint16_t file_index_hash(const char *path);
+static uint8_t file_index_type(const char *path);
+static uint16_t file_index_find(const file_index_set_struct *set, const char *path, uint16_t hash);
+static int file_index_put(file_index_set_struct *set, const char *path, const FILINFO *fileinfo);
+static void file_index_remove(file_index_set_struct *set, const char *path);
+static uint32_t file_index_crc32(uint32_t crc, const uint8_t *data, uint32_t length);
+static int file_index_name_cmp(const void *a, const void *b);
+static int file_index_recent_cmp(const void *a, const void *b);
+static int file_index_load(void);
+static void file_index_save(void);
+static void file_index_build_start(void);
+static void file_index_build_step(void);
+
+/*!
+    \brief      allocate the index and load FILE_INDEX_FILE
+    \param[in]  none
+    \param[out] none
+    \retval     0: index loaded, 1: no valid index file, a rebuild is scheduled, -1: out of memory
+    \note       call after the volume is mounted and before the scheduler starts
+*/
+int file_index_init(void)
+{
+    uint8_t i;
+
+    memset(&file_index_info, 0x00, sizeof(file_index_info));
+
+    for(i = 0; i < 2; i++)
+    {
+        file_index.set[i].entry = (file_index_entry_struct *)mymalloc(SRAMEX, FILE_INDEX_ENTRY_MAX * sizeof(file_index_entry_struct));
+        file_index.set[i].names = (char *)mymalloc(SRAMEX, FILE_INDEX_NAMES_SIZE);
+        file_index.set[i].names_used = 0;
+        file_index.set[i].count = 0;
+    }
+    for(i = 0; i < FILE_INDEX_DEPTH_MAX; i++)
+    {
+        file_index.dir[i] = (DIR *)mymalloc(SRAMIN, sizeof(DIR));
+    }
+    file_index.fileinfo = (FILINFO *)mymalloc(SRAMIN, sizeof(FILINFO));
+    if(file_index.lock == NULL)
+    {
+        file_index.lock = xSemaphoreCreateMutex();
+    }
+
+    for(i = 0; i < FILE_INDEX_DEPTH_MAX; i++)
+    {
+        if(file_index.dir[i] == NULL)break;
+    }
+    if((file_index.set[0].entry == NULL) || (file_index.set[0].names == NULL) || (file_index.set[1].entry == NULL) ||
+       (file_index.set[1].names == NULL) || (i < FILE_INDEX_DEPTH_MAX) || (file_index.fileinfo == NULL) || (file_index.lock == NULL))
+    {
+        PRINT_ERROR("file index disabled, out of memory\r\n");
+        for(i = 0; i < 2; i++)
+        {
+            myfree(SRAMEX, file_index.set[i].entry);
+            myfree(SRAMEX, file_index.set[i].names);
+            file_index.set[i].entry = NULL;
+            file_index.set[i].names = NULL;
+        }
+        for(i = 0; i < FILE_INDEX_DEPTH_MAX; i++)
+        {
+            myfree(SRAMIN, file_index.dir[i]);
+            file_index.dir[i] = NULL;
+        }
+        myfree(SRAMIN, file_index.fileinfo);
+        file_index.fileinfo = NULL;
+        return -1;
+    }
+
+    file_index.live = 0;
+    file_index.building = 0;
+    file_index.dirty = 0;
+    file_index.generation = block_cache_info.generation;
+    file_index.seen_generation = block_cache_info.generation;
+
+    if(file_index_load() != 0)
+    {
+        file_index.set[0].count = 0;
+        file_index.set[0].names_used = 0;
+        file_index.rebuild = 1;
+        file_index_info.stale = 1;
+        PRINT_WARN("file index: no valid %s, rebuilding in the background\r\n", FILE_INDEX_FILE);
+        return 1;
+    }
+
+    file_index_info.count = file_index.set[0].count;
+    PRINT_INFO("file index: %u files\r\n", file_index_info.count);
+
+    return 0;
+}
+
+/*!
+    \brief      add, refresh or drop one file after it changed
+    \param[in]  path: full path of the created, written or deleted file
+    \param[out] none
+    \retval     none
+    \note       the cached CRC is kept only when size and time are unchanged;
+                a running rebuild gets the same change
+*/
+void file_index_update(const char *path)
+{
+    FRESULT fresult;
+    FILINFO *fileinfo;
+
+    if((file_index.set[0].entry == NULL) || (path == NULL))return;
+    if(file_index_strcmp(path, FILE_INDEX_FILE) == 0)return;
+
+    fileinfo = (FILINFO *)mymalloc(SRAMIN, sizeof(FILINFO));
+    if(fileinfo == NULL)return;
+
+    fresult = f_stat(path, fileinfo);
+
+    file_index_lock();
+    if((fresult == FR_OK) && !(fileinfo->fattrib & AM_DIR))
+    {
+        if(file_index_put(&file_index.set[file_index.live], path, fileinfo) < 0)
+        {
+            file_index.rebuild = 1;                     /* full, a rebuild drops the space of deleted paths */
+        }
+        if(file_index.building)
+        {
+            file_index_put(&file_index.set[file_index.live ^ 1], path, fileinfo);
+        }
+    }
+    else if((fresult == FR_NO_FILE) || (fresult == FR_NO_PATH))
+    {
+        file_index_remove(&file_index.set[file_index.live], path);
+        if(file_index.building)
+        {
+            file_index_remove(&file_index.set[file_index.live ^ 1], path);
+        }
+    }
+    file_index.dirty = 1;
+    file_index_info.updates++;
+    file_index_info.count = file_index.set[file_index.live].count;
+    file_index_unlock();
+
+    myfree(SRAMIN, fileinfo);
+}
+
+/*!
+    \brief      CRC-32 of a file, cached in the index
+    \param[in]  path: full path of the file
+    \param[out] crc: CRC-32 (IEEE 802.3) of the file content
+    \retval     0: success, -1: file error, -2: out of memory
+    \note       the file is read only when the index has no CRC for its
+                current size and time
+*/
+int file_index_crc(const char *path, uint32_t *crc)
+{
+    int res = 0;
+    int put;
+    uint16_t index;
+    uint32_t value = 0xFFFFFFFF;
+    UINT read_bytes;
+    FILINFO *fileinfo;
+    FIL *file = NULL;
+    uint8_t *buffer = NULL;
+    file_index_entry_struct *entry;
+
+    fileinfo = (FILINFO *)mymalloc(SRAMIN, sizeof(FILINFO));
+    if(fileinfo == NULL)return -2;
+
+    if(f_stat(path, fileinfo) != FR_OK)
+    {
+        res = -1;
+        goto __exit;
+    }
+
+    if(file_index.set[0].entry != NULL)
+    {
+        file_index_lock();
+        index = file_index_find(&file_index.set[file_index.live], path, file_index_hash(path));
+        entry = (index != FILE_INDEX_NIL) ? &file_index.set[file_index.live].entry[index] : NULL;
+        if((entry != NULL) && (entry->flags & FILE_INDEX_FLAG_CRC) &&
+           (entry->size == ((fileinfo->fsize > 0xFFFFFFFF) ? 0xFFFFFFFF : (uint32_t)fileinfo->fsize)) &&
+           (entry->mtime == (((uint32_t)fileinfo->fdate << 16) | fileinfo->ftime)))
+        {
+            *crc = entry->crc;
+            file_index_info.crc_hit++;
+            file_index_unlock();
+            goto __exit;
+        }
+        file_index_unlock();
+    }
+
+    file = (FIL *)mymalloc(SRAMIN, sizeof(FIL));
+    buffer = (uint8_t *)mymalloc(SRAMEX, FILE_INDEX_CRC_CHUNK);
+    if((file == NULL) || (buffer == NULL))
+    {
+        res = -2;
+        goto __exit;
+    }
+
+    if(f_open(file, path, FA_READ) != FR_OK)
+    {
+        res = -1;
+        goto __exit;
+    }
+    do
+    {
+        if(f_read(file, buffer, FILE_INDEX_CRC_CHUNK, &read_bytes) != FR_OK)
+        {
+            res = -1;
+            break;
+        }
+        value = file_index_crc32(value, buffer, read_bytes);
+    }while(read_bytes == FILE_INDEX_CRC_CHUNK);
+    f_close(file);
+
+    if(res == 0)
+    {
+        *crc = ~value;
+
+        if(file_index.set[0].entry != NULL)
+        {
+            file_index_lock();
+            put = file_index_put(&file_index.set[file_index.live], path, fileinfo);
+            if(put >= 0)
+            {
+                index = (uint16_t)put;
+                file_index.set[file_index.live].entry[index].crc = *crc;
+                file_index.set[file_index.live].entry[index].flags |= FILE_INDEX_FLAG_CRC;
+                file_index.dirty = 1;
+            }
+            file_index_info.count = file_index.set[file_index.live].count;
+            file_index_unlock();
+        }
+    }
+
+__exit:
+    myfree(SRAMEX, buffer);
+    myfree(SRAMIN, file);
+    myfree(SRAMIN, fileinfo);
+    return res;
+}
+
+/*!
+    \brief      files of one type
+    \param[in]  type: file_index_type_enum, FILE_INDEX_TYPE_ANY for all files
+    \param[in]  order: file_index_order_enum
+    \param[out] result: up to max results
+    \param[in]  max: size of the result array
+    \retval     number of results
+    \note       e.g. all FLM files: file_index_query(FILE_INDEX_TYPE_FLM, FILE_INDEX_ORDER_NAME, ...),
+                the 10 latest pictures: file_index_query(FILE_INDEX_TYPE_IMAGE, FILE_INDEX_ORDER_RECENT, result, 10)
+*/
+uint16_t file_index_query(uint8_t type, file_index_order_enum order, file_index_result_struct *result, uint16_t max)
+{
+    uint16_t i, count = 0;
+    uint16_t *match;
+    const file_index_set_struct *set;
+    const file_index_entry_struct *entry;
+
+    if((file_index.set[0].entry == NULL) || (max == 0))return 0;
+
+    match = (uint16_t *)mymalloc(SRAMEX, FILE_INDEX_ENTRY_MAX * sizeof(uint16_t));
+    if(match == NULL)return 0;
+
+    file_index_lock();
+    set = &file_index.set[file_index.live];
+    for(i = 0; i < set->count; i++)
+    {
+        if((type == FILE_INDEX_TYPE_ANY) || (set->entry[i].type == type))
+        {
+            match[count++] = i;
+        }
+    }
+
+    if(order != FILE_INDEX_ORDER_NONE)
+    {
+        file_index_sort_set = set;
+        qsort(match, count, sizeof(uint16_t), (order == FILE_INDEX_ORDER_RECENT) ? file_index_recent_cmp : file_index_name_cmp);
+    }
+
+    if(count > max)count = max;
+    for(i = 0; i < count; i++)
+    {
+        entry = &set->entry[match[i]];
+        strncpy(result[i].path, set->names + entry->path, FF_LFN_BUF);
+        result[i].path[FF_LFN_BUF] = '\0';
+        result[i].size = entry->size;
+        result[i].mtime = entry->mtime;
+        result[i].crc = entry->crc;
+        result[i].type = entry->type;
+        result[i].flags = entry->flags;
+    }
+    file_index_unlock();
+
+    myfree(SRAMEX, match);
+
+    return count;
+}
+
+/*!
+    \brief      check whether a rebuild is running
+    \param[in]  none
+    \param[out] none
+    \retval     1: the storage task should call file_index_service without waiting
+*/
+uint8_t file_index_busy(void)
+{
+    return file_index.building;
+}
+
+/*!
+    \brief      rebuild and save in the background
+    \param[in]  none
+    \param[out] none
+    \retval     none
+    \note       called by the storage task when it has no request; a rebuild
+                is split into steps of FILE_INDEX_STEP_NUM directory entries so
+                queued requests are served in between
+*/
+void file_index_service(void)
+{
+    TickType_t tick = xTaskGetTickCount();
+
+    if(file_index.set[0].entry == NULL)return;
+
+    if(file_index.building)
+    {
+        file_index_build_step();
+        return;
+    }
+
+    if(block_cache_info.generation != file_index.generation)    /* the host wrote to the volume */
+    {
+        file_index_info.stale = 1;
+        if(block_cache_info.generation != file_index.seen_generation)
+        {
+            file_index.seen_generation = block_cache_info.generation;
+            file_index.seen_tick = tick;
+            return;
+        }
+        if((tick - file_index.seen_tick) < pdMS_TO_TICKS(FILE_INDEX_SETTLE_MS))return;
+        file_index.rebuild = 1;
+    }
+
+    if(file_index.rebuild)
+    {
+        file_index_build_start();
+        return;
+    }
+
+    if(file_index.dirty)
+    {
+        file_index_save();
+    }
+}
+
+/*!
+    \brief      take the index lock once the scheduler runs
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void file_index_lock(void)
+{
+    if((file_index.lock != NULL) && (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED))
+    {
+        xSemaphoreTake(file_index.lock, portMAX_DELAY);
+    }
+}
+
+/*!
+    \brief      release the index lock
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void file_index_unlock(void)
+{
+    if((file_index.lock != NULL) && (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED))
+    {
+        xSemaphoreGive(file_index.lock);
+    }
+}
+
+/*!
+    \brief      case insensitive string compare
+    \param[in]  a: string a
+    \param[in]  b: string b
+    \param[out] none
+    \retval     compare result
+*/
+static int file_index_strcmp(const char *a, const char *b)
+{
+    int diff;
+
+    do
+    {
+        diff = toupper((unsigned char)*a) - toupper((unsigned char)*b);
+    }while((diff == 0) && (*a++ != '\0') && (*b++ != '\0'));
+
+    return diff;
+}
+
+/*!
+    \brief      case insensitive path hash
+    \param[in]  path: full path
+    \param[out] none
+    \retval     16-bit FNV-1a hash
+*/
+static uint16_t file_index_hash(const char *path)
+{
+    uint32_t hash = 2166136261U;
+
+    while(*path)
+    {
+        hash ^= (uint8_t)toupper((unsigned char)*path++);
+        hash *= 16777619U;
+    }
+
+    return (uint16_t)(hash ^ (hash >> 16));
+}
+
+/*!
+    \brief      file type from the extension
+    \param[in]  path: file name or path
+    \param[out] none
+    \retval     file_index_type_enum
+*/
+static uint8_t file_index_type(const char *path)
+{
+    const char *ext = strrchr(path, '.');
+    uint8_t i;
+
+    if(ext == NULL)return FILE_INDEX_TYPE_OTHER;
+
+    for(i = 0; i < sizeof(file_index_ext) / sizeof(file_index_ext[0]); i++)
+    {
+        if(file_index_strcmp(ext + 1, file_index_ext[i].ext) == 0)return file_index_ext[i].type;
+    }
+
+    return FILE_INDEX_TYPE_OTHER;
+}
+
+/*!
+    \brief      look a path up
+    \param[in]  set: index copy
+    \param[in]  path: full path
+    \param[in]  hash: file_index_hash of path
+    \param[out] none
+    \retval     entry index, FILE_INDEX_NIL when not indexed
+*/
+static uint16_t file_index_find(const file_index_set_struct *set, const char *path, uint16_t hash)
+{
+    uint16_t i;
+
+    for(i = 0; i < set->count; i++)
+    {
+        if((set->entry[i].hash == hash) && (file_index_strcmp(set->names + set->entry[i].path, path) == 0))return i;
+    }
+
+    return FILE_INDEX_NIL;
+}
+
+/*!
+    \brief      add a file or refresh its entry
+    \param[in]  set: index copy
+    \param[in]  path: full path
+    \param[in]  fileinfo: current FatFs information of the file
+    \param[out] none
+    \retval     entry index, -1: the index copy is full
+*/
+static int file_index_put(file_index_set_struct *set, const char *path, const FILINFO *fileinfo)
+{
+    uint16_t hash = file_index_hash(path);
+    uint16_t index = file_index_find(set, path, hash);
+    uint32_t length, size, mtime;
+    file_index_entry_struct *entry;
+
+    size = (fileinfo->fsize > 0xFFFFFFFF) ? 0xFFFFFFFF : (uint32_t)fileinfo->fsize;
+    mtime = ((uint32_t)fileinfo->fdate << 16) | fileinfo->ftime;
+
+    if(index == FILE_INDEX_NIL)
+    {
+        length = strlen(path) + 1;
+        if((set->count >= FILE_INDEX_ENTRY_MAX) || (set->names_used + length > FILE_INDEX_NAMES_SIZE))return -1;
+
+        index = set->count++;
+        entry = &set->entry[index];
+        memcpy(set->names + set->names_used, path, length);
+        entry->path = set->names_used;
+        set->names_used += length;
+        entry->hash = hash;
+        entry->type = file_index_type(path);
+        entry->flags = 0;
+        entry->crc = 0;
+    }
+    else
+    {
+        entry = &set->entry[index];
+        if((entry->size != size) || (entry->mtime != mtime))
+        {
+            entry->flags &= ~FILE_INDEX_FLAG_CRC;       /* content changed */
+        }
+    }
+    entry->size = size;
+    entry->mtime = mtime;
+
+    return index;
+}
+
+/*!
+    \brief      drop a file
+    \param[in]  set: index copy
+    \param[in]  path: full path
+    \param[out] none
+    \retval     none
+    \note       the last entry takes the free slot, the path bytes stay used
+                until the next rebuild
+*/
+static void file_index_remove(file_index_set_struct *set, const char *path)
+{
+    uint16_t index = file_index_find(set, path, file_index_hash(path));
+
+    if(index == FILE_INDEX_NIL)return;
+
+    set->count--;
+    if(index != set->count)
+    {
+        set->entry[index] = set->entry[set->count];
+    }
+}
+
+/*!
+    \brief      update a CRC-32 (IEEE 802.3, reflected) with a buffer
+    \param[in]  crc: running value, start with 0xFFFFFFFF and invert at the end
+    \param[in]  data: data
+    \param[in]  length: bytes
+    \param[out] none
+    \retval     running value
+*/
+static uint32_t file_index_crc32(uint32_t crc, const uint8_t *data, uint32_t length)
+{
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+
+    while(length--)
+    {
+        crc ^= *data++;
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+    }
+
+    return crc;
+}
+
+/*!
+    \brief      query order: path, case insensitive
+    \param[in]  a: entry index a
+    \param[in]  b: entry index b
+    \param[out] none
+    \retval     compare result
+*/
+static int file_index_name_cmp(const void *a, const void *b)
+{
+    const file_index_set_struct *set = file_index_sort_set;
+
+    return file_index_strcmp(set->names + set->entry[*(const uint16_t *)a].path, set->names + set->entry[*(const uint16_t *)b].path);
+}
+
+/*!
+    \brief      query order: newest first
+    \param[in]  a: entry index a
+    \param[in]  b: entry index b
+    \param[out] none
+    \retval     compare result
+*/
+static int file_index_recent_cmp(const void *a, const void *b)
+{
+    uint32_t ta = file_index_sort_set->entry[*(const uint16_t *)a].mtime;
+    uint32_t tb = file_index_sort_set->entry[*(const uint16_t *)b].mtime;
+
+    if(ta != tb)return (ta > tb) ? -1 : 1;
+    return file_index_name_cmp(a, b);
+}
+
+/*!
+    \brief      read FILE_INDEX_FILE into the live copy
+    \param[in]  none
+    \param[out] none
+    \retval     0: success, -1: missing or invalid file, -2: out of memory
+*/
+static int file_index_load(void)
+{
+    int res = 0;
+    UINT br;
+    FIL *file;
+    file_index_header_struct header;
+    file_index_set_struct *set = &file_index.set[file_index.live];
+
+    file = (FIL *)mymalloc(SRAMIN, sizeof(FIL));
+    if(file == NULL)return -2;
+
+    if(f_open(file, FILE_INDEX_FILE, FA_READ) != FR_OK)
+    {
+        myfree(SRAMIN, file);
+        return -1;
+    }
+
+    if((f_read(file, &header, sizeof(header), &br) != FR_OK) || (br != sizeof(header)) ||
+       (header.magic != FILE_INDEX_MAGIC) || (header.version != FILE_INDEX_VERSION) ||
+       (header.count > FILE_INDEX_ENTRY_MAX) || (header.names_size > FILE_INDEX_NAMES_SIZE) ||
+       (f_size(file) != sizeof(header) + header.count * sizeof(file_index_entry_struct) + header.names_size))
+    {
+        res = -1;
+    }
+    else if((f_read(file, set->entry, header.count * sizeof(file_index_entry_struct), &br) != FR_OK) ||
+            (br != header.count * sizeof(file_index_entry_struct)) ||
+            (f_read(file, set->names, header.names_size, &br) != FR_OK) || (br != header.names_size))
+    {
+        res = -1;
+    }
+    else
+    {
+        set->count = header.count;
+        set->names_used = header.names_size;
+    }
+    f_close(file);
+    myfree(SRAMIN, file);
+
+    return res;
+}
+
+/*!
+    \brief      write the live copy to FILE_INDEX_FILE
+    \param[in]  none
+    \param[out] none
+    \retval     none
+    \note       the live copy is snapshotted into the spare one under the
+                lock (no rebuild runs while saving, both run in the storage
+                task) and written without it, so updates and queries are
+                not held up by the file I/O; a change during the write
+                marks the index dirty again
+*/
+static void file_index_save(void)
+{
+    UINT bw;
+    FRESULT fresult;
+    FIL *file;
+    file_index_header_struct header;
+    file_index_set_struct *live;
+    file_index_set_struct *set;
+
+    file = (FIL *)mymalloc(SRAMIN, sizeof(FIL));
+    if(file == NULL)return;
+
+    file_index_lock();
+    live = &file_index.set[file_index.live];
+    set = &file_index.set[file_index.live ^ 1];
+    memcpy(set->entry, live->entry, live->count * sizeof(file_index_entry_struct));
+    memcpy(set->names, live->names, live->names_used);
+    set->count = live->count;
+    set->names_used = live->names_used;
+    file_index.dirty = 0;
+    file_index_unlock();
+
+    header.magic = FILE_INDEX_MAGIC;
+    header.version = FILE_INDEX_VERSION;
+    header.count = set->count;
+    header.names_size = set->names_used;
+
+    fresult = f_open(file, FILE_INDEX_FILE, FA_CREATE_ALWAYS | FA_WRITE);
+    if(fresult == FR_OK)
+    {
+        fresult = f_write(file, &header, sizeof(header), &bw);
+        if(fresult == FR_OK)fresult = f_write(file, set->entry, set->count * sizeof(file_index_entry_struct), &bw);
+        if(fresult == FR_OK)fresult = f_write(file, set->names, set->names_used, &bw);
+        if((f_close(file) != FR_OK) && (fresult == FR_OK))fresult = FR_DISK_ERR;
+    }
+
+    if(fresult != FR_OK)
+    {
+        PRINT_WARN("file index: save failed(%d)\r\n", fresult);   /* retried with the next change */
+    }
+
+    myfree(SRAMIN, file);
+}
+
+/*!
+    \brief      start a rebuild into the spare copy
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void file_index_build_start(void)
+{
+    file_index_set_struct *set = &file_index.set[file_index.live ^ 1];
+
+    file_index.rebuild = 0;
+    file_index.build_generation = block_cache_info.generation;
+
+    file_index_lock();
+    set->count = 0;
+    set->names_used = 0;
+    file_index_unlock();
+
+    strcpy(file_index.path, "C:");
+    file_index.path_len[0] = strlen(file_index.path);
+    if(f_opendir(file_index.dir[0], file_index.path) != FR_OK)
+    {
+        return;
+    }
+    file_index.depth = 1;
+    file_index.building = 1;
+}
+
+/*!
+    \brief      scan up to FILE_INDEX_STEP_NUM directory entries
+    \param[in]  none
+    \param[out] none
+    \retval     none
+    \note       the copies are swapped when the root folder is finished
+*/
+static void file_index_build_step(void)
+{
+    uint16_t i, index, len, name_len;
+    int put;
+    FRESULT fresult;
+    FILINFO *fileinfo = file_index.fileinfo;
+    file_index_entry_struct *entry;
+    file_index_set_struct *set = &file_index.set[file_index.live ^ 1];
+    const file_index_set_struct *live = &file_index.set[file_index.live];
+
+    for(i = 0; i < FILE_INDEX_STEP_NUM; i++)
+    {
+        fresult = f_readdir(file_index.dir[file_index.depth - 1], fileinfo);
+        if((fresult != FR_OK) || (fileinfo->fname[0] == '\0'))    /* end of this folder */
+        {
+            f_closedir(file_index.dir[file_index.depth - 1]);
+            file_index.depth--;
+            if(file_index.depth == 0)break;
+            file_index.path[file_index.path_len[file_index.depth - 1]] = '\0';
+            continue;
+        }
+
+        len = file_index.path_len[file_index.depth - 1];
+        name_len = strlen(fileinfo->fname);
+        if(len + 1 + name_len > FF_LFN_BUF)continue;    /* path too long */
+        file_index.path[len] = '/';
+        memcpy(&file_index.path[len + 1], fileinfo->fname, name_len + 1);
+
+        if(fileinfo->fattrib & AM_DIR)
+        {
+            if((file_index.depth < FILE_INDEX_DEPTH_MAX) && (f_opendir(file_index.dir[file_index.depth], file_index.path) == FR_OK))
+            {
+                file_index.path_len[file_index.depth] = len + 1 + name_len;
+                file_index.depth++;
+                continue;
+            }
+        }
+        else if(file_index_strcmp(file_index.path, FILE_INDEX_FILE) != 0)
+        {
+            file_index_lock();
+            put = file_index_put(set, file_index.path, fileinfo);  /* may refresh an entry file_index_update added */
+            if(put >= 0)
+            {
+                /* keep the CRC of an unchanged file */
+                entry = &set->entry[put];
+                index = file_index_find(live, file_index.path, entry->hash);
+                if(!(entry->flags & FILE_INDEX_FLAG_CRC) && (index != FILE_INDEX_NIL) && (live->entry[index].flags & FILE_INDEX_FLAG_CRC) &&
+                   (live->entry[index].size == entry->size) && (live->entry[index].mtime == entry->mtime))
+                {
+                    entry->crc = live->entry[index].crc;
+                    entry->flags |= FILE_INDEX_FLAG_CRC;
+                }
+            }
+            file_index_unlock();
+        }
+        file_index.path[len] = '\0';
+    }
+
+    if(file_index.depth != 0)return;
+
+    /* scan complete, the new copy goes live */
+    file_index_lock();
+    file_index.live ^= 1;
+    file_index.generation = file_index.build_generation;
+    file_index_info.count = file_index.set[file_index.live].count;
+    file_index_unlock();
+
+    file_index.building = 0;
+    file_index.dirty = 1;
+    file_index_info.rebuilds++;
+    file_index_info.stale = (block_cache_info.generation != file_index.generation) ? 1 : 0;
+    PRINT_INFO("file index: %u files indexed\r\n", file_index_info.count);
+}
@@ -0,0 +1,125 @@
+/*!
+    \file       file_index.h
+    \brief      Persistent index of the files on the eMMC volume header file
+    \version    1.0
+    \date       2025-08-29
+    \author     Ze-Hou
+    \note       the index (path, size, modified time, type, cached CRC) is kept
+                in SDRAM and saved to FILE_INDEX_FILE, queries never touch the
+                volume. It is kept current in two ways:
+                - code that creates or changes a file through FatFs on the
+                  device calls file_index_update with the path afterwards
+                - writes of the USB host (MSC) bump block_cache_info.generation,
+                  once it has been stable for FILE_INDEX_SETTLE_MS the storage
+                  task rebuilds the index in steps between its requests
+                file_index_update runs in the storage task (the service calls
+                it after its own writes, other tasks submit STORAGE_OP_INDEX)
+                or before the scheduler starts, so it is ordered with the
+                rebuild steps; file_index_crc and queries may be called from
+                any task (FatFs is reentrant, the index has its own lock).
+*/
+
+#ifndef __FILE_INDEX_H
+#define __FILE_INDEX_H
+#include <stdint.h>
+#include "./FATFS/fatfs_config.h"
+
+/* index configuration */
+#define FILE_INDEX_FILE             "C:/SYSTEM/FILES.IDX"   /*!< saved index */
+#define FILE_INDEX_ENTRY_MAX        4096                    /*!< maximum number of indexed files */
+#define FILE_INDEX_NAMES_SIZE       (256 * 1024)            /*!< path storage per index copy (SDRAM) */
+#define FILE_INDEX_DEPTH_MAX        8                       /*!< deepest folder scanned by a rebuild */
+#define FILE_INDEX_STEP_NUM         32                      /*!< directory entries scanned per rebuild step */
+#define FILE_INDEX_SETTLE_MS        2000                    /*!< host writes must stop this long before a rebuild */
+#define FILE_INDEX_MAGIC            0x58444946              /*!< "FIDX" */
+#define FILE_INDEX_VERSION          1                       /*!< index file format version */
+
+/* entry flags */
+#define FILE_INDEX_FLAG_CRC         0x01                    /*!< crc is valid for the current size and time */
+
+/*!
+    \brief      File type enumeration, taken from the extension
+*/
+typedef enum
+{
+    FILE_INDEX_TYPE_OTHER = 0,                          /*!< (0) Anything else */
+    FILE_INDEX_TYPE_FLM,                                /*!< (1) Flash algorithm (.FLM) */
+    FILE_INDEX_TYPE_BIN,                                /*!< (2) Raw image (.BIN) */
+    FILE_INDEX_TYPE_HEX,                                /*!< (3) Intel HEX image (.HEX) */
+    FILE_INDEX_TYPE_RCP,                                /*!< (4) Programming recipe (.RCP) */
+    FILE_INDEX_TYPE_IMAGE,                              /*!< (5) Picture (.BMP .JPG .PNG .GIF) */
+    FILE_INDEX_TYPE_LOG,                                /*!< (6) Text log (.TXT .LOG .CSV) */
+    FILE_INDEX_TYPE_NUM,
+    FILE_INDEX_TYPE_ANY = 0xFF,                         /*!< Query: every type */
+}file_index_type_enum;
+
+/*!
+    \brief      Query order enumeration
+*/
+typedef enum
+{
+    FILE_INDEX_ORDER_NONE = 0,                          /*!< (0) Index order */
+    FILE_INDEX_ORDER_NAME,                              /*!< (1) Path, case insensitive */
+    FILE_INDEX_ORDER_RECENT,                            /*!< (2) Newest first */
+}file_index_order_enum;
+
+/*!
+    \brief      Index entry structure, also the record format of FILE_INDEX_FILE
+*/
+typedef struct
+{
+    uint32_t path;                                      /*!< Offset of the full path in the path storage */
+    uint32_t size;                                      /*!< File size, 0xFFFFFFFF above 4GB */
+    uint32_t mtime;                                     /*!< FatFs fdate << 16 | ftime */
+    uint32_t crc;                                       /*!< CRC-32 of the content, valid with FILE_INDEX_FLAG_CRC */
+    uint16_t hash;                                      /*!< Case insensitive path hash */
+    uint8_t type;                                       /*!< file_index_type_enum */
+    uint8_t flags;                                      /*!< FILE_INDEX_FLAG_xxx */
+}file_index_entry_struct;
+
+/*!
+    \brief      Index file header structure, followed by count entries and names_size path bytes
+*/
+typedef struct
+{
+    uint32_t magic;                                     /*!< FILE_INDEX_MAGIC */
+    uint16_t version;                                   /*!< FILE_INDEX_VERSION */
+    uint16_t count;                                     /*!< Number of entries */
+    uint32_t names_size;                                /*!< Bytes of path storage */
+}file_index_header_struct;
+
+/*!
+    \brief      Query result structure
+*/
+typedef struct
+{
+    char path[FF_LFN_BUF + 1];                          /*!< Full path */
+    uint32_t size;                                      /*!< File size */
+    uint32_t mtime;                                     /*!< FatFs fdate << 16 | ftime */
+    uint32_t crc;                                       /*!< Cached CRC-32, valid with FILE_INDEX_FLAG_CRC */
+    uint8_t type;                                       /*!< file_index_type_enum */
+    uint8_t flags;                                      /*!< FILE_INDEX_FLAG_xxx */
+}file_index_result_struct;
+
+/*!
+    \brief      Index statistics structure
+*/
+typedef struct
+{
+    uint16_t count;                                     /*!< Indexed files */
+    uint8_t stale;                                      /*!< 1: the host changed the volume, a rebuild is due or running */
+    uint32_t rebuilds;                                  /*!< Completed rebuilds */
+    uint32_t updates;                                   /*!< Incremental updates */
+    uint32_t crc_hit;                                   /*!< CRC requests served from the index */
+}file_index_info_struct;
+
+extern file_index_info_struct file_index_info;
+
+/* function declarations */
+int file_index_init(void);                                                      /* allocate the index and load FILE_INDEX_FILE */
+void file_index_update(const char *path);                                       /* add, refresh or drop one file after it changed */
+int file_index_crc(const char *path, uint32_t *crc);                            /* CRC-32 of a file, cached in the index */
+uint16_t file_index_query(uint8_t type, file_index_order_enum order, file_index_result_struct *result, uint16_t max);    /* files of one type */
+uint8_t file_index_busy(void);                                                  /* a rebuild is running */
+void file_index_service(void);                                                  /* storage task: rebuild and save in the background */
+#endif /* __FILE_INDEX_H */
@@ -0,0 +1,296 @@
+/*!
+    \file       recorder.c
+    \brief      High-rate stream recorder to preallocated eMMC files implementation file
+    \version    1.0
+    \date       2025-08-31
+    \author     Ze-Hou
+*/
+
+#include "./FATFS/recorder.h"
+#include "./FATFS/storage_service.h"
+#include "./FATFS/block_cache.h"
+#include "./MALLOC/malloc.h"
+#include "./USART/usart.h"
+#include "./SYSTEM/system.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include <string.h>
+
+/*!
+    \brief      Chunk write job structure
+*/
+typedef struct
+{
+    recorder_struct *recorder;                          /*!< Owner of the chunk */
+    uint8_t half;                                       /*!< Buffer half to write */
+    uint32_t length;                                    /*!< Bytes in the half */
+}recorder_job_struct;
+
+static QueueHandle_t recorder_queue;
+static TaskHandle_t recorder_task_handle;
+
+/* static function declarations */
+static void recorder_task(void *pvParameters);
+static void recorder_submit(recorder_struct *recorder);
+
+/*!
+    \brief      create the recorder task
+    \param[in]  none
+    \param[out] none
+    \retval     0: success, -1: out of memory
+    \note       call before the scheduler starts
+*/
+int recorder_init(void)
+{
+    recorder_queue = xQueueCreate(RECORDER_NUM_MAX * 2, sizeof(recorder_job_struct));
+
+    if((recorder_queue == NULL) ||
+       (xTaskCreate((TaskFunction_t)recorder_task, "recorder_task", RECORDER_STK_SIZE, NULL,
+                    RECORDER_TASK_PRIO, &recorder_task_handle) != pdPASS))
+    {
+        PRINT_ERROR("recorder disabled, out of memory\r\n");
+        recorder_task_handle = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+/*!
+    \brief      preallocate a file and start recording into it
+    \param[in]  recorder: recorder, state must be RECORDER_IDLE
+    \param[in]  path: file to create, an existing file is replaced
+    \param[in]  size: bytes to preallocate, the most that can be recorded
+    \param[out] none
+    \retval     FatFs result, FR_DENIED when the volume has no contiguous free
+                area of that size, FR_NOT_ENOUGH_CORE without buffers or task
+*/
+FRESULT recorder_start(recorder_struct *recorder, const char *path, uint32_t size)
+{
+    storage_request_struct request = {0};
+
+    if((recorder_task_handle == NULL) || (recorder->state != RECORDER_IDLE) || (strlen(path) > FF_LFN_BUF) || (size == 0))
+    {
+        return FR_INVALID_PARAMETER;
+    }
+
+    recorder->buffer[0] = (uint8_t *)mymalloc(SRAMEX, RECORDER_CHUNK_SIZE);
+    recorder->buffer[1] = (uint8_t *)mymalloc(SRAMEX, RECORDER_CHUNK_SIZE);
+    if((recorder->buffer[0] == NULL) || (recorder->buffer[1] == NULL))
+    {
+        myfree(SRAMEX, recorder->buffer[0]);
+        myfree(SRAMEX, recorder->buffer[1]);
+        recorder->buffer[0] = NULL;
+        recorder->buffer[1] = NULL;
+        return FR_NOT_ENOUGH_CORE;
+    }
+
+    size = (size + BLOCK_CACHE_SECTOR_SIZE - 1) & ~(BLOCK_CACHE_SECTOR_SIZE - 1);
+    request.op = STORAGE_OP_EXPAND;
+    request.prio = STORAGE_PRIO_HIGH;
+    request.path = path;
+    request.size = size;
+    if(storage_service_run(&request) != FR_OK)
+    {
+        PRINT_ERROR("recorder %s: preallocating %u bytes failed(%d)\r\n", path, size, request.fresult);
+        myfree(SRAMEX, recorder->buffer[0]);
+        myfree(SRAMEX, recorder->buffer[1]);
+        recorder->buffer[0] = NULL;
+        recorder->buffer[1] = NULL;
+        return request.fresult;
+    }
+
+    strcpy(recorder->path, path);
+    recorder->busy[0] = 0;
+    recorder->busy[1] = 0;
+    recorder->fill = 0;
+    recorder->used = 0;
+    recorder->sector = request.result;
+    recorder->capacity = size;
+    recorder->accepted = 0;
+    recorder->written = 0;
+    recorder->dropped = 0;
+    recorder->start_tick = xTaskGetTickCount();
+    recorder->write_us = 0;
+    recorder->max_write_us = 0;
+    recorder->speed = 0;
+    recorder->error = EMMC_OK;
+    recorder->state = RECORDER_RUNNING;
+
+    return FR_OK;
+}
+
+/*!
+    \brief      append data
+    \param[in]  recorder: running recorder
+    \param[in]  data: data
+    \param[in]  length: bytes
+    \param[out] none
+    \retval     bytes accepted, the rest is counted in dropped
+    \note       one producer task per recorder, not for interrupt handlers;
+                the copy into the buffer is the only work done here
+*/
+uint32_t recorder_write(recorder_struct *recorder, const void *data, uint32_t length)
+{
+    uint32_t size, accepted = 0;
+    const uint8_t *pdata = (const uint8_t *)data;
+
+    while(length > 0)
+    {
+        if(recorder->state != RECORDER_RUNNING)break;
+
+        if(recorder->accepted == recorder->capacity)
+        {
+            recorder->state = RECORDER_FULL;
+            PRINT_WARN("recorder %s: preallocated size reached\r\n", recorder->path);
+            break;
+        }
+        if(recorder->busy[recorder->fill])break;    /* the eMMC fell behind, drop rather than block the producer */
+
+        size = RECORDER_CHUNK_SIZE - recorder->used;
+        if(size > length)size = length;
+        if(size > recorder->capacity - recorder->accepted)size = recorder->capacity - recorder->accepted;
+
+        memcpy(recorder->buffer[recorder->fill] + recorder->used, pdata, size);
+        recorder->used += size;
+        recorder->accepted += size;
+        accepted += size;
+        pdata += size;
+        length -= size;
+
+        if((recorder->used == RECORDER_CHUNK_SIZE) || (recorder->accepted == recorder->capacity))
+        {
+            recorder_submit(recorder);
+        }
+    }
+    recorder->dropped += length;
+
+    return accepted;
+}
+
+/*!
+    \brief      write the rest and set the file size
+    \param[in]  recorder: started recorder
+    \param[out] none
+    \retval     FatFs result of setting the size, FR_DISK_ERR after an eMMC write error
+    \note       the file keeps the bytes that reached the eMMC; call from the
+                producer task or once it no longer writes
+*/
+FRESULT recorder_stop(recorder_struct *recorder)
+{
+    storage_request_struct request = {0};
+    uint32_t time_ms;
+
+    if(recorder->buffer[0] == NULL)return FR_INVALID_PARAMETER;
+
+    if((recorder->state == RECORDER_RUNNING) && (recorder->used > 0))
+    {
+        recorder_submit(recorder);
+    }
+    if(recorder->state == RECORDER_RUNNING)
+    {
+        recorder->state = RECORDER_FULL;            /* no more data */
+    }
+    while(recorder->busy[0] || recorder->busy[1])
+    {
+        vTaskDelay(1);
+    }
+
+    request.op = STORAGE_OP_TRUNCATE;
+    request.prio = STORAGE_PRIO_HIGH;
+    request.path = recorder->path;
+    request.offset = recorder->written;
+    storage_service_run(&request);
+    block_cache_flush();
+
+    time_ms = (xTaskGetTickCount() - recorder->start_tick) * portTICK_PERIOD_MS;
+    recorder->speed = (uint32_t)((uint64_t)recorder->written * 1000 / 1024 / (time_ms + 1));
+    PRINT_INFO("recorder %s: %u bytes, %u dropped, %u KB/s, chunk write max %u us avg %u us\r\n", recorder->path,
+               recorder->written, recorder->dropped, recorder->speed, recorder->max_write_us,
+               recorder->write_us / ((recorder->written + RECORDER_CHUNK_SIZE - 1) / RECORDER_CHUNK_SIZE + (recorder->written == 0)));
+
+    myfree(SRAMEX, recorder->buffer[0]);
+    myfree(SRAMEX, recorder->buffer[1]);
+    recorder->buffer[0] = NULL;
+    recorder->buffer[1] = NULL;
+
+    if(recorder->state == RECORDER_ERROR)
+    {
+        recorder->state = RECORDER_IDLE;
+        return FR_DISK_ERR;
+    }
+    recorder->state = RECORDER_IDLE;
+
+    return request.fresult;
+}
+
+/*!
+    \brief      hand the filled half to the recorder task and switch halves
+    \param[in]  recorder: recorder
+    \param[out] none
+    \retval     none
+*/
+static void recorder_submit(recorder_struct *recorder)
+{
+    recorder_job_struct job;
+
+    job.recorder = recorder;
+    job.half = recorder->fill;
+    job.length = recorder->used;
+
+    recorder->busy[recorder->fill] = 1;
+    xQueueSend(recorder_queue, &job, portMAX_DELAY);    /* two jobs per recorder at most, never waits */
+
+    recorder->fill ^= 1;
+    recorder->used = 0;
+}
+
+/*!
+    \brief      recorder task, writes full halves to the preallocated sectors
+    \param[in]  pvParameters: not used
+    \param[out] none
+    \retval     none
+*/
+static void recorder_task(void *pvParameters)
+{
+    recorder_job_struct job;
+    recorder_struct *recorder;
+    emmc_error_enum status;
+    uint32_t sectors, cycles;
+
+    (void)pvParameters;
+
+    while(1)
+    {
+        xQueueReceive(recorder_queue, &job, portMAX_DELAY);
+        recorder = job.recorder;
+
+        if(recorder->state != RECORDER_ERROR)
+        {
+            /* the last chunk is padded to a whole sector, the size is cut by recorder_stop */
+            sectors = (job.length + BLOCK_CACHE_SECTOR_SIZE - 1) / BLOCK_CACHE_SECTOR_SIZE;
+            memset(recorder->buffer[job.half] + job.length, 0x00, sectors * BLOCK_CACHE_SECTOR_SIZE - job.length);
+
+            cycles = DWT_CYCCNT;
+            status = block_cache_write(BLOCK_CACHE_OWNER_FATFS, recorder->buffer[job.half],
+                                       recorder->sector + recorder->written / BLOCK_CACHE_SECTOR_SIZE, sectors);
+            cycles = (DWT_CYCCNT - cycles) / (SystemCoreClock / 1000000);
+
+            if(status == EMMC_OK)
+            {
+                recorder->written += job.length;
+                recorder->write_us += cycles;
+                if(cycles > recorder->max_write_us)recorder->max_write_us = cycles;
+            }
+            else
+            {
+                recorder->error = status;
+                recorder->state = RECORDER_ERROR;
+                PRINT_ERROR("recorder %s: emmc write failed(%d)\r\n", recorder->path, status);
+            }
+        }
+
+        recorder->busy[job.half] = 0;
+    }
+}
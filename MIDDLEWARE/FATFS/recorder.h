@@ -0,0 +1,79 @@
+/*!
+    \file       recorder.h
+    \brief      High-rate stream recorder to preallocated eMMC files header file
+    \version    1.0
+    \date       2025-08-31
+    \author     Ze-Hou
+    \note       recorder_start creates the file on contiguous clusters (f_expand)
+                through the storage task, the data then bypasses FatFs: the
+                producer fills one half of a double buffer while the recorder
+                task writes the other half as one multi-block transfer with
+                block_cache_write. recorder_stop writes the last partial chunk
+                and truncates the file to the bytes recorded.
+                Throughput: a chunk is dropped only when the producer fills a
+                half before the previous half is on the eMMC, so a stream of R
+                bytes/s records without drops while
+                    RECORDER_CHUNK_SIZE / R (fill time of a half) > max_write_us
+                max_write_us and the sustained rate (speed) of each recording are
+                logged by recorder_stop, emmc_speed_test logs the raw
+                sequential write speed at boot. At 1 MB/s (UART at 10 Mbaud,
+                a busy CAN FD bus) a 64KB half fills in 64ms, power capture is
+                far slower; a 64KB write at a sequential speed of W KB/s takes
+                64000 / W ms, so any card above 10 MB/s keeps a 10x margin.
+                The recorded area is written behind FatFs: until recorder_stop
+                the directory entry holds the preallocated size, after a power
+                failure the tail of the file holds stale data.
+*/
+
+#ifndef __RECORDER_H
+#define __RECORDER_H
+#include <stdint.h>
+#include "./FATFS/fatfs_config.h"
+#include "./SDIO/sdio_emmc.h"
+
+/* recorder configuration */
+#define RECORDER_TASK_PRIO          3                       /*!< above the storage task, data must leave the buffers quickly */
+#define RECORDER_STK_SIZE           512                     /*!< recorder task stack size */
+#define RECORDER_CHUNK_SIZE         (64 * 1024)             /*!< bytes per buffer half (SDRAM), multiple of 512 */
+#define RECORDER_NUM_MAX            4                       /*!< recordings running at the same time */
+
+/*!
+    \brief      Recorder state enumeration
+*/
+typedef enum
+{
+    RECORDER_IDLE = 0,                                  /*!< (0) Not started or stopped */
+    RECORDER_RUNNING,                                   /*!< (1) Accepting data */
+    RECORDER_FULL,                                      /*!< (2) Preallocated size reached, data is dropped */
+    RECORDER_ERROR,                                     /*!< (3) eMMC write failed, data is dropped */
+}recorder_state_enum;
+
+/*!
+    \brief      Recorder structure, zero-initialise it once and keep it valid until recorder_stop returns
+*/
+typedef struct
+{
+    char path[FF_LFN_BUF + 1];                          /*!< Recorded file */
+    uint8_t *buffer[2];                                 /*!< Double buffer halves */
+    volatile uint8_t busy[2];                           /*!< 1: half is queued or being written */
+    uint8_t fill;                                       /*!< Half the producer fills */
+    uint32_t used;                                      /*!< Bytes in the half being filled */
+    uint32_t sector;                                    /*!< First sector of the file */
+    uint32_t capacity;                                  /*!< Preallocated bytes */
+    uint32_t accepted;                                  /*!< Bytes taken by recorder_write */
+    volatile uint32_t written;                          /*!< Bytes on the eMMC */
+    uint32_t dropped;                                   /*!< Bytes refused (buffer busy, full or error) */
+    uint32_t start_tick;                                /*!< Start time */
+    uint32_t write_us;                                  /*!< Total chunk write time */
+    uint32_t max_write_us;                              /*!< Longest chunk write */
+    uint32_t speed;                                     /*!< Sustained rate of the recording (KB/s), set by recorder_stop */
+    volatile recorder_state_enum state;                 /*!< recorder_state_enum */
+    emmc_error_enum error;                              /*!< eMMC status of the failed write */
+}recorder_struct;
+
+/* function declarations */
+int recorder_init(void);                                                        /* create the recorder task */
+FRESULT recorder_start(recorder_struct *recorder, const char *path, uint32_t size);  /* preallocate size bytes and start */
+uint32_t recorder_write(recorder_struct *recorder, const void *data, uint32_t length); /* append data, never blocks */
+FRESULT recorder_stop(recorder_struct *recorder);                              /* write the rest and set the file size */
+#endif /* __RECORDER_H */
@@ -11,6 +11,7 @@
 #include "./MALLOC/malloc.h"
 #include "./USART/usart.h"
 #include "./SDIO/sdio_emmc.h"
+#include "./FATFS/block_cache.h"
 
 #define EMMC_CARD     0       /* eMMC card, device number is 0 */
 
@@ -45,6 +46,7 @@ DSTATUS disk_initialize (
             if(emmc_info.emmc_init_state !=0xAA)
             {
                 res = emmc_init();          /* eMMC card initialization */
+                block_cache_invalidate();   /* cached sectors belong to the previous session */
             }
             break;
 
@@ -86,7 +88,7 @@ DRESULT disk_read (
     switch (pdrv)
     {
         case EMMC_CARD:       /* eMMC card */
-            res = emmc_read_disk((uint32_t *)buff, sector, count);
+            res = block_cache_read(BLOCK_CACHE_OWNER_FATFS, buff, sector, count);
             break;
 
         default:
@@ -127,7 +129,7 @@ DRESULT disk_write (
     switch (pdrv)
     {
         case EMMC_CARD:       /* eMMC card */
-            res = emmc_write_disk((uint32_t *)buff, sector, count);
+            res = block_cache_write(BLOCK_CACHE_OWNER_FATFS, buff, sector, count);
             break;
         default:
             res = 1;
@@ -164,8 +166,8 @@ DRESULT disk_ioctl (
     {
         switch (cmd)
         {
-            case CTRL_SYNC:
-                res = RES_OK;
+            case CTRL_SYNC:                 /* block cache is write-through, only the eMMC write cache is flushed */
+                res = (block_cache_flush() == EMMC_OK) ? RES_OK : RES_ERROR;
                 break;
 
             case GET_SECTOR_SIZE:
@@ -173,8 +175,8 @@ DRESULT disk_ioctl (
                 res = RES_OK;
                 break;
 
-            case GET_BLOCK_SIZE:
-                *(WORD *)buff = (((uint8_t)(emmc_info.csd[1] >> 10) & 0x1F) + 1) * (((uint8_t)(emmc_info.csd[1] >> 5) & 0x1F) + 1);
+            case GET_BLOCK_SIZE:            /* erase group in sectors, f_mkfs aligns the data area to it */
+                *(DWORD *)buff = emmc_info.erase_group;
                 res = RES_OK;
                 break;
 
@@ -183,6 +185,10 @@ DRESULT disk_ioctl (
                 res = RES_OK;
                 break;
 
+            case CTRL_TRIM:                 /* buff: first and last sector of the freed range */
+                res = (block_cache_trim(((LBA_t *)buff)[0], ((LBA_t *)buff)[1] - ((LBA_t *)buff)[0] + 1) == EMMC_OK) ? RES_OK : RES_ERROR;
+                break;
+
             default:
                 res = RES_PARERR;
                 break;
@@ -1,5 +1,6 @@
 #include "./MALLOC/malloc.h"
 #include "ff.h"
+#include "task.h"
 
 
 /**
@@ -36,19 +37,60 @@ void ff_memfree (void* mf)
     myfree(SRAMIN, mf);
 }
 
+#if FF_FS_REENTRANT
+/*!
+    \brief      create the volume lock, called by f_mount
+    \param[in]  vol: volume number
+    \param[out] sobj: created mutex
+    \retval     1: created, 0: out of memory
+*/
+int ff_cre_syncobj (BYTE vol, FF_SYNC_t* sobj)
+{
+    (void)vol;
 
+    *sobj = xSemaphoreCreateMutex();
 
+    return (*sobj != NULL);
+}
 
+/*!
+    \brief      take the volume lock
+    \param[in]  sobj: volume mutex
+    \param[out] none
+    \retval     1: taken, 0: FF_FS_TIMEOUT ticks elapsed (FR_TIMEOUT)
+    \note       before the scheduler starts main is the only context, the
+                lock is not taken
+*/
+int ff_req_grant (FF_SYNC_t sobj)
+{
+    if(xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED)return 1;
 
+    return (xSemaphoreTake(sobj, FF_FS_TIMEOUT) == pdTRUE);
+}
 
+/*!
+    \brief      give the volume lock
+    \param[in]  sobj: volume mutex
+    \param[out] none
+    \retval     none
+*/
+void ff_rel_grant (FF_SYNC_t sobj)
+{
+    if(xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED)return;
 
+    xSemaphoreGive(sobj);
+}
 
+/*!
+    \brief      delete the volume lock, called by f_mount / f_unmount
+    \param[in]  sobj: volume mutex
+    \param[out] none
+    \retval     1
+*/
+int ff_del_syncobj (FF_SYNC_t sobj)
+{
+    vSemaphoreDelete(sobj);
 
-
-
-
-
-
-
-
-
+    return 1;
+}
+#endif
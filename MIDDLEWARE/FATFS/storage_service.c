@@ -0,0 +1,672 @@
+/*!
+    \file       storage_service.c
+    \brief      Asynchronous file system service task implementation file
+    \version    1.0
+    \date       2025-08-28
+    \author     Ze-Hou
+*/
+
+#include "./FATFS/storage_service.h"
+#include "./FATFS/block_cache.h"
+#include "./FATFS/file_index.h"
+#include "./MALLOC/malloc.h"
+#include "./USART/usart.h"
+#include "task.h"
+#include "queue.h"
+#include <string.h>
+
+#define STORAGE_SERVICE_IDLE_MS     1000                    /* kept-open file and directory are closed after this idle time */
+
+/*!
+    \brief      Service control structure
+*/
+typedef struct
+{
+    QueueHandle_t queue[STORAGE_PRIO_NUM];              /*!< Pending requests per priority */
+    SemaphoreHandle_t pending;                          /*!< Counts requests in all queues */
+    TaskHandle_t task;                                  /*!< Storage task */
+    uint8_t *copy_buffer;                               /*!< Default copy buffer in SDRAM */
+    FIL *file;                                          /*!< Kept-open file of the last read */
+    char file_path[FF_LFN_BUF + 1];                     /*!< Path of the kept-open file */
+    uint32_t file_generation;                           /*!< Block cache generation when it was opened */
+    DIR *dir;                                           /*!< Kept-open directory of the last listing */
+    char dir_path[FF_LFN_BUF + 1];                      /*!< Path of the kept-open directory */
+    uint32_t dir_index;                                 /*!< Next entry the directory returns */
+}storage_service_struct;
+
+storage_service_info_struct storage_service_info;
+static storage_service_struct storage_service;
+
+/* static function declarations */
+static void storage_service_task(void *pvParameters);
+static int storage_service_queue(storage_request_struct *request, SemaphoreHandle_t done);
+static storage_request_struct *storage_service_next(uint8_t prio_limit, uint8_t allow_copy);
+static void storage_service_execute(storage_request_struct *request);
+static void storage_service_finish(storage_request_struct *request);
+static uint8_t storage_service_direct(void);
+static void storage_service_close(void);
+static FRESULT storage_service_read(storage_request_struct *request);
+static FRESULT storage_service_write(storage_request_struct *request);
+static FRESULT storage_service_readdir(storage_request_struct *request);
+static FRESULT storage_service_copy(storage_request_struct *request);
+static FRESULT storage_service_expand(storage_request_struct *request);
+static FRESULT storage_service_truncate(storage_request_struct *request);
+
+/*!
+    \brief      create the queues and the storage task
+    \param[in]  none
+    \param[out] none
+    \retval     0: success, -1: out of memory, requests are then executed by the caller
+    \note       call before the scheduler starts, after the volume is mounted
+*/
+int storage_service_init(void)
+{
+    uint8_t i;
+
+    memset(&storage_service, 0x00, sizeof(storage_service));
+    memset(&storage_service_info, 0x00, sizeof(storage_service_info));
+
+    for(i = 0; i < STORAGE_PRIO_NUM; i++)
+    {
+        storage_service.queue[i] = xQueueCreate(STORAGE_SERVICE_QUEUE_LEN, sizeof(storage_request_struct *));
+    }
+    storage_service.pending = xSemaphoreCreateCounting(STORAGE_SERVICE_QUEUE_LEN * STORAGE_PRIO_NUM, 0);
+    storage_service.copy_buffer = (uint8_t *)mymalloc(SRAMEX, STORAGE_SERVICE_COPY_SIZE);
+    storage_service.file = (FIL *)mymalloc(SRAMIN, sizeof(FIL));
+    storage_service.dir = (DIR *)mymalloc(SRAMIN, sizeof(DIR));
+
+    if((storage_service.queue[STORAGE_PRIO_HIGH] == NULL) || (storage_service.queue[STORAGE_PRIO_NORMAL] == NULL) ||
+       (storage_service.queue[STORAGE_PRIO_LOW] == NULL) || (storage_service.pending == NULL) ||
+       (storage_service.copy_buffer == NULL) || (storage_service.file == NULL) || (storage_service.dir == NULL) ||
+       (xTaskCreate((TaskFunction_t)storage_service_task, "storage_task", STORAGE_SERVICE_STK_SIZE, NULL,
+                    STORAGE_SERVICE_TASK_PRIO, &storage_service.task) != pdPASS))
+    {
+        PRINT_ERROR("storage service disabled, out of memory\r\n");
+        storage_service.task = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+/*!
+    \brief      queue a request, returns at once
+    \param[in]  request: filled in request, state is set to STORAGE_QUEUED
+    \param[out] none
+    \retval     0: queued or already executed, -1: queue full
+    \note       before the scheduler starts, from the storage task itself (a
+                callback) or without the service the request runs right away
+*/
+int storage_service_submit(storage_request_struct *request)
+{
+    return storage_service_queue(request, NULL);
+}
+
+/*!
+    \brief      queue a request with its waiter semaphore
+    \param[in]  request: filled in request
+    \param[in]  done: semaphore given on completion, NULL: none
+    \param[out] none
+    \retval     0: queued or already executed, -1: queue full
+    \note       done is always written, a stale handle left in a reused or
+                stack request is never given
+*/
+static int storage_service_queue(storage_request_struct *request, SemaphoreHandle_t done)
+{
+    if(request->prio >= STORAGE_PRIO_NUM)request->prio = STORAGE_PRIO_LOW;
+
+    request->done = done;
+    request->state = STORAGE_QUEUED;
+    request->result = 0;
+    request->tick = xTaskGetTickCount();
+
+    if(storage_service_direct())
+    {
+        storage_service_execute(request);
+        storage_service_finish(request);
+        return 0;
+    }
+
+    if(xQueueSend(storage_service.queue[request->prio], &request, 0) != pdPASS)
+    {
+        request->state = STORAGE_IDLE;
+        return -1;
+    }
+    xSemaphoreGive(storage_service.pending);
+
+    return 0;
+}
+
+/*!
+    \brief      queue a request and wait for it
+    \param[in]  request: filled in request
+    \param[out] none
+    \retval     FatFs result of the request
+*/
+FRESULT storage_service_run(storage_request_struct *request)
+{
+    SemaphoreHandle_t done;
+
+    if(storage_service_direct())
+    {
+        storage_service_submit(request);
+        return request->fresult;
+    }
+
+    done = xSemaphoreCreateBinary();
+    if(done == NULL)
+    {
+        PRINT_WARN("storage: no semaphore, request is polled\r\n");
+    }
+    while(storage_service_queue(request, done) != 0)
+    {
+        vTaskDelay(1);                                  /* queue full, let the storage task catch up */
+    }
+    storage_service_wait(request);                      /* done NULL: polls the state */
+    request->done = NULL;
+    if(done != NULL)
+    {
+        vSemaphoreDelete(done);
+    }
+
+    return request->fresult;
+}
+
+/*!
+    \brief      wait for a submitted request
+    \param[in]  request: submitted request
+    \param[out] none
+    \retval     FatFs result of the request
+*/
+FRESULT storage_service_wait(storage_request_struct *request)
+{
+    if(request->state == STORAGE_IDLE)return request->fresult;
+
+    if(request->done != NULL)
+    {
+        xSemaphoreTake(request->done, portMAX_DELAY);
+    }
+    while(request->state != STORAGE_DONE)
+    {
+        vTaskDelay(1);
+    }
+
+    return request->fresult;
+}
+
+/*!
+    \brief      storage task, serves the queues from high to low priority
+    \param[in]  pvParameters: not used
+    \param[out] none
+    \retval     none
+*/
+static void storage_service_task(void *pvParameters)
+{
+    storage_request_struct *request;
+
+    (void)pvParameters;
+
+    while(1)
+    {
+        if(xSemaphoreTake(storage_service.pending, file_index_busy() ? 0 : pdMS_TO_TICKS(STORAGE_SERVICE_IDLE_MS)) != pdTRUE)
+        {
+            if(!file_index_busy())
+            {
+                storage_service_close();                /* idle: do not hold files open behind the user's back */
+            }
+            file_index_service();                       /* index rebuild steps run only while no request waits */
+            continue;
+        }
+
+        request = storage_service_next(STORAGE_PRIO_NUM, 1);
+        if(request != NULL)
+        {
+            storage_service_execute(request);
+            storage_service_finish(request);
+        }
+    }
+}
+
+/*!
+    \brief      take the most urgent queued request
+    \param[in]  prio_limit: only priorities below this value are served
+    \param[in]  allow_copy: 0 leaves copy requests queued
+    \param[out] none
+    \retval     request, NULL when nothing matches
+    \note       the caller accounts for the pending semaphore
+*/
+static storage_request_struct *storage_service_next(uint8_t prio_limit, uint8_t allow_copy)
+{
+    uint8_t i;
+    storage_request_struct *request;
+
+    for(i = 0; i < prio_limit; i++)
+    {
+        if(xQueuePeek(storage_service.queue[i], &request, 0) != pdPASS)continue;
+        if(!allow_copy && (request->op == STORAGE_OP_COPY))return NULL;
+
+        xQueueReceive(storage_service.queue[i], &request, 0);
+        return request;
+    }
+
+    return NULL;
+}
+
+/*!
+    \brief      execute a request in the calling context
+    \param[in]  request: request to execute
+    \param[out] none
+    \retval     none
+*/
+static void storage_service_execute(storage_request_struct *request)
+{
+    DWORD free_clust;
+    FATFS *fs;
+
+    switch(request->op)
+    {
+        case STORAGE_OP_READ:
+            request->fresult = storage_service_read(request);
+            break;
+
+        case STORAGE_OP_WRITE:
+            request->fresult = storage_service_write(request);
+            break;
+
+        case STORAGE_OP_STAT:
+            request->fresult = f_stat(request->path, (FILINFO *)request->buffer);
+            break;
+
+        case STORAGE_OP_READDIR:
+            request->fresult = storage_service_readdir(request);
+            break;
+
+        case STORAGE_OP_COPY:
+            request->fresult = storage_service_copy(request);
+            break;
+
+        case STORAGE_OP_GETFREE:
+            request->fresult = f_getfree(request->path, &free_clust, &fs);
+            request->result = free_clust;
+            break;
+
+        case STORAGE_OP_EXPAND:
+            request->fresult = storage_service_expand(request);
+            break;
+
+        case STORAGE_OP_TRUNCATE:
+            request->fresult = storage_service_truncate(request);
+            break;
+
+        case STORAGE_OP_INDEX:
+            file_index_update(request->path);
+            request->fresult = FR_OK;
+            break;
+
+        default:
+            request->fresult = FR_INVALID_PARAMETER;
+            break;
+    }
+}
+
+/*!
+    \brief      complete a request: statistics, state, waiter and callback
+    \param[in]  request: executed request
+    \param[out] none
+    \retval     none
+    \note       the request may be reused or freed by its owner as soon as
+                the state is STORAGE_DONE, so everything needed is saved first
+*/
+static void storage_service_finish(storage_request_struct *request)
+{
+    uint32_t wait_ms = (xTaskGetTickCount() - request->tick) * portTICK_PERIOD_MS;
+    uint8_t prio = request->prio;
+    storage_service_cb callback = request->callback;
+    SemaphoreHandle_t done = request->done;
+
+    storage_service_info.served[prio]++;
+    if(wait_ms > storage_service_info.max_wait_ms[prio])storage_service_info.max_wait_ms[prio] = wait_ms;
+
+    if(callback != NULL)
+    {
+        callback(request);
+    }
+    request->state = STORAGE_DONE;
+    if(done != NULL)
+    {
+        xSemaphoreGive(done);
+    }
+}
+
+/*!
+    \brief      check whether requests must run in the caller's context
+    \param[in]  none
+    \param[out] none
+    \retval     1: run directly, 0: queue to the storage task
+*/
+static uint8_t storage_service_direct(void)
+{
+    return (storage_service.task == NULL) || (xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED) ||
+           (xTaskGetCurrentTaskHandle() == storage_service.task);
+}
+
+/*!
+    \brief      close the kept-open file and directory
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void storage_service_close(void)
+{
+    if(storage_service.file_path[0])
+    {
+        f_close(storage_service.file);
+        storage_service.file_path[0] = '\0';
+    }
+    if(storage_service.dir_path[0])
+    {
+        f_closedir(storage_service.dir);
+        storage_service.dir_path[0] = '\0';
+    }
+}
+
+/*!
+    \brief      read part of a file
+    \param[in]  request: STORAGE_OP_READ request
+    \param[out] none
+    \retval     FatFs result
+    \note       the file stays open for the next read of the same path, e.g.
+                the chunks of a firmware image during programming; a host
+                write through USB mass storage forces a reopen
+*/
+static FRESULT storage_service_read(storage_request_struct *request)
+{
+    FRESULT fresult;
+    UINT read_bytes = 0;
+    FIL *file = storage_service.file;
+
+    if(storage_service.task == NULL)                    /* no service: plain open, read, close */
+    {
+        file = (FIL *)mymalloc(SRAMIN, sizeof(FIL));
+        if(file == NULL)return FR_NOT_ENOUGH_CORE;
+
+        fresult = f_open(file, request->path, FA_READ);
+        if(fresult == FR_OK)
+        {
+            fresult = f_lseek(file, request->offset);
+            if(fresult == FR_OK)fresult = f_read(file, request->buffer, request->size, &read_bytes);
+            f_close(file);
+        }
+        myfree(SRAMIN, file);
+        request->result = read_bytes;
+        return fresult;
+    }
+
+    if(storage_service.file_path[0] && (strcmp(storage_service.file_path, request->path) == 0) &&
+       (storage_service.file_generation == block_cache_info.generation))
+    {
+        storage_service_info.open_hit++;
+    }
+    else
+    {
+        if(storage_service.file_path[0])
+        {
+            f_close(file);
+            storage_service.file_path[0] = '\0';
+        }
+        fresult = f_open(file, request->path, FA_READ);
+        if(fresult != FR_OK)return fresult;
+
+        strncpy(storage_service.file_path, request->path, FF_LFN_BUF);
+        storage_service.file_path[FF_LFN_BUF] = '\0';
+        storage_service.file_generation = block_cache_info.generation;
+    }
+
+    fresult = f_lseek(file, request->offset);
+    if(fresult == FR_OK)
+    {
+        fresult = f_read(file, request->buffer, request->size, &read_bytes);
+    }
+    request->result = read_bytes;
+
+    return fresult;
+}
+
+/*!
+    \brief      write part of a file, creating it if missing
+    \param[in]  request: STORAGE_OP_WRITE request, offset STORAGE_OFFSET_APPEND appends
+    \param[out] none
+    \retval     FatFs result
+*/
+static FRESULT storage_service_write(storage_request_struct *request)
+{
+    FRESULT fresult;
+    UINT write_bytes = 0;
+    FIL *file;
+
+    storage_service_close();                            /* the kept-open file may be the one being changed */
+
+    file = (FIL *)mymalloc(SRAMIN, sizeof(FIL));
+    if(file == NULL)return FR_NOT_ENOUGH_CORE;
+
+    fresult = f_open(file, request->path, FA_WRITE | FA_OPEN_ALWAYS);
+    if(fresult == FR_OK)
+    {
+        fresult = f_lseek(file, (request->offset == STORAGE_OFFSET_APPEND) ? f_size(file) : request->offset);
+        if(fresult == FR_OK)
+        {
+            fresult = f_write(file, request->buffer, request->size, &write_bytes);
+        }
+        if(f_close(file) != FR_OK && fresult == FR_OK)
+        {
+            fresult = FR_DISK_ERR;
+        }
+        file_index_update(request->path);
+    }
+    myfree(SRAMIN, file);
+    request->result = write_bytes;
+
+    return fresult;
+}
+
+/*!
+    \brief      list part of a directory
+    \param[in]  request: STORAGE_OP_READDIR request, buffer holds size FILINFO
+    \param[out] none
+    \retval     FatFs result, result is the number of entries, fewer than size at the end
+    \note       a request continuing where the last one stopped reuses the
+                open directory, so paging through a folder stays linear
+*/
+static FRESULT storage_service_readdir(storage_request_struct *request)
+{
+    FRESULT fresult = FR_OK;
+    FILINFO *fileinfo = (FILINFO *)request->buffer;
+    DIR *dir = storage_service.dir;
+    uint32_t count = 0;
+
+    if(storage_service.task == NULL)                    /* no service: nothing is kept open */
+    {
+        dir = (DIR *)mymalloc(SRAMIN, sizeof(DIR));
+        if(dir == NULL)return FR_NOT_ENOUGH_CORE;
+        storage_service.dir_path[0] = '\0';
+    }
+
+    if(!storage_service.dir_path[0] || (strcmp(storage_service.dir_path, request->path) != 0) ||
+       (storage_service.dir_index != request->offset))
+    {
+        if(storage_service.dir_path[0])
+        {
+            f_closedir(dir);
+            storage_service.dir_path[0] = '\0';
+        }
+        fresult = f_opendir(dir, request->path);
+
+        /* skip to the first requested entry */
+        for(storage_service.dir_index = 0; (fresult == FR_OK) && (storage_service.dir_index < request->offset); storage_service.dir_index++)
+        {
+            fresult = f_readdir(dir, &fileinfo[0]);
+            if(fileinfo[0].fname[0] == 0)break;
+        }
+        if(fresult == FR_OK)
+        {
+            strncpy(storage_service.dir_path, request->path, FF_LFN_BUF);
+            storage_service.dir_path[FF_LFN_BUF] = '\0';
+        }
+    }
+
+    while((fresult == FR_OK) && (count < request->size) && (storage_service.dir_index == request->offset + count))
+    {
+        fresult = f_readdir(dir, &fileinfo[count]);
+        if((fresult != FR_OK) || (fileinfo[count].fname[0] == 0))break;
+        count++;
+        storage_service.dir_index++;
+    }
+    request->result = count;
+
+    if(storage_service.dir_path[0] && ((count < request->size) || (storage_service.task == NULL)))     /* end of directory */
+    {
+        f_closedir(dir);
+        storage_service.dir_path[0] = '\0';
+    }
+    if(storage_service.task == NULL)
+    {
+        myfree(SRAMIN, dir);
+    }
+
+    return fresult;
+}
+
+/*!
+    \brief      copy a file
+    \param[in]  request: STORAGE_OP_COPY request, path to path2
+    \param[out] none
+    \retval     FatFs result, result is the number of bytes copied
+    \note       queued higher priority requests (other than copies) are
+                served between chunks, so a long copy does not hold up
+                programming reads or the user interface
+*/
+static FRESULT storage_service_copy(storage_request_struct *request)
+{
+    FRESULT fresult;
+    UINT read_bytes, write_bytes;
+    FIL *src, *dst;
+    uint8_t *buffer = (request->buffer != NULL) ? (uint8_t *)request->buffer : storage_service.copy_buffer;
+    uint32_t size = (request->buffer != NULL) ? request->size : STORAGE_SERVICE_COPY_SIZE;
+    storage_request_struct *urgent;
+
+    if((buffer == NULL) || (size == 0))return FR_INVALID_PARAMETER;
+
+    storage_service_close();
+
+    src = (FIL *)mymalloc(SRAMIN, sizeof(FIL));
+    dst = (FIL *)mymalloc(SRAMIN, sizeof(FIL));
+    if((src == NULL) || (dst == NULL))
+    {
+        myfree(SRAMIN, src);
+        myfree(SRAMIN, dst);
+        return FR_NOT_ENOUGH_CORE;
+    }
+
+    fresult = f_open(src, request->path, FA_READ);
+    if(fresult == FR_OK)
+    {
+        fresult = f_open(dst, request->path2, FA_WRITE | FA_CREATE_ALWAYS);
+        if(fresult == FR_OK)
+        {
+            while(1)
+            {
+                fresult = f_read(src, buffer, size, &read_bytes);
+                if((fresult != FR_OK) || (read_bytes == 0))break;
+                fresult = f_write(dst, buffer, read_bytes, &write_bytes);
+                request->result += write_bytes;
+                if((fresult == FR_OK) && (write_bytes != read_bytes))fresult = FR_DENIED;   /* volume full */
+                if((fresult != FR_OK) || (read_bytes < size))break;
+
+                if(xTaskGetCurrentTaskHandle() == storage_service.task)
+                {
+                    while((urgent = storage_service_next(request->prio, 0)) != NULL)
+                    {
+                        xSemaphoreTake(storage_service.pending, 0);
+                        storage_service_execute(urgent);
+                        storage_service_finish(urgent);
+                    }
+                }
+            }
+            if((f_close(dst) != FR_OK) && (fresult == FR_OK))fresult = FR_DISK_ERR;
+            file_index_update(request->path2);
+        }
+        f_close(src);
+    }
+
+    myfree(SRAMIN, src);
+    myfree(SRAMIN, dst);
+
+    return fresult;
+}
+
+/*!
+    \brief      create a file on contiguous clusters
+    \param[in]  request: STORAGE_OP_EXPAND request, size is the file size
+    \param[out] none
+    \retval     FatFs result, FR_DENIED when no contiguous free area is large enough
+    \note       result is the first sector of the file, the data area can then
+                be written with block_cache_write without FatFs; the file
+                keeps the full size until it is truncated
+*/
+static FRESULT storage_service_expand(storage_request_struct *request)
+{
+    FRESULT fresult;
+    FIL *file;
+
+    storage_service_close();
+
+    file = (FIL *)mymalloc(SRAMIN, sizeof(FIL));
+    if(file == NULL)return FR_NOT_ENOUGH_CORE;
+
+    fresult = f_open(file, request->path, FA_WRITE | FA_CREATE_ALWAYS);
+    if(fresult == FR_OK)
+    {
+        fresult = f_expand(file, request->size, 1);
+        if(fresult == FR_OK)
+        {
+            request->result = file->obj.fs->database + (file->obj.sclust - 2) * file->obj.fs->csize;
+        }
+        if((f_close(file) != FR_OK) && (fresult == FR_OK))fresult = FR_DISK_ERR;
+        if(fresult != FR_OK)
+        {
+            f_unlink(request->path);
+        }
+    }
+    myfree(SRAMIN, file);
+
+    return fresult;
+}
+
+/*!
+    \brief      cut a file
+    \param[in]  request: STORAGE_OP_TRUNCATE request, offset is the new size
+    \param[out] none
+    \retval     FatFs result
+*/
+static FRESULT storage_service_truncate(storage_request_struct *request)
+{
+    FRESULT fresult;
+    FIL *file;
+
+    storage_service_close();
+
+    file = (FIL *)mymalloc(SRAMIN, sizeof(FIL));
+    if(file == NULL)return FR_NOT_ENOUGH_CORE;
+
+    fresult = f_open(file, request->path, FA_WRITE | FA_OPEN_EXISTING);
+    if(fresult == FR_OK)
+    {
+        fresult = f_lseek(file, request->offset);
+        if(fresult == FR_OK)fresult = f_truncate(file);
+        if((f_close(file) != FR_OK) && (fresult == FR_OK))fresult = FR_DISK_ERR;
+        file_index_update(request->path);
+    }
+    myfree(SRAMIN, file);
+
+    return fresult;
+}
@@ -0,0 +1,115 @@
+/*!
+    \file       storage_service.h
+    \brief      Asynchronous file system service task header file
+    \version    1.0
+    \date       2025-08-28
+    \author     Ze-Hou
+    \note       FatFs is built with FF_FS_REENTRANT 1 (volume mutex in
+                ffsystem.c), so direct f_* calls from other tasks stay safe;
+                the service orders and prioritises the long operations: tasks
+                hand it request structures and either wait for them
+                (storage_service_run) or get a callback / poll the state
+                (storage_service_submit).
+                The request, its path strings and buffers must stay valid
+                until the state is STORAGE_DONE. Callbacks run in the storage
+                task before the state changes to STORAGE_DONE, they must not
+                call LVGL or resubmit the same request.
+*/
+
+#ifndef __STORAGE_SERVICE_H
+#define __STORAGE_SERVICE_H
+#include <stdint.h>
+#include "./FATFS/fatfs_config.h"
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+/* service configuration */
+#define STORAGE_SERVICE_TASK_PRIO   2                       /*!< above the debugger download task, below LVGL */
+#define STORAGE_SERVICE_STK_SIZE    1024                    /*!< storage task stack size */
+#define STORAGE_SERVICE_QUEUE_LEN   8                       /*!< requests per priority */
+#define STORAGE_SERVICE_COPY_SIZE   (32 * 1024)             /*!< copy chunk (SDRAM), higher priority requests run between chunks */
+#define STORAGE_OFFSET_APPEND       0xFFFFFFFFU             /*!< write offset: end of file */
+
+/*!
+    \brief      Request operation enumeration
+*/
+typedef enum
+{
+    STORAGE_OP_READ = 0,                                /*!< (0) Read size bytes at offset into buffer */
+    STORAGE_OP_WRITE,                                   /*!< (1) Write size bytes at offset, the file is created if missing */
+    STORAGE_OP_STAT,                                    /*!< (2) FILINFO of path into buffer */
+    STORAGE_OP_READDIR,                                 /*!< (3) Up to size FILINFO entries starting at entry offset */
+    STORAGE_OP_COPY,                                    /*!< (4) Copy path to path2 */
+    STORAGE_OP_GETFREE,                                 /*!< (5) Free clusters of the volume path */
+    STORAGE_OP_EXPAND,                                  /*!< (6) Create path with size bytes of contiguous clusters, result is its first sector */
+    STORAGE_OP_TRUNCATE,                                /*!< (7) Cut path to offset bytes and free the clusters behind */
+    STORAGE_OP_INDEX,                                   /*!< (8) Refresh the file index entry of path after it changed */
+}storage_op_enum;
+
+/*!
+    \brief      Request priority enumeration
+*/
+typedef enum
+{
+    STORAGE_PRIO_HIGH = 0,                              /*!< (0) Target programming */
+    STORAGE_PRIO_NORMAL,                                /*!< (1) User interface */
+    STORAGE_PRIO_LOW,                                   /*!< (2) Background copies and scans */
+    STORAGE_PRIO_NUM,
+}storage_prio_enum;
+
+/*!
+    \brief      Request state enumeration
+*/
+typedef enum
+{
+    STORAGE_IDLE = 0,                                   /*!< (0) Not submitted */
+    STORAGE_QUEUED,                                     /*!< (1) Waiting for or being served by the storage task */
+    STORAGE_DONE,                                       /*!< (2) Finished, fresult and result are valid */
+}storage_state_enum;
+
+typedef struct storage_request storage_request_struct;
+
+/*!
+    \brief      Request completion callback, called in the storage task
+*/
+typedef void (*storage_service_cb)(storage_request_struct *request);
+
+/*!
+    \brief      Storage request structure
+*/
+struct storage_request
+{
+    storage_op_enum op;                                 /*!< Operation */
+    storage_prio_enum prio;                             /*!< Queue the request is served from */
+    const char *path;                                   /*!< File, directory or volume */
+    const char *path2;                                  /*!< Copy destination */
+    void *buffer;                                       /*!< Data, FILINFO or FILINFO array; NULL for copy uses the service buffer */
+    uint32_t offset;                                    /*!< File offset or first directory entry */
+    uint32_t size;                                      /*!< Bytes, maximum directory entries or copy buffer size */
+    uint32_t result;                                    /*!< Bytes transferred, entries returned or free clusters */
+    FRESULT fresult;                                    /*!< FatFs result */
+    volatile storage_state_enum state;                  /*!< storage_state_enum */
+    storage_service_cb callback;                        /*!< Completion callback, may be NULL */
+    void *user;                                         /*!< Caller context for the callback */
+    SemaphoreHandle_t done;                             /*!< Internal, given when a waited request finishes */
+    uint32_t tick;                                      /*!< Internal, submit time */
+};
+
+/*!
+    \brief      Service statistics structure
+*/
+typedef struct
+{
+    uint32_t served[STORAGE_PRIO_NUM];                  /*!< Requests finished per priority */
+    uint32_t max_wait_ms[STORAGE_PRIO_NUM];             /*!< Longest queue time per priority */
+    uint32_t open_hit;                                  /*!< Reads served from the kept-open file */
+}storage_service_info_struct;
+
+extern storage_service_info_struct storage_service_info;
+
+/* function declarations */
+int storage_service_init(void);                                                 /* create the queues and the storage task */
+int storage_service_submit(storage_request_struct *request);                    /* queue a request, returns at once */
+FRESULT storage_service_run(storage_request_struct *request);                   /* queue a request and wait for it */
+FRESULT storage_service_wait(storage_request_struct *request);                  /* wait for a submitted request */
+#endif /* __STORAGE_SERVICE_H */
@@ -12,17 +12,18 @@
 #include "./DELAY/delay.h"
 #include "./USART/usart.h"
 #include "./W25Q256/w25q256.h"
+#include "./FATFS/file_index.h"
+#include "./SYSTEM/system.h"
 #include "ff.h"
 #include <string.h>
 
 #define FONTINFOADDR        0
-#define FONTSECSIZE         8147    /* sectors need to be erased */
  
 /* stores various font library information including address and size */
 font_info_struct font_info;
 
 /* font library file paths in memory */
-char *const FONT_GBK_PATH[21] =
+char *const FONT_GBK_PATH[FONTNUM] =
 {
     "/UNIGBK.BIN",                  /* UNIGBK.BIN storage location */ 
     "/ASCll12_ST.BIN",              /* ASCll12_ST.BIN storage location */
@@ -48,7 +49,7 @@ char *const FONT_GBK_PATH[21] =
 };
 
 /* update progress display messages */
-char *const FONT_UPDATE_REMIND_TBL[21] =
+char *const FONT_UPDATE_REMIND_TBL[FONTNUM] =
 {
     "Updating UNIGBK.BIN",                  /* indicates updating UNIGBK.bin */
     "Updating ASCll12_ST.BIN",              /* indicates updating ASCll12_ST */
@@ -100,27 +101,135 @@ static void fonts_progress_show(uint16_t x, uint16_t y, uint32_t totsize, uint32
     }
 }
 
+/*!
+    \brief      get the address and size of a font
+    \param[in]  info: font information
+    \param[in]  fx: font index, order of FONT_GBK_PATH
+    \param[out] addr: start address
+    \param[out] size: file size
+    \retval     none
+*/
+static void fonts_entry_get(const font_info_struct *info, uint8_t fx, uint32_t *addr, uint32_t *size)
+{
+    const uint8_t *entry = (const uint8_t *)info + 1 + fx * 8;     /* the pairs follow fontok, packed */
+
+    memcpy(addr, entry, 4);
+    memcpy(size, entry + 4, 4);
+}
+
+/*!
+    \brief      set the address and size of a font
+    \param[in]  info: font information
+    \param[in]  fx: font index, order of FONT_GBK_PATH
+    \param[in]  addr: start address
+    \param[in]  size: file size
+    \param[out] none
+    \retval     none
+*/
+static void fonts_entry_set(font_info_struct *info, uint8_t fx, uint32_t addr, uint32_t size)
+{
+    uint8_t *entry = (uint8_t *)info + 1 + fx * 8;
+
+    memcpy(entry, &addr, 4);
+    memcpy(entry + 4, &size, 4);
+}
+
+/*!
+    \brief      erase the whole sectors of a font
+    \param[in]  start: first address, sector aligned
+    \param[in]  end: end address, sector aligned
+    \param[out] none
+    \retval     time spent erasing (us)
+    \note       64KB blocks where aligned, sectors at the edges. Each erase is
+                timed on its own, the whole range takes longer than a DWT
+                counter lap
+*/
+static uint32_t fonts_erase_range(uint32_t start, uint32_t end)
+{
+    uint32_t cycles, time_us = 0;
+
+    while (start < end)
+    {
+        cycles = DWT_CYCCNT;
+
+        if ((start % W25Q256_BLOCK_SIZE == 0) && (end - start >= W25Q256_BLOCK_SIZE))
+        {
+            w25q256_erase_block(start / W25Q256_BLOCK_SIZE);
+            start += W25Q256_BLOCK_SIZE;
+        }
+        else
+        {
+            w25q256_erase_sector(start / 4096);
+            start += 4096;
+        }
+
+        time_us += (DWT_CYCCNT - cycles) / (SystemCoreClock / 1000000);
+    }
+
+    return time_us;
+}
+
+/*!
+    \brief      write font data
+    \param[in]  addr: flash address
+    \param[in]  buf: data
+    \param[in]  len: bytes, at most 4096
+    \param[in]  start, end: sectors erased by fonts_erase_range
+    \param[out] none
+    \retval     0, success; others, error;
+    \note       data inside start..end is programmed directly, the partial
+                sectors at the edges are shared with the neighbouring fonts and
+                go through w25q256_write_data which keeps their other bytes
+*/
+static uint8_t fonts_write_range(uint32_t addr, uint8_t *buf, uint32_t len, uint32_t start, uint32_t end)
+{
+    uint32_t n;
+    uint8_t res = 0;
+
+    while ((len > 0) && (res == 0))
+    {
+        if (addr < start)
+        {
+            n = (len < start - addr) ? len : start - addr;
+            res = w25q256_write_data(addr, buf, n);
+        }
+        else if (addr < end)
+        {
+            n = (len < end - addr) ? len : end - addr;
+            res = w25q256_program_data(addr, buf, n);
+        }
+        else
+        {
+            n = len;
+            res = w25q256_write_data(addr, buf, n);
+        }
+
+        addr += n;
+        buf += n;
+        len -= n;
+    }
+
+    return res;
+}
+
 /*!
     \brief      update a specific font library
     \param[in]  x, y: display information coordinates
     \param[in]  fpath: file path
-    \param[in]  fx: font index to update
-      \arg        0, ungbk;
-      \arg        1, gbk12;
-      \arg        2, gbk16;
-      \arg        3, gbk24;
+    \param[in]  flashaddr: start address in the flash
+    \param[in]  size: file size
     \param[in]  color: font color
-    \param[out] none
+    \param[out] time_us: time spent erasing and programming the flash
     \retval     0, success; others, error code;
 */
-static uint8_t fonts_update_fontx(uint16_t x, uint16_t y, uint8_t *fpath, uint8_t fx, uint16_t color)
+static uint8_t fonts_update_fontx(uint16_t x, uint16_t y, uint8_t *fpath, uint32_t flashaddr, uint32_t size, uint16_t color, uint32_t *time_us)
 {
-    uint32_t flashaddr = 0;
     FIL *fftemp;
     uint8_t *tempbuf;
     uint8_t res;
-    uint16_t bread;
+    UINT bread;
     uint32_t offx = 0;
+    uint32_t start, end, cycles;
     uint8_t rval = 0;
     fftemp = (FIL *)mymalloc(SRAMIN, sizeof(FIL));  /* allocate memory */
 
@@ -130,151 +239,41 @@ static uint8_t fonts_update_fontx(uint16_t x, uint16_t y, uint8_t *fpath, uint8_
 
     if (tempbuf == NULL)rval = 1;
 
-    res = f_open(fftemp, (const TCHAR *)fpath, FA_READ);
+    *time_us = 0;
+    res = (rval == 0) ? f_open(fftemp, (const TCHAR *)fpath, FA_READ) : FR_NOT_ENOUGH_CORE;
 
     if (res)rval = 2;   /* open file failed */
 
     if (rval == 0)
     {
-        switch (fx)
-        {
-            case 0: /* update UNIGBK.BIN */
-                font_info.ugbkaddr = FONTINFOADDR + sizeof(font_info);      /* after info header, next is UNIGBK conversion table */
-                font_info.ugbksize = fftemp->obj.objsize;                   /* UNIGBK size */
-                flashaddr = font_info.ugbkaddr;
-                break;
-
-            case 1: /* update ascii12st */
-                font_info.ascii12staddr = font_info.ugbkaddr + font_info.ugbksize;  /* after UNIGBK, next is ascii12st font */
-                font_info.ascii12stsize = fftemp->obj.objsize;                      /* ascii12st font size */
-                flashaddr = font_info.ascii12staddr;                                /* ascii12st start address */
-                break;
-
-            case 2: /* update ascii16st */
-                font_info.ascii16staddr = font_info.ascii12staddr + font_info.ascii12stsize;    /* after ascii12st, next is ascii16st font */
-                font_info.ascii16stsize = fftemp->obj.objsize;                                  /* ascii16st font size */
-                flashaddr = font_info.ascii16staddr;                                            /* ascii16st start address */
-                break;
-
-            case 3: /* update ascii24st */
-                font_info.ascii24staddr = font_info.ascii16staddr + font_info.ascii16stsize;    /* after ascii16st, next is ascii24st font */
-                font_info.ascii24stsize = fftemp->obj.objsize;                                  /* ascii24st font size */
-                flashaddr = font_info.ascii24staddr;                                            /* ascii24st start address */
-                break;
-            case 4: /* update ascii32st */
-                font_info.ascii32staddr = font_info.ascii24staddr + font_info.ascii24stsize;    /* after ascii24st, next is ascii32st font */
-                font_info.ascii32stsize = fftemp->obj.objsize;                                  /* ascii32st font size */
-                flashaddr = font_info.ascii32staddr;                                            /* ascii32st start address */
-                break;
-            
-            case 5: /* update ascii12sp */
-                font_info.ascii12spaddr = font_info.ascii32staddr + font_info.ascii32stsize;    /* after ascii32st, next is ascii12sp font */
-                font_info.ascii12spsize = fftemp->obj.objsize;                                  /* ascii12sp font size */
-                flashaddr = font_info.ascii12spaddr;                                            /* ascii12sp start address */
-                break;
-            
-            case 6: /* update ascii16sp */
-                font_info.ascii16spaddr = font_info.ascii12spaddr + font_info.ascii12spsize;    /* after ascii12sp, next is ascii16sp font */
-                font_info.ascii16spsize = fftemp->obj.objsize;                                  /* ascii16sp font size */
-                flashaddr = font_info.ascii16spaddr;                                            /* ascii16sp start address */
-                break;
-            
-            case 7: /* update ascii24sp */
-                font_info.ascii24spaddr = font_info.ascii16spaddr + font_info.ascii16spsize;    /* after ascii16sp, next is ascii24sp font */
-                font_info.ascii24spsize = fftemp->obj.objsize;                                  /* ascii24sp font size */
-                flashaddr = font_info.ascii24spaddr;                                            /* ascii24sp start address */
-                break;
-            
-            case 8: /* update ascii32sp */
-                font_info.ascii32spaddr = font_info.ascii24spaddr + font_info.ascii24spsize;    /* after ascii24sp, next is ascii32sp font */
-                font_info.ascii32spsize = fftemp->obj.objsize;                                  /* ascii32sp font size */
-                flashaddr = font_info.ascii32spaddr;                                            /* ascii32sp start address */
-                break;
-            
-            case 9: /* update gbk16 */
-                font_info.gbk16addr = font_info.ascii32spaddr + font_info.ascii32spsize;    /* after ascii32sp, next is gbk16 font */
-                font_info.gbk16size = fftemp->obj.objsize;                                  /* gbk16 font size */
-                flashaddr = font_info.gbk16addr;                                            /* gbk16 start address */
-                break;
-            
-            case 10: /* update lvfontsimsun12 */
-                font_info.lvfontsimsun12addr = font_info.gbk16addr + font_info.gbk16size;   /* after gbk16, next is lvfontsimsun12 font */
-                font_info.lvfontsimsun12size = fftemp->obj.objsize;                         /* lvfontsimsun12 font size */
-                flashaddr = font_info.lvfontsimsun12addr;                                   /* lvfontsimsun12 start address */
-                break;
-            
-            case 11: /* update lvfontsimsun16 */
-                font_info.lvfontsimsun16addr = font_info.lvfontsimsun12addr + font_info.lvfontsimsun12size; /* after lvfontsimsun12, next is lvfontsimsun16 font */
-                font_info.lvfontsimsun16size = fftemp->obj.objsize;                                         /* lvfontsimsun16 font size */
-                flashaddr = font_info.lvfontsimsun16addr;                                                   /* lvfontsimsun16 start address */
-                break;
-  
-            case 12: /* update lvfontsimsun24 */
-                font_info.lvfontsimsun24addr = font_info.lvfontsimsun16addr + font_info.lvfontsimsun16size; /* after lvfontsimsun16, next is lvfontsimsun24 font */
-                font_info.lvfontsimsun24size = fftemp->obj.objsize;                                         /* lvfontsimsun24 font size */
-                flashaddr = font_info.lvfontsimsun24addr;                                                   /* lvfontsimsun24 start address */
-                break;
-            
-            case 13: /* update lvfontsimsun32 */
-                font_info.lvfontsimsun32addr = font_info.lvfontsimsun24addr + font_info.lvfontsimsun24size; /* after lvfontsimsun24, next is lvfontsimsun32 font */
-                font_info.lvfontsimsun32size = fftemp->obj.objsize;                                         /* lvfontsimsun32 font size */
-                flashaddr = font_info.lvfontsimsun32addr;                                                   /* lvfontsimsun32 start address */
-                break;
-            
-            case 14: /* update lvfontsimsun48 */
-                font_info.lvfontsimsun48addr = font_info.lvfontsimsun32addr + font_info.lvfontsimsun32size; /* after lvfontsimsun32, next is lvfontsimsun48 font */
-                font_info.lvfontsimsun48size = fftemp->obj.objsize;                                         /* lvfontsimsun48 font size */
-                flashaddr = font_info.lvfontsimsun48addr;                                                   /* lvfontsimsun48 start address */
-                break;
-            
-            case 15: /* update lvfontfzst12 */
-                font_info.lvfontfzst12addr = font_info.lvfontsimsun48addr + font_info.lvfontsimsun48size;   /* after lvfontst48, next is lvfontfzst12 font */
-                font_info.lvfontfzst12size = fftemp->obj.objsize;                                           /* lvfontfzst12 font size */
-                flashaddr = font_info.lvfontfzst12addr;                                                     /* lvfontfzst12 start address */
-                break;
-            
-            case 16: /* update lvfontfzst16 */
-                font_info.lvfontfzst16addr = font_info.lvfontfzst12addr + font_info.lvfontfzst12size;   /* after lvfontfzst12, next is lvfontfzst16 font */
-                font_info.lvfontfzst16size = fftemp->obj.objsize;                                       /* lvfontfzst16 font size */
-                flashaddr = font_info.lvfontfzst16addr;                                                 /* lvfontfzst16 start address */
-                break;
-            
-            case 17: /* update lvfontfzst24 */
-                font_info.lvfontfzst24addr = font_info.lvfontfzst16addr + font_info.lvfontfzst16size;   /* after lvfontfzst16, next is lvfontfzst24 font */
-                font_info.lvfontfzst24size = fftemp->obj.objsize;                                       /* lvfontfzst24 font size */
-                flashaddr = font_info.lvfontfzst24addr;                                                 /* lvfontfzst24 start address */
-                break;
-            
-            case 18: /* update lvfontfzst32 */
-                font_info.lvfontfzst32addr = font_info.lvfontfzst24addr + font_info.lvfontfzst24size;   /* after lvfontfzst24, next is lvfontfzst32 font */
-                font_info.lvfontfzst32size = fftemp->obj.objsize;                                       /* lvfontfzst32 font size */
-                flashaddr = font_info.lvfontfzst32addr;                                                 /* lvfontfzst32 start address */
-                break;
-            
-            case 19: /* update lvfontfzst48 */
-                font_info.lvfontfzst48addr = font_info.lvfontfzst32addr + font_info.lvfontfzst32size;   /* after lvfontfzst32, next is lvfontfzst48 font */
-                font_info.lvfontfzst48size = fftemp->obj.objsize;                                       /* lvfontfzst48 font size */
-                flashaddr = font_info.lvfontfzst48addr;                                                 /* lvfontfzst48 start address */
-                break;
-            
-            case 20: /* update lvfontfzst56 */
-                font_info.lvfontfzst56addr = font_info.lvfontfzst48addr + font_info.lvfontfzst48size;   /* after lvfontst48, next is lvfontfzst56 font */
-                font_info.lvfontfzst56size = fftemp->obj.objsize;                                       /* lvfontfzst56 font size */
-                flashaddr = font_info.lvfontfzst56addr;                                                 /* lvfontfzst56 start address */
-                break;
-            
-            default: break;
-        }
+        start = (flashaddr + 4095) & ~4095U;        /* whole sectors of the font */
+        end = (flashaddr + size) & ~4095U;
+
+        if (end < start)end = start;
+
+        *time_us += fonts_erase_range(start, end);
 
         while (res == FR_OK)   /* loop execution */
         {
-            res = f_read(fftemp, tempbuf, 4096, (UINT *)&bread);    /* read data */
+            res = f_read(fftemp, tempbuf, 4096, &bread);    /* read data */
 
             if (res != FR_OK)break;     /* execution error */
 
-            w25q256_write_data(offx + flashaddr, tempbuf, bread);       /* write bread bytes from 0 */
+            if (bread > 0)
+            {
+                cycles = DWT_CYCCNT;    /* per chunk, the DWT counter wraps within seconds */
+
+                if (fonts_write_range(flashaddr + offx, tempbuf, bread, start, end))
+                {
+                    res = FR_NOT_ENOUGH_CORE;
+                    break;
+                }
+
+                *time_us += (DWT_CYCCNT - cycles) / (SystemCoreClock / 1000000);
+            }
+
             offx += bread;
-            fonts_progress_show(x, y, fftemp->obj.objsize, offx, color);    /* progress display */
+            fonts_progress_show(x, y, size, offx, color);  /* progress display */
 
             if (bread != 4096)break;    /* read complete */
         }
@@ -290,94 +289,130 @@ static uint8_t fonts_update_fontx(uint16_t x, uint16_t y, uint8_t *fpath, uint8_
 
 /*!
     \brief      update all font files
-    \note       updates all font libraries (UNIGBK,GBK12,GBK16,GBK24)
+    \note       the fonts are packed one after the other behind the font
+                information, a font is rewritten only when its CRC-32, size or
+                address differs from the font information in the flash (a
+                changed size moves the fonts behind it). The CRCs come from
+                file_index_crc, cached in the file index, so checking unchanged
+                files costs one f_stat each. Nothing is displayed when every
+                font is up to date
     \param[in]  x, y: display information coordinates
     \param[in]  src: font file source path
     \param[in]  color: font color
     \param[out] none
-    \retval     0, success; others, error code;
+    \retval     0, success or up to date; others, error code;
 */
 uint8_t fonts_update_font(uint16_t x, uint16_t y, uint8_t *src, uint16_t color)
 {
     uint8_t *pname;
-    uint32_t *buf;
+    font_info_struct *old, *info;
+    FILINFO *fileinfo;
     uint8_t res = 0;
-    uint16_t i, j;
-    FIL *fftemp;
+    uint16_t i;
+    uint32_t addr, size, old_addr, old_size;
+    uint32_t changed = 0;
+    uint32_t crc;
+    uint32_t time_us;
     uint8_t rval = 0;
-    res = 0xFF;
-    font_info.fontok = 0xFF;
     pname = mymalloc(SRAMIN, 100);                          /* allocate 100 bytes memory */
-    buf = mymalloc(SRAMIN, 4096);                           /* allocate 4K bytes memory */
-    fftemp = (FIL *)mymalloc(SRAMIN, sizeof(FIL));          /* allocate memory */
+    old = (font_info_struct *)mymalloc(SRAMIN, sizeof(font_info_struct));
+    info = (font_info_struct *)mymalloc(SRAMIN, sizeof(font_info_struct));
+    fileinfo = (FILINFO *)mymalloc(SRAMIN, sizeof(FILINFO));
 
-    if (buf == NULL || pname == NULL || fftemp == NULL)
+    if (pname == NULL || old == NULL || info == NULL || fileinfo == NULL)
     {
-        myfree(SRAMIN, fftemp);
+        myfree(SRAMIN, fileinfo);
+        myfree(SRAMIN, info);
+        myfree(SRAMIN, old);
         myfree(SRAMIN, pname);
-        myfree(SRAMIN, buf);
         return 5;           /* memory allocation failed */
     }
 
-    for (i = 0; i < 21; i++) /* first test if files exist */
+    w25q256_read_data(FONTINFOADDR, (uint8_t *)old, sizeof(font_info_struct));     /* fonts in the flash */
+    memset(info, 0, sizeof(font_info_struct));
+    addr = FONTINFOADDR + sizeof(font_info_struct);         /* after info header, next is UNIGBK conversion table */
+
+    for (i = 0; i < FONTNUM; i++) /* first test if files exist, then lay them out and compare */
     {
         strcpy((char *)pname, (char *)src);                 /* copy src data to pname */
         strcat((char *)pname, (char *)FONT_GBK_PATH[i]);    /* append specific file path */
-        res = f_open(fftemp, (const TCHAR *)pname, FA_READ);/* try to open */
+        res = f_stat((const TCHAR *)pname, fileinfo);
 
-        if (res)
+        if (res || (fileinfo->fsize > FONTSECSIZE * 4096) || (file_index_crc((const char *)pname, &crc) != 0))
         {
             rval |= 1 << 7; /* mark open file failed */
             break;          /* error, exit directly */
         }
+
+        size = (uint32_t)fileinfo->fsize;
+        info->crc[i] = crc;
+        fonts_entry_set(info, i, addr, size);
+        fonts_entry_get(old, i, &old_addr, &old_size);
+
+        if ((old->fontok != 0xAA) || (old_addr != addr) || (old_size != size) || (old->crc[i] != info->crc[i]))
+        {
+            changed |= 1 << i;
+        }
+
+        addr += size;
     }
 
-    myfree(SRAMIN, fftemp); /* free memory */
+    if ((rval == 0) && (addr > FONTSECSIZE * 4096))
+    {
+        PRINT_ERROR("fonts need %u bytes, font area is %u bytes\r\n", addr, FONTSECSIZE * 4096);
+        rval |= 1 << 7;
+    }
 
-    if (rval == 0)          /* font files exist */
+    if ((rval == 0) && (changed != 0))
     {
-        rgblcd_ipa_fill(x, y, x + 256, y + 16, rgblcd_status.back_color);
-        rgblcd_show_string(x, y, 256, 16, "Erasing sectors...", RGBLCD_FONT_16, color);            /* display erasing sectors */
+        font_info.fontok = 0xFF;    /* invalid until every changed font is written */
+        w25q256_write_data(FONTINFOADDR, &font_info.fontok, 1);
 
-        for (i = 0; i < FONTSECSIZE; i++)           /* first erase font sectors to increase write speed */
+        for (i = 0; i < FONTNUM; i++)
         {
-            fonts_progress_show(x + 256 + 16, y, FONTSECSIZE, i, color);     /* progress display */
-            w25q256_read_data(((FONTINFOADDR / 4096) + i) * 4096, (uint8_t *)buf, 4096);    /* read one sector data */
-
-            for (j = 0; j < 1024; j++)              /* check data */
+            if (!(changed & (1 << i)))
             {
-                if (buf[j] != 0xFFFFFFFF) break;    /* needs erase */
+                PRINT_INFO("font %s unchanged, skipped\r\n", FONT_GBK_PATH[i]);
+                continue;
             }
 
-            if (j != 1024)
-            {
-                w25q256_erase_sector((FONTINFOADDR / 4096) + i); /* needs to erase this sector */
-            }
-        }
-
-        for (i = 0; i < 21; i++)
-        {
-            rgblcd_ipa_fill(x, y, x + 256, y + 16, rgblcd_status.back_color);
+            fonts_entry_get(info, i, &addr, &size);
+            rgblcd_ipa_fill(x, y, x + 256 + 16 + 3 * 16 / 2 + 8 + 96, y + 16, rgblcd_status.back_color);
             rgblcd_show_string(x, y, 256, 16, FONT_UPDATE_REMIND_TBL[i], RGBLCD_FONT_16, color);
             strcpy((char *)pname, (char *)src);                     /* copy src data to pname */
             strcat((char *)pname, (char *)FONT_GBK_PATH[i]);        /* append specific file path */
-            res = fonts_update_fontx(x + 256 + 16, y, pname, i, color);  /* update font */
+            res = fonts_update_fontx(x + 256 + 16, y, pname, addr, size, color, &time_us);  /* update font */
 
             if (res)
             {
-                myfree(SRAMIN, buf);
+                myfree(SRAMIN, fileinfo);
+                myfree(SRAMIN, info);
+                myfree(SRAMIN, old);
                 myfree(SRAMIN, pname);
                 return 1 + i;
             }
+
+            time_us /= 1000;    /* ms */
+            PRINT_INFO("font %s: %u bytes at 0x%08X, %u ms, %u KB/s\r\n", FONT_GBK_PATH[i], size, addr,
+                       time_us, (uint32_t)((uint64_t)size * 1000 / 1024 / (time_us + 1)));
+            rgblcd_show_num(x + 256 + 16 + 3 * 16 / 2 + 8, y, (uint32_t)((uint64_t)size * 1000 / 1024 / (time_us + 1)), 5, RGBLCD_FONT_16, color);
+            rgblcd_show_string(x + 256 + 16 + 3 * 16 / 2 + 8 + 5 * 16 / 2, y, 56, 16, "KB/s", RGBLCD_FONT_16, color);
         }
 
         /* all updates completed */
-        font_info.fontok = 0xAA;
+        info->fontok = 0xAA;
+        memcpy(&font_info, info, sizeof(font_info_struct));
         w25q256_write_data(FONTINFOADDR, (uint8_t *)&font_info, sizeof(font_info));           /* write font info */
     }
+    else if (rval == 0)
+    {
+        PRINT_INFO("fonts up to date\r\n");
+    }
 
+    myfree(SRAMIN, fileinfo);
+    myfree(SRAMIN, info);
+    myfree(SRAMIN, old);
     myfree(SRAMIN, pname);  /* free memory */
-    myfree(SRAMIN, buf);
     
     return rval;            /* no error */
 }
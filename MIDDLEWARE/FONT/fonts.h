@@ -12,10 +12,14 @@
 #include <stdint.h>
 
 /* font information storage base address
- * occupies 41 bytes, first 1 byte is used to mark whether font library exists, then every 8 bytes as a group, respectively storing start address and file size
+ * occupies 253 bytes, first 1 byte is used to mark whether font library exists, then every 8 bytes as a group, respectively storing start address and file size,
+ * then the CRC-32 of every font file
  */
 extern uint32_t FONTINFOADDR;
 
+#define FONTNUM             21      /* number of font files */
+#define FONTSECSIZE         8147    /* sectors reserved for the fonts, the flash above them is free */
+
 /* font information structure definition
  * stores various font library information including address and size
  */
@@ -64,6 +68,7 @@ typedef __PACKED_STRUCT
     uint32_t lvfontfzst48size;              /* lvfontfzst48 size */
     uint32_t lvfontfzst56addr;              /* lvfontfzst56 address */
     uint32_t lvfontfzst56size;              /* lvfontfzst56 size */
+    uint32_t crc[FONTNUM];                  /* CRC-32 of each font file, in the order of the address and size pairs */
 }font_info_struct;
 
 /* font information structure instance */
@@ -21,6 +21,9 @@
 #include "./MALLOC/malloc.h"
 
 #include "./DAP/dap_main.h"
+#include "./FATFS/storage_service.h"
+#include "./FATFS/recorder.h"
+#include "./W25Q256/w25q256.h"
 
 #include "lvgl_main.h"
 #include "lvgl_setting.h"
@@ -90,6 +93,10 @@ QueueHandle_t xQueueWirelseeState;                          /* Wireless state qu
 
 /* static variable declarations */
 
+/* static function declarations */
+static void debugger_recipe_progress(uint8_t step, flash_recipe_phase_enum phase);
+static void debugger_readback_progress(uint32_t done, uint32_t total);
+
 /******************************************************************************************************/
 
 /*!
@@ -111,6 +118,15 @@ void freertos_main(void)
     xQueueDebuggerDownload = xQueueCreate(xQueueDebuggerDownloadLength, xQueueDebuggerDownloadSize);
     xQueueWirelseeState = xQueueCreate(xQueueWirelseeStateLength, xQueueWirelseeStateSize); 
     
+    /* Create storage service task, it owns the FatFs volume from here on */
+    storage_service_init();
+    
+    /* Create recorder task, writes capture streams to preallocated files */
+    recorder_init();
+    
+    /* Create flash task, serves asynchronous W25Q256 reads, programs and erases */
+    w25q256_async_init();
+    
     /* Create DAP link task */
     xTaskCreate((TaskFunction_t)dap_link_task,
                 (const char*)"dap_link_task",
@@ -287,6 +303,7 @@ void debugger_download_task(void *pvParameters)
         lvgl_debugger_download.run_count = 0;
         lvgl_debugger_download.status = notify_val;
         lvgl_debugger_download.error = 0;
+        lvgl_debugger_download.phase = 0;
 
         switch(notify_val)
         {
@@ -453,6 +470,33 @@ void debugger_download_task(void *pvParameters)
                 }
                 break;
                 
+            case 5: /* Run programming recipe, connect for it */
+            case 6: /* Run programming recipe in the attached session */
+                lvgl_debugger_download.status = 5;
+                lvgl_debugger_download.phase = FLASH_RECIPE_PHASE_DONE;
+                if(flash_recipe_run((notify_val == 6), debugger_recipe_progress) == ERROR_SUCCESS)
+                {
+                    lvgl_debugger_download.run_count = flash_recipe->step_num;
+                }
+                else
+                {
+                    lvgl_debugger_download.status = 0;
+                    lvgl_debugger_download.error = 5;
+                }
+                break;
+                
+            case 7: /* Read target flash back to file */
+            case 8: /* Read back at each SWJ clock */
+                lvgl_debugger_download.status = 7;
+                lvgl_debugger_download.run_count = 100;
+                if(((notify_val == 7) ? flash_readback_run(&debugger_readback, debugger_readback_progress) : 
+                                        flash_readback_sweep(&debugger_readback, debugger_readback_speed, debugger_readback_progress)) != ERROR_SUCCESS)
+                {
+                    lvgl_debugger_download.status = 0;
+                    lvgl_debugger_download.error = 7;
+                }
+                break;
+                
             default: break;
         }
         
@@ -463,6 +507,42 @@ void debugger_download_task(void *pvParameters)
     }
 }
 
+/*!
+    \brief      Programming recipe progress callback, runs in the debugger download task
+    \param[in]  step: index of the running step
+    \param[in]  phase: phase of the running step
+    \param[out] none
+    \retval     none
+*/
+static void debugger_recipe_progress(uint8_t step, flash_recipe_phase_enum phase)
+{
+    lvgl_debugger_download_struct lvgl_debugger_download;
+    
+    lvgl_debugger_download.run_count = step;
+    lvgl_debugger_download.status = 5;
+    lvgl_debugger_download.error = 0;
+    lvgl_debugger_download.phase = phase;
+    xQueueOverwrite(xQueueDebuggerDownload, &lvgl_debugger_download);
+}
+
+/*!
+    \brief      Flash readback progress callback, runs in the debugger download task
+    \param[in]  done: bytes read
+    \param[in]  total: bytes to read
+    \param[out] none
+    \retval     none
+*/
+static void debugger_readback_progress(uint32_t done, uint32_t total)
+{
+    lvgl_debugger_download_struct lvgl_debugger_download;
+    
+    lvgl_debugger_download.run_count = (uint64_t)done * 99 / total;     /* 100 is reserved for the final report */
+    lvgl_debugger_download.status = 7;
+    lvgl_debugger_download.error = 0;
+    lvgl_debugger_download.phase = 0;
+    xQueueOverwrite(xQueueDebuggerDownload, &lvgl_debugger_download);
+}
+
 /*!
     \brief      Wireless task
     \param[in]  pvParameters: task parameters
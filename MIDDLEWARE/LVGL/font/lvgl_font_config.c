@@ -3,6 +3,11 @@
 #include "./W25Q256/w25q256.h"
 #include "./MALLOC/malloc.h"
 #include "./FONT/fonts.h"
+#include "./SYSTEM/system.h"
+#include "./LVGL/font/lvgl_font_config.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
 #include <string.h>
 #include <stdio.h>
 
@@ -11,6 +16,7 @@ static const uint8_t opa4_table[16] = {0,  17, 34,  51,
                                        136, 153, 170, 187,
                                        204, 221, 238, 255
                                       };
+static uint16_t opa4_pair_table[256];   /* 一个4bpp字节(两个像素)对应的两个A8字节, 小端 */
 
 typedef struct{
     uint16_t min;
@@ -38,83 +44,700 @@ static x_header_t __g_xbf_hd = {
     .bpp = 4,
 };
 
-static uint8_t *lvgl_font_buffer;
+#define LVGL_FONT_CACHE_NONE    0xFFFF
+
+/*!
+    \brief      Glyph cache entry structure
+*/
+typedef struct{
+    uint32_t unicode;                       /*!< Code point */
+    uint32_t pos;                           /*!< Descriptor offset in the font, 0: glyph missing */
+    uint8_t *bitmap;                        /*!< Decoded A8 bitmap, NULL until drawn */
+    uint16_t hash_next;                     /*!< Next entry of the hash bucket or of the free list */
+    uint16_t lru_prev;                      /*!< More recently used entry */
+    uint16_t lru_next;                      /*!< Less recently used entry */
+    uint8_t  line_height;                   /*!< Font key, 0: entry free */
+    glyph_dsc_t dsc;                        /*!< Glyph descriptor */
+}lvgl_font_cache_entry_struct;
+
+/*!
+    \brief      Glyph cache structure
+*/
+typedef struct{
+    lvgl_font_cache_entry_struct *entry;    /*!< LVGL_FONT_CACHE_NUM entries (SDRAM) */
+    uint16_t *hash;                         /*!< LVGL_FONT_CACHE_HASH bucket heads */
+    uint16_t lru_head;                      /*!< Most recently used entry */
+    uint16_t lru_tail;                      /*!< Least recently used entry */
+    uint16_t free_head;                     /*!< First unused entry */
+    uint8_t buffer_busy;                    /*!< Bit i set: lvgl_font_buffer[i] in use */
+    lv_mutex_t lock;                        /*!< Held for lookups and updates only, never during flash reads */
+}lvgl_font_cache_struct;
+
+/*!
+    \brief      Font resident in SDRAM structure
+*/
+typedef struct{
+    uint8_t  line_height;                   /*!< Font key */
+    uint8_t *data;                          /*!< Copy of the start of the font file (SDRAM) */
+    volatile uint32_t resident;             /*!< Bytes of the file in data, 0: not (yet) resident */
+}lvgl_font_preload_struct;
+
+static uint8_t *lvgl_font_buffer[LVGL_FONT_BUFFER_NUM];
+static lvgl_font_preload_struct lvgl_font_preload[LVGL_FONT_PRELOAD_NUM];
+static const uint8_t lvgl_font_preload_list[LVGL_FONT_PRELOAD_NUM] = LVGL_FONT_PRELOAD_LIST;
+lvgl_font_preload_info_struct lvgl_font_preload_info;
+static lvgl_font_cache_struct lvgl_font_cache;
+lvgl_font_cache_info_struct lvgl_font_cache_info;
+
+static void lvgl_font_preload_task(void *pvParameters);
+static uint8_t lvgl_font_preload_wait(w25q256_request_struct *request);
+static void lvgl_font_a4_expand(const uint8_t *in, uint8_t *out, uint32_t w, uint32_t h, uint32_t stride);
 
 /**************************************************************
 函数名称 ： lvgl_font_buffer_malloc
-功    能 ： 为lvgl_font_buffer申请内存
+功    能 ： 为lvgl_font_buffer和字形缓存申请内存
 参    数 ： 无
 返 回 值 ： 无
 作    者 ： ZeHou
 **************************************************************/
 void lvgl_font_buffer_malloc(void)
 {
-    lvgl_font_buffer = (uint8_t *)mymalloc(SRAMDTCM, 2176);
-    if(lvgl_font_buffer)
+    uint16_t i;
+    
+    for(i = 0; i < 256; i++)
     {
-        PRINT_INFO("apply 2176 byte memory successfully in lvgl_font_buffer_malloc, address: 0x%08X\r\n", (uint32_t)lvgl_font_buffer);
+        opa4_pair_table[i] = opa4_table[i >> 4] | ((uint16_t)opa4_table[i & 0x0F] << 8);
     }
-    else
+    
+    for(i = 0; i < LVGL_FONT_BUFFER_NUM; i++)
+    {
+        lvgl_font_buffer[i] = (uint8_t *)mymalloc(SRAMDTCM, LVGL_FONT_BUFFER_SIZE);
+        if(lvgl_font_buffer[i])
+        {
+            PRINT_INFO("apply %u byte memory successfully in lvgl_font_buffer_malloc, address: 0x%08X\r\n", LVGL_FONT_BUFFER_SIZE, (uint32_t)lvgl_font_buffer[i]);
+        }
+        else
+        {
+            lvgl_font_cache.buffer_busy |= 1 << i;  /* never handed out */
+            PRINT_ERROR("apply %u byte memory unsuccessfully in lvgl_font_buffer_malloc\r\n", LVGL_FONT_BUFFER_SIZE);
+        }
+    }
+    
+    lv_mutex_init(&lvgl_font_cache.lock);
+    lvgl_font_cache.entry = (lvgl_font_cache_entry_struct *)mymalloc(SRAMEX, LVGL_FONT_CACHE_NUM * sizeof(lvgl_font_cache_entry_struct));
+    lvgl_font_cache.hash = (uint16_t *)mymalloc(SRAMEX, LVGL_FONT_CACHE_HASH * sizeof(uint16_t));
+    if((lvgl_font_cache.entry == NULL) || (lvgl_font_cache.hash == NULL))
+    {
+        myfree(SRAMEX, lvgl_font_cache.entry);
+        myfree(SRAMEX, lvgl_font_cache.hash);
+        lvgl_font_cache.entry = NULL;
+        lvgl_font_cache.hash = NULL;
+        PRINT_ERROR("lvgl font cache disabled, out of memory\r\n");
+        return;
+    }
+    
+    memset(lvgl_font_cache.entry, 0x00, LVGL_FONT_CACHE_NUM * sizeof(lvgl_font_cache_entry_struct));
+    lvgl_font_cache_clear();
+}
+
+/**************************************************************
+函数名称 ： lvgl_font_preload_start
+功    能 ： 创建字体预加载任务, 调度器启动后在后台运行
+参    数 ： 无
+返 回 值 ： 无
+作    者 ： ZeHou
+**************************************************************/
+void lvgl_font_preload_start(void)
+{
+    uint8_t i;
+    
+    for(i = 0; i < LVGL_FONT_PRELOAD_NUM; i++)
+    {
+        lvgl_font_preload[i].line_height = lvgl_font_preload_list[i];
+    }
+    
+    if((font_info.fontok != 0xAA) || ((LVGL_FONT_PRELOAD_BUDGET == 0) && !LVGL_FONT_STRESS_TEST_BOOT))
+    {
+        lvgl_font_preload_info.done = 1;
+        return;
+    }
+    
+    if(xTaskCreate((TaskFunction_t)lvgl_font_preload_task, "font_preload_task", LVGL_FONT_PRELOAD_STK_SIZE, NULL,
+                   LVGL_FONT_PRELOAD_TASK_PRIO, NULL) != pdPASS)
+    {
+        lvgl_font_preload_info.done = 1;
+        PRINT_ERROR("lvgl font preload disabled, out of memory\r\n");
+    }
+}
+
+/**************************************************************
+函数名称 ： lvgl_font_cache_clear
+功    能 ： 清空字形缓存, 字库更新后调用
+参    数 ： 无
+返 回 值 ： 无
+作    者 ： ZeHou
+**************************************************************/
+void lvgl_font_cache_clear(void)
+{
+    uint32_t i;
+    
+    if(lvgl_font_cache.entry == NULL)return;
+    
+    lv_mutex_lock(&lvgl_font_cache.lock);
+    for(i = 0; i < LVGL_FONT_CACHE_NUM; i++)
     {
-        PRINT_ERROR("apply 2176 byte memory unsuccessfully in lvgl_font_buffer_malloc\r\n");
+        myfree(SRAMEX, lvgl_font_cache.entry[i].bitmap);
+        lvgl_font_cache.entry[i].bitmap = NULL;
+        lvgl_font_cache.entry[i].line_height = 0;
+        lvgl_font_cache.entry[i].hash_next = (i + 1 < LVGL_FONT_CACHE_NUM) ? (i + 1) : LVGL_FONT_CACHE_NONE;
     }
+    for(i = 0; i < LVGL_FONT_CACHE_HASH; i++)
+    {
+        lvgl_font_cache.hash[i] = LVGL_FONT_CACHE_NONE;
+    }
+    lvgl_font_cache.lru_head = LVGL_FONT_CACHE_NONE;
+    lvgl_font_cache.lru_tail = LVGL_FONT_CACHE_NONE;
+    lvgl_font_cache.free_head = 0;
+    lvgl_font_cache_info.used = 0;
+    lv_mutex_unlock(&lvgl_font_cache.lock);
 }
                                      
-static uint8_t *__user_font_getdata(int32_t line_height, int offset, int size){
-    uint32_t address;
+/**************************************************************
+函数名称 ： __user_font_address
+功    能 ： 取字体文件在外部FLASH中的地址和大小
+参    数 ： line_height: 字体行高(字体标识)
+            size: 输出字体文件大小, 可为NULL
+返 回 值 ： 字体文件地址
+作    者 ： ZeHou
+**************************************************************/
+static uint32_t __user_font_address(int32_t line_height, uint32_t *size)
+{
+    uint32_t address = 0, length = 0;
     
     switch(line_height)
     {
         case 13:
             address = font_info.lvfontfzst12addr;
+            length = font_info.lvfontfzst12size;
             break;
         
         case 14:
             address = font_info.lvfontsimsun12addr;
+            length = font_info.lvfontsimsun12size;
             break;
         
         case 17:
             address = font_info.lvfontfzst16addr;
+            length = font_info.lvfontfzst16size;
             break;
         
         case 18:
             address = font_info.lvfontsimsun16addr;
+            length = font_info.lvfontsimsun16size;
             break;
         
         case 25:
             address = font_info.lvfontfzst24addr;
+            length = font_info.lvfontfzst24size;
             break;
         
         case 27:
             address = font_info.lvfontsimsun24addr;
+            length = font_info.lvfontsimsun24size;
             break;
         
         case 34:
             address = font_info.lvfontfzst32addr;
+            length = font_info.lvfontfzst32size;
             break;
         
         case 37:
             address = font_info.lvfontsimsun32addr;
+            length = font_info.lvfontsimsun32size;
             break;
         
         case 51:
             address = font_info.lvfontfzst48addr;
+            length = font_info.lvfontfzst48size;
             break;
         
         case 55:
             address = font_info.lvfontsimsun48addr;
+            length = font_info.lvfontsimsun48size;
             break;
         
         case 59:
             address = font_info.lvfontfzst56addr;
+            length = font_info.lvfontfzst56size;
             break;
         
         default: break;
     }
+    
+    if(size != NULL)*size = length;
+    
+    return address;
+}
+
+static const uint8_t *__user_font_getdata(uint8_t *buffer, int32_t line_height, int offset, int size){
+    uint8_t i;
+    
+    /* a font preloaded into SDRAM is read in place */
+    for(i = 0; i < LVGL_FONT_PRELOAD_NUM; i++)
+    {
+        if((lvgl_font_preload[i].line_height == line_height) && ((uint32_t)(offset + size) <= lvgl_font_preload[i].resident))
+        {
+            return lvgl_font_preload[i].data + offset;
+        }
+    }
+    
+    w25q256_read_data(__user_font_address(line_height, NULL) + offset, buffer, size);   /* holds the OSPI lock for this transaction only */
+    
+    return buffer;
+}
+
+/**************************************************************
+函数名称 ： lvgl_font_preload_wait
+功    能 ： 等待一个预加载读请求完成
+参    数 ： request: 读请求, W25Q256_REQ_IDLE表示未提交
+返 回 值 ： 0: 成功或未提交, 1: 读失败
+作    者 ： ZeHou
+**************************************************************/
+static uint8_t lvgl_font_preload_wait(w25q256_request_struct *request)
+{
+    while(request->state == W25Q256_REQ_QUEUED)
+    {
+        xTaskNotifyWait(0, request->notify_bits, NULL, 1);   /* 通知先于状态更新到达时下一拍再查 */
+    }
+    
+    return (request->state == W25Q256_REQ_DONE) ? request->status : 0;
+}
+
+/**************************************************************
+函数名称 ： lvgl_font_preload_task
+功    能 ： 后台任务, 按lvgl_font_preload_list的顺序把字体的索引表
+            (LVGL_FONT_PRELOAD_FULL时为整个字体)复制到SDRAM, 分块的
+            MDMA读请求交给FLASH任务, 两块同时排队, 与擦写请求按序执行
+参    数 ： pvParameters: 未使用
+返 回 值 ： 无
+作    者 ： ZeHou
+**************************************************************/
+static void lvgl_font_preload_task(void *pvParameters)
+{
+    lvgl_font_preload_struct *font;
+    w25q256_request_struct request[2];
+    uint32_t address, size, length, offset, chunk;
+    TickType_t start_tick;
+    uint8_t i, slot, failed;
+    
+    (void)pvParameters;
+    
+    memset(request, 0x00, sizeof(request));
+    for(slot = 0; slot < 2; slot++)
+    {
+        request[slot].op = W25Q256_OP_READ_BACKGROUND;
+        request[slot].state = W25Q256_REQ_IDLE;
+        request[slot].notify = xTaskGetCurrentTaskHandle();
+        request[slot].notify_bits = 1U << slot;
+    }
+    
+    start_tick = xTaskGetTickCount();
+    for(i = 0; i < LVGL_FONT_PRELOAD_NUM; i++)
+    {
+        font = &lvgl_font_preload[i];
+        address = __user_font_address(font->line_height, &size);
+        length = sizeof(x_header_t) + (__g_xbf_hd.max - __g_xbf_hd.min + 1) * 4;  /* index table */
+        
+        if((address == 0) || (size < length))continue;
+        if(LVGL_FONT_PRELOAD_FULL && (lvgl_font_preload_info.used + size <= LVGL_FONT_PRELOAD_BUDGET))
+        {
+            length = size;
+        }
+        if(lvgl_font_preload_info.used + length > LVGL_FONT_PRELOAD_BUDGET)continue;
+        
+        font->data = (uint8_t *)mymalloc(SRAMEX, length);
+        if(font->data == NULL)continue;
+        
+        failed = 0;
+        for(offset = 0, slot = 0; offset < length; offset += chunk, slot ^= 1)
+        {
+            chunk = (length - offset > LVGL_FONT_PRELOAD_CHUNK) ? LVGL_FONT_PRELOAD_CHUNK : (length - offset);
+            failed = lvgl_font_preload_wait(&request[slot]);        /* the chunk before the previous one */
+            if(failed)break;
+            
+            request[slot].address = address + offset;
+            request[slot].pbuffer = font->data + offset;
+            request[slot].size = chunk;
+            while(w25q256_async_submit(&request[slot]) != 0)
+            {
+                vTaskDelay(1);                                      /* queue full */
+            }
+        }
+        failed |= lvgl_font_preload_wait(&request[0]);
+        failed |= lvgl_font_preload_wait(&request[1]);
+        request[0].state = W25Q256_REQ_IDLE;
+        request[1].state = W25Q256_REQ_IDLE;
+        
+        if(failed)
+        {
+            myfree(SRAMEX, font->data);
+            font->data = NULL;
+            PRINT_ERROR("lvgl font %u preload failed\r\n", font->line_height);
+            continue;
+        }
+        
+        __DMB();
+        font->resident = length;                        /* the callbacks use the copy from now on */
+        lvgl_font_preload_info.used += length;
+        lvgl_font_preload_info.resident_num++;
+        if(length == size)lvgl_font_preload_info.full_num++;
+    }
+    
+    lvgl_font_preload_info.time_ms = (xTaskGetTickCount() - start_tick) * portTICK_PERIOD_MS;
+    lvgl_font_preload_info.done = 1;
+    PRINT_INFO("lvgl font preload: %u/%u fonts resident (%u full), %u KB of %u KB, %u ms\r\n",
+               lvgl_font_preload_info.resident_num, LVGL_FONT_PRELOAD_NUM, lvgl_font_preload_info.full_num,
+               lvgl_font_preload_info.used / 1024, LVGL_FONT_PRELOAD_BUDGET / 1024, lvgl_font_preload_info.time_ms);
+    
+#if LVGL_FONT_STRESS_TEST_BOOT
+    lvgl_font_stress_test(LVGL_FONT_STRESS_ROUNDS);     /* resident and flash fonts mixed */
+#endif
+    
+    vTaskDelete(NULL);
+}
+
+/**************************************************************
+函数名称 ： lvgl_font_buffer_get
+功    能 ： 取一个空闲的FLASH读缓冲, 每个绘制单元和LVGL任务各有一个
+参    数 ： 无
+返 回 值 ： 缓冲, NULL表示没有空闲缓冲
+作    者 ： ZeHou
+**************************************************************/
+static uint8_t *lvgl_font_buffer_get(void)
+{
+    uint8_t *buffer = NULL;
+    uint8_t i;
+    
+    lv_mutex_lock(&lvgl_font_cache.lock);
+    for(i = 0; i < LVGL_FONT_BUFFER_NUM; i++)
+    {
+        if(!(lvgl_font_cache.buffer_busy & (1 << i)))
+        {
+            lvgl_font_cache.buffer_busy |= 1 << i;
+            buffer = lvgl_font_buffer[i];
+            break;
+        }
+    }
+    lv_mutex_unlock(&lvgl_font_cache.lock);
+    
+    return buffer;
+}
+
+/**************************************************************
+函数名称 ： lvgl_font_buffer_put
+功    能 ： 归还lvgl_font_buffer_get取得的缓冲
+参    数 ： buffer: 缓冲
+返 回 值 ： 无
+作    者 ： ZeHou
+**************************************************************/
+static void lvgl_font_buffer_put(uint8_t *buffer)
+{
+    uint8_t i;
+    
+    lv_mutex_lock(&lvgl_font_cache.lock);
+    for(i = 0; i < LVGL_FONT_BUFFER_NUM; i++)
+    {
+        if(lvgl_font_buffer[i] == buffer)
+        {
+            lvgl_font_cache.buffer_busy &= ~(1 << i);
+            break;
+        }
+    }
+    lv_mutex_unlock(&lvgl_font_cache.lock);
+}
+
+/**************************************************************
+函数名称 ： lvgl_font_cache_hash
+功    能 ： 计算(字体, 字符)的哈希桶
+参    数 ： line_height: 字体行高(字体标识)
+            unicode: 字符编码
+返 回 值 ： 哈希桶序号
+作    者 ： ZeHou
+**************************************************************/
+static uint32_t lvgl_font_cache_hash(uint8_t line_height, uint32_t unicode)
+{
+    return (unicode * 31 + line_height) & (LVGL_FONT_CACHE_HASH - 1);
+}
+
+/**************************************************************
+函数名称 ： lvgl_font_cache_lru_unlink
+功    能 ： 将缓存项从LRU链表中移除
+参    数 ： index: 缓存项序号
+返 回 值 ： 无
+作    者 ： ZeHou
+**************************************************************/
+static void lvgl_font_cache_lru_unlink(uint16_t index)
+{
+    lvgl_font_cache_entry_struct *e = &lvgl_font_cache.entry[index];
+    
+    if(e->lru_prev != LVGL_FONT_CACHE_NONE)lvgl_font_cache.entry[e->lru_prev].lru_next = e->lru_next;
+    else lvgl_font_cache.lru_head = e->lru_next;
+    if(e->lru_next != LVGL_FONT_CACHE_NONE)lvgl_font_cache.entry[e->lru_next].lru_prev = e->lru_prev;
+    else lvgl_font_cache.lru_tail = e->lru_prev;
+}
+
+/**************************************************************
+函数名称 ： lvgl_font_cache_lru_push
+功    能 ： 将缓存项放到LRU链表头(最近使用)
+参    数 ： index: 缓存项序号
+返 回 值 ： 无
+作    者 ： ZeHou
+**************************************************************/
+static void lvgl_font_cache_lru_push(uint16_t index)
+{
+    lvgl_font_cache_entry_struct *e = &lvgl_font_cache.entry[index];
+    
+    e->lru_prev = LVGL_FONT_CACHE_NONE;
+    e->lru_next = lvgl_font_cache.lru_head;
+    if(lvgl_font_cache.lru_head != LVGL_FONT_CACHE_NONE)lvgl_font_cache.entry[lvgl_font_cache.lru_head].lru_prev = index;
+    else lvgl_font_cache.lru_tail = index;
+    lvgl_font_cache.lru_head = index;
+}
+
+/**************************************************************
+函数名称 ： lvgl_font_cache_evict
+功    能 ： 淘汰最久未使用的缓存项
+参    数 ： 无
+返 回 值 ： 被淘汰的缓存项序号
+作    者 ： ZeHou
+**************************************************************/
+static uint16_t lvgl_font_cache_evict(void)
+{
+    uint16_t index = lvgl_font_cache.lru_tail;
+    uint16_t *link;
+    lvgl_font_cache_entry_struct *e = &lvgl_font_cache.entry[index];
+    
+    lvgl_font_cache_lru_unlink(index);
+    
+    link = &lvgl_font_cache.hash[lvgl_font_cache_hash(e->line_height, e->unicode)];
+    while(*link != index)
+    {
+        link = &lvgl_font_cache.entry[*link].hash_next;
+    }
+    *link = e->hash_next;
+    
+    if(e->bitmap)
+    {
+        myfree(SRAMEX, e->bitmap);
+        e->bitmap = NULL;
+        lvgl_font_cache_info.used -= lv_draw_buf_width_to_stride(e->dsc.box_w, LV_COLOR_FORMAT_A8) * e->dsc.box_h;
+    }
+    e->line_height = 0;
+    
+    return index;
+}
+
+/**************************************************************
+函数名称 ： lvgl_font_cache_find
+功    能 ： 查找已缓存的字形, 调用者持有lvgl_font_cache.lock
+参    数 ： line_height: 字体行高(字体标识)
+            unicode: 字符编码
+返 回 值 ： 缓存项, NULL表示未缓存
+作    者 ： ZeHou
+**************************************************************/
+static lvgl_font_cache_entry_struct *lvgl_font_cache_find(uint8_t line_height, uint32_t unicode)
+{
+    lvgl_font_cache_entry_struct *e;
+    uint16_t index;
+    
+    if(lvgl_font_cache.entry == NULL)return NULL;
+    
+    for(index = lvgl_font_cache.hash[lvgl_font_cache_hash(line_height, unicode)]; index != LVGL_FONT_CACHE_NONE; index = e->hash_next)
+    {
+        e = &lvgl_font_cache.entry[index];
+        if((e->line_height == line_height) && (e->unicode == unicode))
+        {
+            lvgl_font_cache_lru_unlink(index);
+            lvgl_font_cache_lru_push(index);
+            return e;
+        }
+    }
+    
+    return NULL;
+}
+
+/**************************************************************
+函数名称 ： lvgl_font_cache_insert
+功    能 ： 缓存从FLASH读出的字形描述符, 调用者持有lvgl_font_cache.lock
+参    数 ： glyph: 读出的字形(unicode, line_height, pos, dsc有效)
+返 回 值 ： 缓存项, 其他线程已缓存时返回已有的项, NULL表示缓存不可用
+作    者 ： ZeHou
+**************************************************************/
+static lvgl_font_cache_entry_struct *lvgl_font_cache_insert(const lvgl_font_cache_entry_struct *glyph)
+{
+    lvgl_font_cache_entry_struct *e;
+    uint32_t bucket;
+    uint16_t index;
+    
+    e = lvgl_font_cache_find(glyph->line_height, glyph->unicode);
+    if((e != NULL) || (lvgl_font_cache.entry == NULL))return e;
+    
+    if(lvgl_font_cache.free_head != LVGL_FONT_CACHE_NONE)
+    {
+        index = lvgl_font_cache.free_head;
+        lvgl_font_cache.free_head = lvgl_font_cache.entry[index].hash_next;
+    }
+    else
+    {
+        index = lvgl_font_cache_evict();
+    }
+    
+    e = &lvgl_font_cache.entry[index];
+    e->unicode = glyph->unicode;
+    e->line_height = glyph->line_height;
+    e->pos = glyph->pos;
+    e->dsc = glyph->dsc;
+    e->bitmap = NULL;
+    
+    bucket = lvgl_font_cache_hash(e->line_height, e->unicode);
+    e->hash_next = lvgl_font_cache.hash[bucket];
+    lvgl_font_cache.hash[bucket] = index;
+    lvgl_font_cache_lru_push(index);
+    
+    return e;
+}
+
+/**************************************************************
+函数名称 ： lvgl_font_glyph_read
+功    能 ： 从外部FLASH读取字形的索引和描述符, 不持有缓存锁
+参    数 ： buffer: 调用者的FLASH读缓冲
+            glyph: unicode和line_height为输入, 输出pos和dsc
+返 回 值 ： 无
+作    者 ： ZeHou
+**************************************************************/
+static void lvgl_font_glyph_read(uint8_t *buffer, lvgl_font_cache_entry_struct *glyph)
+{
+    glyph->pos = *(const uint32_t *)__user_font_getdata(buffer, glyph->line_height, sizeof(x_header_t) + (glyph->unicode - __g_xbf_hd.min) * 4, 4);
+    if(glyph->pos != 0)
+    {
+        memcpy(&glyph->dsc, __user_font_getdata(buffer, glyph->line_height, glyph->pos, sizeof(glyph_dsc_t)), sizeof(glyph_dsc_t));
+    }
+}
+
+/**************************************************************
+函数名称 ： lvgl_font_glyph_get
+功    能 ： 取字形描述符, 未缓存时读FLASH后加入缓存
+参    数 ： buffer: 调用者的FLASH读缓冲
+            glyph: unicode和line_height为输入, 输出pos, dsc, 以及
+                   位图是否已缓存(bitmap非NULL, 仅作标志)
+返 回 值 ： 无
+作    者 ： ZeHou
+**************************************************************/
+static void lvgl_font_glyph_get(uint8_t *buffer, lvgl_font_cache_entry_struct *glyph)
+{
+    lvgl_font_cache_entry_struct *e;
+    
+    lv_mutex_lock(&lvgl_font_cache.lock);
+    e = lvgl_font_cache_find(glyph->line_height, glyph->unicode);
+    if(e != NULL)
+    {
+        lvgl_font_cache_info.hit++;
+        *glyph = *e;
+        lv_mutex_unlock(&lvgl_font_cache.lock);
+        return;
+    }
+    lvgl_font_cache_info.miss++;
+    lv_mutex_unlock(&lvgl_font_cache.lock);
+    
+    glyph->bitmap = NULL;
+    lvgl_font_glyph_read(buffer, glyph);
+    
+    lv_mutex_lock(&lvgl_font_cache.lock);
+    lvgl_font_cache_insert(glyph);
+    lv_mutex_unlock(&lvgl_font_cache.lock);
+}
 
-    w25q256_read_data(address + offset, lvgl_font_buffer, size);
+/**************************************************************
+函数名称 ： lvgl_font_cache_bitmap_alloc
+功    能 ： 为解码后的位图申请缓存, 超出预算时淘汰最久未使用的字形,
+            调用者持有lvgl_font_cache.lock
+参    数 ： e: 当前缓存项(位于LRU链表头, 不会被淘汰)
+            size: 位图字节数
+返 回 值 ： 位图缓存, NULL表示不缓存
+作    者 ： ZeHou
+**************************************************************/
+static uint8_t *lvgl_font_cache_bitmap_alloc(lvgl_font_cache_entry_struct *e, uint32_t size)
+{
+    uint8_t *bitmap = NULL;
+    uint16_t index;
+    
+    if(size > LVGL_FONT_CACHE_SIZE)return NULL;
     
-    return lvgl_font_buffer;
+    while(1)
+    {
+        if(lvgl_font_cache_info.used + size <= LVGL_FONT_CACHE_SIZE)
+        {
+            bitmap = (uint8_t *)mymalloc(SRAMEX, size);
+            if(bitmap != NULL)break;
+        }
+        if(lvgl_font_cache.lru_tail == (uint16_t)(e - lvgl_font_cache.entry))return NULL;
+        index = lvgl_font_cache_evict();
+        lvgl_font_cache.entry[index].hash_next = lvgl_font_cache.free_head;
+        lvgl_font_cache.free_head = index;
+    }
+    
+    lvgl_font_cache_info.used += size;
+    
+    return bitmap;
+}
+
+/**************************************************************
+函数名称 ： lvgl_font_a4_expand
+功    能 ： 4bpp字形位图展开为A8, 查opa4_pair_table一次处理两个像素,
+            一次写入四个像素; XBF位图的行之间不按字节对齐, 奇数宽度
+            时下一行从半个字节开始
+参    数 ： in: 4bpp位图, 高半字节为左侧像素
+            out: A8输出
+            w: 宽度(像素)
+            h: 高度(像素)
+            stride: 输出行跨度(字节)
+返 回 值 ： 无
+作    者 ： ZeHou
+**************************************************************/
+static void lvgl_font_a4_expand(const uint8_t *in, uint8_t *out, uint32_t w, uint32_t h, uint32_t stride)
+{
+    uint32_t x, quad, odd = 0;  /* odd: 本行第一个像素是*in的低半字节 */
+    uint16_t pair;
+    
+    for(; h > 0; h--, out += stride)
+    {
+        x = 0;
+        if(odd)
+        {
+            out[0] = opa4_table[*in++ & 0x0F];
+            x = 1;
+        }
+        for(; x + 3 < w; x += 4, in += 2)
+        {
+            quad = opa4_pair_table[in[0]] | ((uint32_t)opa4_pair_table[in[1]] << 16);
+            memcpy(out + x, &quad, 4);      /* 输出可能不按字对齐, 编译为一次非对齐存储 */
+        }
+        if(x + 1 < w)
+        {
+            pair = opa4_pair_table[*in++];
+            memcpy(out + x, &pair, 2);
+            x += 2;
+        }
+        if(x < w)
+        {
+            out[x] = opa4_table[*in >> 4];
+            odd = 1;
+        }
+        else
+        {
+            odd = 0;
+        }
+    }
 }
 
 static const void * __user_font_get_bitmap(lv_font_glyph_dsc_t * g_dsc, lv_draw_buf_t * draw_buf)
@@ -122,62 +745,92 @@ static const void * __user_font_get_bitmap(lv_font_glyph_dsc_t * g_dsc, lv_draw_
     uint32_t unicode_letter = g_dsc->gid.index;
     uint8_t * bitmap_out = draw_buf->data;
     const lv_font_t *font = g_dsc->resolved_font;
-
-    lv_font_fmt_txt_dsc_t * fdsc = (lv_font_fmt_txt_dsc_t *) font->dsc;
+    lvgl_font_cache_entry_struct glyph, *e;
+    const void *result = NULL;
+    uint8_t *buffer;
+    uint32_t cycles = DWT_CYCCNT;
 
     if(unicode_letter >__g_xbf_hd.max || unicode_letter<__g_xbf_hd.min ) {
         return NULL;
     }
+    
+    buffer = lvgl_font_buffer_get();
+    if(buffer == NULL) {
+        return NULL;
+    }
 
-    uint32_t unicode_offset = sizeof(x_header_t)+(unicode_letter-__g_xbf_hd.min)*4;
-    uint32_t *p_pos = (uint32_t *)__user_font_getdata(font->line_height, unicode_offset, 4);
-    if( p_pos[0] != 0 ) {
-        uint32_t pos = p_pos[0];
-        glyph_dsc_t * gdsc = (glyph_dsc_t*)__user_font_getdata(font->line_height, pos, sizeof(glyph_dsc_t));
-        glyph_dsc_t gdscPoint = {0};
-        memcpy(&gdscPoint, gdsc, sizeof(glyph_dsc_t));
-        gdsc = &gdscPoint;
-       
+    glyph.unicode = unicode_letter;
+    glyph.line_height = font->line_height;
+    lvgl_font_glyph_get(buffer, &glyph);
+    if( glyph.pos != 0 ) {
+        glyph_dsc_t * gdsc = &glyph.dsc;
         int32_t gsize = (int32_t) gdsc->box_w * gdsc->box_h;
-        if(gsize == 0) return NULL;
-        if(fdsc->bitmap_format == LV_FONT_FMT_TXT_PLAIN) {
-            const uint8_t * bitmap_in = __user_font_getdata(font->line_height, pos+sizeof(glyph_dsc_t), gdsc->box_w*gdsc->box_h*__g_xbf_hd.bpp/8);
-            uint8_t * bitmap_out_tmp = bitmap_out;
-            int32_t i = 0;
-            int32_t x, y;
-            uint32_t stride = lv_draw_buf_width_to_stride(gdsc->box_w, LV_COLOR_FORMAT_A8);
-
-            if(fdsc->bpp == 4) {
-                for(y = 0; y < gdsc->box_h; y ++) {
-                    for(x = 0; x < gdsc->box_w; x++, i++) {
-                        i = i & 0x1;
-                        if(i == 0) {
-                            bitmap_out_tmp[x] = opa4_table[(*bitmap_in) >> 4];
-                        }
-                        else if(i == 1) {
-                            bitmap_out_tmp[x] = opa4_table[(*bitmap_in) & 0xF];
-                            bitmap_in++;
-                        }
-                    }
-                    bitmap_out_tmp += stride;
+        uint32_t stride = lv_draw_buf_width_to_stride(gdsc->box_w, LV_COLOR_FORMAT_A8);
+        uint32_t bytes = (gsize * __g_xbf_hd.bpp + 7) / 8;
+        
+        if(glyph.bitmap) {
+            /* copy under the lock, another thread may evict the glyph */
+            lv_mutex_lock(&lvgl_font_cache.lock);
+            e = lvgl_font_cache_find(glyph.line_height, glyph.unicode);
+            if((e != NULL) && (e->bitmap != NULL)) {
+                memcpy(bitmap_out, e->bitmap, stride * gdsc->box_h);
+                lvgl_font_cache_info.bitmap_hit++;
+                result = draw_buf;
+            }
+            lv_mutex_unlock(&lvgl_font_cache.lock);
+        }
+        
+        if((result == NULL) && (gsize != 0) && (bytes <= LVGL_FONT_BUFFER_SIZE)) {
+            const uint8_t * bitmap_in = __user_font_getdata(buffer, font->line_height, glyph.pos+sizeof(glyph_dsc_t), bytes);
+            uint32_t decode = DWT_CYCCNT;
+
+            lvgl_font_a4_expand(bitmap_in, bitmap_out, gdsc->box_w, gdsc->box_h, stride);
+            decode = (DWT_CYCCNT - decode) / (SystemCoreClock / 1000000);
+            
+            lv_mutex_lock(&lvgl_font_cache.lock);
+            e = lvgl_font_cache_insert(&glyph);
+            if((e != NULL) && (e->bitmap == NULL)) {
+                e->bitmap = lvgl_font_cache_bitmap_alloc(e, stride * gdsc->box_h);
+                if(e->bitmap) {
+                    memcpy(e->bitmap, bitmap_out, stride * gdsc->box_h);
                 }
             }
-            return draw_buf;
+            lvgl_font_cache_info.bitmap_miss++;
+            lvgl_font_cache_info.decode_us += decode;
+            lvgl_font_cache_info.decode_pixels += gsize;
+            lv_mutex_unlock(&lvgl_font_cache.lock);
+            result = draw_buf;
         }
     }
-    return NULL;
+    lvgl_font_buffer_put(buffer);
+    lvgl_font_cache_info.time_us += (DWT_CYCCNT - cycles) / (SystemCoreClock / 1000000);
+    
+    return result;
 }
 
 
 static bool __user_font_get_glyph_dsc(const lv_font_t * font, lv_font_glyph_dsc_t * dsc_out, uint32_t unicode_letter, uint32_t unicode_letter_next) {
+    lvgl_font_cache_entry_struct glyph;
+    uint8_t *buffer;
+    uint32_t cycles = DWT_CYCCNT;
+    
     if( unicode_letter>__g_xbf_hd.max || unicode_letter<__g_xbf_hd.min ) {
-        return NULL;
+        return false;
+    }
+    
+    buffer = lvgl_font_buffer_get();
+    if(buffer == NULL) {
+        return false;
     }
 
-    uint32_t unicode_offset = sizeof(x_header_t)+(unicode_letter-__g_xbf_hd.min)*4;
-    uint32_t *p_pos = (uint32_t *)__user_font_getdata(font->line_height, unicode_offset, 4);
-    if( p_pos[0] != 0 ) {
-        glyph_dsc_t * gdsc = (glyph_dsc_t*)__user_font_getdata(font->line_height, p_pos[0], sizeof(glyph_dsc_t));
+    glyph.unicode = unicode_letter;
+    glyph.line_height = font->line_height;
+    lvgl_font_glyph_get(buffer, &glyph);
+    lvgl_font_buffer_put(buffer);
+    lvgl_font_cache_info.time_us += (DWT_CYCCNT - cycles) / (SystemCoreClock / 1000000);
+    
+    if( glyph.pos != 0 ) {
+        glyph_dsc_t * gdsc = &glyph.dsc;
         dsc_out->adv_w = gdsc->adv_w;
         dsc_out->box_h = gdsc->box_h;
         dsc_out->box_w = gdsc->box_w;
@@ -300,3 +953,245 @@ const lv_font_t lv_font_fzst_56 = {
     .line_height = 59,
     .base_line = 0,
 };
+
+#define LVGL_FONT_STRESS_CHARS      64                  /* 每个字体的字符: 32个ASCII, 32个汉字 */
+#define LVGL_FONT_STRESS_FONT_NUM   (sizeof(lvgl_font_stress_font) / sizeof(lvgl_font_stress_font[0]))
+
+/*!
+    \brief      Stress test label structure, one per font
+*/
+typedef struct{
+    const lv_font_t *font;                  /*!< Font of the label */
+    int32_t y;                              /*!< Top row in its layer */
+    int32_t h;                              /*!< Rows, the text wraps at LVGL_FONT_STRESS_WIDTH */
+    uint32_t reference;                     /*!< Pixel hash drawn alone */
+}lvgl_font_stress_label_struct;
+
+static const lv_font_t * const lvgl_font_stress_font[] = {
+    &lv_font_simsun_12, &lv_font_fzst_12, &lv_font_simsun_16, &lv_font_fzst_16,
+    &lv_font_simsun_24, &lv_font_fzst_24, &lv_font_simsun_32, &lv_font_fzst_32,
+    &lv_font_simsun_48, &lv_font_fzst_48, &lv_font_fzst_56,
+};
+static char lvgl_font_stress_text[32 + 32 * 3 + 1];    /* UTF-8 */
+static volatile uint32_t lvgl_font_stress_clears;
+
+/**************************************************************
+函数名称 ： lvgl_font_stress_hash
+功    能 ： FNV-1a散列
+参    数 ： hash: 初值
+            data: 数据
+            size: 字节数
+返 回 值 ： 散列值
+作    者 ： ZeHou
+**************************************************************/
+static uint32_t lvgl_font_stress_hash(uint32_t hash, const uint8_t *data, uint32_t size)
+{
+    while(size--)
+    {
+        hash = (hash ^ *data++) * 16777619U;
+    }
+    
+    return hash;
+}
+
+/**************************************************************
+函数名称 ： lvgl_font_stress_clear
+功    能 ： 软件定时器回调, 在绘制单元取字形的同时清空字形缓存,
+            使查找, 读FLASH, 插入和淘汰交错进行
+参    数 ： timer: 定时器
+返 回 值 ： 无
+作    者 ： ZeHou
+**************************************************************/
+static void lvgl_font_stress_clear(TimerHandle_t timer)
+{
+    (void)timer;
+    lvgl_font_cache_clear();
+    lvgl_font_stress_clears++;
+}
+
+/**************************************************************
+函数名称 ： lvgl_font_stress_layer
+功    能 ： 在画布图层上绘制标签first, first + step, ..., 一次提交,
+            互不重叠的标签由各绘制单元同时渲染; 然后计算每个标签
+            区域的像素散列, 记为参考或与参考比较
+参    数 ： canvas: 画布
+            label: 标签表
+            first: 第一个标签
+            step: 标签间隔
+            reference: 1: 记录参考, 0: 与参考比较
+返 回 值 ： 与参考不同的标签数
+作    者 ： ZeHou
+**************************************************************/
+static uint32_t lvgl_font_stress_layer(lv_obj_t *canvas, lvgl_font_stress_label_struct *label, uint32_t first, uint32_t step, uint8_t reference)
+{
+    lv_draw_buf_t *draw_buf = lv_canvas_get_draw_buf(canvas);
+    lv_draw_label_dsc_t dsc;
+    lv_layer_t layer;
+    lv_area_t area;
+    uint32_t i, hash, mismatch = 0;
+    int32_t y;
+    
+    lv_canvas_fill_bg(canvas, lv_color_black(), LV_OPA_COVER);
+    lv_canvas_init_layer(canvas, &layer);
+    for(i = first; i < LVGL_FONT_STRESS_FONT_NUM; i += step)
+    {
+        lv_draw_label_dsc_init(&dsc);
+        dsc.font = label[i].font;
+        dsc.color = lv_color_white();
+        dsc.text = lvgl_font_stress_text;
+        area.x1 = 0;
+        area.y1 = label[i].y;
+        area.x2 = LVGL_FONT_STRESS_WIDTH - 1;
+        area.y2 = label[i].y + label[i].h - 1;
+        lv_draw_label(&layer, &dsc, &area);
+    }
+    lv_canvas_finish_layer(canvas, &layer);             /* 分派给绘制单元并等待完成 */
+    
+    for(i = first; i < LVGL_FONT_STRESS_FONT_NUM; i += step)
+    {
+        hash = 2166136261U;
+        for(y = label[i].y; y < label[i].y + label[i].h; y++)
+        {
+            hash = lvgl_font_stress_hash(hash, draw_buf->data + y * draw_buf->header.stride, LVGL_FONT_STRESS_WIDTH * 2);
+        }
+        
+        if(reference)
+        {
+            label[i].reference = hash;
+        }
+        else if(hash != label[i].reference)
+        {
+            mismatch++;
+        }
+    }
+    
+    return mismatch;
+}
+
+/**************************************************************
+函数名称 ： lvgl_font_stress_test
+功    能 ： 字体回调的并发压力测试: 11种字体的标签(ASCII和汉字混合)
+            轮流分到LVGL_FONT_STRESS_LAYERS个画布图层, 先逐个单独
+            绘制得到参考, 再按图层整体提交, 同一图层的标签由各绘制
+            单元在各自的线程中同时渲染, 期间软件定时器每
+            LVGL_FONT_STRESS_CLEAR_MS清空一次字形缓存, 任何一个标签
+            的像素与参考不同即失败. lv_lock只在排版和提交一个图层时
+            持有, 取字形在绘制单元线程中进行, 图层之间LVGL任务照常
+            刷新界面
+参    数 ： rounds: 每个图层的绘制次数
+返 回 值 ： 0: 通过, -1: 无字库或内存不足, 大于0: 不一致的标签数
+作    者 ： ZeHou
+**************************************************************/
+int lvgl_font_stress_test(uint32_t rounds)
+{
+    lvgl_font_stress_label_struct label[LVGL_FONT_STRESS_FONT_NUM];
+    lv_obj_t *canvas[LVGL_FONT_STRESS_LAYERS];
+    uint8_t *buffer[LVGL_FONT_STRESS_LAYERS];
+    int32_t height[LVGL_FONT_STRESS_LAYERS];
+    TimerHandle_t timer;
+    TickType_t start_tick;
+    lv_point_t size;
+    uint32_t i, k, unicode, round, ready = 0, renders = 0, mismatch = 0;
+    char *text = lvgl_font_stress_text;
+    int result = -1;
+    
+    if((font_info.fontok != 0xAA) || (xTaskGetSchedulerState() != taskSCHEDULER_RUNNING))return -1;
+    
+    /* 字形与原测试相同: 32个ASCII和32个分散的汉字 */
+    for(k = 0; k < LVGL_FONT_STRESS_CHARS; k++)
+    {
+        if(k < 32)
+        {
+            *text++ = (char)(0x21 + k * 3);
+        }
+        else
+        {
+            unicode = 0x4E00 + (k - 32) * 331;
+            *text++ = (char)(0xE0 | (unicode >> 12));
+            *text++ = (char)(0x80 | ((unicode >> 6) & 0x3F));
+            *text++ = (char)(0x80 | (unicode & 0x3F));
+        }
+    }
+    *text = '\0';
+    
+    /* 排版: 字体轮流分到各图层, 同一图层内的标签上下排列互不重叠 */
+    memset(height, 0x00, sizeof(height));
+    lv_lock();
+    for(i = 0; i < LVGL_FONT_STRESS_FONT_NUM; i++)
+    {
+        label[i].font = lvgl_font_stress_font[i];
+        lv_text_get_size(&size, lvgl_font_stress_text, label[i].font, 0, 0, LVGL_FONT_STRESS_WIDTH, LV_TEXT_FLAG_NONE);
+        label[i].y = height[i % LVGL_FONT_STRESS_LAYERS];
+        label[i].h = size.y;
+        height[i % LVGL_FONT_STRESS_LAYERS] += size.y;
+    }
+    for(i = 0; i < LVGL_FONT_STRESS_LAYERS; i++)
+    {
+        canvas[i] = NULL;
+        buffer[i] = (uint8_t *)mymalloc(SRAMEX, LV_CANVAS_BUF_SIZE(LVGL_FONT_STRESS_WIDTH, height[i], 16, LV_DRAW_BUF_STRIDE_ALIGN));
+        if(buffer[i] == NULL)continue;
+        canvas[i] = lv_canvas_create(NULL);             /* 不显示的屏幕 */
+        lv_canvas_set_buffer(canvas[i], buffer[i], LVGL_FONT_STRESS_WIDTH, height[i], LV_COLOR_FORMAT_RGB565);
+        ready++;
+    }
+    lv_unlock();
+    
+    timer = xTimerCreate("font_stress", pdMS_TO_TICKS(LVGL_FONT_STRESS_CLEAR_MS), pdTRUE, NULL, lvgl_font_stress_clear);
+    
+    if((ready == LVGL_FONT_STRESS_LAYERS) && (timer != NULL))
+    {
+        /* 参考: 每次只提交一个标签, 同一时刻只有一个绘制单元取字形 */
+        lvgl_font_cache_clear();
+        for(i = 0; i < LVGL_FONT_STRESS_FONT_NUM; i++)
+        {
+            lv_lock();
+            lvgl_font_stress_layer(canvas[i % LVGL_FONT_STRESS_LAYERS], label, i, LVGL_FONT_STRESS_FONT_NUM, 1);
+            lv_unlock();
+        }
+        
+        start_tick = xTaskGetTickCount();
+        lvgl_font_stress_clears = 0;
+        lvgl_font_cache_clear();
+        xTimerStart(timer, portMAX_DELAY);
+        for(round = 0; round < rounds; round++)
+        {
+            for(i = 0; i < LVGL_FONT_STRESS_LAYERS; i++)
+            {
+                lv_lock();
+                mismatch += lvgl_font_stress_layer(canvas[i], label, i, LVGL_FONT_STRESS_LAYERS, 0);
+                lv_unlock();
+                vTaskDelay(1);                          /* 图层之间让LVGL任务刷新界面 */
+            }
+            renders += LVGL_FONT_STRESS_FONT_NUM;
+        }
+        xTimerStop(timer, portMAX_DELAY);               /* 定时器任务优先级最高, 返回时回调已不再运行 */
+        
+        result = (int)mismatch;
+        PRINT_INFO("lvgl font stress: %u draw units, %u layers, %u fonts, %u labels, %u cache clears, %u ms, %u mismatches\r\n",
+                   (uint32_t)LV_DRAW_SW_DRAW_UNIT_CNT, (uint32_t)LVGL_FONT_STRESS_LAYERS, (uint32_t)LVGL_FONT_STRESS_FONT_NUM,
+                   renders, lvgl_font_stress_clears, (xTaskGetTickCount() - start_tick) * portTICK_PERIOD_MS, mismatch);
+    }
+    
+    if(timer != NULL)
+    {
+        xTimerDelete(timer, portMAX_DELAY);
+    }
+    lv_lock();
+    for(i = 0; i < LVGL_FONT_STRESS_LAYERS; i++)
+    {
+        if(canvas[i] != NULL)lv_obj_delete(canvas[i]);
+        myfree(SRAMEX, buffer[i]);
+    }
+    lv_unlock();
+    
+    if(result < 0)
+    {
+        PRINT_ERROR("lvgl font stress test not run, out of memory\r\n");
+    }
+    else if(result > 0)
+    {
+        PRINT_ERROR("lvgl font stress test failed, %u labels differ\r\n", mismatch);
+    }
+    
+    return result;
+}
@@ -0,0 +1,100 @@
+/*!
+    \file       lvgl_font_config.h
+    \brief      LVGL external XBF font header file
+    \version    1.0
+    \date       2025-09-01
+    \author     Ze-Hou
+    \note       the XBF fonts live in the W25Q256, a glyph costs an index
+                read, a descriptor read and a bitmap read plus the 4bpp to A8
+                expansion. Decoded glyphs are kept in an LRU cache in SDRAM
+                keyed by (font, unicode): descriptors (also of glyphs missing
+                from the font) in LVGL_FONT_CACHE_NUM entries, A8 bitmaps
+                within LVGL_FONT_CACHE_SIZE bytes. A hit costs one memcpy of
+                the bitmap into the LVGL draw buffer. A miss expands the 4bpp
+                bitmap with a 256-entry byte-pair table, four pixels per
+                store; decode_us / decode_pixels give the expansion rate.
+                The glyphs stay A8 for LVGL: the software renderer blends every
+                A1/A2/A4/A8 glyph as an 8-bit mask, it takes no packed A4.
+                The callbacks are reentrant: each caller (LVGL task, draw
+                units) reads the flash into its own buffer and decodes
+                without a lock, the OSPI is held by w25q256_read_data for one
+                transaction and the cache lock only for lookups and updates,
+                so the draw units render text in parallel.
+                lvgl_font_preload_start copies the index tables (whole fonts
+                when LVGL_FONT_PRELOAD_BUDGET allows) of LVGL_FONT_PRELOAD_LIST
+                into SDRAM from a low priority task: MDMA chunk reads queued
+                to the W25Q256 flash task, two in flight, so they run in order
+                with the flash programs and erases and the preload task never
+                holds the OSPI lock itself. The callbacks read a resident font in
+                place instead of from the flash.
+                lvgl_font_stress_test draws text of all fonts on canvas
+                layers, the labels of a layer are rendered by the draw units
+                side by side while a timer clears the glyph cache, and
+                compares every label with a reference drawn alone
+                (LVGL_FONT_STRESS_TEST_BOOT runs it after the preload).
+*/
+
+#ifndef __LVGL_FONT_CONFIG_H
+#define __LVGL_FONT_CONFIG_H
+#include <stdint.h>
+#include "lv_conf.h"
+
+#define LVGL_FONT_BUFFER_SIZE           2176                /*!< flash read buffer (DTCM), largest 4bpp glyph bitmap */
+#define LVGL_FONT_BUFFER_NUM            (LV_DRAW_SW_DRAW_UNIT_CNT + 1)  /*!< one per draw unit and one for the LVGL task, at most 8 */
+#define LVGL_FONT_CACHE_NUM             1024                /*!< glyph descriptors kept, at most 65535 */
+#define LVGL_FONT_CACHE_HASH            256                 /*!< hash buckets, power of 2 */
+#define LVGL_FONT_CACHE_SIZE            (1024 * 1024)       /*!< bytes of decoded A8 bitmaps kept (SDRAM) */
+
+/* font preload configuration */
+#define LVGL_FONT_PRELOAD_NUM           4                   /*!< fonts in LVGL_FONT_PRELOAD_LIST */
+#define LVGL_FONT_PRELOAD_LIST          {25, 34, 17, 37}    /*!< line heights of fzst_24, fzst_32, fzst_16, simsun_32, most used first */
+#define LVGL_FONT_PRELOAD_BUDGET        (8 * 1024 * 1024)   /*!< SDRAM bytes for resident fonts, 0: no preload */
+#define LVGL_FONT_PRELOAD_FULL          1                   /*!< 1: whole font when it fits, 0: index tables only */
+#define LVGL_FONT_PRELOAD_CHUNK         (8 * 1024)          /*!< bytes per MDMA transfer, the flash is locked meanwhile */
+#define LVGL_FONT_PRELOAD_TASK_PRIO     1                   /*!< lowest application priority */
+#define LVGL_FONT_PRELOAD_STK_SIZE      1024                /*!< preload task stack size, the stress test draws from it */
+
+/* font stress test configuration */
+#define LVGL_FONT_STRESS_TEST_BOOT      1                   /*!< 1: run lvgl_font_stress_test after the preload */
+#define LVGL_FONT_STRESS_ROUNDS         4                   /*!< draws of every layer */
+#define LVGL_FONT_STRESS_LAYERS         2                   /*!< canvas layers (SDRAM, RGB565), the fonts are spread over them */
+#define LVGL_FONT_STRESS_WIDTH          480                 /*!< layer width, the text wraps there */
+#define LVGL_FONT_STRESS_CLEAR_MS       5                   /*!< glyph cache cleared this often while the layers are drawn */
+
+/*!
+    \brief      Glyph cache statistics structure
+*/
+typedef struct
+{
+    uint32_t hit;                                       /*!< Descriptor lookups served by the cache */
+    uint32_t miss;                                      /*!< Descriptor lookups read from the flash */
+    uint32_t bitmap_hit;                                /*!< Bitmaps copied from the cache */
+    uint32_t bitmap_miss;                               /*!< Bitmaps read from the flash and decoded */
+    uint32_t used;                                      /*!< Bitmap bytes in the cache */
+    uint32_t time_us;                                   /*!< Total time spent in the font callbacks */
+    uint32_t decode_us;                                 /*!< Of that, time spent expanding 4bpp bitmaps to A8 */
+    uint32_t decode_pixels;                             /*!< Pixels expanded */
+}lvgl_font_cache_info_struct;
+
+extern lvgl_font_cache_info_struct lvgl_font_cache_info;
+
+/*!
+    \brief      Font preload statistics structure
+*/
+typedef struct
+{
+    uint32_t used;                                      /*!< SDRAM bytes holding fonts */
+    uint8_t resident_num;                               /*!< Fonts read from SDRAM */
+    uint8_t full_num;                                   /*!< Of those, fonts copied whole (else index table only) */
+    volatile uint8_t done;                              /*!< 1: preload finished */
+    uint32_t time_ms;                                   /*!< Preload duration */
+}lvgl_font_preload_info_struct;
+
+extern lvgl_font_preload_info_struct lvgl_font_preload_info;
+
+/* function declarations */
+void lvgl_font_buffer_malloc(void);                                 /* allocate the font buffer and the glyph cache */
+void lvgl_font_cache_clear(void);                                   /* drop all cached glyphs */
+void lvgl_font_preload_start(void);                                 /* copy the most used fonts into SDRAM in the background */
+int lvgl_font_stress_test(uint32_t rounds);                         /* draw mixed fonts through the draw units and compare */
+#endif /* __LVGL_FONT_CONFIG_H */
@@ -14,10 +14,10 @@
 #include "lvgl.h"
 #include "lvgl_setting.h"
 #include "lvgl_usart.h"
+#include "./LVGL/font/lvgl_font_config.h"
 
 /* External function declarations */
 extern TickType_t xTaskGetTickCount( void );
-extern void lvgl_font_buffer_malloc(void);
 extern void lvgl_power_chart_buffer_malloc(void);
 
 /* External input device declarations */
@@ -57,9 +57,12 @@ void lvgl_config(void)
         lv_log_register_print_cb(lvgl_log_cb);
     #endif
     
-    /* Allocate memory for LVGL font buffer */
+    /* Allocate memory for LVGL font buffer and glyph cache */
     lvgl_font_buffer_malloc();
     
+    /* Copy the most used fonts into SDRAM once the scheduler runs */
+    lvgl_font_preload_start();
+    
     /* Allocate memory for LVGL power chart buffer */
     lvgl_power_chart_buffer_malloc();
 }
@@ -4,6 +4,7 @@
 #include "gd32h7xx_timer.h"
 #include "./USART/usart.h"
 #include "./MALLOC/malloc.h"
+#include "./FATFS/storage_service.h"
 
 extern void reset_dap_link_state(void);
 extern volatile uint8_t gDebuggerOnLineIdleFlag;
@@ -14,8 +15,9 @@ lvgl_debugger_struct lvgl_debugger;
 static lvgl_debugger_download_struct lvgl_debugger_download;
 
 volatile static uint8_t connect_status = 0;
+volatile static uint8_t download_busy = 0;
 volatile static uint32_t read_address = 0;
-volatile static uint16_t read_size = 0;
+volatile static uint32_t read_size = 0;
 static char download_file_path[FF_LFN_BUF + 1];
 volatile uint32_t download_file_size = 0;
 volatile static uint32_t download_count = 0;
@@ -23,12 +25,20 @@ volatile static float download_time = 0.0;
 volatile static uint16_t erase_count_check = 0;
 volatile static uint16_t download_count_check = 0;
 volatile static uint16_t verify_count_check = 0;
+flash_readback_struct debugger_readback;
+flash_readback_speed_struct debugger_readback_speed[FLASH_READBACK_SWEEP_NUM];
 
 /* static function declarations */
 static void lvgl_flm_select_msgbox_creat(void);
 static void flm_file_select(lv_obj_t *parent);
 static void bin_file_select(lv_obj_t *parent);
 static uint32_t get_debugger_bin_file_size(void);
+static void recipe_file_select(lv_obj_t *parent);
+static void lvgl_recipe_report_show(void);
+static void lvgl_flm_library_select(void);
+static void lvgl_readback_msgbox_creat(void);
+static void lvgl_readback_report_show(uint8_t sweep);
+static void lvgl_debugger_busy_set(uint8_t busy);
 
 /**************************************************************
 函数名称 ： flm_prase_callback
@@ -43,6 +53,69 @@ static void flm_prase_callback(void)
     myfree(SRAMIN, flash_device.sectors);
 }
 
+/**************************************************************
+函数名称 ： lvgl_debugger_busy_set
+功    能 ： 后台下载任务运行期间禁用关闭、连接、下载、配方和回读
+            按钮，防止在任务使用算法和配方时释放它们或断开目标，
+            防止重复创建定时器以及与任务同时访问SWD
+参    数 ： busy: 1 后台任务开始，0 后台任务结束
+返 回 值 ： 无
+作    者 ： ZeHou
+**************************************************************/
+static void lvgl_debugger_busy_set(uint8_t busy)
+{
+    download_busy = busy;
+    if(busy)
+    {
+        lv_obj_remove_flag(lvgl_debugger.close_btn, LV_OBJ_FLAG_CLICKABLE);
+        lv_obj_remove_flag(lvgl_debugger.connect_btn, LV_OBJ_FLAG_CLICKABLE);
+        lv_obj_remove_flag(lvgl_debugger.download_btn, LV_OBJ_FLAG_CLICKABLE);
+        lv_obj_remove_flag(lvgl_debugger.recipe_btn, LV_OBJ_FLAG_CLICKABLE);
+        lv_obj_remove_flag(lvgl_debugger.read_btn, LV_OBJ_FLAG_CLICKABLE);
+    }
+    else
+    {
+        lv_obj_add_flag(lvgl_debugger.close_btn, LV_OBJ_FLAG_CLICKABLE);
+        lv_obj_add_flag(lvgl_debugger.connect_btn, LV_OBJ_FLAG_CLICKABLE);
+        lv_obj_add_flag(lvgl_debugger.download_btn, LV_OBJ_FLAG_CLICKABLE);
+        lv_obj_add_flag(lvgl_debugger.recipe_btn, LV_OBJ_FLAG_CLICKABLE);
+        lv_obj_add_flag(lvgl_debugger.read_btn, LV_OBJ_FLAG_CLICKABLE);
+    }
+}
+
+/**************************************************************
+函数名称 ： msgbox_library_btn_event_cb
+功    能 ： 消息框重建算法库索引按钮事件回调
+参    数 ： e
+返 回 值 ： 无
+作    者 ： ZeHou
+**************************************************************/
+static void msgbox_library_btn_event_cb(lv_event_t *e)
+{
+    int count;
+    char text[40];
+    lv_event_code_t code = lv_event_get_code(e);
+    
+    switch(code)
+    {
+        case LV_EVENT_CLICKED:
+            lv_msgbox_close(lvgl_debugger.msgbox);
+            count = flm_library_index_build();
+            if(count < 0)
+            {
+                lvgl_show_error_msgbox_creat("算法库索引建立失败，请检查" FLM_LIBRARY_PATH "目录！");
+            }
+            else
+            {
+                snprintf(text, sizeof(text), "FLM library: %d devices indexed", count);
+                lv_textarea_set_text(lvgl_debugger.textarea, text);
+            }
+            break;
+        
+        default: break;
+    }
+}
+
 /**************************************************************
 函数名称 ： timer_cb
 功    能 ： 定时器回调
@@ -74,13 +147,22 @@ static void timer_cb(lv_timer_t *timer)
                         lv_label_set_text(lvgl_debugger.download_update_label, "E VFY.");
                         break;
                     
+                    case 5:
+                        lv_label_set_text_fmt(lvgl_debugger.download_update_label, "E RCP%u.", flash_recipe->step_done + 1);
+                        lvgl_recipe_report_show();
+                        break;
+                    
+                    case 7:
+                        lv_label_set_text(lvgl_debugger.download_update_label, "E RDB.");
+                        break;
+                    
                     default: break;
                 }
                 if(lvgl_debugger_download.error)    /* 只要有错误发送就终止当前下载 */
                 {
                     lv_led_off(lvgl_debugger.download_led);
                     lv_timer_delete(lvgl_debugger.timer);
-                    lv_obj_add_flag(lvgl_debugger.download_btn, LV_OBJ_FLAG_CLICKABLE);
+                    lvgl_debugger_busy_set(0);
                 }
                 break;
                 
@@ -119,7 +201,41 @@ static void timer_cb(lv_timer_t *timer)
                     lv_label_set_text_fmt(lvgl_debugger.download_label, "%uc, %.1fms", download_count, download_time);
                     lv_led_off(lvgl_debugger.download_led);
                     lv_timer_delete(lvgl_debugger.timer);
-                    lv_obj_add_flag(lvgl_debugger.download_btn, LV_OBJ_FLAG_CLICKABLE);
+                    lvgl_debugger_busy_set(0);
+                }
+                break;
+                
+            case 5:
+                /* 配方执行中，run_count为当前步骤，全部完成时为步骤数 */
+                if((lvgl_debugger_download.phase == FLASH_RECIPE_PHASE_DONE) && (lvgl_debugger_download.run_count == flash_recipe->step_num))
+                {
+                    download_count++;
+                    lv_label_set_text_fmt(lvgl_debugger.download_label, "%uc, %ums", download_count, flash_recipe->total_time_ms);
+                    lv_label_set_text(lvgl_debugger.download_update_label, "R OK");
+                    lvgl_recipe_report_show();
+                    lv_led_off(lvgl_debugger.download_led);
+                    lv_timer_delete(lvgl_debugger.timer);
+                    lvgl_debugger_busy_set(0);
+                }
+                else
+                {
+                    lv_label_set_text_fmt(lvgl_debugger.download_update_label, "R %u/%u %c", lvgl_debugger_download.run_count + 1, flash_recipe->step_num, "AEPVD"[lvgl_debugger_download.phase]);
+                }
+                break;
+                
+            case 7:
+                /* 回读进度百分比，100表示全部写入文件 */
+                if(lvgl_debugger_download.run_count == 100)
+                {
+                    lv_label_set_text(lvgl_debugger.download_update_label, "B OK");
+                    lvgl_readback_report_show(debugger_readback.swj_clock == 0 && debugger_readback_speed[0].swj_clock != 0);
+                    lv_led_off(lvgl_debugger.download_led);
+                    lv_timer_delete(lvgl_debugger.timer);
+                    lvgl_debugger_busy_set(0);
+                }
+                else
+                {
+                    lv_label_set_text_fmt(lvgl_debugger.download_update_label, "B %u%%", lvgl_debugger_download.run_count);
                 }
                 break;
                 
@@ -191,8 +307,11 @@ static void closebtn_event_handler(lv_event_t *e)
     switch(code)
     {
         case LV_EVENT_CLICKED:
+            if(download_busy)break;                     /* 后台任务仍在使用算法和配方 */
             lvgl_debugger_off_line_delete();
             flm_prase_callback();
+            flash_recipe_free();
+            flash_recipe_algo_cache_clear();
             break;
         
         default: break;
@@ -214,6 +333,7 @@ static void flm_file_select_event_handler(lv_event_t *e)
     switch(code)
     {
         case LV_EVENT_CLICKED:
+            if(download_busy)break;                     /* 后台任务运行期间不能更换算法 */
             lvgl_flm_select_msgbox_creat();
             break;
         
@@ -249,6 +369,10 @@ static void btn_event_handler(lv_event_t *e)
                 {
                     if(gDebuggerOnLineIdleFlag == 0)
                     {
+                        if(strcmp(lv_label_get_text(lvgl_debugger.flm_file_label), "NULL") == 0)
+                        {
+                            lvgl_flm_library_select();  /* 未选择算法时按目标ID从算法库自动选择 */
+                        }
                         if(strcmp(lv_label_get_text(lvgl_debugger.flm_file_label), "NULL") != 0)
                         {
                             error_code = target_flash_init(flash_device.devAdr);
@@ -299,7 +423,11 @@ static void btn_event_handler(lv_event_t *e)
                 {
                     read_address = atoi(lv_textarea_get_text(lvgl_debugger.address_textarea));
                     read_size = atoi(lv_textarea_get_text(lvgl_debugger.size_textarea));
-                    if(((read_address + read_size) <= flash_device.szDev) && (read_size <= 1024) && read_size)
+                    if(((read_address + read_size) <= flash_device.szDev) && (read_size > 1024))
+                    {
+                        lvgl_readback_msgbox_creat();  /* 大于1024字节时回读到文件 */
+                    }
+                    else if(((read_address + read_size) <= flash_device.szDev) && (read_size <= 1024) && read_size)
                     {
                         buffer_read = (uint8_t *)mymalloc(SRAMDTCM, read_size);
                         buffer_textarea = (char *)mymalloc(SRAMDTCM, BUFFER_TEXTAREA_SIZE);
@@ -372,7 +500,7 @@ static void btn_event_handler(lv_event_t *e)
                         verify_count_check = download_count_check;
                         if((download_file_size <= flash_device.szDev) && download_file_size)
                         {
-                            lv_obj_remove_flag(lvgl_debugger.download_btn, LV_OBJ_FLAG_CLICKABLE);
+                            lvgl_debugger_busy_set(1);
                             lvgl_debugger.timer = lv_timer_create(timer_cb, 100, NULL);
                             if(DBUGGER_DOWNLOADTask_Handler != NULL)
                             {
@@ -390,6 +518,17 @@ static void btn_event_handler(lv_event_t *e)
                     lvgl_show_error_msgbox_creat("请先连接目标设备！");
                 }
             }
+            else if(obj == lvgl_debugger.recipe_btn)
+            {
+                if(gDebuggerOnLineIdleFlag == 0)
+                {
+                    recipe_file_select(lvgl_debugger.main_obj);
+                }
+                else
+                {
+                    lvgl_show_error_msgbox_creat("在线调试器与离线调试器不能同时使用！");
+                }
+            }
             break;
         
         default: break;
@@ -476,24 +615,26 @@ static void bin_file_select_event_handler(lv_event_t *e)
 **************************************************************/
 static uint32_t get_debugger_bin_file_size(void)
 {
-    uint32_t file_size;
-    FRESULT fresult;
-    FIL *file;
+    storage_request_struct request = {0};
+    FILINFO *fileinfo;
+    uint32_t file_size = 0;
     
-    file = (FIL *)mymalloc(SRAMIN, sizeof(FIL));
-    if((file == NULL))
+    fileinfo = (FILINFO *)mymalloc(SRAMIN, sizeof(FILINFO));
+    if((fileinfo == NULL))
     {
         return 0;
     }
     
-    fresult = f_open(file, download_file_path, FA_READ);
-    if(fresult == FR_OK)
+    request.op = STORAGE_OP_STAT;
+    request.prio = STORAGE_PRIO_NORMAL;
+    request.path = download_file_path;
+    request.buffer = fileinfo;
+    if(storage_service_run(&request) == FR_OK)
     {
-        file_size = f_size(file);
+        file_size = fileinfo->fsize;
     }
 
-    f_close(file);
-    myfree(SRAMIN, file);
+    myfree(SRAMIN, fileinfo);
     
     return file_size;
 }
@@ -508,32 +649,19 @@ static uint32_t get_debugger_bin_file_size(void)
 **************************************************************/
 int debugger_read_bin_file(uint32_t offset, void* buf, uint32_t size, uint32_t *read_bytes)
 {
-    FRESULT fresult;
-    FIL *file;
+    storage_request_struct request = {0};
     
-    file = (FIL *)mymalloc(SRAMIN, sizeof(FIL));
-    if(file == NULL)return -1;
-    
-    fresult = f_open(file, download_file_path, FA_READ);
-    if(fresult != FR_OK)
-    {
-        goto __exit;
-    }
-    fresult = f_lseek(file, offset);
-    if(fresult != FR_OK)
-    {
-        goto __exit;
-    }
-    fresult = f_read(file, buf, size, read_bytes);
-    if(fresult != FR_OK)
-    {
-        goto __exit;
-    }
+    /* 编程读取走最高优先级，文件在存储任务中保持打开 */
+    request.op = STORAGE_OP_READ;
+    request.prio = STORAGE_PRIO_HIGH;
+    request.path = download_file_path;
+    request.buffer = buf;
+    request.offset = offset;
+    request.size = size;
+    storage_service_run(&request);
+    *read_bytes = request.result;
     
-__exit:
-    f_close(file);
-    myfree(SRAMIN, file);
-    return fresult;
+    return request.fresult;
 }
 
 /**************************************************************
@@ -557,6 +685,137 @@ static void lvgl_flm_select_msgbox_creat(void)
     
     btn2 = lv_msgbox_add_footer_button(lvgl_debugger.msgbox, "确定");
     lv_obj_add_event_cb(btn2, msgbox_ack_btn_event_cb, LV_EVENT_CLICKED, NULL);
+    
+    btn2 = lv_msgbox_add_footer_button(lvgl_debugger.msgbox, "重建算法库");
+    lv_obj_add_event_cb(btn2, msgbox_library_btn_event_cb, LV_EVENT_CLICKED, NULL);
+}
+
+/**************************************************************
+函数名称 ： msgbox_readback_btn_event_cb
+功    能 ： 回读格式选择按钮事件回调，user_data为0:BIN，1:HEX，2:各SWJ时钟测速
+参    数 ： e
+返 回 值 ： 无
+作    者 ： ZeHou
+**************************************************************/
+static void msgbox_readback_btn_event_cb(lv_event_t *e)
+{
+    uint32_t mode = (uint32_t)lv_event_get_user_data(e);
+    lv_event_code_t code = lv_event_get_code(e);
+    
+    switch(code)
+    {
+        case LV_EVENT_CLICKED:
+            lv_msgbox_close(lvgl_debugger.msgbox);
+            if(download_busy)break;                         /* 后台任务正在使用SWD */
+            debugger_readback.addr = flash_device.devAdr + read_address;
+            debugger_readback.size = read_size;
+            debugger_readback.format = (mode == 1) ? FLASH_READBACK_HEX : FLASH_READBACK_BIN;
+            debugger_readback.swj_clock = 0;
+            snprintf(debugger_readback.path, sizeof(debugger_readback.path), "%s/RB_%08X_%u.%s", FLASH_READBACK_PATH, 
+                     debugger_readback.addr, debugger_readback.size, (mode == 1) ? "HEX" : "BIN");
+            memset(debugger_readback_speed, 0x00, sizeof(debugger_readback_speed));
+            
+            lvgl_debugger_busy_set(1);
+            lv_led_on(lvgl_debugger.download_led);
+            lvgl_debugger.timer = lv_timer_create(timer_cb, 100, NULL);
+            if(DBUGGER_DOWNLOADTask_Handler != NULL)
+            {
+                xTaskNotify((TaskHandle_t)DBUGGER_DOWNLOADTask_Handler, (uint32_t)((mode == 2) ? 8 : 7), (eNotifyAction)eSetValueWithOverwrite);
+            }
+            break;
+        
+        default: break;
+    }
+}
+
+/**************************************************************
+函数名称 ： lvgl_readback_msgbox_creat
+功    能 ： 创建回读到文件的格式选择消息框
+参    数 ： 无
+返 回 值 ： 无
+作    者 ： ZeHou
+**************************************************************/
+static void lvgl_readback_msgbox_creat(void)
+{
+    lv_obj_t *btn;
+    
+    lvgl_debugger.msgbox = lv_msgbox_create(NULL);
+    lv_obj_set_style_text_font(lvgl_debugger.msgbox, &lv_font_fzst_24, 0);
+    lv_msgbox_add_title(lvgl_debugger.msgbox, "回读到文件");
+    lv_msgbox_add_text(lvgl_debugger.msgbox, "读取大小超过1024字节，将保存到" FLASH_READBACK_PATH "，请选择文件格式");
+    
+    btn = lv_msgbox_add_header_button(lvgl_debugger.msgbox, LV_SYMBOL_CLOSE);
+    lv_obj_add_event_cb(btn, msgbox_close_btn_event_cb, LV_EVENT_CLICKED, NULL);
+    
+    btn = lv_msgbox_add_footer_button(lvgl_debugger.msgbox, "BIN");
+    lv_obj_add_event_cb(btn, msgbox_readback_btn_event_cb, LV_EVENT_CLICKED, (void *)0);
+    
+    btn = lv_msgbox_add_footer_button(lvgl_debugger.msgbox, "HEX");
+    lv_obj_add_event_cb(btn, msgbox_readback_btn_event_cb, LV_EVENT_CLICKED, (void *)1);
+    
+    btn = lv_msgbox_add_footer_button(lvgl_debugger.msgbox, "测速");
+    lv_obj_add_event_cb(btn, msgbox_readback_btn_event_cb, LV_EVENT_CLICKED, (void *)2);
+}
+
+/**************************************************************
+函数名称 ： lvgl_readback_report_show
+功    能 ： 在文本框中显示回读结果及速度
+参    数 ： sweep: 1显示各SWJ时钟下的测速结果
+返 回 值 ： 无
+作    者 ： ZeHou
+**************************************************************/
+static void lvgl_readback_report_show(uint8_t sweep)
+{
+    uint8_t i;
+    uint32_t len = 0;
+    char *buffer_textarea;
+    
+    buffer_textarea = (char *)mymalloc(SRAMDTCM, BUFFER_TEXTAREA_SIZE);
+    if(buffer_textarea == NULL)return;
+    
+    len += snprintf(buffer_textarea + len, BUFFER_TEXTAREA_SIZE - len, "%s\n0x%08X, %u bytes, %ums\n", debugger_readback.path,
+                    debugger_readback.addr, debugger_readback.done, debugger_readback.time_ms);
+    if(sweep)
+    {
+        for(i = 0; i < FLASH_READBACK_SWEEP_NUM; i++)
+        {
+            len += snprintf(buffer_textarea + len, BUFFER_TEXTAREA_SIZE - len, "SWJ %5ukHz: %u.%02uMB/s\n", debugger_readback_speed[i].swj_clock / 1000,
+                            debugger_readback_speed[i].kbps / 1024, (debugger_readback_speed[i].kbps % 1024) * 100 / 1024);
+        }
+    }
+    else
+    {
+        snprintf(buffer_textarea + len, BUFFER_TEXTAREA_SIZE - len, "SWJ %ukHz: %u.%02uMB/s\n", flash_readback_swj_clock_get() / 1000,
+                 flash_readback_kbps(&debugger_readback) / 1024, (flash_readback_kbps(&debugger_readback) % 1024) * 100 / 1024);
+    }
+    lv_textarea_set_text(lvgl_debugger.textarea, (const char *)buffer_textarea);
+    myfree(SRAMDTCM, buffer_textarea);
+}
+
+/**************************************************************
+函数名称 ： lvgl_flm_library_select
+功    能 ： 读取目标DP IDCODE/CPUID/DBGMCU_IDCODE，在算法库索引中
+            查找并按索引记录的目标内存布局加载对应的FLM算法
+参    数 ： 无
+返 回 值 ： 无
+作    者 ： ZeHou
+**************************************************************/
+static void lvgl_flm_library_select(void)
+{
+    char fpath[FF_LFN_BUF + 1];
+    flm_library_entry_struct entry;
+    
+    if(flm_library_lookup(&entry, fpath, sizeof(fpath)) == 0)
+    {
+        if(flm_prase_ram(fpath, entry.ram_base, entry.ram_size) != 0)   /* 按算法库中的目标内存布局加载 */
+        {
+            lv_label_set_text(lvgl_debugger.flm_file_label, "NULL");
+            return;
+        }
+        lv_label_set_text(lvgl_debugger.flm_file_label, flash_device.devName);
+        lv_textarea_set_text(lvgl_debugger.textarea, "");
+        lv_textarea_add_text(lvgl_debugger.textarea, fpath);
+    }
 }
 
 /**************************************************************
@@ -587,6 +846,54 @@ static void bin_file_select(lv_obj_t *parent)
     lvgl_file_manager_creat(parent);            /* 创建文件管理器，并且进入文件选择模式 */
 }
 
+/**************************************************************
+函数名称 ： recipe_file_select
+功    能 ： 烧录配方文件选取
+参    数 ： parent: 父母
+返 回 值 ： 无
+作    者 ： ZeHou
+**************************************************************/
+static void recipe_file_select(lv_obj_t *parent)
+{
+    lvgl_file_manager.file_selector = FILE_SELECTOR_RCP;    /* 需要选择RCP配方文件 */
+    memcpy(lvgl_file_manager.file_ext, file_selector_file_ext[FILE_SELECTOR_RCP], strlen(file_selector_file_ext[FILE_SELECTOR_RCP]) + 1);   /* 文件扩展名 */
+    lvgl_file_manager_creat(parent);            /* 创建文件管理器，并且进入文件选择模式 */
+}
+
+/**************************************************************
+函数名称 ： lvgl_recipe_report_show
+功    能 ： 在文本框中显示配方各步骤及耗时
+参    数 ： 无
+返 回 值 ： 无
+作    者 ： ZeHou
+**************************************************************/
+static void lvgl_recipe_report_show(void)
+{
+    uint8_t i;
+    uint32_t len = 0;
+    char *buffer_textarea;
+    flash_recipe_step_struct *step;
+    
+    if(flash_recipe == NULL)return;
+    
+    buffer_textarea = (char *)mymalloc(SRAMDTCM, BUFFER_TEXTAREA_SIZE);
+    if(buffer_textarea == NULL)return;
+    
+    for(i = 0; (i < flash_recipe->step_num) && (len < BUFFER_TEXTAREA_SIZE); i++)
+    {
+        step = &flash_recipe->step[i];
+        len += snprintf(buffer_textarea + len, BUFFER_TEXTAREA_SIZE - len, "%u: %s\n    0x%08X %s %ums %s\n", i + 1, step->image_path, step->base_addr,
+                        (step->verify == FLASH_RECIPE_VERIFY_READ) ? "read" : "none", step->time_ms,
+                        (i < flash_recipe->step_done) ? "OK" : ((step->error != ERROR_SUCCESS) ? error_get_string(step->error) : "-"));
+    }
+    if(len < BUFFER_TEXTAREA_SIZE)
+    {
+        snprintf(buffer_textarea + len, BUFFER_TEXTAREA_SIZE - len, "total: %u/%u, %ums", flash_recipe->step_done, flash_recipe->step_num, flash_recipe->total_time_ms);
+    }
+    lv_textarea_set_text(lvgl_debugger.textarea, (const char *)buffer_textarea);
+    myfree(SRAMDTCM, buffer_textarea);
+}
+
 /**************************************************************
 函数名称 ： lvgl_debugger_off_line_creat
 功    能 ： 创建离线调试器
@@ -636,6 +943,7 @@ void lvgl_debugger_off_line_creat(lv_obj_t *parent)
     lv_obj_center(titlelabel);
     
     closebtn = lv_button_create(obj1);                                              /* 创建关闭按钮 */
+    lvgl_debugger.close_btn = closebtn;
     lv_obj_add_event_cb(closebtn, closebtn_event_handler, LV_EVENT_CLICKED, NULL);
     lv_obj_set_size(closebtn, lv_pct(10), lv_pct(100));
     lv_obj_align(closebtn, LV_ALIGN_RIGHT_MID, 0, 0);
@@ -698,7 +1006,7 @@ void lvgl_debugger_off_line_creat(lv_obj_t *parent)
     lv_obj_set_style_text_font(lvgl_debugger.size_textarea, &lv_font_fzst_24, 0);
     lv_textarea_set_one_line(lvgl_debugger.size_textarea, true);
     lv_textarea_set_accepted_chars(lvgl_debugger.size_textarea, "0123456789");
-    lv_textarea_set_placeholder_text(lvgl_debugger.size_textarea, "rd size max(1024)");
+    lv_textarea_set_placeholder_text(lvgl_debugger.size_textarea, "rd size (>1024 to file)");
     lv_obj_add_event_cb(lvgl_debugger.size_textarea, textarea_event_handler, LV_EVENT_ALL, NULL);
     lv_obj_set_style_pad_top(lvgl_debugger.size_textarea, 5, 0);
     lv_obj_set_style_pad_bottom(lvgl_debugger.size_textarea, 5, 0);
@@ -717,6 +1025,19 @@ void lvgl_debugger_off_line_creat(lv_obj_t *parent)
     lv_label_set_text(label2, "读取");
     lv_obj_set_style_text_font(label2, &lv_font_fzst_24, 0);
     lv_obj_center(label2);
+    
+    lvgl_debugger.recipe_btn = lv_button_create(obj2);
+    lv_obj_set_size(lvgl_debugger.recipe_btn, lv_pct(100), LV_SIZE_CONTENT);
+    lv_obj_add_event_cb(lvgl_debugger.recipe_btn, btn_event_handler, LV_EVENT_CLICKED, NULL);
+    lv_obj_set_style_pad_top(lvgl_debugger.recipe_btn, 5, 0);
+    lv_obj_set_style_pad_bottom(lvgl_debugger.recipe_btn, 5, 0);
+    lv_obj_set_style_pad_left(lvgl_debugger.recipe_btn, 5, 0);
+    lv_obj_set_style_pad_right(lvgl_debugger.recipe_btn, 5, 0);
+    
+    label2 = lv_label_create(lvgl_debugger.recipe_btn);
+    lv_label_set_text(label2, "配方");
+    lv_obj_set_style_text_font(label2, &lv_font_fzst_24, 0);
+    lv_obj_center(label2);
 
     obj3 = lv_obj_create(lvgl_debugger.main_obj);
     lv_obj_add_style(obj3, &lvgl_style.general_obj, 0);
@@ -817,6 +1138,34 @@ void bin_file_select_callback(const char *fpath)
     lv_label_set_text(lvgl_debugger.download_bin_path_label, fpath);
 }
 
+/**************************************************************
+函数名称 ： recipe_file_select_callback
+功    能 ： 烧录配方文件选取回调，解析后在后台任务中执行
+            已连接时复用当前调试会话，未连接时由配方自行连接和断开
+参    数 ： fpath: 配方文件路径
+返 回 值 ： 无
+作    者 ： ZeHou
+**************************************************************/
+void recipe_file_select_callback(const char *fpath)
+{
+    if(download_busy)return;                            /* 选择文件期间已开始其他后台操作 */
+    
+    if(flash_recipe_load(fpath) < 0)
+    {
+        lvgl_show_error_msgbox_creat("配方文件解析失败，请检查配方格式！");
+        return;
+    }
+    
+    lvgl_recipe_report_show();
+    lvgl_debugger_busy_set(1);
+    lv_led_on(lvgl_debugger.download_led);
+    lvgl_debugger.timer = lv_timer_create(timer_cb, 100, NULL);
+    if(DBUGGER_DOWNLOADTask_Handler != NULL)
+    {
+        xTaskNotify((TaskHandle_t)DBUGGER_DOWNLOADTask_Handler, (uint32_t)((connect_status == 0x01) ? 6 : 5), (eNotifyAction)eSetValueWithOverwrite);
+    }
+}
+
 /**************************************************************
 函数名称 ： lvgl_debugger_off_line_delete
 功    能 ： 删除离线调试器
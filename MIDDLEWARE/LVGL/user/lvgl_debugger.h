@@ -13,11 +13,17 @@
 #include "FlashOS.h"
 #include "SWD_host.h"
 #include "SWD_flash.h"
+#include "flash_recipe.h"
+#include "flm_library.h"
+#include "flash_readback.h"
 
 extern FlashDeviceStruct flash_device;         /* target flash information */
 extern program_target_t flash_algo;            /* target flash algorithm information */
 extern int flm_prase(const char* fpath);       /* FLM file parser function */
+extern int flm_prase_ram(const char* fpath, uint32_t ram_base, uint32_t ram_size);   /* FLM file parser, algorithm placed in the given target RAM */
 extern volatile uint32_t download_file_size;   /* download file size */
+extern flash_readback_struct debugger_readback; /* flash readback job */
+extern flash_readback_speed_struct debugger_readback_speed[FLASH_READBACK_SWEEP_NUM];  /* readback speed per SWJ clock */
 
 /*!
     \brief      LVGL debugger interface structure
@@ -39,6 +45,8 @@ typedef struct
     lv_obj_t *download_label;               /*!< Download progress label */
     lv_obj_t *download_bin_path_label;      /*!< Download BIN file path label */
     lv_obj_t *download_btn;                 /*!< Download button */
+    lv_obj_t *recipe_btn;                   /*!< Recipe button */
+    lv_obj_t *close_btn;                    /*!< Close button */
     
     lv_timer_t *timer;                      /*!< Update timer */
 }lvgl_debugger_struct;
@@ -52,6 +60,7 @@ typedef struct
     uint16_t run_count;                     /*!< Run count */
     uint8_t status;                         /*!< Download status */
     uint8_t error;                          /*!< Error code */
+    uint8_t phase;                          /*!< Recipe step phase */
 }lvgl_debugger_download_struct;
 
 /* function declarations */
@@ -59,6 +68,7 @@ int debugger_read_bin_file(uint32_t offset, void* buf, uint32_t size, uint32_t *
 void lvgl_debugger_off_line_creat(lv_obj_t *parent);                                           /* create debugger offline interface */
 void lvgl_flm_prase(const char *fpath);                                                        /* parse FLM file */
 void bin_file_select_callback(const char *fpath);                                              /* BIN file selection callback */
+void recipe_file_select_callback(const char *fpath);                                           /* recipe file selection callback */
 void lvgl_debugger_off_line_delete(void);                                                      /* delete debugger offline interface */
 
 #endif /* __LVGL_DEBUGGER_H */
@@ -4,8 +4,10 @@
 #include "./MALLOC/malloc.h"
 #include "lvgl_debugger.h"
 #include <ctype.h>
+#include <stdlib.h>
 
 lvgl_file_manager_struct lvgl_file_manager;
+static const char *const lvgl_file_manager_sort_text[FILE_SORT_NUM] = {"默认", "名称", "日期", "大小"};
 
 /* static function declarations */
 static void lvgl_file_manager_scan_files(const char *path);
@@ -13,6 +15,16 @@ static void lvgl_file_manager_files_info(const char *path);
 static void lvgl_file_manager_select_file(const char *file_ext);
 static void lvgl_file_manager_delete_list(void);
 static void lvgl_file_manager_delete_info_obj(void);
+static void lvgl_file_manager_add_page(void);
+static void lvgl_file_manager_fill_info(void);
+static void lvgl_file_manager_timer_cb(lv_timer_t *timer);
+static void lvgl_file_manager_free(void);
+static void lvgl_file_manager_add_entry(const FILINFO *fno);
+static uint8_t lvgl_file_manager_filter(uint16_t index);
+static int lvgl_file_manager_compare(uint16_t a, uint16_t b);
+static int lvgl_file_manager_sort_cmp(const void *a, const void *b);
+static void lvgl_file_manager_sort(void);
+static void lvgl_file_manager_list_refresh(void);
 
 /**************************************************************
 函数名称 ： closebtn_event_handler
@@ -83,26 +95,30 @@ static void backbtn_event_handler(lv_event_t *e)
 static void listbtn_event_handler(lv_event_t *e)
 {
     lv_event_code_t code = lv_event_get_code(e);
-    lv_obj_t *obj = lv_event_get_target(e);
-    char path_temp[FF_LFN_BUF + 1];
-    const char *path;
+    uint32_t slot = (uint32_t)lv_event_get_user_data(e);   /* 行按钮在复用池中的序号 */
+    lvgl_file_manager_entry_struct *entry;
+    const char *name;
     char *temp;
     
-    memcpy(path_temp, "/", strlen("/") + 1);
-    path = lv_list_get_button_text(lvgl_file_manager.list, obj);
-    strncat(path_temp, path, FF_LFN_BUF - strlen(path_temp));
-    strncat(lvgl_file_manager.fpath, path_temp, FF_LFN_BUF - strlen(lvgl_file_manager.fpath));  /* 追加完整路径 */
-    temp = strrchr(path_temp , '.');    /* 查找路径是否存在 '.'，若存在，则视当前路径为文件 */
+    if(lvgl_file_manager.row_entry[slot] == LVGL_FILE_MANAGER_NIL)
+    {
+        return;
+    }
+    
+    entry = &lvgl_file_manager.entry[lvgl_file_manager.row_entry[slot]];
+    name = lvgl_file_manager.names + entry->name;
+    strncat(lvgl_file_manager.fpath, "/", FF_LFN_BUF - strlen(lvgl_file_manager.fpath));
+    strncat(lvgl_file_manager.fpath, name, FF_LFN_BUF - strlen(lvgl_file_manager.fpath));  /* 追加完整路径 */
     
     switch(code)
     {
         case LV_EVENT_SHORT_CLICKED:  /* 短按 */
-            if(temp == NULL)                /* 路径不存在 '.' */
+            if(entry->fattrib & AM_DIR)     /* 目录 */
             {
                 lvgl_file_manager_delete_list();
                 lvgl_file_manager_scan_files(lvgl_file_manager.fpath);
             }
-            else                            /* 路径存在 '.' */
+            else                            /* 文件 */
             {
                 if(lvgl_file_manager.file_selector == 0) /* 未进行文件选择 */
                 {
@@ -112,7 +128,8 @@ static void listbtn_event_handler(lv_event_t *e)
                 }
                 else
                 {
-                    lvgl_file_manager_select_file(temp + 1);
+                    temp = strrchr(name, '.');
+                    lvgl_file_manager_select_file((temp == NULL) ? "" : temp + 1);
                 }
             }
             break;
@@ -128,6 +145,49 @@ static void listbtn_event_handler(lv_event_t *e)
     }
 }
 
+/**************************************************************
+函数名称 ： list_event_handler
+功    能 ： 列表滚动回调，把复用的行按钮移到可见区域
+参    数 ： e
+返 回 值 ： 无
+作    者 ： ZeHou
+**************************************************************/
+static void list_event_handler(lv_event_t *e)
+{
+    lv_event_code_t code = lv_event_get_code(e);
+    
+    switch(code)
+    {
+        case LV_EVENT_SCROLL:
+            lvgl_file_manager_list_refresh();
+            break;
+        
+        default: break;
+    }
+}
+
+/**************************************************************
+函数名称 ： sortbtn_event_handler
+功    能 ： 排序按钮回调，依次切换默认/名称/日期/大小排序
+参    数 ： e
+返 回 值 ： 无
+作    者 ： ZeHou
+**************************************************************/
+static void sortbtn_event_handler(lv_event_t *e)
+{
+    lv_event_code_t code = lv_event_get_code(e);
+    
+    switch(code)
+    {
+        case LV_EVENT_CLICKED:
+            lvgl_file_manager.sort = (file_sort_enum)((lvgl_file_manager.sort + 1) % FILE_SORT_NUM);
+            lvgl_file_manager_sort();
+            break;
+        
+        default: break;
+    }
+}
+
 /**************************************************************
 函数名称 ： lvgl_file_manager_scan_files
 功    能 ： 扫描磁盘文件
@@ -137,51 +197,364 @@ static void listbtn_event_handler(lv_event_t *e)
 **************************************************************/
 static void lvgl_file_manager_scan_files(const char *path)
 {
-    lv_obj_t * listbtn;
+    lv_obj_t *header;
+    lv_obj_t *sortbtn;
+    uint32_t i;
     
-    lvgl_file_manager.dir = (DIR *)mymalloc(SRAMIN, sizeof(DIR));
-    lvgl_file_manager.fileinfo = (FILINFO *)mymalloc(SRAMIN, sizeof(FILINFO));
-    if((!lvgl_file_manager.dir) || (!lvgl_file_manager.fileinfo))   /* 如果有内存申请失败，则退出 */
+    /* 虚拟列表：只创建可见行数量的按钮，滚动时复用，目录项保存在SDRAM中 */
+    lvgl_file_manager.list = lv_list_create(lvgl_file_manager.main_obj);    /* 创建一个列表，用于显示当前路径下的文件 */
+    lv_obj_set_size(lvgl_file_manager.list, lv_pct(60), lv_pct(90));
+    lv_obj_set_layout(lvgl_file_manager.list, LV_LAYOUT_NONE);              /* 行按钮由刷新函数定位 */
+    lv_obj_align(lvgl_file_manager.list, LV_ALIGN_BOTTOM_LEFT, 0, 0);
+    lv_obj_set_style_text_font(lvgl_file_manager.list, &lv_font_fzst_24, 0);/* 设置字体 */
+    lv_obj_add_event_cb(lvgl_file_manager.list, list_event_handler, LV_EVENT_SCROLL, NULL);
+    
+    header = lv_list_add_text(lvgl_file_manager.list, path);                /* 向列表头添加当前路径 */
+    lv_obj_set_size(header, lv_pct(100), LVGL_FILE_MANAGER_ROW_HEIGHT);
+    lv_obj_set_pos(header, 0, 0);
+    
+    sortbtn = lv_button_create(lvgl_file_manager.list);                     /* 排序按钮，切换排序不重建行按钮 */
+    lv_obj_set_size(sortbtn, LV_SIZE_CONTENT, LVGL_FILE_MANAGER_ROW_HEIGHT - 4);
+    lv_obj_align(sortbtn, LV_ALIGN_TOP_RIGHT, 0, 2);
+    lv_obj_add_event_cb(sortbtn, sortbtn_event_handler, LV_EVENT_CLICKED, NULL);
+    lvgl_file_manager.sort_label = lv_label_create(sortbtn);
+    lv_label_set_text(lvgl_file_manager.sort_label, lvgl_file_manager_sort_text[lvgl_file_manager.sort]);
+    lv_obj_center(lvgl_file_manager.sort_label);
+    
+    lvgl_file_manager.spacer = lv_obj_create(lvgl_file_manager.list);      /* 撑开滚动区域的占位对象 */
+    lv_obj_remove_style_all(lvgl_file_manager.spacer);
+    lv_obj_remove_flag(lvgl_file_manager.spacer, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_set_size(lvgl_file_manager.spacer, 1, 1);
+    lv_obj_set_pos(lvgl_file_manager.spacer, 0, 0);
+    
+    for(i = 0; i < LVGL_FILE_MANAGER_ROW_NUM; i++)
+    {
+        lvgl_file_manager.row[i] = lv_list_add_button(lvgl_file_manager.list, LV_SYMBOL_FILE, "");
+        lv_obj_set_size(lvgl_file_manager.row[i], lv_pct(100), LVGL_FILE_MANAGER_ROW_HEIGHT);
+        lv_obj_add_flag(lvgl_file_manager.row[i], LV_OBJ_FLAG_HIDDEN);
+        lv_obj_add_event_cb(lvgl_file_manager.row[i], listbtn_event_handler, LV_EVENT_SHORT_CLICKED, (void *)i);  /* 添加短按事件 */
+        lv_obj_add_event_cb(lvgl_file_manager.row[i], listbtn_event_handler, LV_EVENT_LONG_PRESSED, (void *)i);   /* 添加长按事件 */
+        lvgl_file_manager.row_entry[i] = LVGL_FILE_MANAGER_NIL;
+    }
+    
+    lvgl_file_manager.entry_num = 0;
+    lvgl_file_manager.view_num = 0;
+    lvgl_file_manager.names_used = 0;
+    lvgl_file_manager.scan_tick = lv_tick_get();
+    
+    /* 目录交给存储任务分页读取，由定时器逐页加入目录项，界面不会被阻塞 */
+    strncpy(lvgl_file_manager.scan_path, path, FF_LFN_BUF);
+    lvgl_file_manager.scan_path[FF_LFN_BUF] = '\0';
+    memset(&lvgl_file_manager.list_request, 0x00, sizeof(lvgl_file_manager.list_request));
+    lvgl_file_manager.list_request.op = STORAGE_OP_READDIR;
+    lvgl_file_manager.list_request.prio = STORAGE_PRIO_NORMAL;
+    lvgl_file_manager.list_request.path = lvgl_file_manager.scan_path;
+    lvgl_file_manager.list_request.buffer = lvgl_file_manager.page;
+    lvgl_file_manager.list_request.offset = 0;
+    lvgl_file_manager.list_request.size = LVGL_FILE_MANAGER_PAGE_NUM;
+    storage_service_submit(&lvgl_file_manager.list_request);
+}
+
+/**************************************************************
+函数名称 ： lvgl_file_manager_add_page
+功    能 ： 将读取完成的一页目录项添加到列表，并请求下一页
+参    数 ： 无
+返 回 值 ： 无
+作    者 ： ZeHou
+**************************************************************/
+static void lvgl_file_manager_add_page(void)
+{
+    storage_request_struct *request = &lvgl_file_manager.list_request;
+    uint16_t first = lvgl_file_manager.entry_num;
+    uint32_t i;
+    
+    request->state = STORAGE_IDLE;
+    lvgl_file_manager.fresult = request->fresult;
+    
+    for(i = 0; (i < request->result) && (lvgl_file_manager.entry_num < LVGL_FILE_MANAGER_ENTRY_MAX); i++)
+    {
+        lvgl_file_manager_add_entry(&lvgl_file_manager.page[i]);
+    }
+    
+    lv_obj_set_y(lvgl_file_manager.spacer, (lvgl_file_manager.view_num + 1) * LVGL_FILE_MANAGER_ROW_HEIGHT);   /* 更新滚动高度 */
+    lvgl_file_manager_list_refresh();
+    
+    if(first == 0)
+    {
+        PRINT_INFO("file manager %s: first rows in %u ms\r\n", lvgl_file_manager.scan_path, lv_tick_elaps(lvgl_file_manager.scan_tick));
+    }
+    
+    if((request->fresult == FR_OK) && (request->result == request->size) &&
+       (lvgl_file_manager.entry_num < LVGL_FILE_MANAGER_ENTRY_MAX))        /* 整页读满，继续读取下一页 */
     {
-        myfree(SRAMIN, lvgl_file_manager.dir);
-        myfree(SRAMIN, lvgl_file_manager.fileinfo);
+        request->offset += request->result;
+        storage_service_submit(request);
+    }
+    else
+    {
+        PRINT_INFO("file manager %s: %u entries in %u ms\r\n", lvgl_file_manager.scan_path, lvgl_file_manager.entry_num, lv_tick_elaps(lvgl_file_manager.scan_tick));
+    }
+}
+
+/**************************************************************
+函数名称 ： lvgl_file_manager_add_entry
+功    能 ： 保存一个目录项，符合筛选条件时按当前排序插入显示序列
+参    数 ： fno: 目录项
+返 回 值 ： 无
+作    者 ： ZeHou
+**************************************************************/
+static void lvgl_file_manager_add_entry(const FILINFO *fno)
+{
+    lvgl_file_manager_entry_struct *entry;
+    uint32_t length = strlen(fno->fname) + 1;
+    uint16_t index = lvgl_file_manager.entry_num;
+    uint16_t low, high, mid;
+    char *names;
+    
+    if(lvgl_file_manager.names_used + length > lvgl_file_manager.names_size)  /* 名称区已满，扩大一倍 */
+    {
+        names = (char *)myrealloc(SRAMEX, lvgl_file_manager.names, lvgl_file_manager.names_size * 2);
         
+        if(names == NULL)
+        {
+            return;
+        }
+        
+        lvgl_file_manager.names = names;
+        lvgl_file_manager.names_size *= 2;
+    }
+    
+    entry = &lvgl_file_manager.entry[index];
+    entry->name = lvgl_file_manager.names_used;
+    entry->fsize = fno->fsize;
+    entry->fdate = fno->fdate;
+    entry->ftime = fno->ftime;
+    entry->fattrib = fno->fattrib;
+    memcpy(lvgl_file_manager.names + lvgl_file_manager.names_used, fno->fname, length);
+    lvgl_file_manager.names_used += length;
+    lvgl_file_manager.entry_num++;
+    
+    if(!lvgl_file_manager_filter(index))
+    {
         return;
     }
     
-    /*Create a list*/
-    lvgl_file_manager.list = lv_list_create(lvgl_file_manager.main_obj);    /* 创建一个列表，用于显示当前路径下的文件 */
-    lv_obj_set_size(lvgl_file_manager.list, lv_pct(60), lv_pct(90));
-    lv_obj_set_style_pad_row(lvgl_file_manager.list, 0, 0);
-    lv_obj_align(lvgl_file_manager.list, LV_ALIGN_BOTTOM_LEFT, 0, 0);
+    /* 二分查找插入位置，已显示的行按钮在刷新时只更新内容变化的行 */
+    low = 0;
+    high = lvgl_file_manager.view_num;
+    while(low < high)
+    {
+        mid = (low + high) / 2;
+        if(lvgl_file_manager_compare(lvgl_file_manager.view[mid], index) < 0)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
     
-    lv_list_add_text(lvgl_file_manager.list, path);                         /* 向列表头添加当前路径 */
-    lv_obj_set_style_text_font(lvgl_file_manager.list, &lv_font_fzst_24, 0);/* 设置字体 */
+    memmove(&lvgl_file_manager.view[low + 1], &lvgl_file_manager.view[low], (lvgl_file_manager.view_num - low) * sizeof(uint16_t));
+    lvgl_file_manager.view[low] = index;
+    lvgl_file_manager.view_num++;
+}
+
+/**************************************************************
+函数名称 ： lvgl_file_manager_filter
+功    能 ： 判断目录项是否显示，文件选择模式下只显示目录和指定扩展名的文件
+参    数 ： index: 目录项序号
+返 回 值 ： 1: 显示，0: 不显示
+作    者 ： ZeHou
+**************************************************************/
+static uint8_t lvgl_file_manager_filter(uint16_t index)
+{
+    const char *ext;
+    uint8_t i;
+    
+    if((lvgl_file_manager.file_selector == FILE_SELECTOR_OFF) || (lvgl_file_manager.entry[index].fattrib & AM_DIR))
+    {
+        return 1;
+    }
+    
+    ext = strrchr(lvgl_file_manager.names + lvgl_file_manager.entry[index].name, '.');
+    
+    if(ext == NULL)
+    {
+        return 0;
+    }
     
-    lvgl_file_manager.fresult = f_opendir(lvgl_file_manager.dir, path);     /* 打开当前目录 */
-    if(lvgl_file_manager.fresult == FR_OK)
+    for(i = 0; lvgl_file_manager.file_ext[i] != '\0'; i++)
     {
-        while(1)                                                            /* 打开成功，则轮询当前目录下的文件，并在列表添加 */
+        if(toupper((unsigned char)ext[i + 1]) != lvgl_file_manager.file_ext[i])
         {
-            lvgl_file_manager.fresult = f_readdir(lvgl_file_manager.dir, lvgl_file_manager.fileinfo);
-            if((lvgl_file_manager.fresult != FR_OK) || (lvgl_file_manager.fileinfo->fname[0] == 0)) break;  /* 轮询完，退出循环 */
-            if(lvgl_file_manager.fileinfo->fattrib & AM_DIR)
-            {
-                listbtn = lv_list_add_button(lvgl_file_manager.list, LV_SYMBOL_DIRECTORY, lvgl_file_manager.fileinfo->fname);
-            }
-            else
-            {
-                listbtn = lv_list_add_button(lvgl_file_manager.list, LV_SYMBOL_FILE, lvgl_file_manager.fileinfo->fname);
-            }
-            lv_obj_set_style_text_font(listbtn, &lv_font_fzst_24, 0);
-            lv_obj_add_event_cb(listbtn, listbtn_event_handler, LV_EVENT_SHORT_CLICKED, NULL);  /* 添加短按事件 */
-            lv_obj_add_event_cb(listbtn, listbtn_event_handler, LV_EVENT_LONG_PRESSED, NULL);   /* 添加长按事件 */
+            return 0;
         }
-        f_closedir(lvgl_file_manager.dir);
     }
+    
+    return (ext[i + 1] == '\0') ? 1 : 0;
+}
 
-    myfree(SRAMIN, lvgl_file_manager.dir);                                  /* 释放内存 */
-    myfree(SRAMIN, lvgl_file_manager.fileinfo);
+/**************************************************************
+函数名称 ： lvgl_file_manager_compare
+功    能 ： 按当前排序方式比较两个目录项
+参    数 ： a, b: 目录项序号
+返 回 值 ： <0: a在前，>0: b在前
+作    者 ： ZeHou
+**************************************************************/
+static int lvgl_file_manager_compare(uint16_t a, uint16_t b)
+{
+    const lvgl_file_manager_entry_struct *ea = &lvgl_file_manager.entry[a];
+    const lvgl_file_manager_entry_struct *eb = &lvgl_file_manager.entry[b];
+    const char *na, *nb;
+    uint32_t ka, kb;
+    
+    if(lvgl_file_manager.sort == FILE_SORT_NONE)        /* 目录顺序 */
+    {
+        return (int)a - (int)b;
+    }
+    
+    if((ea->fattrib ^ eb->fattrib) & AM_DIR)            /* 目录在前 */
+    {
+        return (ea->fattrib & AM_DIR) ? -1 : 1;
+    }
+    
+    if(lvgl_file_manager.sort == FILE_SORT_DATE)        /* 新的在前 */
+    {
+        ka = ((uint32_t)ea->fdate << 16) | ea->ftime;
+        kb = ((uint32_t)eb->fdate << 16) | eb->ftime;
+        if(ka != kb)
+        {
+            return (ka > kb) ? -1 : 1;
+        }
+    }
+    else if(lvgl_file_manager.sort == FILE_SORT_SIZE)   /* 大的在前 */
+    {
+        if(ea->fsize != eb->fsize)
+        {
+            return (ea->fsize > eb->fsize) ? -1 : 1;
+        }
+    }
+    
+    na = lvgl_file_manager.names + ea->name;            /* 名称不区分大小写 */
+    nb = lvgl_file_manager.names + eb->name;
+    while((*na != '\0') && (tolower((unsigned char)*na) == tolower((unsigned char)*nb)))
+    {
+        na++;
+        nb++;
+    }
+    
+    if(tolower((unsigned char)*na) != tolower((unsigned char)*nb))
+    {
+        return tolower((unsigned char)*na) - tolower((unsigned char)*nb);
+    }
+    
+    return (int)a - (int)b;
+}
+
+/**************************************************************
+函数名称 ： lvgl_file_manager_sort_cmp
+功    能 ： qsort比较函数
+参    数 ： a, b: 显示序列元素
+返 回 值 ： 比较结果
+作    者 ： ZeHou
+**************************************************************/
+static int lvgl_file_manager_sort_cmp(const void *a, const void *b)
+{
+    return lvgl_file_manager_compare(*(const uint16_t *)a, *(const uint16_t *)b);
+}
+
+/**************************************************************
+函数名称 ： lvgl_file_manager_sort
+功    能 ： 按当前排序方式重排显示序列，只刷新可见行
+参    数 ： 无
+返 回 值 ： 无
+作    者 ： ZeHou
+**************************************************************/
+static void lvgl_file_manager_sort(void)
+{
+    if(lvgl_file_manager.list == NULL)
+    {
+        return;
+    }
+    
+    qsort(lvgl_file_manager.view, lvgl_file_manager.view_num, sizeof(uint16_t), lvgl_file_manager_sort_cmp);
+    lv_label_set_text(lvgl_file_manager.sort_label, lvgl_file_manager_sort_text[lvgl_file_manager.sort]);
+    lv_obj_scroll_to_y(lvgl_file_manager.list, 0, LV_ANIM_OFF);
+    lvgl_file_manager_list_refresh();
+}
+
+/**************************************************************
+函数名称 ： lvgl_file_manager_list_refresh
+功    能 ： 把复用的行按钮绑定到可见的目录项
+参    数 ： 无
+返 回 值 ： 无
+作    者 ： ZeHou
+**************************************************************/
+static void lvgl_file_manager_list_refresh(void)
+{
+    int32_t first;
+    uint32_t i, pos, slot;
+    uint16_t index;
+    lv_obj_t *row;
+    
+    if(lvgl_file_manager.list == NULL)
+    {
+        return;
+    }
+    
+    first = lv_obj_get_scroll_y(lvgl_file_manager.list) / LVGL_FILE_MANAGER_ROW_HEIGHT - 1; /* 第0行是路径 */
+    if(first < 0)
+    {
+        first = 0;
+    }
+    
+    /* 行按钮按显示位置取模复用，滚动时仍可见的行不需要更新 */
+    for(i = 0; i < LVGL_FILE_MANAGER_ROW_NUM; i++)
+    {
+        pos = first + i;
+        slot = pos % LVGL_FILE_MANAGER_ROW_NUM;
+        row = lvgl_file_manager.row[slot];
+        
+        if(pos >= lvgl_file_manager.view_num)
+        {
+            lvgl_file_manager.row_entry[slot] = LVGL_FILE_MANAGER_NIL;
+            lv_obj_add_flag(row, LV_OBJ_FLAG_HIDDEN);
+            continue;
+        }
+        
+        index = lvgl_file_manager.view[pos];
+        lv_obj_set_y(row, (pos + 1) * LVGL_FILE_MANAGER_ROW_HEIGHT);
+        
+        if(lvgl_file_manager.row_entry[slot] != index)
+        {
+            lvgl_file_manager.row_entry[slot] = index;
+            lv_image_set_src(lv_obj_get_child(row, 0), (lvgl_file_manager.entry[index].fattrib & AM_DIR) ? LV_SYMBOL_DIRECTORY : LV_SYMBOL_FILE);
+            lv_list_set_button_text(lvgl_file_manager.list, row, lvgl_file_manager.names + lvgl_file_manager.entry[index].name);
+        }
+        
+        lv_obj_remove_flag(row, LV_OBJ_FLAG_HIDDEN);
+    }
+}
+
+/**************************************************************
+函数名称 ： lvgl_file_manager_timer_cb
+功    能 ： 轮询存储请求，完成后在LVGL任务中更新界面
+参    数 ： timer
+返 回 值 ： 无
+作    者 ： ZeHou
+**************************************************************/
+static void lvgl_file_manager_timer_cb(lv_timer_t *timer)
+{
+    if((lvgl_file_manager.list_request.state == STORAGE_DONE) && (lvgl_file_manager.list != NULL))
+    {
+        lvgl_file_manager_add_page();
+    }
+    
+    if((lvgl_file_manager.info_request.state == STORAGE_DONE) && (lvgl_file_manager.info_obj != NULL))
+    {
+        lvgl_file_manager_fill_info();
+    }
 }
 
 /**************************************************************
@@ -195,10 +568,6 @@ static void lvgl_file_manager_files_info(const char *path)
 {
     lv_obj_t * titlelabel;
     lv_obj_t * table;
-    uint16_t buffer_len;
-    char * file_info_buffer;
-    FATFS *fs;
-    uint32_t free_clust = 0, total_sector = 0, free_sector;
 
     /* Create a info obj */
     lvgl_file_manager.info_obj = lv_obj_create(lvgl_file_manager.main_obj);    /* 创建一个基础对象，用于容纳文件属性信息 */
@@ -220,10 +589,40 @@ static void lvgl_file_manager_files_info(const char *path)
     lv_obj_set_size(table, lv_pct(100), lv_pct(90));
     lv_obj_set_style_text_font(table, &lv_font_fzst_24, 0);
     lv_obj_align(table, LV_ALIGN_BOTTOM_MID, 0, 0);
+    lvgl_file_manager.info_table = table;
+    
+    /* 属性查询交给存储任务（首次统计空闲簇需要遍历FAT表），完成后由定时器填表 */
+    strncpy(lvgl_file_manager.info_path, path, FF_LFN_BUF);
+    lvgl_file_manager.info_path[FF_LFN_BUF] = '\0';
+    memset(&lvgl_file_manager.info_request, 0x00, sizeof(lvgl_file_manager.info_request));
+    lvgl_file_manager.info_request.op = (strcmp(path, "C:") == 0) ? STORAGE_OP_GETFREE : STORAGE_OP_STAT;
+    lvgl_file_manager.info_request.prio = STORAGE_PRIO_NORMAL;
+    lvgl_file_manager.info_request.path = lvgl_file_manager.info_path;
+    lvgl_file_manager.info_request.buffer = lvgl_file_manager.fileinfo;
+    storage_service_submit(&lvgl_file_manager.info_request);
+}
+
+/**************************************************************
+函数名称 ： lvgl_file_manager_fill_info
+功    能 ： 用存储任务返回的结果填写文件属性表
+参    数 ： 无
+返 回 值 ： 无
+作    者 ： ZeHou
+**************************************************************/
+static void lvgl_file_manager_fill_info(void)
+{
+    lv_obj_t * table = lvgl_file_manager.info_table;
+    uint16_t buffer_len;
+    char * file_info_buffer;
+    FATFS *fs = fatfs[0];
+    uint32_t free_clust = 0, total_sector = 0, free_sector;
     
-    if(strcmp(path, "C:") == 0)
+    lvgl_file_manager.info_request.state = STORAGE_IDLE;
+    lvgl_file_manager.fresult = lvgl_file_manager.info_request.fresult;
+
+    if(lvgl_file_manager.info_request.op == STORAGE_OP_GETFREE)
     {
-        lvgl_file_manager.fresult = f_getfree((const TCHAR *)path, (DWORD *)&free_clust, &fs);
+        free_clust = lvgl_file_manager.info_request.result;
         
         if(lvgl_file_manager.fresult == FR_OK)
         {
@@ -253,15 +652,6 @@ static void lvgl_file_manager_files_info(const char *path)
     }
     else
     {
-        lvgl_file_manager.fileinfo = (FILINFO *)mymalloc(SRAMIN, sizeof(FILINFO));
-
-        if(!lvgl_file_manager.fileinfo)                                             /* 如果有内存申请失败，则退出 */
-        {      
-            return;
-        }
-        
-        lvgl_file_manager.fresult = f_stat(path, lvgl_file_manager.fileinfo);
-    
         if(lvgl_file_manager.fresult == FR_OK)
         {
             lv_table_set_cell_value(table, 0, 0, "date");
@@ -309,8 +699,6 @@ static void lvgl_file_manager_files_info(const char *path)
                 }
             }
         }
-        
-        myfree(SRAMIN, lvgl_file_manager.fileinfo); /* 释放内存 */
     }
 }
 
@@ -355,6 +743,10 @@ static void lvgl_file_manager_select_file(const char *file_ext)
                 bin_file_select_callback(path_temp);
                 break;
                 
+            case FILE_SELECTOR_RCP:
+                recipe_file_select_callback(path_temp);
+                break;
+                
             default: break;
         }
     }
@@ -380,7 +772,21 @@ void lvgl_file_manager_creat(lv_obj_t *parent)
     lv_obj_t *listbtn;
 
     lvgl_file_manager.fpath = (char *)mymalloc(SRAMIN, FF_LFN_BUF + 1); /* 为文件管理器查询文件路径申请内存 */
-    if(lvgl_file_manager.fpath == NULL)return;
+    lvgl_file_manager.scan_path = (char *)mymalloc(SRAMIN, FF_LFN_BUF + 1);
+    lvgl_file_manager.info_path = (char *)mymalloc(SRAMIN, FF_LFN_BUF + 1);
+    lvgl_file_manager.fileinfo = (FILINFO *)mymalloc(SRAMIN, sizeof(FILINFO));
+    lvgl_file_manager.page = (FILINFO *)mymalloc(SRAMEX, LVGL_FILE_MANAGER_PAGE_NUM * sizeof(FILINFO));
+    lvgl_file_manager.entry = (lvgl_file_manager_entry_struct *)mymalloc(SRAMEX, LVGL_FILE_MANAGER_ENTRY_MAX * sizeof(lvgl_file_manager_entry_struct));
+    lvgl_file_manager.view = (uint16_t *)mymalloc(SRAMEX, LVGL_FILE_MANAGER_ENTRY_MAX * sizeof(uint16_t));
+    lvgl_file_manager.names = (char *)mymalloc(SRAMEX, LVGL_FILE_MANAGER_NAME_POOL);
+    lvgl_file_manager.names_size = LVGL_FILE_MANAGER_NAME_POOL;
+    if((!lvgl_file_manager.fpath) || (!lvgl_file_manager.scan_path) || (!lvgl_file_manager.info_path) ||
+       (!lvgl_file_manager.fileinfo) || (!lvgl_file_manager.page) || (!lvgl_file_manager.entry) ||
+       (!lvgl_file_manager.view) || (!lvgl_file_manager.names))         /* 如果有内存申请失败，则退出 */
+    {
+        lvgl_file_manager_free();
+        return;
+    }
     memcpy(lvgl_file_manager.fpath, "C:", strlen("C:") + 1);
 
     lvgl_file_manager.main_obj = lv_obj_create(parent);                 /* 创建文件管理器容器 */
@@ -440,6 +846,7 @@ void lvgl_file_manager_creat(lv_obj_t *parent)
     lv_obj_set_style_text_font(btnlabel, &lv_font_fzst_24, 0);
     lv_obj_center(btnlabel);
     
+    lvgl_file_manager.timer = lv_timer_create(lvgl_file_manager_timer_cb, LVGL_FILE_MANAGER_POLL_MS, NULL);
     lvgl_file_manager_scan_files(lvgl_file_manager.fpath);
     lvgl_file_manager_files_info(lvgl_file_manager.fpath);
     
@@ -455,12 +862,17 @@ void lvgl_file_manager_creat(lv_obj_t *parent)
 **************************************************************/
 void lvgl_file_manager_delete(void)
 {
-    myfree(SRAMIN, lvgl_file_manager.fpath);
+    storage_service_wait(&lvgl_file_manager.list_request);    /* 存储任务可能仍在写入缓冲区 */
+    storage_service_wait(&lvgl_file_manager.info_request);
+    lv_timer_delete(lvgl_file_manager.timer);
+    lvgl_file_manager.timer = NULL;
+    lvgl_file_manager_free();
     lv_obj_delete(lvgl_file_manager.main_obj);
     lvgl_file_manager.main_obj = NULL;
     lvgl_file_manager.list = NULL;
     lvgl_file_manager.info_obj = NULL;
     lvgl_file_manager.file_selector = FILE_SELECTOR_OFF;
+    lvgl_file_manager.sort = FILE_SORT_NONE;
     memset(lvgl_file_manager.file_ext, '\0', sizeof(lvgl_file_manager.file_ext));
     main_menu_page_flag &= ~0x01;
     if(main_menu_page_flag == 0)
@@ -478,8 +890,12 @@ void lvgl_file_manager_delete(void)
 **************************************************************/
 static void lvgl_file_manager_delete_list(void)
 {
+    storage_service_wait(&lvgl_file_manager.list_request);    /* 等待正在读取的一页完成 */
+    lvgl_file_manager.list_request.state = STORAGE_IDLE;
     lv_obj_delete(lvgl_file_manager.list);
     lvgl_file_manager.list = NULL;
+    lvgl_file_manager.spacer = NULL;
+    lvgl_file_manager.sort_label = NULL;
 }
 
 /**************************************************************
@@ -491,6 +907,35 @@ static void lvgl_file_manager_delete_list(void)
 **************************************************************/
 static void lvgl_file_manager_delete_info_obj(void)
 {
+    storage_service_wait(&lvgl_file_manager.info_request);
+    lvgl_file_manager.info_request.state = STORAGE_IDLE;
     lv_obj_delete(lvgl_file_manager.info_obj);
     lvgl_file_manager.info_obj = NULL;    
-}
\ No newline at end of file
+}
+
+/**************************************************************
+函数名称 ： lvgl_file_manager_free
+功    能 ： 释放文件管理器申请的内存
+参    数 ： 无
+返 回 值 ： 无
+作    者 ： ZeHou
+**************************************************************/
+static void lvgl_file_manager_free(void)
+{
+    myfree(SRAMIN, lvgl_file_manager.fpath);
+    myfree(SRAMIN, lvgl_file_manager.scan_path);
+    myfree(SRAMIN, lvgl_file_manager.info_path);
+    myfree(SRAMIN, lvgl_file_manager.fileinfo);
+    myfree(SRAMEX, lvgl_file_manager.page);
+    myfree(SRAMEX, lvgl_file_manager.entry);
+    myfree(SRAMEX, lvgl_file_manager.view);
+    myfree(SRAMEX, lvgl_file_manager.names);
+    lvgl_file_manager.fpath = NULL;
+    lvgl_file_manager.scan_path = NULL;
+    lvgl_file_manager.info_path = NULL;
+    lvgl_file_manager.fileinfo = NULL;
+    lvgl_file_manager.page = NULL;
+    lvgl_file_manager.entry = NULL;
+    lvgl_file_manager.view = NULL;
+    lvgl_file_manager.names = NULL;
+}
@@ -9,8 +9,17 @@
 #ifndef __LVGL_FILE_MANAGER_H
 #define __LVGL_FILE_MANAGER_H
 #include "./FATFS/fatfs_config.h"
+#include "./FATFS/storage_service.h"
 #include "lvgl.h"
 
+#define LVGL_FILE_MANAGER_PAGE_NUM      32                  /*!< directory entries fetched per storage request */
+#define LVGL_FILE_MANAGER_POLL_MS       20                  /*!< storage request polling period */
+#define LVGL_FILE_MANAGER_ENTRY_MAX     10000               /*!< directory entries kept per directory (SDRAM) */
+#define LVGL_FILE_MANAGER_NAME_POOL     (32 * 1024)         /*!< initial file name storage (SDRAM), doubled when full */
+#define LVGL_FILE_MANAGER_ROW_HEIGHT    40                  /*!< list row height in pixels */
+#define LVGL_FILE_MANAGER_ROW_NUM       14                  /*!< recycled row buttons, more than fit in the list */
+#define LVGL_FILE_MANAGER_NIL           0xFFFF              /*!< no entry */
+
 /*!
     \brief      File selector mode enumeration
 */
@@ -19,8 +28,33 @@ typedef enum
     FILE_SELECTOR_OFF = 0,                              /*!< (0) View files mode */
     FILE_SELECTOR_FLM,                                  /*!< (1) Select FLM files mode */
     FILE_SELECTOR_BIN,                                  /*!< (2) Select BIN files mode */
+    FILE_SELECTOR_RCP,                                  /*!< (3) Select programming recipe files mode */
 }file_selector_enum;
 
+/*!
+    \brief      File list sort mode enumeration
+*/
+typedef enum
+{
+    FILE_SORT_NONE = 0,                                 /*!< (0) Directory order */
+    FILE_SORT_NAME,                                     /*!< (1) Name, directories first */
+    FILE_SORT_DATE,                                     /*!< (2) Newest first, directories first */
+    FILE_SORT_SIZE,                                     /*!< (3) Largest first, directories first */
+    FILE_SORT_NUM,
+}file_sort_enum;
+
+/*!
+    \brief      Directory entry structure
+*/
+typedef struct
+{
+    uint32_t name;                          /*!< Offset of the name in the name storage */
+    FSIZE_t fsize;                          /*!< File size */
+    WORD fdate;                             /*!< Modified date */
+    WORD ftime;                             /*!< Modified time */
+    BYTE fattrib;                           /*!< File attribute */
+}lvgl_file_manager_entry_struct;
+
 /*!
     \brief      LVGL file manager structure
 */
@@ -28,11 +62,29 @@ typedef struct
 {
     lv_obj_t *main_obj;                     /*!< Main object container */
     lv_obj_t *info_obj;                     /*!< Information object */
-    lv_obj_t *list;                         /*!< File list object */
+    lv_obj_t *list;                         /*!< File list object, only the visible rows exist */
+    lv_obj_t *spacer;                       /*!< Sets the scroll height of the list */
+    lv_obj_t *sort_label;                   /*!< Sort mode button label */
+    lv_obj_t *row[LVGL_FILE_MANAGER_ROW_NUM];           /*!< Recycled row buttons */
+    uint16_t row_entry[LVGL_FILE_MANAGER_ROW_NUM];      /*!< Entry shown by each row, LVGL_FILE_MANAGER_NIL none */
+    lvgl_file_manager_entry_struct *entry;  /*!< Directory entries in read order */
+    uint16_t *view;                         /*!< Filtered and sorted entry indices */
+    char *names;                            /*!< File name storage */
+    uint32_t names_size;                    /*!< Size of the name storage */
+    uint32_t names_used;                    /*!< Used bytes of the name storage */
+    uint16_t entry_num;                     /*!< Number of entries read */
+    uint16_t view_num;                      /*!< Number of entries shown */
+    file_sort_enum sort;                    /*!< Sort mode */
+    uint32_t scan_tick;                     /*!< Directory scan start time */
     char *fpath;                            /*!< File path pointer */
-    DIR *dir;                               /*!< Directory pointer */
-    FIL *file;                              /*!< File pointer */
+    char *scan_path;                        /*!< Directory being listed by list_request */
+    char *info_path;                        /*!< Path being queried by info_request */
+    FILINFO *page;                          /*!< Directory entries of the page being loaded */
     FILINFO *fileinfo;                      /*!< File information pointer */
+    lv_obj_t *info_table;                   /*!< File information table */
+    lv_timer_t *timer;                      /*!< Polls the storage requests */
+    storage_request_struct list_request;    /*!< Directory page request */
+    storage_request_struct info_request;    /*!< File information request */
     FRESULT fresult;                        /*!< File system result */
     file_selector_enum file_selector;      /*!< File selector mode */
     char file_ext[5];                       /*!< File extension, max 4 characters */
@@ -46,6 +98,7 @@ static const char *const file_selector_file_ext[] = {
     "",                                     /*!< No filter */
     "FLM",                                  /*!< FLM file extension */
     "BIN",                                  /*!< BIN file extension */
+    "RCP",                                  /*!< Programming recipe file extension */
 };
 
 /* function declarations */
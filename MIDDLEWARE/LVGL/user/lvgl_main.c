@@ -13,6 +13,7 @@
 #include "lvgl_debugger.h"
 #include "lvgl_usart.h"
 #include "lvgl_can.h"
+#include "lvgl_wallpaper.h"
 
 lvgl_main_struct lvgl_main;
 lvgl_style_struct lvgl_style;
@@ -22,7 +23,6 @@ static lvgl_cpu_info_struct lvgl_cpu_info;
 static lvgl_main_mem_perused_struct lvgl_main_mem_perused;
 lvgl_main_state_struct lvgl_main_state;
 
-static __ALIGNED(4) uint8_t wallpaper_buffer[1024 * 1024] __attribute__((section(".bss.ARM.__at_0XC0100000")));
 volatile uint8_t main_menu_page_flag = 0;
 volatile static uint8_t timer_run_count = 0;
     
@@ -52,7 +52,6 @@ static void lvgl_show_mem_perused(void);
 static void lvgl_show_wifi_name(void);
 static void lvgl_show_rtc_data(void);
 static void lvgl_style_init(void);
-static uint8_t lvgl_wallpaper_load(lv_img_dsc_t *image, const char *path);
 
 static void lvgl_power_creat(uint16_t width, uint16_t height);
 static void lvgl_debugger_on_line_creat(uint16_t width, uint16_t height);
@@ -413,7 +412,10 @@ void lvgl_start(void)
     lv_anim_t a2;
 
     lvgl_style_init();
-    lvgl_wallpaper_load(&lvgl_main.wallpaper_dsc, "C:/SYSTEM/wallpaper/wallpaper.bin");
+    if(lvgl_wallpaper_load(&lvgl_main.wallpaper_dsc, LVGL_WALLPAPER_DIR "/wallpaper.wpz") != 0)    /* 优先使用压缩壁纸 */
+    {
+        lvgl_wallpaper_load(&lvgl_main.wallpaper_dsc, LVGL_WALLPAPER_DIR "/wallpaper.bin");
+    }
     
     lv_obj_set_style_bg_color(lv_screen_active(), lv_color_black(), 0);
     
@@ -854,66 +856,24 @@ static void lvgl_style_init(void)
 }
 
 /**************************************************************
-函数名称 ： lvgl_wallpaper_load
-功    能 ： 加载壁纸数据到SDRAM
-参    数 ： image: 图像数据描述结构体, path: 壁纸路径
-返 回 值 ： 无
+函数名称 ： lvgl_main_wallpaper_set
+功    能 ： 切换壁纸, 最近使用的壁纸从SDRAM缓存直接显示
+参    数 ： path: 壁纸路径
+返 回 值 ： 0: 成功, 其他: 加载失败, 保持原壁纸
 作    者 ： ZeHou
 **************************************************************/
-static uint8_t lvgl_wallpaper_load(lv_img_dsc_t *image, const char *path)
+uint8_t lvgl_main_wallpaper_set(const char *path)
 {
-    /* header size 12 byte
-    +----------------------------------------------------------+
-    | magic |  cf  | flags |   w   |   h   | stride | reserved |
-    +----------------------------------------------------------+
-    |  8bit | 8bit | 16bit | 16bit | 16bit | 16bit  |  16bit   |
-    +----------------------------------------------------------+
-    */
-    uint32_t read_bytes, file_size;
-    FRESULT fresult;
-    FIL *file;
-    uint8_t *pbuffer;
-    
-    pbuffer = wallpaper_buffer;
-
-    file = (FIL *)mymalloc(SRAMIN, sizeof(FIL));
-    if((file == NULL))
-    {
-        return 1;
-    }
+    uint8_t res;
 
-    fresult = f_open(file, path, FA_READ);
-    if(fresult != FR_OK)
-    {
-        return fresult;
-    }
-    
-    file_size = f_size(file);
-    if(file_size - 12 > 800 * 480 * 2)
-    {
-        return 2;
-    }
-    
-    fresult = f_read(file, pbuffer, file_size, &read_bytes);
-    if(fresult != FR_OK || read_bytes != file_size)
+    res = lvgl_wallpaper_load(&lvgl_main.wallpaper_dsc, path);
+    if((res == 0) && (lvgl_main.wallpaper != NULL))
     {
-        return fresult;
+        lv_image_set_src(lvgl_main.wallpaper, &lvgl_main.wallpaper_dsc);
+        lv_obj_invalidate(lvgl_main.wallpaper);
     }
- 
-    image->header.magic         = *(uint8_t *)((uint8_t *)pbuffer + 0);
-    image->header.cf            = *(uint8_t *)((uint8_t *)pbuffer + 1);
-    image->header.flags         = *(uint16_t *)((uint8_t *)pbuffer + 2);
-    image->header.w             = *(uint16_t *)((uint8_t *)pbuffer + 4);
-    image->header.h             = *(uint16_t *)((uint8_t *)pbuffer + 6);
-    image->header.stride        = *(uint16_t *)((uint8_t *)pbuffer + 8);
-    image->header.reserved_2    = *(uint16_t *)((uint8_t *)pbuffer + 10);
-    image->data_size            = file_size - 12;
-    image->data                 = (uint8_t *)pbuffer + 12;
-
-    f_close(file);
-    myfree(SRAMIN, file);
-    
-    return 0;
+
+    return res;
 }
 
 
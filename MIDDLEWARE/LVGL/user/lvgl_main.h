@@ -129,5 +129,6 @@ void lvgl_all_keyboard_delete(void);                            /* delete full k
 void lvgl_show_error_msgbox_creat(const char *errorInfo);       /* create error message box */
 void lvgl_hidden_main_menu(void);                               /* hide main menu */
 void lvgl_show_main_menu(void);                                 /* show main menu */
+uint8_t lvgl_main_wallpaper_set(const char *path);              /* change the wallpaper */
 
 #endif /* __LVGL_MAIN_H */
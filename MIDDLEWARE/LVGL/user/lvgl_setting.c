@@ -5,8 +5,13 @@
 #include "./CH224K/ch224k.h"
 #include "./SCREEN/RGBLCD/rgblcd.h"
 #include "./SC8721/sc8721.h"
+#include "./SDIO/sdio_emmc.h"
+#include "./LVGL/font/lvgl_font_config.h"
+#include "./FATFS/storage_service.h"
+#include "lvgl_wallpaper.h"
 #include "./MALLOC/malloc.h"
 #include "freertos_main.h"
+#include <string.h>
 
 lvgl_setting_struct lvgl_setting;
 lvgl_setting_state_struct lvgl_setting_state;
@@ -28,6 +33,7 @@ static lv_obj_t *menu_create_switch(lv_obj_t *parent, const char *icon, const ch
 static lv_obj_t *menu_create_btn(lv_obj_t *parent, const char *icon, const char *txt, const char *btn_txt);
 static lv_obj_t *menu_create_dropdown(lv_obj_t *parent, const char *icon, const char *txt, const char *option, uint8_t option_id);
 static void lvgl_setting_delete(void);
+static void lvgl_setting_wallpaper_list(lv_obj_t *dropdown);
 static void lvgl_setting_scan_wifi_list_creat(void);
 static void lvgl_setting_scan_wifi_list_delete(void);
 
@@ -338,6 +344,18 @@ static void dropdown_event_handler(lv_event_t *e)
                     default: break;
                 }
             }
+            else if(dropdown == lvgl_setting.wallpaper_dropdown)
+            {
+                char path[FF_LFN_BUF + 1];
+                uint32_t length = sizeof(LVGL_WALLPAPER_DIR);
+
+                memcpy(path, LVGL_WALLPAPER_DIR "/", length);
+                lv_dropdown_get_selected_str(dropdown, path + length, sizeof(path) - length);
+                if(lvgl_main_wallpaper_set(path) != 0)
+                {
+                    lvgl_setting_wallpaper_list(dropdown);      /* 加载失败, 恢复为当前壁纸 */
+                }
+            }
             break;
         
         default: break;
@@ -405,6 +423,7 @@ void lvgl_setting_creat(lv_obj_t *parent)
     
     uint8_t buffer_len;
     char data_buffer[256];
+    char speed_buffer[2][16];
     
     lvgl_setting.main_obj = lv_obj_create(parent);
     lv_obj_set_size(lvgl_setting.main_obj, lv_pct(100), lv_pct(100));
@@ -455,6 +474,21 @@ void lvgl_setting_creat(lv_obj_t *parent)
     snprintf(data_buffer, buffer_len, "RAM: %u KB(ITCM: %u, DTCM: %u, SRAM: %u)", system_device_info.memory_sram, system_device_info.share_sram_itcm, system_device_info.share_sram_dtcm, \
                                                                                   system_device_info.memory_sram - system_device_info.share_sram_itcm - system_device_info.share_sram_dtcm);
     cont = menu_create_text(section, NULL, data_buffer, LV_MENU_ITEM_BUILDER_VARIANT_1);
+    /* 0表示未测量(写入测速默认关闭, 见EMMC_SPEED_TEST_BOOT) */
+    snprintf(speed_buffer[0], sizeof(speed_buffer[0]), emmc_info.read_speed ? "%u.%02u MB/s" : "not measured",
+             emmc_info.read_speed / 1024, emmc_info.read_speed % 1024 * 100 / 1024);
+    snprintf(speed_buffer[1], sizeof(speed_buffer[1]), emmc_info.write_speed ? "%u.%02u MB/s" : "not measured",
+             emmc_info.write_speed / 1024, emmc_info.write_speed % 1024 * 100 / 1024);
+    buffer_len = snprintf(NULL, 0, "eMMC: %u-bit %s, R %s, W %s", emmc_info.bus_width, emmc_info.bus_ddr ? "DDR" : "SDR", speed_buffer[0], speed_buffer[1]) + 1;
+    snprintf(data_buffer, buffer_len, "eMMC: %u-bit %s, R %s, W %s", emmc_info.bus_width, emmc_info.bus_ddr ? "DDR" : "SDR", speed_buffer[0], speed_buffer[1]);
+    cont = menu_create_text(section, NULL, data_buffer, LV_MENU_ITEM_BUILDER_VARIANT_1);
+    buffer_len = snprintf(NULL, 0, "Font: %u/%u in SDRAM(%u full, %u/%u KB%s), hit %u%%", lvgl_font_preload_info.resident_num, LVGL_FONT_PRELOAD_NUM, \
+                                    lvgl_font_preload_info.full_num, lvgl_font_preload_info.used / 1024, LVGL_FONT_PRELOAD_BUDGET / 1024, lvgl_font_preload_info.done ? "" : ", loading", \
+                                    lvgl_font_cache_info.hit * 100 / (lvgl_font_cache_info.hit + lvgl_font_cache_info.miss + 1)) + 1;
+    snprintf(data_buffer, buffer_len, "Font: %u/%u in SDRAM(%u full, %u/%u KB%s), hit %u%%", lvgl_font_preload_info.resident_num, LVGL_FONT_PRELOAD_NUM, \
+                                    lvgl_font_preload_info.full_num, lvgl_font_preload_info.used / 1024, LVGL_FONT_PRELOAD_BUDGET / 1024, lvgl_font_preload_info.done ? "" : ", loading", \
+                                    lvgl_font_cache_info.hit * 100 / (lvgl_font_cache_info.hit + lvgl_font_cache_info.miss + 1));
+    cont = menu_create_text(section, NULL, data_buffer, LV_MENU_ITEM_BUILDER_VARIANT_1);
 
     section = lv_menu_section_create(root_page);
     cont = menu_create_text(section, NULL, "关于此设备", LV_MENU_ITEM_BUILDER_VARIANT_1);
@@ -477,6 +511,10 @@ void lvgl_setting_creat(lv_obj_t *parent)
     snprintf(data_buffer, buffer_len, "屏幕分辨率: %ux%u", lv_display_get_horizontal_resolution(lv_display_get_default()), \
                                                            lv_display_get_vertical_resolution(lv_display_get_default()));
     cont = menu_create_text(section, NULL, data_buffer, LV_MENU_ITEM_BUILDER_VARIANT_1);
+    cont = menu_create_dropdown(section, NULL, "壁纸", "", 0);
+    lvgl_setting.wallpaper_dropdown = lv_obj_get_child(cont, 1);
+    lvgl_setting_wallpaper_list(lvgl_setting.wallpaper_dropdown);
+    lv_obj_add_event_cb(lvgl_setting.wallpaper_dropdown, dropdown_event_handler, LV_EVENT_VALUE_CHANGED, NULL);
     
     section = lv_menu_section_create(root_page);
     cont = menu_create_text(section, NULL, "显示与亮度", LV_MENU_ITEM_BUILDER_VARIANT_1);
@@ -739,6 +777,58 @@ static void lvgl_setting_delete(void)
     }
 }
 
+/**************************************************************
+函数名称 ： lvgl_setting_wallpaper_list
+功    能 ： 列出壁纸目录中的.wpz和.bin文件, 选中当前壁纸
+参    数 ： dropdown: 壁纸下拉列表
+返 回 值 ： 无
+作    者 ： ZeHou
+**************************************************************/
+static void lvgl_setting_wallpaper_list(lv_obj_t *dropdown)
+{
+    storage_request_struct request = {0};
+    FILINFO *fileinfo;
+    const char *ext;
+    uint32_t i;
+    int32_t index;
+
+    lv_dropdown_clear_options(dropdown);
+    fileinfo = (FILINFO *)mymalloc(SRAMIN, LVGL_WALLPAPER_LIST_NUM * sizeof(FILINFO));
+    if(fileinfo == NULL)
+    {
+        return;
+    }
+
+    request.op = STORAGE_OP_READDIR;
+    request.prio = STORAGE_PRIO_NORMAL;
+    request.path = LVGL_WALLPAPER_DIR;
+    request.buffer = fileinfo;
+    request.offset = 0;
+    request.size = LVGL_WALLPAPER_LIST_NUM;
+    storage_service_run(&request);
+
+    for(i = 0; i < request.result; i++)
+    {
+        ext = strrchr(fileinfo[i].fname, '.');
+        if((fileinfo[i].fattrib & AM_DIR) || (ext == NULL))continue;
+        if((strcmp(ext, ".wpz") == 0) || (strcmp(ext, ".WPZ") == 0) ||
+           (strcmp(ext, ".bin") == 0) || (strcmp(ext, ".BIN") == 0))
+        {
+            lv_dropdown_add_option(dropdown, fileinfo[i].fname, LV_DROPDOWN_POS_LAST);
+        }
+    }
+    myfree(SRAMIN, fileinfo);
+
+    if(lvgl_wallpaper_info.path != NULL)
+    {
+        index = lv_dropdown_get_option_index(dropdown, strrchr(lvgl_wallpaper_info.path, '/') + 1);
+        if(index >= 0)
+        {
+            lv_dropdown_set_selected(dropdown, index);
+        }
+    }
+}
+
 /**************************************************************
 函数名称 ： listbtn_event_handler
 功    能 ： 列表事件回调
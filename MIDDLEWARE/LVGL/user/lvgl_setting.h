@@ -18,6 +18,7 @@ typedef struct
     lv_obj_t *main_obj;                     /*!< Main object container */
     lv_obj_t *brightness_slider;            /*!< Brightness adjustment slider */
     lv_obj_t *brightness_slider_label;      /*!< Brightness slider label */
+    lv_obj_t *wallpaper_dropdown;           /*!< Wallpaper selection dropdown */
     lv_obj_t *wifi_switch;                  /*!< WiFi enable/disable switch */
     lv_obj_t *wifi_cont;                    /*!< WiFi container */
     lv_obj_t *wifi_label;                   /*!< WiFi status label */
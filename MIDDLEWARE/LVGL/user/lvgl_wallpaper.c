@@ -0,0 +1,437 @@
+#include "lvgl_wallpaper.h"
+#include "./FATFS/storage_service.h"
+#include "./FATFS/block_cache.h"
+#include "./MALLOC/malloc.h"
+#include "./USART/usart.h"
+#include <string.h>
+
+#define LVGL_WALLPAPER_SIZE_MAX         (LVGL_WALLPAPER_WIDTH * LVGL_WALLPAPER_HEIGHT * 2)
+
+/*!
+    \brief      Decoded wallpaper cache slot structure
+*/
+typedef struct
+{
+    char path[FF_LFN_BUF + 1];                          /*!< Wallpaper file, empty when the slot is free */
+    uint8_t *data;                                      /*!< Decoded pixels */
+    lv_image_header_t header;                           /*!< LVGL image header of the pixels */
+    uint32_t data_size;                                 /*!< Bytes of pixels */
+    uint32_t fsize;                                     /*!< File size when decoded */
+    uint32_t mtime;                                     /*!< File fdate << 16 | ftime when decoded */
+    uint32_t generation;                                /*!< Block cache generation when last checked */
+    uint32_t use;                                       /*!< Last use, for the LRU replacement */
+}lvgl_wallpaper_slot_struct;
+
+lvgl_wallpaper_info_struct lvgl_wallpaper_info;
+static __ALIGNED(4) uint8_t wallpaper_buffer[1024 * 1024] __attribute__((section(".bss.ARM.__at_0XC0100000")));
+static lvgl_wallpaper_slot_struct lvgl_wallpaper_slot[LVGL_WALLPAPER_CACHE_NUM];
+static uint8_t lvgl_wallpaper_current = 0xFF;           /* 当前显示的缓存槽 */
+static uint32_t lvgl_wallpaper_use = 0;
+
+/* static function declarations */
+static FRESULT lvgl_wallpaper_read(const char *path, void *buffer, uint32_t offset, uint32_t size);
+static uint8_t lvgl_wallpaper_rle_decode(const uint8_t *src, uint32_t src_size, uint16_t *dst, uint32_t pixels);
+static uint8_t lvgl_wallpaper_load_raw(lvgl_wallpaper_slot_struct *slot, const char *path, uint32_t file_size);
+static uint8_t lvgl_wallpaper_load_wpz(lvgl_wallpaper_slot_struct *slot, const char *path);
+
+/**************************************************************
+函数名称 ： lvgl_wallpaper_load
+功    能 ： 加载壁纸到SDRAM缓存槽, 已缓存且文件未变化时不读文件
+参    数 ： image: 图像数据描述结构体, path: 壁纸路径(.bin或.wpz)
+返 回 值 ： 0: 成功, 1: 内存不足, 2: 格式错误, 3: 读文件失败
+作    者 ： ZeHou
+**************************************************************/
+uint8_t lvgl_wallpaper_load(lv_image_dsc_t *image, const char *path)
+{
+    storage_request_struct request = {0};
+    lvgl_wallpaper_slot_struct *slot = NULL;
+    FILINFO *fileinfo;
+    uint32_t tick, mtime;
+    uint8_t i, res = 0, victim = 0xFF;
+
+    tick = lv_tick_get();
+    lvgl_wallpaper_info.bytes_read = 0;
+
+    /* 查找缓存, 卷未被USB主机写过时无需任何I/O */
+    for(i = 0; i < LVGL_WALLPAPER_CACHE_NUM; i++)
+    {
+        if((lvgl_wallpaper_slot[i].path[0] != '\0') && (strcmp(lvgl_wallpaper_slot[i].path, path) == 0))
+        {
+            slot = &lvgl_wallpaper_slot[i];
+            break;
+        }
+    }
+
+    fileinfo = NULL;
+    if((slot == NULL) || (slot->generation != block_cache_info.generation))
+    {
+        fileinfo = (FILINFO *)mymalloc(SRAMIN, sizeof(FILINFO));
+        if(fileinfo == NULL)
+        {
+            return 1;
+        }
+
+        request.op = STORAGE_OP_STAT;
+        request.prio = STORAGE_PRIO_NORMAL;
+        request.path = path;
+        request.buffer = fileinfo;
+        if(storage_service_run(&request) != FR_OK)
+        {
+            myfree(SRAMIN, fileinfo);
+            return 3;
+        }
+
+        mtime = ((uint32_t)fileinfo->fdate << 16) | fileinfo->ftime;
+        if((slot != NULL) && (slot->fsize == (uint32_t)fileinfo->fsize) && (slot->mtime == mtime))
+        {
+            slot->generation = block_cache_info.generation;     /* 文件未变化 */
+        }
+        else
+        {
+            slot = NULL;
+        }
+    }
+
+    if(slot != NULL)
+    {
+        lvgl_wallpaper_info.cache_hit++;
+    }
+    else
+    {
+        /* 选择空槽或最久未用的槽, 不覆盖正在显示的壁纸 */
+        for(i = 0; i < LVGL_WALLPAPER_CACHE_NUM; i++)
+        {
+            if(i == lvgl_wallpaper_current)continue;
+            if((victim == 0xFF) || (lvgl_wallpaper_slot[i].path[0] == '\0') ||
+               ((lvgl_wallpaper_slot[victim].path[0] != '\0') && (lvgl_wallpaper_slot[i].use < lvgl_wallpaper_slot[victim].use)))
+            {
+                victim = i;
+            }
+        }
+        slot = &lvgl_wallpaper_slot[victim];
+
+        if(slot->data == NULL)
+        {
+            slot->data = (victim == 0) ? wallpaper_buffer : (uint8_t *)mymalloc(SRAMEX, LVGL_WALLPAPER_SIZE_MAX);
+            if(slot->data == NULL)
+            {
+                myfree(SRAMIN, fileinfo);
+                return 1;
+            }
+        }
+        slot->path[0] = '\0';
+
+        if((fileinfo->fsize >= sizeof(lvgl_wallpaper_header_struct)) && (strlen(path) <= FF_LFN_BUF))
+        {
+            res = lvgl_wallpaper_load_wpz(slot, path);
+            if(res == 5)
+            {
+                res = lvgl_wallpaper_load_raw(slot, path, (uint32_t)fileinfo->fsize);
+            }
+        }
+        else
+        {
+            res = 2;
+        }
+
+        if(res != 0)
+        {
+            myfree(SRAMIN, fileinfo);
+            PRINT_ERROR("wallpaper %s load failed(%d)\r\n", path, res);
+            return res;
+        }
+
+        /* 同一路径的旧缓存已过期 */
+        for(i = 0; i < LVGL_WALLPAPER_CACHE_NUM; i++)
+        {
+            if((&lvgl_wallpaper_slot[i] != slot) && (strcmp(lvgl_wallpaper_slot[i].path, path) == 0))
+            {
+                lvgl_wallpaper_slot[i].path[0] = '\0';
+            }
+        }
+        strcpy(slot->path, path);
+        slot->fsize = (uint32_t)fileinfo->fsize;
+        slot->mtime = ((uint32_t)fileinfo->fdate << 16) | fileinfo->ftime;
+        slot->generation = block_cache_info.generation;
+        lvgl_wallpaper_info.cache_miss++;
+    }
+    myfree(SRAMIN, fileinfo);
+
+    slot->use = ++lvgl_wallpaper_use;
+    lvgl_wallpaper_current = slot - lvgl_wallpaper_slot;
+    lvgl_wallpaper_info.path = slot->path;              /* 显示中的槽不会被替换 */
+
+    lv_image_cache_drop(image);                         /* 描述符内容即将改变 */
+    image->header       = slot->header;
+    image->data_size    = slot->data_size;
+    image->data         = slot->data;
+
+    lvgl_wallpaper_info.load_ms = lv_tick_elaps(tick);
+    PRINT_INFO("wallpaper %s: %u bytes read, %u ms\r\n", path, lvgl_wallpaper_info.bytes_read, lvgl_wallpaper_info.load_ms);
+
+    return 0;
+}
+
+/**************************************************************
+函数名称 ： lvgl_wallpaper_read
+功    能 ： 通过存储任务读取文件数据
+参    数 ： path: 文件路径, buffer: 数据缓冲区
+            offset: 文件偏移, size: 读取大小
+返 回 值 ： 读取结果, 读取不足时返回FR_INT_ERR
+作    者 ： ZeHou
+**************************************************************/
+static FRESULT lvgl_wallpaper_read(const char *path, void *buffer, uint32_t offset, uint32_t size)
+{
+    storage_request_struct request = {0};
+
+    request.op = STORAGE_OP_READ;
+    request.prio = STORAGE_PRIO_NORMAL;
+    request.path = path;
+    request.buffer = buffer;
+    request.offset = offset;
+    request.size = size;
+    if(storage_service_run(&request) != FR_OK)
+    {
+        return request.fresult;
+    }
+    lvgl_wallpaper_info.bytes_read += request.result;
+
+    return (request.result == size) ? FR_OK : FR_INT_ERR;
+}
+
+/**************************************************************
+函数名称 ： lvgl_wallpaper_rle_decode
+功    能 ： 解码一个RLE16图块
+参    数 ： src: 压缩数据, src_size: 压缩数据大小
+            dst: 像素输出, pixels: 图块像素数
+返 回 值 ： 0: 成功, 1: 数据错误
+作    者 ： ZeHou
+**************************************************************/
+static uint8_t lvgl_wallpaper_rle_decode(const uint8_t *src, uint32_t src_size, uint16_t *dst, uint32_t pixels)
+{
+    const uint8_t *src_end = src + src_size;
+    uint16_t *dst_end = dst + pixels;
+    uint16_t pixel;
+    uint32_t count;
+
+    while((src < src_end) && (dst < dst_end))
+    {
+        count = (*src & 0x7F) + 1;
+        if((uint32_t)(dst_end - dst) < count)
+        {
+            return 1;
+        }
+
+        if(*src++ & 0x80)
+        {
+            if(src_end - src < 2)
+            {
+                return 1;
+            }
+            pixel = src[0] | (src[1] << 8);
+            src += 2;
+            while(count--)
+            {
+                *dst++ = pixel;
+            }
+        }
+        else
+        {
+            if((uint32_t)(src_end - src) < count * 2)
+            {
+                return 1;
+            }
+            memcpy(dst, src, count * 2);
+            dst += count;
+            src += count * 2;
+        }
+    }
+
+    return ((src == src_end) && (dst == dst_end)) ? 0 : 1;
+}
+
+/**************************************************************
+函数名称 ： lvgl_wallpaper_load_raw
+功    能 ： 分块读取未压缩的LVGL图像文件
+参    数 ： slot: 缓存槽, path: 壁纸路径, file_size: 文件大小
+返 回 值 ： 0: 成功, 2: 格式错误, 3: 读文件失败
+作    者 ： ZeHou
+**************************************************************/
+static uint8_t lvgl_wallpaper_load_raw(lvgl_wallpaper_slot_struct *slot, const char *path, uint32_t file_size)
+{
+    /* header size 12 byte
+    +----------------------------------------------------------+
+    | magic |  cf  | flags |   w   |   h   | stride | reserved |
+    +----------------------------------------------------------+
+    |  8bit | 8bit | 16bit | 16bit | 16bit | 16bit  |  16bit   |
+    +----------------------------------------------------------+
+    */
+    uint32_t offset, size;
+
+    if((file_size < sizeof(lv_image_header_t)) || (file_size - sizeof(lv_image_header_t) > LVGL_WALLPAPER_SIZE_MAX))
+    {
+        return 2;
+    }
+
+    if(lvgl_wallpaper_read(path, &slot->header, 0, sizeof(lv_image_header_t)) != FR_OK)
+    {
+        return 3;
+    }
+    if(slot->header.magic != LV_IMAGE_HEADER_MAGIC)
+    {
+        return 2;
+    }
+
+    slot->data_size = file_size - sizeof(lv_image_header_t);
+    for(offset = 0; offset < slot->data_size; offset += size)
+    {
+        size = slot->data_size - offset;
+        if(size > LVGL_WALLPAPER_READ_SIZE)size = LVGL_WALLPAPER_READ_SIZE;
+
+        if(lvgl_wallpaper_read(path, slot->data + offset, sizeof(lv_image_header_t) + offset, size) != FR_OK)
+        {
+            return 3;
+        }
+    }
+
+    return 0;
+}
+
+/**************************************************************
+函数名称 ： lvgl_wallpaper_load_wpz
+功    能 ： 流式读取并解码压缩壁纸, 存储任务预读下一图块
+参    数 ： slot: 缓存槽, path: 壁纸路径
+返 回 值 ： 0: 成功, 1: 内存不足, 2: 格式错误, 3: 读文件失败, 5: 不是压缩壁纸
+作    者 ： ZeHou
+**************************************************************/
+static uint8_t lvgl_wallpaper_load_wpz(lvgl_wallpaper_slot_struct *slot, const char *path)
+{
+    storage_request_struct request[2] = {0};
+    lvgl_wallpaper_header_struct header;
+    uint32_t *tile_table = NULL;
+    uint8_t *stage[2] = {NULL, NULL};
+    uint32_t tile_max, offset, size, rows;
+    uint16_t tile;
+    uint8_t res = 0;
+
+    if(lvgl_wallpaper_read(path, &header, 0, sizeof(header)) != FR_OK)
+    {
+        return 3;
+    }
+    if(header.magic != LVGL_WALLPAPER_MAGIC)
+    {
+        return 5;
+    }
+    if((header.w == 0) || (header.w > LVGL_WALLPAPER_WIDTH) || (header.h == 0) || (header.h > LVGL_WALLPAPER_HEIGHT) ||
+       (header.tile_h == 0) || (header.tile_num != (header.h + header.tile_h - 1) / header.tile_h) ||
+       (header.method != LVGL_WALLPAPER_METHOD_RLE16) || (header.cf != LV_COLOR_FORMAT_RGB565))
+    {
+        return 2;
+    }
+
+    tile_max = header.w * header.tile_h * 2;
+    tile_table = (uint32_t *)mymalloc(SRAMIN, header.tile_num * sizeof(uint32_t));
+    stage[0] = (uint8_t *)mymalloc(SRAMEX, tile_max);
+    stage[1] = (uint8_t *)mymalloc(SRAMEX, tile_max);
+    if((tile_table == NULL) || (stage[0] == NULL) || (stage[1] == NULL))
+    {
+        res = 1;
+        goto __exit;
+    }
+
+    if(lvgl_wallpaper_read(path, tile_table, sizeof(header), header.tile_num * sizeof(uint32_t)) != FR_OK)
+    {
+        res = 3;
+        goto __exit;
+    }
+    for(tile = 0; tile < header.tile_num; tile++)
+    {
+        if((tile_table[tile] & ~LVGL_WALLPAPER_TILE_RAW) > tile_max)
+        {
+            res = 2;
+            goto __exit;
+        }
+    }
+
+    /* 图块i解码时, 存储任务已在读取图块i+1 */
+    offset = sizeof(header) + header.tile_num * sizeof(uint32_t);
+    for(tile = 0; tile < header.tile_num; tile++)
+    {
+        request[tile & 1].op = STORAGE_OP_READ;
+        request[tile & 1].prio = STORAGE_PRIO_NORMAL;
+        request[tile & 1].path = path;
+        request[tile & 1].buffer = stage[tile & 1];
+        request[tile & 1].offset = offset;
+        request[tile & 1].size = tile_table[tile] & ~LVGL_WALLPAPER_TILE_RAW;
+        offset += request[tile & 1].size;
+
+        if(tile == 0)
+        {
+            storage_service_run(&request[0]);
+        }
+        else
+        {
+            storage_service_wait(&request[tile & 1]);   /* 上一轮已提交 */
+        }
+        if((request[tile & 1].fresult != FR_OK) || (request[tile & 1].result != request[tile & 1].size))
+        {
+            res = 3;
+            break;
+        }
+        lvgl_wallpaper_info.bytes_read += request[tile & 1].result;
+
+        if(tile + 1 < header.tile_num)
+        {
+            request[(tile + 1) & 1].op = STORAGE_OP_READ;
+            request[(tile + 1) & 1].prio = STORAGE_PRIO_NORMAL;
+            request[(tile + 1) & 1].path = path;
+            request[(tile + 1) & 1].buffer = stage[(tile + 1) & 1];
+            request[(tile + 1) & 1].offset = offset;
+            request[(tile + 1) & 1].size = tile_table[tile + 1] & ~LVGL_WALLPAPER_TILE_RAW;
+            if(storage_service_submit(&request[(tile + 1) & 1]) != 0)
+            {
+                storage_service_run(&request[(tile + 1) & 1]);  /* 队列已满, 直接等待 */
+            }
+        }
+
+        rows = header.h - tile * header.tile_h;
+        if(rows > header.tile_h)rows = header.tile_h;
+        size = header.w * rows * 2;
+
+        if(tile_table[tile] & LVGL_WALLPAPER_TILE_RAW)
+        {
+            if(request[tile & 1].size != size)
+            {
+                res = 2;
+                break;
+            }
+            memcpy(slot->data + tile * header.tile_h * header.w * 2, stage[tile & 1], size);
+        }
+        else if(lvgl_wallpaper_rle_decode(stage[tile & 1], request[tile & 1].size,
+                                          (uint16_t *)(slot->data + tile * header.tile_h * header.w * 2), size / 2) != 0)
+        {
+            res = 2;
+            break;
+        }
+    }
+
+    if(res == 0)
+    {
+        memset(&slot->header, 0x00, sizeof(slot->header));
+        slot->header.magic = LV_IMAGE_HEADER_MAGIC;
+        slot->header.cf = LV_COLOR_FORMAT_RGB565;
+        slot->header.w = header.w;
+        slot->header.h = header.h;
+        slot->header.stride = header.w * 2;
+        slot->data_size = header.w * header.h * 2;
+    }
+
+__exit:
+    storage_service_wait(&request[0]);                  /* 预读可能仍在写入缓冲区 */
+    storage_service_wait(&request[1]);
+    myfree(SRAMIN, tile_table);
+    myfree(SRAMEX, stage[0]);
+    myfree(SRAMEX, stage[1]);
+
+    return res;
+}
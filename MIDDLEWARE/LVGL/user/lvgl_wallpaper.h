@@ -0,0 +1,72 @@
+/*!
+    \file       lvgl_wallpaper.h
+    \brief      LVGL wallpaper loader header file
+    \version    1.0
+    \date       2025-08-30
+    \author     Ze-Hou
+    \note       two file formats are accepted:
+                - raw LVGL image (.bin): 12-byte lv_image_header_t followed by
+                  the RGB565 pixels, read straight into the cache slot
+                - compressed wallpaper (.wpz): lvgl_wallpaper_header_struct,
+                  a table of tile_num uint32_t tile sizes, then the tiles.
+                  A tile is tile_h full-width rows (the last one may be
+                  shorter) coded with LVGL_WALLPAPER_METHOD_RLE16, or stored
+                  as plain pixels when LVGL_WALLPAPER_TILE_RAW is set in its
+                  size. RLE16 control byte c: bit7 set repeats the following
+                  pixel (c & 0x7F) + 1 times, bit7 clear copies the following
+                  (c + 1) pixels. All values are little endian.
+                Tiles are read by the storage task one ahead of the decoder.
+                Decoded wallpapers stay in LVGL_WALLPAPER_CACHE_NUM SDRAM slots,
+                loading a cached wallpaper again costs no file I/O as long as
+                the volume has not been written by the USB host.
+                tools/wpz_encode/wpz_encode.py writes .wpz files from .bin or
+                PNG wallpapers.
+*/
+
+#ifndef __LVGL_WALLPAPER_H
+#define __LVGL_WALLPAPER_H
+#include "./FATFS/fatfs_config.h"
+#include "lvgl.h"
+
+#define LVGL_WALLPAPER_WIDTH            800                 /*!< largest wallpaper width */
+#define LVGL_WALLPAPER_HEIGHT           480                 /*!< largest wallpaper height */
+#define LVGL_WALLPAPER_CACHE_NUM        3                   /*!< decoded wallpapers kept in SDRAM, at least 2 */
+#define LVGL_WALLPAPER_READ_SIZE        (32 * 1024)         /*!< read chunk of a raw wallpaper */
+#define LVGL_WALLPAPER_DIR              "C:/SYSTEM/wallpaper"   /*!< wallpapers offered by the settings page */
+#define LVGL_WALLPAPER_LIST_NUM         16                  /*!< most wallpapers listed from LVGL_WALLPAPER_DIR */
+#define LVGL_WALLPAPER_MAGIC            0x315A5057          /*!< "WPZ1" */
+#define LVGL_WALLPAPER_METHOD_RLE16     1                   /*!< RGB565 run length coding */
+#define LVGL_WALLPAPER_TILE_RAW         0x80000000U         /*!< tile size flag: tile stored as plain pixels */
+
+/*!
+    \brief      Compressed wallpaper file header structure (16 bytes)
+*/
+typedef struct
+{
+    uint32_t magic;                                     /*!< LVGL_WALLPAPER_MAGIC */
+    uint16_t w;                                         /*!< Width in pixels */
+    uint16_t h;                                         /*!< Height in pixels */
+    uint16_t tile_h;                                    /*!< Rows per tile */
+    uint16_t tile_num;                                  /*!< Number of tiles, (h + tile_h - 1) / tile_h */
+    uint8_t method;                                     /*!< LVGL_WALLPAPER_METHOD_xxx */
+    uint8_t cf;                                         /*!< LV_COLOR_FORMAT_RGB565 */
+    uint16_t reserved;                                  /*!< 0 */
+}lvgl_wallpaper_header_struct;
+
+/*!
+    \brief      Wallpaper load statistics structure
+*/
+typedef struct
+{
+    const char *path;                                   /*!< Wallpaper on display, NULL before the first load */
+    uint32_t load_ms;                                   /*!< Duration of the last load */
+    uint32_t bytes_read;                                /*!< File bytes read by the last load, 0 on a cache hit */
+    uint32_t cache_hit;                                 /*!< Loads served from the decoded cache */
+    uint32_t cache_miss;                                /*!< Loads that read the file */
+}lvgl_wallpaper_info_struct;
+
+extern lvgl_wallpaper_info_struct lvgl_wallpaper_info;
+
+/* function declarations */
+uint8_t lvgl_wallpaper_load(lv_image_dsc_t *image, const char *path);     /* load a wallpaper into image */
+#endif /* __LVGL_WALLPAPER_H */
@@ -0,0 +1,584 @@
+/*!
+    \file       telemetry_log.c
+    \brief      Append-only telemetry log on the spare W25Q256 sectors implementation file
+    \version    1.0
+    \date       2025-09-02
+    \author     Ze-Hou
+*/
+
+#include "./TELEMETRY/telemetry_log.h"
+#include "./MALLOC/malloc.h"
+#include "./USART/usart.h"
+#include "./SYSTEM/system.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include <string.h>
+
+#define TELEMETRY_LOG_HEADER_SIZE       sizeof(telemetry_log_sector_struct)     /*!< first record offset */
+#define TELEMETRY_LOG_NONE              0xFFFF                                  /*!< no sector open */
+
+/*!
+    \brief      Sector table entry structure, copy of a valid sector header
+*/
+typedef struct
+{
+    uint32_t seq;                                       /*!< Sequence number, 0: sector holds no valid header */
+    uint32_t first_time;                                /*!< Time of the first record */
+    uint32_t erase_count;                               /*!< Erases of this sector */
+}telemetry_log_entry_struct;
+
+/*!
+    \brief      Log state structure
+*/
+typedef struct
+{
+    telemetry_log_entry_struct sector[TELEMETRY_LOG_SECTOR_NUM];   /*!< Sector table */
+    uint16_t current;                                   /*!< Sector appended to, TELEMETRY_LOG_NONE: none */
+    uint16_t offset;                                    /*!< Next record offset in current */
+    uint32_t seq;                                       /*!< Highest sequence number written */
+    uint32_t last_time;                                 /*!< Time of the newest record */
+    SemaphoreHandle_t lock;                             /*!< Log lock */
+    uint8_t buffer[TELEMETRY_LOG_HEADER_SIZE + sizeof(telemetry_log_record_struct) + TELEMETRY_LOG_PAYLOAD_MAX];   /*!< Record assembly buffer */
+}telemetry_log_struct;
+
+telemetry_log_info_struct telemetry_log_info;
+static telemetry_log_struct telemetry_log;
+
+/* static function declarations */
+static void telemetry_log_lock(void);
+static void telemetry_log_unlock(void);
+static uint32_t telemetry_log_crc32(uint32_t crc, const uint8_t *data, uint32_t length);
+static uint32_t telemetry_log_record_crc(const telemetry_log_record_struct *record, const uint8_t *data);
+static uint16_t telemetry_log_oldest(void);
+static uint16_t telemetry_log_next(uint16_t sector);
+static uint16_t telemetry_log_scan(const uint8_t *data);
+
+/*!
+    \brief      recover the log state from the flash
+    \param[in]  none
+    \param[out] none
+    \retval     0: success, -1: out of memory or flash read error
+    \note       call after w25q256_init; reads the sector headers and the
+                newest sector, mount_us holds the time taken
+*/
+int telemetry_log_init(void)
+{
+    telemetry_log_sector_struct header;
+    uint8_t *data;
+    uint32_t cycles, min_erase = 0xFFFFFFFF;
+    uint16_t i;
+
+    memset(&telemetry_log_info, 0x00, sizeof(telemetry_log_info));
+    telemetry_log_info.sectors = TELEMETRY_LOG_SECTOR_NUM;
+    telemetry_log.current = TELEMETRY_LOG_NONE;
+    telemetry_log.offset = TELEMETRY_LOG_SECTOR_SIZE;
+    telemetry_log.seq = 0;
+    telemetry_log.last_time = 0;
+
+    if(telemetry_log.lock == NULL)
+    {
+        telemetry_log.lock = xSemaphoreCreateMutex();
+    }
+    data = (uint8_t *)mymalloc(SRAMEX, TELEMETRY_LOG_SECTOR_SIZE);
+    if((telemetry_log.lock == NULL) || (data == NULL))
+    {
+        myfree(SRAMEX, data);
+        PRINT_ERROR("telemetry log disabled, out of memory\r\n");
+        return -1;
+    }
+
+    cycles = DWT_CYCCNT;
+
+    /* sector table from the headers, the highest sequence number is the newest sector */
+    for(i = 0; i < TELEMETRY_LOG_SECTOR_NUM; i++)
+    {
+        telemetry_log.sector[i].seq = 0;
+        if(w25q256_read_data(TELEMETRY_LOG_START + (uint32_t)i * TELEMETRY_LOG_SECTOR_SIZE, (uint8_t *)&header, sizeof(header)))
+        {
+            myfree(SRAMEX, data);
+            PRINT_ERROR("telemetry log: flash read failed\r\n");
+            return -1;
+        }
+        if((header.magic != TELEMETRY_LOG_MAGIC) || (header.seq == 0) ||
+           (header.crc != ~telemetry_log_crc32(0xFFFFFFFF, (const uint8_t *)&header, sizeof(header) - 4)))
+        {
+            continue;
+        }
+
+        telemetry_log.sector[i].seq = header.seq;
+        telemetry_log.sector[i].first_time = header.first_time;
+        telemetry_log.sector[i].erase_count = header.erase_count;
+        if(header.erase_count > telemetry_log_info.max_erase_count)telemetry_log_info.max_erase_count = header.erase_count;
+        if(header.erase_count < min_erase)min_erase = header.erase_count;
+        telemetry_log_info.used_sectors++;
+        if(header.seq > telemetry_log.seq)
+        {
+            telemetry_log.seq = header.seq;
+            telemetry_log.current = i;
+        }
+    }
+
+    /* a sector without header lost its count (never used or cut after the erase), assume the least worn */
+    for(i = 0; i < TELEMETRY_LOG_SECTOR_NUM; i++)
+    {
+        if(telemetry_log.sector[i].seq == 0)
+        {
+            telemetry_log.sector[i].erase_count = (min_erase == 0xFFFFFFFF) ? 0 : min_erase;
+        }
+    }
+
+    /* the newest sector: find the end of the data, a torn record closes the sector */
+    if(telemetry_log.current != TELEMETRY_LOG_NONE)
+    {
+        if(w25q256_read_data(TELEMETRY_LOG_START + (uint32_t)telemetry_log.current * TELEMETRY_LOG_SECTOR_SIZE, data, TELEMETRY_LOG_SECTOR_SIZE))
+        {
+            myfree(SRAMEX, data);
+            PRINT_ERROR("telemetry log: flash read failed\r\n");
+            return -1;
+        }
+        telemetry_log.last_time = telemetry_log.sector[telemetry_log.current].first_time;
+        telemetry_log.offset = telemetry_log_scan(data);
+    }
+
+    telemetry_log_info.mount_us = (DWT_CYCCNT - cycles) / (SystemCoreClock / 1000000);
+    telemetry_log_info.ready = 1;
+    myfree(SRAMEX, data);
+
+    PRINT_INFO("telemetry log: %u/%u sectors used, erase count max %u, %u torn, mounted in %u us\r\n",
+               telemetry_log_info.used_sectors, telemetry_log_info.sectors, telemetry_log_info.max_erase_count,
+               telemetry_log_info.torn, telemetry_log_info.mount_us);
+
+    return 0;
+}
+
+/*!
+    \brief      append a record
+    \param[in]  type: telemetry_type_enum or an application type
+    \param[in]  time: record time, a time below the newest record is raised to it
+    \param[in]  data: payload, may be NULL when length is 0
+    \param[in]  length: payload bytes, at most TELEMETRY_LOG_PAYLOAD_MAX
+    \param[out] none
+    \retval     0: success, -1: not initialised or invalid length, -2: flash error
+    \note       one page program, plus a sector erase when the record opens
+                a new sector; not for interrupt handlers
+*/
+int telemetry_log_append(uint8_t type, uint32_t time, const void *data, uint16_t length)
+{
+    telemetry_log_record_struct record;
+    telemetry_log_sector_struct header;
+    uint32_t cycles, size, address;
+    uint16_t next, head = 0;
+    uint8_t status;
+
+    if((telemetry_log_info.ready == 0) || (length > TELEMETRY_LOG_PAYLOAD_MAX))return -1;
+
+    size = sizeof(record) + ((length + 3) & ~3);
+
+    telemetry_log_lock();
+    cycles = DWT_CYCCNT;
+
+    if(time < telemetry_log.last_time)time = telemetry_log.last_time;
+
+    record.length = length;
+    record.type = type;
+    record.reserved = 0;
+    record.time = time;
+    record.crc = telemetry_log_record_crc(&record, (const uint8_t *)data);
+
+    if(telemetry_log.offset + size > TELEMETRY_LOG_SECTOR_SIZE)
+    {
+        /* open the next sector of the ring, the oldest one once the ring is full */
+        next = (telemetry_log.current == TELEMETRY_LOG_NONE) ? 0 : (telemetry_log.current + 1) % TELEMETRY_LOG_SECTOR_NUM;
+        header.magic = TELEMETRY_LOG_MAGIC;
+        header.seq = telemetry_log.seq + 1;
+        header.erase_count = telemetry_log.sector[next].erase_count + 1;
+        header.first_time = time;
+        header.crc = ~telemetry_log_crc32(0xFFFFFFFF, (const uint8_t *)&header, sizeof(header) - 4);
+
+        if(telemetry_log.sector[next].seq == 0)telemetry_log_info.used_sectors++;
+        telemetry_log.sector[next].seq = 0;     /* invalid until the header is programmed */
+        w25q256_erase_sector(FONTSECSIZE + next);
+
+        memcpy(telemetry_log.buffer, &header, sizeof(header));
+        head = sizeof(header);
+
+        telemetry_log.current = next;
+        telemetry_log.offset = TELEMETRY_LOG_HEADER_SIZE;
+        telemetry_log.sector[next].first_time = time;
+        telemetry_log.sector[next].erase_count = header.erase_count;
+        if(header.erase_count > telemetry_log_info.max_erase_count)telemetry_log_info.max_erase_count = header.erase_count;
+    }
+
+    /* header (new sector only), record and payload in one program, padding stays erased */
+    memcpy(telemetry_log.buffer + head, &record, sizeof(record));
+    if(length > 0)memcpy(telemetry_log.buffer + head + sizeof(record), data, length);
+    memset(telemetry_log.buffer + head + sizeof(record) + length, 0xFF, size - sizeof(record) - length);
+
+    address = TELEMETRY_LOG_START + (uint32_t)telemetry_log.current * TELEMETRY_LOG_SECTOR_SIZE + telemetry_log.offset - head;
+    status = w25q256_program_data(address, telemetry_log.buffer, head + size);
+    if(head > 0)
+    {
+        /* used even when the program failed: the header may be on the flash, the records fail their CRC */
+        telemetry_log.sector[telemetry_log.current].seq = header.seq;
+        telemetry_log.seq = header.seq;
+    }
+
+    if(status == 0)
+    {
+        telemetry_log.offset += size;
+        telemetry_log.last_time = time;
+
+        cycles = (DWT_CYCCNT - cycles) / (SystemCoreClock / 1000000);
+        telemetry_log_info.records++;
+        telemetry_log_info.bytes += head + size;
+        telemetry_log_info.append_us += cycles;
+        if(cycles > telemetry_log_info.max_append_us)telemetry_log_info.max_append_us = cycles;
+    }
+    else
+    {
+        telemetry_log.offset = TELEMETRY_LOG_SECTOR_SIZE;   /* retry in a fresh sector */
+    }
+
+    telemetry_log_unlock();
+
+    return (status == 0) ? 0 : -2;
+}
+
+/*!
+    \brief      position a cursor at the first record not older than time
+    \param[in]  time: record time looked for, 0: oldest record
+    \param[out] cursor: read position for telemetry_log_read
+    \retval     1: positioned, 0: no such record (log empty or all older), -1: not initialised or flash error
+    \note       the sector is chosen from the first record times in RAM, only
+                the record headers of that sector are read
+*/
+int telemetry_log_seek(uint32_t time, telemetry_log_cursor_struct *cursor)
+{
+    telemetry_log_record_struct record;
+    uint32_t base;
+    uint16_t sector, found;
+    int res = 0;
+
+    if(telemetry_log_info.ready == 0)return -1;
+
+    telemetry_log_lock();
+
+    /* newest sector that starts at or before time, in ring order from the oldest */
+    sector = telemetry_log_oldest();
+    found = sector;
+    while(sector != TELEMETRY_LOG_NONE)
+    {
+        if(telemetry_log.sector[sector].first_time > time)break;
+        found = sector;
+        sector = telemetry_log_next(sector);
+    }
+
+    while(found != TELEMETRY_LOG_NONE)
+    {
+        cursor->sector = found;
+        cursor->seq = telemetry_log.sector[found].seq;
+        cursor->offset = TELEMETRY_LOG_HEADER_SIZE;
+        base = TELEMETRY_LOG_START + (uint32_t)found * TELEMETRY_LOG_SECTOR_SIZE;
+
+        while(cursor->offset + sizeof(record) <= TELEMETRY_LOG_SECTOR_SIZE)
+        {
+            if(w25q256_read_data(base + cursor->offset, (uint8_t *)&record, sizeof(record)))
+            {
+                res = -1;
+                break;
+            }
+            if((record.length > TELEMETRY_LOG_PAYLOAD_MAX) ||
+               (cursor->offset + sizeof(record) + record.length > TELEMETRY_LOG_SECTOR_SIZE))break;
+            if(record.time >= time)
+            {
+                res = 1;
+                break;
+            }
+            cursor->offset += sizeof(record) + ((record.length + 3) & ~3);
+        }
+        if(res != 0)break;
+
+        /* every record of the sector is older, the answer is the first record of the next one */
+        found = telemetry_log_next(found);
+        time = 0;
+    }
+
+    telemetry_log_unlock();
+
+    return res;
+}
+
+/*!
+    \brief      read the record at the cursor and advance it
+    \param[in]  cursor: position set by telemetry_log_seek
+    \param[out] record: record header
+    \param[out] data: payload, at most size bytes are copied
+    \param[in]  size: bytes available in data
+    \param[out] cursor: next record
+    \retval     1: record read, 0: end of the log, -1: not initialised or flash error
+    \note       records that fail their CRC are skipped; when the sector under
+                the cursor was reused meanwhile, reading resumes at the oldest
+                record
+*/
+int telemetry_log_read(telemetry_log_cursor_struct *cursor, telemetry_log_record_struct *record, void *data, uint16_t size)
+{
+    uint32_t base;
+    uint16_t next;
+    int res = 0;
+
+    if(telemetry_log_info.ready == 0)return -1;
+
+    telemetry_log_lock();
+
+    if((cursor->sector >= TELEMETRY_LOG_SECTOR_NUM) || (telemetry_log.sector[cursor->sector].seq != cursor->seq))
+    {
+        cursor->sector = telemetry_log_oldest();
+        if(cursor->sector != TELEMETRY_LOG_NONE)
+        {
+            cursor->seq = telemetry_log.sector[cursor->sector].seq;
+            cursor->offset = TELEMETRY_LOG_HEADER_SIZE;
+        }
+    }
+
+    while(cursor->sector != TELEMETRY_LOG_NONE)
+    {
+        base = TELEMETRY_LOG_START + (uint32_t)cursor->sector * TELEMETRY_LOG_SECTOR_SIZE;
+
+        if((cursor->sector == telemetry_log.current) && (cursor->offset >= telemetry_log.offset))break;   /* newest record read */
+
+        if(cursor->offset + sizeof(*record) <= TELEMETRY_LOG_SECTOR_SIZE)
+        {
+            if(w25q256_read_data(base + cursor->offset, (uint8_t *)record, sizeof(*record)))
+            {
+                res = -1;
+                break;
+            }
+            if((record->length <= TELEMETRY_LOG_PAYLOAD_MAX) &&
+               (cursor->offset + sizeof(*record) + record->length <= TELEMETRY_LOG_SECTOR_SIZE))
+            {
+                cursor->offset += sizeof(*record);
+                if((record->length > 0) && w25q256_read_data(base + cursor->offset, telemetry_log.buffer, record->length))
+                {
+                    res = -1;
+                    break;
+                }
+                cursor->offset += (record->length + 3) & ~3;
+
+                if(record->crc != telemetry_log_record_crc(record, telemetry_log.buffer))continue;
+
+                memcpy(data, telemetry_log.buffer, (record->length < size) ? record->length : size);
+                res = 1;
+                break;
+            }
+        }
+
+        /* end of the sector data, continue in the next sector when it is newer */
+        next = telemetry_log_next(cursor->sector);
+        if((next == TELEMETRY_LOG_NONE) || (telemetry_log.sector[next].seq < cursor->seq))break;
+        cursor->sector = next;
+        cursor->seq = telemetry_log.sector[next].seq;
+        cursor->offset = TELEMETRY_LOG_HEADER_SIZE;
+    }
+
+    telemetry_log_unlock();
+
+    return res;
+}
+
+/*!
+    \brief      drop all records
+    \param[in]  none
+    \param[out] none
+    \retval     0: success, -1: not initialised
+    \note       only the used sectors are erased, their erase counts are
+                kept in RAM for the next headers
+*/
+int telemetry_log_erase(void)
+{
+    uint16_t i;
+
+    if(telemetry_log_info.ready == 0)return -1;
+
+    telemetry_log_lock();
+
+    for(i = 0; i < TELEMETRY_LOG_SECTOR_NUM; i++)
+    {
+        if(telemetry_log.sector[i].seq != 0)
+        {
+            w25q256_erase_sector(FONTSECSIZE + i);
+            telemetry_log.sector[i].seq = 0;
+            telemetry_log.sector[i].erase_count++;
+        }
+    }
+    telemetry_log.current = TELEMETRY_LOG_NONE;
+    telemetry_log.offset = TELEMETRY_LOG_SECTOR_SIZE;
+    telemetry_log.last_time = 0;
+    telemetry_log_info.used_sectors = 0;
+
+    telemetry_log_unlock();
+
+    return 0;
+}
+
+/*!
+    \brief      take the log lock
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void telemetry_log_lock(void)
+{
+    if((telemetry_log.lock != NULL) && (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED))
+    {
+        xSemaphoreTake(telemetry_log.lock, portMAX_DELAY);
+    }
+}
+
+/*!
+    \brief      release the log lock
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void telemetry_log_unlock(void)
+{
+    if((telemetry_log.lock != NULL) && (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED))
+    {
+        xSemaphoreGive(telemetry_log.lock);
+    }
+}
+
+/*!
+    \brief      update a CRC-32 (IEEE 802.3, reflected) with data
+    \param[in]  crc: running value, start with 0xFFFFFFFF and invert the result
+    \param[in]  data: data
+    \param[in]  length: bytes
+    \param[out] none
+    \retval     updated CRC
+*/
+static uint32_t telemetry_log_crc32(uint32_t crc, const uint8_t *data, uint32_t length)
+{
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+
+    while(length--)
+    {
+        crc ^= *data++;
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+    }
+
+    return crc;
+}
+
+/*!
+    \brief      CRC of a record
+    \param[in]  record: record header, the crc field is not covered
+    \param[in]  data: payload of record->length bytes
+    \param[out] none
+    \retval     CRC-32
+*/
+static uint32_t telemetry_log_record_crc(const telemetry_log_record_struct *record, const uint8_t *data)
+{
+    uint32_t crc;
+
+    crc = telemetry_log_crc32(0xFFFFFFFF, (const uint8_t *)record, sizeof(*record) - 4);
+    if(record->length > 0)crc = telemetry_log_crc32(crc, data, record->length);
+
+    return ~crc;
+}
+
+/*!
+    \brief      oldest sector holding records
+    \param[in]  none
+    \param[out] none
+    \retval     sector index, TELEMETRY_LOG_NONE: log empty
+    \note       sectors are opened in ring order, the oldest is the first
+                valid sector after the current one
+*/
+static uint16_t telemetry_log_oldest(void)
+{
+    uint16_t i, sector;
+
+    if(telemetry_log.current == TELEMETRY_LOG_NONE)return TELEMETRY_LOG_NONE;
+
+    for(i = 1; i <= TELEMETRY_LOG_SECTOR_NUM; i++)
+    {
+        sector = (telemetry_log.current + i) % TELEMETRY_LOG_SECTOR_NUM;
+        if(telemetry_log.sector[sector].seq != 0)
+        {
+            return sector;
+        }
+    }
+
+    return TELEMETRY_LOG_NONE;
+}
+
+/*!
+    \brief      next sector holding records in ring order
+    \param[in]  sector: sector index
+    \param[out] none
+    \retval     sector index, TELEMETRY_LOG_NONE: sector is the newest
+    \note       sectors without a valid header are stepped over: one whose
+                header program failed stays a hole until the ring wraps,
+                the records behind it are still read
+*/
+static uint16_t telemetry_log_next(uint16_t sector)
+{
+    uint16_t i;
+
+    for(i = 1; i < TELEMETRY_LOG_SECTOR_NUM; i++)
+    {
+        if(sector == telemetry_log.current)break;
+        sector = (sector + 1) % TELEMETRY_LOG_SECTOR_NUM;
+        if(telemetry_log.sector[sector].seq != 0)
+        {
+            return sector;
+        }
+    }
+
+    return TELEMETRY_LOG_NONE;
+}
+
+/*!
+    \brief      find the end of the data of the newest sector
+    \param[in]  data: sector contents
+    \param[out] none
+    \retval     offset of the next record, TELEMETRY_LOG_SECTOR_SIZE when the
+                sector ends with a torn record
+    \note       a record header of all 0xFF is the end of the data; anything
+                else that fails its CRC was cut by a power loss, appending
+                behind it would be unsafe so the sector is closed; last_time
+                is raised to the newest valid record
+*/
+static uint16_t telemetry_log_scan(const uint8_t *data)
+{
+    static const uint8_t erased[sizeof(telemetry_log_record_struct)] = {
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    };
+    telemetry_log_record_struct record;
+    uint32_t offset = TELEMETRY_LOG_HEADER_SIZE;
+
+    while(offset + sizeof(record) <= TELEMETRY_LOG_SECTOR_SIZE)
+    {
+        if(memcmp(data + offset, erased, sizeof(record)) == 0)return offset;
+
+        memcpy(&record, data + offset, sizeof(record));
+        if((record.length > TELEMETRY_LOG_PAYLOAD_MAX) ||
+           (offset + sizeof(record) + record.length > TELEMETRY_LOG_SECTOR_SIZE) ||
+           (record.crc != telemetry_log_record_crc(&record, data + offset + sizeof(record))))
+        {
+            telemetry_log_info.torn++;
+            PRINT_WARN("telemetry log: torn record at sector %u offset %u, sector closed\r\n", telemetry_log.current, offset);
+            return TELEMETRY_LOG_SECTOR_SIZE;
+        }
+
+        if(record.time > telemetry_log.last_time)telemetry_log.last_time = record.time;
+        offset += sizeof(record) + ((record.length + 3) & ~3);
+    }
+
+    return TELEMETRY_LOG_SECTOR_SIZE;
+}
@@ -0,0 +1,114 @@
+/*!
+    \file       telemetry_log.h
+    \brief      Append-only telemetry log on the spare W25Q256 sectors header file
+    \version    1.0
+    \date       2025-09-02
+    \author     Ze-Hou
+    \note       the sectors above the font area (FONTSECSIZE) up to the W25Q256
+                read mode check sector (W25Q256_CHECK_ADDR) form a ring. A
+                sector starts with telemetry_log_sector_struct, then records
+                (telemetry_log_record_struct and the payload, padded to 4
+                bytes) are programmed one after the other into the erased
+                flash; a length of 0xFFFF marks the end. When a record does not
+                fit, the next sector of the ring (the oldest) is erased and
+                gets a new header, so every sector is erased once per lap and
+                wear is spread evenly over the region.
+                Append is O(1): the write position is kept in RAM, a record
+                costs one page program, a sector change one 4KB erase more.
+                telemetry_log_init rebuilds the state from the sector headers
+                and scans only the newest sector; a record torn by a power
+                loss fails its CRC, the sector is closed there and the next
+                append opens a new one. A sector whose header could not be
+                programmed is a hole that seek and read step over. Seek by
+                time uses the first record time in the headers (kept in RAM)
+                and scans one sector.
+                Record times must not decrease, the caller chooses the clock
+                (RTC seconds, milliseconds since a stored epoch ...).
+                Append throughput and recovery time are kept in
+                telemetry_log_info.
+*/
+
+#ifndef __TELEMETRY_LOG_H
+#define __TELEMETRY_LOG_H
+#include <stdint.h>
+#include "./FONT/fonts.h"
+#include "./W25Q256/w25q256.h"
+
+/* log configuration */
+#define TELEMETRY_LOG_SECTOR_SIZE       4096                                        /*!< erase unit */
+#define TELEMETRY_LOG_START             (FONTSECSIZE * TELEMETRY_LOG_SECTOR_SIZE)   /*!< first byte above the font area */
+#define TELEMETRY_LOG_SECTOR_NUM        ((W25Q256_CHECK_ADDR - TELEMETRY_LOG_START) / TELEMETRY_LOG_SECTOR_SIZE)   /*!< sectors in the ring, at least 2 */
+#define TELEMETRY_LOG_PAYLOAD_MAX       256                                         /*!< largest record payload */
+#define TELEMETRY_LOG_MAGIC             0x474F4C54                                  /*!< "TLOG" */
+
+/*!
+    \brief      Record type enumeration
+*/
+typedef enum
+{
+    TELEMETRY_TYPE_EVENT = 0,                           /*!< (0) System event */
+    TELEMETRY_TYPE_POWER,                               /*!< (1) Power samples */
+    TELEMETRY_TYPE_PROGRAM,                             /*!< (2) Target programming statistics */
+    TELEMETRY_TYPE_USER = 0x80,                         /*!< (0x80) First application defined type */
+}telemetry_type_enum;
+
+/*!
+    \brief      Sector header structure (20 bytes), programmed with the first record
+*/
+typedef struct
+{
+    uint32_t magic;                                     /*!< TELEMETRY_LOG_MAGIC */
+    uint32_t seq;                                       /*!< Sector sequence number, +1 per sector opened */
+    uint32_t erase_count;                               /*!< Erases of this sector */
+    uint32_t first_time;                                /*!< Time of the first record */
+    uint32_t crc;                                       /*!< CRC-32 of the fields above */
+}telemetry_log_sector_struct;
+
+/*!
+    \brief      Record header structure (12 bytes), followed by the payload
+*/
+typedef struct
+{
+    uint16_t length;                                    /*!< Payload bytes, 0xFFFF: end of the sector data */
+    uint8_t type;                                       /*!< telemetry_type_enum */
+    uint8_t reserved;                                   /*!< 0 */
+    uint32_t time;                                      /*!< Record time */
+    uint32_t crc;                                       /*!< CRC-32 of length, type, reserved, time and payload */
+}telemetry_log_record_struct;
+
+/*!
+    \brief      Read position structure, set by telemetry_log_seek
+*/
+typedef struct
+{
+    uint32_t seq;                                       /*!< Sequence number of the sector read */
+    uint16_t sector;                                    /*!< Sector index in the ring */
+    uint16_t offset;                                    /*!< Next record in the sector */
+}telemetry_log_cursor_struct;
+
+/*!
+    \brief      Log statistics structure
+*/
+typedef struct
+{
+    uint8_t ready;                                      /*!< 1: telemetry_log_init succeeded */
+    uint16_t sectors;                                   /*!< Sectors in the ring */
+    uint16_t used_sectors;                              /*!< Sectors holding records */
+    uint32_t records;                                   /*!< Records appended since boot */
+    uint32_t bytes;                                     /*!< Flash bytes appended since boot */
+    uint32_t append_us;                                 /*!< Total append time, sector erases included */
+    uint32_t max_append_us;                             /*!< Longest append */
+    uint32_t torn;                                      /*!< Torn records found by telemetry_log_init */
+    uint32_t mount_us;                                  /*!< Duration of telemetry_log_init */
+    uint32_t max_erase_count;                           /*!< Highest sector erase count */
+}telemetry_log_info_struct;
+
+extern telemetry_log_info_struct telemetry_log_info;
+
+/* function declarations */
+int telemetry_log_init(void);                                                                   /* recover the log state from the flash */
+int telemetry_log_append(uint8_t type, uint32_t time, const void *data, uint16_t length);        /* append a record */
+int telemetry_log_seek(uint32_t time, telemetry_log_cursor_struct *cursor);                     /* position at the first record not older than time */
+int telemetry_log_read(telemetry_log_cursor_struct *cursor, telemetry_log_record_struct *record, void *data, uint16_t size);   /* read the next record */
+int telemetry_log_erase(void);                                                                  /* drop all records */
+#endif /* __TELEMETRY_LOG_H */
@@ -28,7 +28,10 @@
 /* middleware header files */
 #include "./MALLOC/malloc.h"
 #include "./FATFS/fatfs_config.h"
+#include "./FATFS/block_cache.h"
+#include "./FATFS/file_index.h"
 #include "./FONT/fonts.h"
+#include "./TELEMETRY/telemetry_log.h"
 #include "usb_dwc2_reg.h"
 #include "./DAP/dap_main.h"
 #include "lvgl.h"
@@ -48,6 +51,10 @@
 int main() 
 {
     uint8_t res = 0;
+    uint32_t *emmc_test_buffer;
+#if W25Q256_SPEED_TEST_BOOT
+    uint8_t *flash_test_buffer;
+#endif
 
     SystemCoreClockUpdate();                                            /* update system clock */
     system_nvic_vector_table_config(ITCMRAM_BASE, 0);
@@ -86,17 +93,38 @@ int main()
     my_mem_init(SRAMDTCM);                                        /* initialize DTCM memory pool */
     my_mem_init(SRAMEX);                                          /* initialize external SDRAM memory pool */
 
-    w25q256_init();                                                     /* initialize W25Q256 SPI flash memory */
+    emmc_test_buffer = (uint32_t *)mymalloc(SRAMEX, EMMC_SPEED_TEST_NUM * 512);
+    if(emmc_test_buffer != NULL)
+    {
+        emmc_speed_test(emmc_test_buffer, EMMC_SPEED_TEST_NUM, EMMC_SPEED_TEST_BOOT); /* eMMC sequential read speed, writes only when enabled */
+        myfree(SRAMEX, emmc_test_buffer);
+    }
+
+    if(w25q256_init() == 0)                                             /* initialize W25Q256 SPI flash memory */
+    {
+#if W25Q256_SPEED_TEST_BOOT
+        flash_test_buffer = (uint8_t *)mymalloc(SRAMIN, W25Q256_SPEED_TEST_SIZE);
+        if(flash_test_buffer != NULL)
+        {
+            w25q256_speed_test(flash_test_buffer, W25Q256_SPEED_TEST_SIZE);  /* indirect vs memory-mapped reads */
+            myfree(SRAMIN, flash_test_buffer);
+        }
+#endif
+        telemetry_log_init();                                           /* recover the telemetry log from the spare flash sectors */
+    }
     rgblcd_init();                                                      /* initialize RGB LCD display */
     wireless_init(115200);                                   /* initialize wireless module */
 
     fatfs_config();                                                     /* allocate memory for FATFS related variables */
+    block_cache_init();                                                 /* eMMC sector cache in SDRAM, shared with USB MSC */
 
     _remount:
         res = f_mount(fatfs[0], "C:", 1);                 /* immediately mount eMMC card */
 
         if(!res)
         {
+            fatfs_cache_pin(fatfs[0], "C:/SYSTEM");                      /* keep the FATs, the root and the system folder hot */
+            file_index_init();                                          /* file index, rebuilt in the background when missing */
             PRINT_INFO("fatfs mount emmc successfully.\r\n");
             rgblcd_show_string(10, 0, 512, 16, "log: fatfs mount emmc successfully", RGBLCD_FONT_16, BLACK); 
         }
@@ -107,7 +135,7 @@ int main()
                 case FR_NO_FILESYSTEM:
                     PRINT_ERROR("There is no valid FAT volume in emmc.\r\n");
                     PRINT_ERROR("Please format a FAT volume.\r\n");
-//                    f_mkfs("C:", NULL, NULL, FF_MIN_SS);
+//                    fatfs_format("C:");
                     goto _remount;      /* remount EMMC */
                     break;
                 
@@ -125,6 +153,12 @@ int main()
         {
             PRINT_INFO("initlize font successfully.\r\n");
             rgblcd_show_string(10, 20, 512, 16, "log: initlize font successfully", RGBLCD_FONT_16, BLACK);
+            fonts_update_font(10, 40, (uint8_t *)"C:/SYSTEM/FONT", RED); /* rewrite only the font files changed on the eMMC */
+
+            if(font_info.fontok != 0xAA)
+            {
+                goto _reinit_fonts;                     /* update interrupted */
+            }
         }
         else
         {
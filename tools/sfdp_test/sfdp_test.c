@@ -0,0 +1,216 @@
+/*!
+    \file       sfdp_test.c
+    \brief      host test of the SFDP (JESD216) decoder w25q256_sfdp_parse
+    \version    1.0
+    \date       2025-09-01
+    \author     Ze-Hou
+    \note       the tables below are laid out from the SFDP register maps in
+                the datasheets; the DWORDs the decoder reads follow them, the
+                rest of the area is left erased. A dump captured on a board
+                (w25q256_sfdp_read buffer, W25Q256_SFDP_SIZE bytes) can be
+                decoded with: sfdp_test dump.bin
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "./W25Q256/w25q256_sfdp.h"
+
+static unsigned int sfdp_test_failed = 0;
+
+#define SFDP_CHECK(name, value, expect)                                                         \
+    do                                                                                          \
+    {                                                                                           \
+        if((uint32_t)(value) != (uint32_t)(expect))                                             \
+        {                                                                                       \
+            printf("FAIL %s: %s = 0x%X, expected 0x%X\n", name, #value, (unsigned int)(value), (unsigned int)(expect)); \
+            sfdp_test_failed++;                                                                 \
+        }                                                                                       \
+    }while(0)
+
+/* W25Q256JV: JESD216B, basic table at 0x80, 4-byte address instruction table at 0xD0, no 4-4-4 */
+static const uint8_t sfdp_w25q256jv[256] = {
+    0x53, 0x46, 0x44, 0x50, 0x06, 0x01, 0x01, 0xFF, 0x00, 0x06, 0x01, 0x10, 0x80, 0x00, 0x00, 0xFF,
+    0x84, 0x00, 0x01, 0x02, 0xD0, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xE5, 0x20, 0xF3, 0xFF, 0xFF, 0xFF, 0xFF, 0x0F, 0x44, 0xEB, 0x08, 0x6B, 0x08, 0x3B, 0x42, 0xBB,
+    0xEE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0xFF, 0xFF, 0xFF, 0x00, 0xFF, 0x0C, 0x20, 0x0F, 0x52,
+    0x10, 0xD8, 0x00, 0xFF, 0x42, 0x02, 0xA6, 0x00, 0x81, 0x83, 0xEC, 0xD0, 0x14, 0x05, 0xEB, 0x38,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x9E, 0xA2, 0xF8, 0x30, 0x04, 0xA6, 0x7C, 0xFF, 0xD6, 0x00, 0x00,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x0A, 0xF0, 0xFF, 0x21, 0xFF, 0xDC, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+};
+
+/* MX25L25645G: JESD216B with 4-4-4 and DTR, basic table at 0x30, 4-byte table at 0xC0,
+   vendor table at 0x110 outside the 256-byte dump */
+static const uint8_t sfdp_mx25l25645g[256] = {
+    0x53, 0x46, 0x44, 0x50, 0x06, 0x01, 0x02, 0xFF, 0x00, 0x06, 0x01, 0x10, 0x30, 0x00, 0x00, 0xFF,
+    0x84, 0x00, 0x01, 0x02, 0xC0, 0x00, 0x00, 0xFF, 0xC2, 0x00, 0x01, 0x04, 0x10, 0x01, 0x00, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xE5, 0x20, 0xFB, 0xFF, 0xFF, 0xFF, 0xFF, 0x0F, 0x44, 0xEB, 0x08, 0x6B, 0x08, 0x3B, 0x04, 0xBB,
+    0xFE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0xFF, 0xFF, 0xFF, 0x44, 0xEB, 0x0C, 0x20, 0x0F, 0x52,
+    0x10, 0xD8, 0x00, 0xFF, 0xFF, 0x82, 0xFF, 0x00, 0x81, 0x8A, 0xF1, 0x02, 0x44, 0x06, 0xEB, 0x38,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x9E, 0xA2, 0xF9, 0xF0, 0xD0, 0xE5, 0x7C, 0xFF, 0xE9, 0x00, 0x00,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x7F, 0x0F, 0x00, 0x21, 0x5C, 0xDC, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+};
+
+/* GD25Q256C: JESD216 1.0, 9-DWORD basic table, 4-4-4, no 4-byte address instruction table */
+static const uint8_t sfdp_gd25q256c[128] = {
+    0x53, 0x46, 0x44, 0x50, 0x00, 0x01, 0x00, 0xFF, 0x00, 0x00, 0x01, 0x09, 0x30, 0x00, 0x00, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xE5, 0x20, 0xF3, 0xFF, 0xFF, 0xFF, 0xFF, 0x0F, 0x44, 0xEB, 0x08, 0x6B, 0x08, 0x3B, 0x42, 0xBB,
+    0xFE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0xFF, 0xFF, 0xFF, 0x46, 0xEB, 0x0C, 0x20, 0x0F, 0x52,
+    0x10, 0xD8, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+};
+
+/*!
+    \brief      print the decoded features
+    \param[in]  info: decoded features
+    \retval     none
+*/
+static void sfdp_test_print(const w25q256_sfdp_struct *info)
+{
+    uint8_t i;
+    
+    printf("  revision %u.%u, %u KB, page %u, address bytes %u, dtr %u\n", info->major, info->minor,
+           (unsigned int)(info->density / 1024), (unsigned int)info->page_size, info->addr_bytes, info->dtr);
+    printf("  1-1-4 0x%02X/%u, 1-4-4 0x%02X/%u, 4-4-4 0x%02X/%u, 4-byte table 0x%08X\n",
+           info->read_114.opcode, info->read_114.dummy, info->read_144.opcode, info->read_144.dummy,
+           info->read_444.opcode, info->read_444.dummy, (unsigned int)info->opcode_4b);
+    for(i = 0; i < 4; i++)
+    {
+        if(info->erase_size[i])printf("  erase type %u: %u bytes, 0x%02X\n", i + 1, (unsigned int)info->erase_size[i], info->erase_opcode[i]);
+    }
+}
+
+/*!
+    \brief      check the three chip tables and the malformed areas
+    \param[in]  none
+    \retval     number of failed checks
+*/
+static unsigned int sfdp_test_run(void)
+{
+    w25q256_sfdp_struct info;
+    uint8_t blank[256];
+    
+    /* W25Q256JV: 1-4-4 and 1-1-4 from DWORD 3, 4-byte opcodes, three erase types */
+    SFDP_CHECK("w25q256jv", w25q256_sfdp_parse(sfdp_w25q256jv, sizeof(sfdp_w25q256jv), &info), 0);
+    SFDP_CHECK("w25q256jv", info.valid, 1);
+    SFDP_CHECK("w25q256jv", info.major, 1);
+    SFDP_CHECK("w25q256jv", info.minor, 6);
+    SFDP_CHECK("w25q256jv", info.addr_bytes, 34);
+    SFDP_CHECK("w25q256jv", info.dtr, 0);
+    SFDP_CHECK("w25q256jv", info.density, 32 * 1024 * 1024);
+    SFDP_CHECK("w25q256jv", info.read_144.opcode, 0xEB);
+    SFDP_CHECK("w25q256jv", info.read_144.dummy, 6);
+    SFDP_CHECK("w25q256jv", info.read_114.opcode, 0x6B);
+    SFDP_CHECK("w25q256jv", info.read_114.dummy, 8);
+    SFDP_CHECK("w25q256jv", info.read_444.opcode, 0);
+    SFDP_CHECK("w25q256jv", info.erase_size[0], 4096);
+    SFDP_CHECK("w25q256jv", info.erase_opcode[0], 0x20);
+    SFDP_CHECK("w25q256jv", info.erase_size[1], 32768);
+    SFDP_CHECK("w25q256jv", info.erase_opcode[1], 0x52);
+    SFDP_CHECK("w25q256jv", info.erase_size[2], 65536);
+    SFDP_CHECK("w25q256jv", info.erase_opcode[2], 0xD8);
+    SFDP_CHECK("w25q256jv", info.erase_size[3], 0);
+    SFDP_CHECK("w25q256jv", info.page_size, 256);
+    SFDP_CHECK("w25q256jv", info.opcode_4b, 0xFFF00AFF);
+    SFDP_CHECK("w25q256jv", (info.opcode_4b >> 5) & 1, 1);      /* 0xEC used by w25q256_read_mode_select */
+    SFDP_CHECK("w25q256jv", (info.opcode_4b >> 4) & 1, 1);      /* 0x6C */
+    
+    /* MX25L25645G: 4-4-4 from DWORD 7, DTR, a vendor table outside the dump is skipped */
+    SFDP_CHECK("mx25l25645g", w25q256_sfdp_parse(sfdp_mx25l25645g, sizeof(sfdp_mx25l25645g), &info), 0);
+    SFDP_CHECK("mx25l25645g", info.addr_bytes, 34);
+    SFDP_CHECK("mx25l25645g", info.dtr, 1);
+    SFDP_CHECK("mx25l25645g", info.read_444.opcode, 0xEB);
+    SFDP_CHECK("mx25l25645g", info.read_444.dummy, 6);
+    SFDP_CHECK("mx25l25645g", info.read_144.dummy, 6);
+    SFDP_CHECK("mx25l25645g", info.erase_size[2], 65536);
+    SFDP_CHECK("mx25l25645g", info.page_size, 256);
+    SFDP_CHECK("mx25l25645g", info.opcode_4b, 0x000F7FFF);
+    
+    /* GD25Q256C: 9-DWORD table, no page size DWORD, no 4-byte table */
+    SFDP_CHECK("gd25q256c", w25q256_sfdp_parse(sfdp_gd25q256c, sizeof(sfdp_gd25q256c), &info), 0);
+    SFDP_CHECK("gd25q256c", info.major, 1);
+    SFDP_CHECK("gd25q256c", info.minor, 0);
+    SFDP_CHECK("gd25q256c", info.density, 32 * 1024 * 1024);
+    SFDP_CHECK("gd25q256c", info.read_444.opcode, 0xEB);
+    SFDP_CHECK("gd25q256c", info.read_444.dummy, 8);
+    SFDP_CHECK("gd25q256c", info.page_size, 256);
+    SFDP_CHECK("gd25q256c", info.opcode_4b, 0);
+    
+    /* the 4-byte table past the end of a short dump is ignored, the basic table is not */
+    SFDP_CHECK("w25q256jv 0xD0 bytes", w25q256_sfdp_parse(sfdp_w25q256jv, 0xD0, &info), 0);
+    SFDP_CHECK("w25q256jv 0xD0 bytes", info.opcode_4b, 0);
+    SFDP_CHECK("w25q256jv 0xD0 bytes", info.read_144.opcode, 0xEB);
+    
+    /* basic table outside the dump, blank chip, too short */
+    SFDP_CHECK("w25q256jv 0x90 bytes", w25q256_sfdp_parse(sfdp_w25q256jv, 0x90, &info), 1);
+    SFDP_CHECK("w25q256jv 0x90 bytes", info.valid, 0);
+    memset(blank, 0xFF, sizeof(blank));
+    SFDP_CHECK("blank", w25q256_sfdp_parse(blank, sizeof(blank), &info), 1);
+    SFDP_CHECK("blank", info.valid, 0);
+    SFDP_CHECK("short", w25q256_sfdp_parse(sfdp_w25q256jv, 8, &info), 1);
+    
+    return sfdp_test_failed;
+}
+
+int main(int argc, char *argv[])
+{
+    w25q256_sfdp_struct info;
+    uint8_t dump[4096];
+    size_t size;
+    FILE *file;
+    
+    if(argc > 1)
+    {
+        file = fopen(argv[1], "rb");
+        if(file == NULL)
+        {
+            printf("cannot open %s\n", argv[1]);
+            return 2;
+        }
+        size = fread(dump, 1, sizeof(dump), file);
+        fclose(file);
+        
+        if(w25q256_sfdp_parse(dump, (uint32_t)size, &info) != 0)
+        {
+            printf("%s: no SFDP basic flash parameter table\n", argv[1]);
+            return 1;
+        }
+        printf("%s:\n", argv[1]);
+        sfdp_test_print(&info);
+        return 0;
+    }
+    
+    if(sfdp_test_run() != 0)
+    {
+        printf("sfdp_test: %u checks failed\n", sfdp_test_failed);
+        return 1;
+    }
+    
+    w25q256_sfdp_parse(sfdp_w25q256jv, sizeof(sfdp_w25q256jv), &info);
+    printf("w25q256jv:\n");
+    sfdp_test_print(&info);
+    printf("sfdp_test: all checks passed\n");
+    
+    return 0;
+}
@@ -0,0 +1,5 @@
+/* host build: a small font area keeps the telemetry ring short */
+#ifndef __HOST_FONTS_H
+#define __HOST_FONTS_H
+#define FONTSECSIZE         4
+#endif /* __HOST_FONTS_H */
@@ -0,0 +1,14 @@
+/* host stand-in for the FreeRTOS API used by telemetry_log.c: one thread, no scheduler */
+#ifndef __HOST_FREERTOS_H
+#define __HOST_FREERTOS_H
+#include <stdint.h>
+
+typedef void *SemaphoreHandle_t;
+
+#define portMAX_DELAY                   0xFFFFFFFFU
+#define taskSCHEDULER_NOT_STARTED       1
+#define xTaskGetSchedulerState()        taskSCHEDULER_NOT_STARTED
+#define xSemaphoreCreateMutex()         ((SemaphoreHandle_t)1)
+#define xSemaphoreTake(lock, ticks)     ((void)(lock), (void)(ticks))
+#define xSemaphoreGive(lock)            ((void)(lock))
+#endif /* __HOST_FREERTOS_H */
@@ -0,0 +1,9 @@
+/* host build: the memory pools are the C heap */
+#ifndef __HOST_MALLOC_H
+#define __HOST_MALLOC_H
+#include <stdlib.h>
+
+#define SRAMEX                          1
+#define mymalloc(pool, size)            malloc(size)
+#define myfree(pool, ptr)               free(ptr)
+#endif /* __HOST_MALLOC_H */
@@ -0,0 +1,8 @@
+/* host build: the cycle counter does not run */
+#ifndef __HOST_SYSTEM_H
+#define __HOST_SYSTEM_H
+#include <stdint.h>
+
+#define DWT_CYCCNT                      0U
+#define SystemCoreClock                 600000000U
+#endif /* __HOST_SYSTEM_H */
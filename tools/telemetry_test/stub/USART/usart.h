@@ -0,0 +1,9 @@
+/* host build: errors only, the torn record warnings are expected */
+#ifndef __HOST_USART_H
+#define __HOST_USART_H
+#include <stdio.h>
+
+#define PRINT_ERROR(fmt, ...)   printf("[ERROR] " fmt, ##__VA_ARGS__)
+#define PRINT_WARN(fmt, ...)    do {} while(0)
+#define PRINT_INFO(fmt, ...)    do {} while(0)
+#endif /* __HOST_USART_H */
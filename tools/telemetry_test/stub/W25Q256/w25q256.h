@@ -0,0 +1,12 @@
+/* host build: the flash model in telemetry_test.c, the ring is TELEMETRY_TEST_SECTORS long */
+#ifndef __HOST_W25Q256_H
+#define __HOST_W25Q256_H
+#include <stdint.h>
+
+#define TELEMETRY_TEST_SECTORS          8
+#define W25Q256_CHECK_ADDR              ((FONTSECSIZE + TELEMETRY_TEST_SECTORS) * 4096)
+
+uint8_t w25q256_read_data(uint32_t address, uint8_t *pbuffer, uint32_t read_size);
+void w25q256_erase_sector(uint16_t sector);
+uint8_t w25q256_program_data(uint32_t address, uint8_t *pbuffer, uint32_t write_size);
+#endif /* __HOST_W25Q256_H */
@@ -0,0 +1 @@
+/* host build: the semaphore API is in FreeRTOS.h */
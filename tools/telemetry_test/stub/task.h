@@ -0,0 +1 @@
+/* host build: the task API is in FreeRTOS.h */
@@ -0,0 +1,407 @@
+/*!
+    \file       telemetry_test.c
+    \brief      host test of the telemetry log against a NOR flash model
+    \version    1.0
+    \date       2025-09-02
+    \author     Ze-Hou
+    \note       telemetry_log.c is built unchanged over a RAM flash of
+                TELEMETRY_TEST_SECTORS sectors: a program only clears bits,
+                an erase sets a sector to 0xFF, and programming a byte that
+                is not erased is reported. Two faults are injected:
+                - power loss: an erase or program stops part way (a prefix of
+                  the bytes, one byte half programmed, or a sector partly
+                  erased), the test restarts at telemetry_log_init and checks
+                  the log read back
+                - program failure: w25q256_program_data returns an error
+                  after a partial program, the log must keep every record
+                  appended before and after it readable, and
+                  telemetry_log_erase must leave no sector behind
+                A record's payload, length and time follow from its number,
+                so every record read is checked in full.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include "./TELEMETRY/telemetry_log.h"
+
+#define TELEMETRY_TEST_POWER_CYCLES     3000                /* power losses injected */
+#define TELEMETRY_TEST_POWER_OPS        48                  /* a loss within this many flash operations */
+#define TELEMETRY_TEST_APPENDS          20000               /* appends with program failures */
+#define TELEMETRY_TEST_FAIL_RATE        16                  /* 1 program in this many fails */
+
+static uint8_t telemetry_test_flash[W25Q256_CHECK_ADDR];
+static jmp_buf telemetry_test_power;
+static uint32_t telemetry_test_ops = 0;                     /* flash operations so far */
+static uint32_t telemetry_test_loss_at = 0;                 /* operation that loses the power, 0: none */
+static uint32_t telemetry_test_fail_rate = 0;               /* 0: programs do not fail */
+static uint32_t telemetry_test_overprogram = 0;
+static uint32_t telemetry_test_torn = 0;                    /* torn records found by all restarts */
+static unsigned int telemetry_test_failed = 0;
+static uint32_t telemetry_test_rand_state = 1;
+
+/*!
+    \brief      xorshift32, the runs repeat for a given seed
+*/
+static uint32_t telemetry_test_rand(void)
+{
+    telemetry_test_rand_state ^= telemetry_test_rand_state << 13;
+    telemetry_test_rand_state ^= telemetry_test_rand_state >> 17;
+    telemetry_test_rand_state ^= telemetry_test_rand_state << 5;
+
+    return telemetry_test_rand_state;
+}
+
+/*!
+    \brief      flash model: read
+*/
+uint8_t w25q256_read_data(uint32_t address, uint8_t *pbuffer, uint32_t read_size)
+{
+    if((address < TELEMETRY_LOG_START) || (address + read_size > sizeof(telemetry_test_flash)))
+    {
+        printf("FAIL read outside the ring: 0x%X + %u\n", (unsigned int)address, (unsigned int)read_size);
+        telemetry_test_failed++;
+        return 1;
+    }
+    memcpy(pbuffer, telemetry_test_flash + address, read_size);
+
+    return 0;
+}
+
+/*!
+    \brief      flash model: 4KB sector erase, may lose the power half way
+*/
+void w25q256_erase_sector(uint16_t sector)
+{
+    uint8_t *data = telemetry_test_flash + (uint32_t)sector * 4096;
+    uint32_t i;
+
+    if(((uint32_t)sector < FONTSECSIZE) || ((uint32_t)sector * 4096 >= sizeof(telemetry_test_flash)))
+    {
+        printf("FAIL erase outside the ring: sector %u\n", (unsigned int)sector);
+        telemetry_test_failed++;
+        return;
+    }
+
+    if(++telemetry_test_ops == telemetry_test_loss_at)
+    {
+        /* bits drift towards 1 unevenly: some bytes erased, some partly, some untouched */
+        for(i = 0; i < 4096; i++)
+        {
+            switch(telemetry_test_rand() % 3)
+            {
+                case 0: data[i] = 0xFF; break;
+                case 1: data[i] |= (uint8_t)telemetry_test_rand(); break;
+                default: break;
+            }
+        }
+        longjmp(telemetry_test_power, 1);
+    }
+    memset(data, 0xFF, 4096);
+}
+
+/*!
+    \brief      flash model: program, may lose the power or fail half way
+*/
+uint8_t w25q256_program_data(uint32_t address, uint8_t *pbuffer, uint32_t write_size)
+{
+    uint32_t i, done = write_size;
+    uint8_t fault = 0, erased;
+
+    if((address < TELEMETRY_LOG_START) || (address + write_size > sizeof(telemetry_test_flash)) ||
+       ((address & 0xFFF) + write_size > 4096))
+    {
+        printf("FAIL program outside a ring sector: 0x%X + %u\n", (unsigned int)address, (unsigned int)write_size);
+        telemetry_test_failed++;
+        return 1;
+    }
+
+    if(++telemetry_test_ops == telemetry_test_loss_at)
+    {
+        fault = 1;
+    }
+    else if((telemetry_test_fail_rate != 0) && (telemetry_test_rand() % telemetry_test_fail_rate == 0))
+    {
+        fault = 2;
+    }
+    if(fault)
+    {
+        /* cut at a byte that changes, the record is always left incomplete */
+        for(done = write_size; (done > 0) && (pbuffer[done - 1] == 0xFF); done--);
+        if(done == 0)return (fault == 2) ? 1 : 0;
+        for(done = telemetry_test_rand() % done; pbuffer[done] == 0xFF; done++);
+    }
+
+    for(i = 0; i < done; i++)
+    {
+        if((pbuffer[i] != 0xFF) && (telemetry_test_flash[address + i] != 0xFF))
+        {
+            telemetry_test_overprogram++;
+        }
+        telemetry_test_flash[address + i] &= pbuffer[i];
+    }
+    if(fault)
+    {
+        /* cut mid byte: of the bits to clear, some and at least the lowest stay 1 */
+        erased = (uint8_t)~pbuffer[done];
+        erased &= (uint8_t)telemetry_test_rand() | (uint8_t)(erased & -erased);
+        telemetry_test_flash[address + done] &= pbuffer[done] | erased;
+        if(fault == 1)
+        {
+            longjmp(telemetry_test_power, 1);
+        }
+        return 1;
+    }
+
+    return 0;
+}
+
+/*!
+    \brief      payload length, bytes and time of record number id
+*/
+static uint16_t telemetry_test_length(uint32_t id)
+{
+    return (uint16_t)((id * 2654435761U) >> 16) % (TELEMETRY_LOG_PAYLOAD_MAX + 1);
+}
+
+static void telemetry_test_payload(uint32_t id, uint8_t *data)
+{
+    uint16_t i, length = telemetry_test_length(id);
+
+    memcpy(data, &id, sizeof(id) < length ? sizeof(id) : length);
+    for(i = sizeof(id); i < length; i++)
+    {
+        data[i] = (uint8_t)(id * 31 + i);
+    }
+}
+
+/*!
+    \brief      record number of a record read back, 0 when the record is not one appended
+*/
+static uint32_t telemetry_test_check(const telemetry_log_record_struct *record, const uint8_t *data)
+{
+    uint8_t expect[TELEMETRY_LOG_PAYLOAD_MAX];
+    uint32_t id = record->time;
+
+    telemetry_test_payload(id, expect);
+    if((id == 0) || (record->type != TELEMETRY_TYPE_USER) || (record->length != telemetry_test_length(id)) ||
+       (memcmp(data, expect, record->length) != 0))
+    {
+        return 0;
+    }
+
+    return id;
+}
+
+/*!
+    \brief      read the whole log and check it
+    \param[in]  name: phase, for the messages
+    \param[in]  acked: newest record whose append returned 0, 0: none
+    \param[in]  lost_ok: 1: records of the oldest sector may be missing (a cut erase leaves its header)
+    \param[out] none
+    \retval     newest record number read, 0: log empty
+*/
+static uint32_t telemetry_test_verify(const char *name, uint32_t acked, uint8_t lost_ok)
+{
+    telemetry_log_cursor_struct cursor;
+    telemetry_log_record_struct record;
+    uint8_t data[TELEMETRY_LOG_PAYLOAD_MAX];
+    uint32_t id, last = 0, first_sector_last = 0, target, expect, count = 0;
+    uint16_t first_sector = 0xFFFF;
+    int res;
+
+    res = telemetry_log_seek(0, &cursor);
+    while((res == 1) && ((res = telemetry_log_read(&cursor, &record, data, sizeof(data))) == 1))
+    {
+        id = telemetry_test_check(&record, data);
+        if(id == 0)
+        {
+            printf("FAIL %s: record %u read back corrupted\n", name, (unsigned int)record.time);
+            telemetry_test_failed++;
+            return last;
+        }
+        if(first_sector == 0xFFFF)first_sector = cursor.sector;
+        if((last != 0) && ((id <= last) || ((id != last + 1) && !(lost_ok && (cursor.sector == first_sector)))))
+        {
+            printf("FAIL %s: record %u read after %u\n", name, (unsigned int)id, (unsigned int)last);
+            telemetry_test_failed++;
+            return last;
+        }
+        if(cursor.sector == first_sector)first_sector_last = id;
+        last = id;
+        count++;
+    }
+    if(res < 0)
+    {
+        printf("FAIL %s: read error\n", name);
+        telemetry_test_failed++;
+    }
+
+    /* the newest acknowledged record survives, the one cut in flight may have been completed */
+    if((last < acked) || (last > acked + 1))
+    {
+        printf("FAIL %s: newest record %u, acknowledged %u (%u records read)\n", name, (unsigned int)last, (unsigned int)acked, (unsigned int)count);
+        telemetry_test_failed++;
+        return last;
+    }
+
+    /* seek behind the oldest sector lands on the first record not older than the target */
+    if(last > first_sector_last)
+    {
+        target = first_sector_last + 1 + telemetry_test_rand() % (last - first_sector_last);
+        expect = target;
+        if((telemetry_log_seek(target, &cursor) != 1) || (telemetry_log_read(&cursor, &record, data, sizeof(data)) != 1) ||
+           (telemetry_test_check(&record, data) != expect))
+        {
+            printf("FAIL %s: seek %u\n", name, (unsigned int)target);
+            telemetry_test_failed++;
+        }
+    }
+    /* a torn record may stop the seek, nothing is read behind it */
+    if((last != 0) && (telemetry_log_seek(last + 1, &cursor) == 1) && (telemetry_log_read(&cursor, &record, data, sizeof(data)) != 0))
+    {
+        printf("FAIL %s: seek past the newest record\n", name);
+        telemetry_test_failed++;
+    }
+
+    return last;
+}
+
+/*!
+    \brief      append record number id
+*/
+static int telemetry_test_append(uint32_t id)
+{
+    uint8_t data[TELEMETRY_LOG_PAYLOAD_MAX];
+
+    telemetry_test_payload(id, data);
+
+    return telemetry_log_append(TELEMETRY_TYPE_USER, id, data, telemetry_test_length(id));
+}
+
+/*!
+    \brief      power losses at random erases and programs, restart after each
+*/
+static void telemetry_test_power_loss(void)
+{
+    /* volatile: kept across the longjmp out of the flash model */
+    volatile uint32_t cycle = 0, acked = 0, next = 1, appends = 0;
+    uint32_t last;
+
+    memset(telemetry_test_flash, 0xFF, sizeof(telemetry_test_flash));
+    telemetry_test_fail_rate = 0;
+    telemetry_test_loss_at = telemetry_test_ops + 1 + telemetry_test_rand() % TELEMETRY_TEST_POWER_OPS;
+
+    if(setjmp(telemetry_test_power) != 0)
+    {
+        cycle++;
+        telemetry_test_loss_at = 0;
+        if(telemetry_log_init() != 0)
+        {
+            printf("FAIL power loss: init\n");
+            telemetry_test_failed++;
+            return;
+        }
+        telemetry_test_torn += telemetry_log_info.torn;
+        last = telemetry_test_verify("power loss", acked, 1);
+        if(telemetry_test_failed)return;
+        if(last > acked)acked = last;               /* the cut record was complete */
+        next = acked + 1;
+        if(cycle == TELEMETRY_TEST_POWER_CYCLES)
+        {
+            printf("ok   power loss: %u cycles, %u appends, %u torn records, erase count max %u\n", (unsigned int)cycle,
+                   (unsigned int)appends, (unsigned int)telemetry_test_torn, (unsigned int)telemetry_log_info.max_erase_count);
+            return;
+        }
+        telemetry_test_loss_at = telemetry_test_ops + 1 + telemetry_test_rand() % TELEMETRY_TEST_POWER_OPS;
+    }
+    else if(telemetry_log_init() != 0)
+    {
+        printf("FAIL power loss: init\n");
+        telemetry_test_failed++;
+        return;
+    }
+
+    for(;;)
+    {
+        if(telemetry_test_append(next) != 0)
+        {
+            printf("FAIL power loss: append %u\n", (unsigned int)next);
+            telemetry_test_failed++;
+            return;
+        }
+        acked = next++;
+        appends++;
+    }
+}
+
+/*!
+    \brief      program failures, the log is read back after every append
+*/
+static void telemetry_test_program_fail(void)
+{
+    uint32_t i, acked = 0, next = 1, failures = 0;
+
+    memset(telemetry_test_flash, 0xFF, sizeof(telemetry_test_flash));
+    telemetry_test_loss_at = 0;
+    telemetry_test_fail_rate = TELEMETRY_TEST_FAIL_RATE;
+    telemetry_log_init();
+
+    for(i = 0; (i < TELEMETRY_TEST_APPENDS) && (telemetry_test_failed == 0); i++)
+    {
+        if(telemetry_test_append(next) == 0)
+        {
+            acked = next++;
+        }
+        else
+        {
+            failures++;                             /* the same record again next time */
+        }
+        telemetry_test_verify("program failure", acked, 0);
+
+        if(i % 997 == 0)
+        {
+            telemetry_log_init();                   /* holes are found again after a restart */
+            telemetry_test_verify("program failure restart", acked, 0);
+        }
+        if(i % 1499 == 1498)
+        {
+            /* sectors left by failed programs are erased too, nothing comes back after a restart */
+            telemetry_log_erase();
+            telemetry_log_init();
+            acked = 0;
+            if((telemetry_test_verify("erase", acked, 0) != 0) || (telemetry_log_info.used_sectors != 0))
+            {
+                printf("FAIL erase: %u sectors left\n", (unsigned int)telemetry_log_info.used_sectors);
+                telemetry_test_failed++;
+            }
+        }
+    }
+    telemetry_test_fail_rate = 0;
+
+    if(telemetry_test_failed == 0)
+    {
+        printf("ok   program failure: %u appends, %u failed\n", (unsigned int)i, (unsigned int)failures);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc > 1)
+    {
+        telemetry_test_rand_state = (uint32_t)strtoul(argv[1], NULL, 0) | 1;
+    }
+
+    telemetry_test_power_loss();
+    if(telemetry_test_failed == 0)telemetry_test_program_fail();
+
+    if(telemetry_test_overprogram != 0)
+    {
+        printf("FAIL %u bytes programmed that were not erased\n", (unsigned int)telemetry_test_overprogram);
+        telemetry_test_failed++;
+    }
+    printf("%s\n", telemetry_test_failed ? "FAILED" : "all passed");
+
+    return telemetry_test_failed ? 1 : 0;
+}
@@ -0,0 +1,235 @@
+#!/usr/bin/env python3
+"""Encode a wallpaper into the compressed .wpz format read by lvgl_wallpaper.c.
+
+    wpz_encode.py wallpaper.bin wallpaper.wpz       LVGL RGB565 image (.bin)
+    wpz_encode.py wallpaper.png wallpaper.wpz       any image Pillow can open
+    wpz_encode.py --self-test                       round trip on synthetic images
+
+Layout (see lvgl_wallpaper.h), all values little endian:
+    header   magic "WPZ1", w, h, tile_h, tile_num (uint16), method, cf (uint8),
+             reserved (uint16)                                      16 bytes
+    table    tile_num uint32 tile sizes, bit 31 set: tile stored raw
+    tiles    tile_h full-width rows each, the last one may be shorter
+RLE16 control byte c: bit7 set repeats the following pixel (c & 0x7F) + 1 times,
+bit7 clear copies the following c + 1 pixels.
+
+Copy the result to C:/SYSTEM/wallpaper/ on the device volume, the settings
+page lists every .wpz and .bin file of that directory.
+"""
+
+import argparse
+import random
+import struct
+import sys
+
+WPZ_MAGIC = 0x315A5057              # LVGL_WALLPAPER_MAGIC
+WPZ_METHOD_RLE16 = 1                # LVGL_WALLPAPER_METHOD_RLE16
+WPZ_TILE_RAW = 0x80000000           # LVGL_WALLPAPER_TILE_RAW
+WPZ_WIDTH_MAX = 800                 # LVGL_WALLPAPER_WIDTH
+WPZ_HEIGHT_MAX = 480                # LVGL_WALLPAPER_HEIGHT
+LV_IMAGE_HEADER_MAGIC = 0x19
+LV_COLOR_FORMAT_RGB565 = 0x12
+RUN_MAX = 128                       # (0x7F) + 1
+
+
+def rle16_encode(pixels):
+    """Code a list of RGB565 values, runs of two or more become repeats."""
+    out = bytearray()
+    literal = []
+
+    def flush():
+        while literal:
+            chunk = literal[:RUN_MAX]
+            del literal[:RUN_MAX]
+            out.append(len(chunk) - 1)
+            out.extend(struct.pack("<%dH" % len(chunk), *chunk))
+
+    i = 0
+    n = len(pixels)
+    while i < n:
+        run = 1
+        while i + run < n and run < RUN_MAX and pixels[i + run] == pixels[i]:
+            run += 1
+        if run >= 2:
+            flush()
+            out.append(0x80 | (run - 1))
+            out.extend(struct.pack("<H", pixels[i]))
+        else:
+            literal.append(pixels[i])
+        i += run
+    flush()
+    return bytes(out)
+
+
+def rle16_decode(data, count):
+    """Mirror of lvgl_wallpaper_rle_decode, raises ValueError where it returns 1."""
+    pixels = []
+    pos = 0
+    while pos < len(data) and len(pixels) < count:
+        c = data[pos]
+        pos += 1
+        run = (c & 0x7F) + 1
+        if count - len(pixels) < run:
+            raise ValueError("run past the end of the tile")
+        if c & 0x80:
+            if len(data) - pos < 2:
+                raise ValueError("truncated repeat")
+            pixels.extend([struct.unpack_from("<H", data, pos)[0]] * run)
+            pos += 2
+        else:
+            if len(data) - pos < run * 2:
+                raise ValueError("truncated literal")
+            pixels.extend(struct.unpack_from("<%dH" % run, data, pos))
+            pos += run * 2
+    if pos != len(data) or len(pixels) != count:
+        raise ValueError("tile size mismatch")
+    return pixels
+
+
+def wpz_encode(w, h, pixels, tile_h):
+    """Build a .wpz file from w * h RGB565 values, row major."""
+    if not (0 < w <= WPZ_WIDTH_MAX and 0 < h <= WPZ_HEIGHT_MAX):
+        raise ValueError("%ux%u exceeds %ux%u" % (w, h, WPZ_WIDTH_MAX, WPZ_HEIGHT_MAX))
+    if not 0 < tile_h <= h:
+        raise ValueError("tile height %u out of range" % tile_h)
+    tile_num = (h + tile_h - 1) // tile_h
+    table = []
+    tiles = bytearray()
+    for tile in range(tile_num):
+        rows = min(tile_h, h - tile * tile_h)
+        part = pixels[tile * tile_h * w:(tile * tile_h + rows) * w]
+        raw = struct.pack("<%dH" % len(part), *part)
+        rle = rle16_encode(part)
+        if len(rle) < len(raw):
+            table.append(len(rle))
+            tiles += rle
+        else:
+            table.append(len(raw) | WPZ_TILE_RAW)
+            tiles += raw
+    header = struct.pack("<IHHHHBBH", WPZ_MAGIC, w, h, tile_h, tile_num,
+                         WPZ_METHOD_RLE16, LV_COLOR_FORMAT_RGB565, 0)
+    return header + struct.pack("<%dI" % tile_num, *table) + bytes(tiles)
+
+
+def wpz_decode(data):
+    """Check a .wpz file the way lvgl_wallpaper_load_wpz does, return (w, h, pixels)."""
+    magic, w, h, tile_h, tile_num, method, cf, _ = struct.unpack_from("<IHHHHBBH", data, 0)
+    if magic != WPZ_MAGIC:
+        raise ValueError("not a .wpz file")
+    if (not 0 < w <= WPZ_WIDTH_MAX or not 0 < h <= WPZ_HEIGHT_MAX or tile_h == 0 or
+            tile_num != (h + tile_h - 1) // tile_h or method != WPZ_METHOD_RLE16 or
+            cf != LV_COLOR_FORMAT_RGB565):
+        raise ValueError("bad header")
+    tile_max = w * tile_h * 2
+    table = struct.unpack_from("<%dI" % tile_num, data, 16)
+    offset = 16 + tile_num * 4
+    pixels = []
+    for tile, entry in enumerate(table):
+        size = entry & ~WPZ_TILE_RAW
+        if size > tile_max or offset + size > len(data):
+            raise ValueError("tile %u size %u" % (tile, size))
+        rows = min(tile_h, h - tile * tile_h)
+        chunk = data[offset:offset + size]
+        if entry & WPZ_TILE_RAW:
+            if size != w * rows * 2:
+                raise ValueError("raw tile %u size %u" % (tile, size))
+            pixels.extend(struct.unpack("<%dH" % (w * rows), chunk))
+        else:
+            pixels.extend(rle16_decode(chunk, w * rows))
+        offset += size
+    return w, h, pixels
+
+
+def load_bin(data):
+    """RGB565 pixels of an LVGL image file (12-byte lv_image_header_t)."""
+    if len(data) < 12 or data[0] != LV_IMAGE_HEADER_MAGIC or data[1] != LV_COLOR_FORMAT_RGB565:
+        raise ValueError("not an RGB565 LVGL image")
+    w, h, stride = struct.unpack_from("<HHH", data, 4)
+    if stride < w * 2 or len(data) < 12 + stride * h:
+        raise ValueError("truncated LVGL image")
+    pixels = []
+    for y in range(h):
+        pixels.extend(struct.unpack_from("<%dH" % w, data, 12 + y * stride))
+    return w, h, pixels
+
+
+def load_image(path):
+    """RGB565 pixels of a .bin or, through Pillow, of any image file."""
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:1] == bytes([LV_IMAGE_HEADER_MAGIC]):
+        return load_bin(data)
+    try:
+        from PIL import Image
+    except ImportError:
+        raise ValueError("%s is not an LVGL .bin image and Pillow is not installed" % path)
+    image = Image.open(path).convert("RGB")
+    w, h = image.size
+    pixels = [((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3) for r, g, b in image.getdata()]
+    return w, h, pixels
+
+
+def self_test():
+    rng = random.Random(1)
+    cases = {
+        "flat": (800, 480, lambda x, y: 0x39E7),
+        "gradient": (800, 480, lambda x, y: ((y * 31 // 479) << 11) | (x * 63 // 799) << 5),
+        "noise": (123, 77, lambda x, y: rng.getrandbits(16)),
+        "bands": (320, 241, lambda x, y: 0xF800 if (x // 3) & 1 else 0x001F),
+    }
+    for name, (w, h, fn) in cases.items():
+        pixels = [fn(x, y) for y in range(h) for x in range(w)]
+        for tile_h in (1, 16, 60, h):
+            data = wpz_encode(w, h, pixels, tile_h)
+            if wpz_decode(data) != (w, h, pixels):
+                print("FAIL %s tile_h %u" % (name, tile_h))
+                return 1
+        print("ok   %-8s %ux%u: %u -> %u bytes" % (name, w, h, w * h * 2, len(wpz_encode(w, h, pixels, 16))))
+
+    # runs at the 128 pixel limit and a literal next to a repeat
+    pixels = [1] * 128 + [2] * 129 + [3, 4, 4, 5]
+    if rle16_decode(rle16_encode(pixels), len(pixels)) != pixels:
+        print("FAIL run limits")
+        return 1
+    for bad in (b"\x81\x00", b"\x01\x00\x00", b"\xff\x00\x00"):
+        try:
+            rle16_decode(bad, 4)
+        except ValueError:
+            continue
+        print("FAIL accepted %r" % bad)
+        return 1
+    print("all passed")
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description="encode a wallpaper as .wpz (RLE16 tiles)")
+    parser.add_argument("input", nargs="?", help="LVGL RGB565 .bin or an image file")
+    parser.add_argument("output", nargs="?", help=".wpz file to write")
+    parser.add_argument("--tile-h", type=int, default=16, help="rows per tile (default 16)")
+    parser.add_argument("--self-test", action="store_true", help="run the round trip tests")
+    args = parser.parse_args()
+
+    if args.self_test:
+        return self_test()
+    if not args.input or not args.output:
+        parser.error("input and output are required")
+
+    try:
+        w, h, pixels = load_image(args.input)
+        data = wpz_encode(w, h, pixels, args.tile_h)
+        if wpz_decode(data) != (w, h, pixels):
+            raise ValueError("round trip mismatch")
+    except (OSError, ValueError) as e:
+        print("wpz_encode: %s" % e, file=sys.stderr)
+        return 1
+
+    with open(args.output, "wb") as f:
+        f.write(data)
+    print("%s: %ux%u, %u bytes -> %u bytes (%u%%)" % (args.output, w, h, w * h * 2, len(data),
+                                                     len(data) * 100 // (w * h * 2)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())